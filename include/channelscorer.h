@@ -0,0 +1,47 @@
+#ifndef _CHANNEL_SCORER_H_
+#define _CHANNEL_SCORER_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// The highest 2.4 GHz channel that may be used (US)
+constexpr int CHANNEL_SCORER_MAX_CHANNEL = 11;
+// The maximum number of networks that are checked for duplicates, later networks are still scored
+constexpr size_t CHANNEL_SCORER_MAX_NETWORKS = 32;
+// Channels closer than this overlap
+constexpr int CHANNEL_SCORER_OVERLAP = 5;
+
+/// @brief Scores 2.4 GHz channels by the networks found in a scan, independent of the wifi driver
+/// @note Every network adds its signal strength to its own channel and, reduced, to the channels it overlaps
+class ChannelScorer
+{
+public:
+    /// @brief Creates an empty scorer
+    ChannelScorer();
+
+    /// @brief Adds a scanned network, networks that were already added are ignored
+    /// @note Past CHANNEL_SCORER_MAX_NETWORKS, networks are scored without the duplicate check
+    /// @param bssid The BSSID of the network
+    /// @param channel The channel of the network
+    /// @param rssi The received signal strength in dBm
+    /// @return False if the network was ignored
+    bool add(const uint8_t *bssid, int channel, int rssi);
+    /// @brief Removes all networks
+    void clear();
+
+    /// @brief Returns the score of a channel, lower is better
+    uint32_t getScore(int channel);
+    /// @brief Returns the channel with the lowest score, preferring the non-overlapping channels 1, 6 and 11 on ties
+    int getBestChannel();
+    /// @brief Returns the number of networks that were added, past CHANNEL_SCORER_MAX_NETWORKS a network may be counted more than once
+    size_t getNetworkCount();
+
+private:
+    uint8_t bssids[CHANNEL_SCORER_MAX_NETWORKS][6];
+    size_t networkCount;
+    /// @brief The networks added after the BSSID table was full
+    size_t uncheckedCount;
+    uint32_t scores[CHANNEL_SCORER_MAX_CHANNEL + 1];
+};
+
+#endif
@@ -29,20 +29,34 @@
 #include <lwip/ip_addr.h>
 
 #define DHCPS_BASE_IP (16)
-#define DHCPS_MAX_IP (8)
+#ifndef DHCPS_MAX_IP
+#define DHCPS_MAX_IP (32) // set by PICO_RADIO_DHCP_POOL_SIZE
+#endif
+
+// The size of a reply, the BOOTP minimum of 300 bytes fits the header and all options
+#define DHCPS_REPLY_SIZE (300)
+
+#if DHCPS_BASE_IP + DHCPS_MAX_IP > 255
+#error "DHCP pool does not fit into the subnet"
+#endif
 
 typedef struct _dhcp_server_lease_t
 {
     uint8_t mac[6];
-    uint16_t expiry;
+    uint32_t expiry; // in seconds since boot
 } dhcp_server_lease_t;
 
 typedef struct _dhcp_server_t
 {
     ip_addr_t ip;
     ip_addr_t nm;
+    // indexed by IP offset, a DISCOVER places a MAC address at its hash or the next free lease, a REQUEST anywhere
     dhcp_server_lease_t lease[DHCPS_MAX_IP];
     struct udp_pcb *udp;
+    bool persist_pending;
+    // reply precomputed on init, only the client fields and message type are written per request
+    uint8_t reply[DHCPS_REPLY_SIZE];
+    uint16_t reply_opt_offset;
 } dhcp_server_t;
 
 #ifdef __cplusplus
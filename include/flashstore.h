@@ -0,0 +1,34 @@
+#ifndef _FLASH_STORE_H_
+#define _FLASH_STORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Keys of the records kept in the flash store
+#define FLASH_STORE_KEY_DHCP_LEASES (1)
+#define FLASH_STORE_KEY_AP_CHANNEL (2)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    /// @brief Reads the latest record of a key from the flash store
+    /// @param key The record key
+    /// @param data The buffer to read into
+    /// @param length The expected record length
+    /// @return False if there is no valid record of this key and length
+    bool flash_store_read(uint8_t key, void *data, size_t length);
+
+    /// @brief Writes a record to the flash store, replacing the previous record of the key
+    /// @param key The record key
+    /// @param data The record data
+    /// @param length The record length
+    /// @return True if succeeded
+    /// @note Blocks while flash is programmed, must not be called from an interrupt or the lwIP thread
+    bool flash_store_write(uint8_t key, const void *data, size_t length);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef _MDNS_RESPONDER_H_
+#define _MDNS_RESPONDER_H_
+
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include "udpsocket.h"
+
+// The mDNS port and the maximum length of a DNS name
+constexpr uint16_t MDNS_PORT = 5353;
+constexpr size_t MDNS_MAX_NAME_LENGTH = 256;
+// The maximum number of advertised services
+constexpr size_t MDNS_MAX_SERVICES = 2;
+// The maximum length of a precomputed response
+constexpr size_t MDNS_MAX_RESPONSE_LENGTH = 256;
+// The maximum length of a legacy unicast response, which echoes the question
+constexpr size_t MDNS_MAX_LEGACY_RESPONSE_LENGTH = MDNS_MAX_RESPONSE_LENGTH + MDNS_MAX_NAME_LENGTH + 6;
+// The maximum length of a handled query
+constexpr size_t MDNS_MAX_QUERY_LENGTH = 512;
+
+/// @brief A mDNS responder that answers A queries for <hostname>.local and advertises DNS-SD services
+/// @note All multicast responses are precomputed, answering a query sends one in place without copying it
+class MdnsResponder
+{
+public:
+    /// @brief Creates the responder and joins the mDNS multicast group
+    /// @param hostname The hostname to answer for, without the .local suffix
+    MdnsResponder(std::string_view hostname);
+    /// @brief Leaves the mDNS multicast group
+    ~MdnsResponder();
+
+    /// @brief Returns true if the responder is listening
+    bool isOpen();
+
+    /// @brief Advertises a service through DNS-SD, with the hostname as instance name
+    /// @param type The service type, e.g. "_networktables._tcp"
+    /// @param port The port of the service
+    /// @return True if succeeded
+    bool addService(std::string_view type, uint16_t port);
+    /// @brief Stops advertising a service
+    /// @param type The service type
+    /// @return True if the service was advertised
+    bool removeService(std::string_view type);
+
+    /// @brief Sends unsolicited responses for the hostname and all services, e.g. after the address changed
+    void announce();
+
+    /// @brief Returns the first created responder, used to advertise services of other modules
+    static MdnsResponder *getDefault();
+
+private:
+    struct Service
+    {
+        bool active = false;
+        uint16_t port = 0;
+        /// @brief e.g. "_networktables._tcp.local"
+        std::string typeName;
+        /// @brief e.g. "pico-radio._networktables._tcp.local"
+        std::string instanceName;
+        /// @brief PTR, SRV, TXT and A records for the service
+        uint8_t response[MDNS_MAX_RESPONSE_LENGTH];
+        size_t responseLength = 0;
+    };
+
+    UdpSocket *socket;
+    std::string hostname;
+    /// @brief e.g. "pico-radio.local"
+    std::string hostLocalName;
+
+    /// @brief The A record for the hostname
+    uint8_t addressResponse[MDNS_MAX_RESPONSE_LENGTH];
+    size_t addressResponseLength = 0;
+    Service services[MDNS_MAX_SERVICES];
+
+    /// @brief The address the responses were computed for
+    u32_t cachedAddress = 0;
+    /// @brief Buffer for queries that span multiple pbufs
+    uint8_t queryBuffer[MDNS_MAX_QUERY_LENGTH];
+    /// @brief Buffer for responses to legacy unicast queries, only used with the lwIP lock held
+    uint8_t legacyResponse[MDNS_MAX_LEGACY_RESPONSE_LENGTH];
+
+    /// @brief Recomputes all responses if the interface address changed
+    void updateResponses(bool force);
+    void buildAddressResponse();
+    void buildServiceResponse(Service *service);
+    /// @brief Builds the response to a legacy unicast query into legacyResponse
+    /// @param service The service to answer for, or null for the hostname
+    /// @return The length of the response, 0 if it does not fit
+    size_t buildLegacyResponse(Service *service, std::string_view question, uint16_t type);
+
+    void handleQuery(Datagram *datagram);
+    /// @brief Sends a response without copying it, to the querier if unicast, otherwise to the multicast group
+    void sendResponse(const uint8_t *response, size_t length, Datagram *query, bool unicast);
+    void sendLegacyResponse(Service *service, const uint8_t *packet, size_t length, size_t questionOffset, Datagram *query, uint16_t id);
+
+    static void receiveCallback(UdpSocket *socket, Datagram *datagram, void *args);
+};
+
+#endif
@@ -6,6 +6,8 @@
 #define CPPACK_PACKER_HPP
 
 #include <vector>
+#include <bit>
+#include <cstring>
 #include <set>
 #include <list>
 #include <map>
@@ -16,6 +18,8 @@
 #include <system_error>
 #include <unordered_map>
 #include <string>
+#include <string_view>
+#include <span>
 #include <concepts>
 #include <type_traits>
 
@@ -72,7 +76,7 @@ namespace msgpack
     // positive fixint = 0x00 - 0x7f
     // fixmap = 0x80 - 0x8f
     fixarray_start = 0x90,
-    fixarray_end = 0x9a,
+    fixarray_end = 0x9f,
     // fixstr = 0xa0 - 0xbf
     // negative fixint = 0xe0 - 0xff
 
@@ -199,10 +203,41 @@ namespace msgpack
     return msgpack::NVPValue<std::decay_t<T>>{field_name, std::forward<T>(field_value)};
   }
 
+  // Stores an unsigned integer at an unaligned position in network byte order
+  template <class T>
+  inline void store_big_endian(uint8_t *position, T value)
+  {
+    if constexpr (std::endian::native == std::endian::little)
+    {
+      value = std::byteswap(value);
+    }
+    std::memcpy(position, &value, sizeof(T));
+  }
+
+  // Loads an unsigned integer in network byte order from an unaligned position
+  template <class T>
+  inline T load_big_endian(const uint8_t *position)
+  {
+    T value;
+    std::memcpy(&value, position, sizeof(T));
+    if constexpr (std::endian::native == std::endian::little)
+    {
+      value = std::byteswap(value);
+    }
+    return value;
+  }
+
   template <bool nvp_packing = false>
   class Packer
   {
   public:
+    Packer() = default;
+
+    // Packs into a caller owned buffer instead of the internal vector, nothing is allocated.
+    // Once an object does not fit the packer stops writing, check overflowed() before using the bytes
+    Packer(uint8_t *buffer, std::size_t capacity)
+        : buffer(buffer), buffer_capacity(capacity), external(true) {};
+
     template <class... Types>
       requires(nvp_packing && (IsNVPValue<Types> && ...))
     void operator()(const Types &...args)
@@ -250,23 +285,15 @@ namespace msgpack
       if (size < 16)
       {
         auto size_mask = uint8_t(0b10010000);
-        serialized_object.emplace_back(uint8_t(size | size_mask));
+        put(uint8_t(size | size_mask));
       }
       else if (size < std::numeric_limits<uint16_t>::max())
       {
-        serialized_object.emplace_back(array16);
-        for (auto i = sizeof(uint16_t); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(size >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(array16, uint16_t(size));
       }
       else if (size < std::numeric_limits<uint32_t>::max())
       {
-        serialized_object.emplace_back(array32);
-        for (auto i = sizeof(uint32_t); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(size >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(array32, uint32_t(size));
       }
       else
       {
@@ -274,18 +301,96 @@ namespace msgpack
       }
     }
 
+    // The packed bytes of a packer without a caller buffer
     const std::vector<uint8_t> &vector() const
     {
       return serialized_object;
     }
 
+    const uint8_t *data() const
+    {
+      return external ? buffer : serialized_object.data();
+    }
+
+    std::size_t size() const
+    {
+      return external ? buffer_length : serialized_object.size();
+    }
+
+    // True if the caller buffer was too small, the packed bytes are incomplete
+    bool overflowed() const
+    {
+      return overflow;
+    }
+
     void clear()
     {
       serialized_object.clear();
+      buffer_length = 0;
+      overflow = false;
     }
 
   private:
     std::vector<uint8_t> serialized_object{};
+    uint8_t *buffer = nullptr;
+    std::size_t buffer_length = 0;
+    std::size_t buffer_capacity = 0;
+    bool external = false;
+    bool overflow = false;
+
+    // Returns room for count bytes at the end of the packed data, or nullptr once the caller buffer is full
+    uint8_t *claim(std::size_t count)
+    {
+      if (!external)
+      {
+        auto size = serialized_object.size();
+        serialized_object.resize(size + count);
+        return serialized_object.data() + size;
+      }
+      if (overflow || buffer_capacity - buffer_length < count)
+      {
+        overflow = true;
+        return nullptr;
+      }
+      auto position = buffer + buffer_length;
+      buffer_length += count;
+      return position;
+    }
+
+    void put(uint8_t byte)
+    {
+      if (!external)
+      {
+        serialized_object.push_back(byte);
+      }
+      else if (auto position = claim(1))
+      {
+        *position = byte;
+      }
+    }
+
+    void put(const uint8_t *bytes, std::size_t count)
+    {
+      if (count == 0)
+      {
+        return;
+      }
+      if (auto position = claim(count))
+      {
+        std::memcpy(position, bytes, count);
+      }
+    }
+
+    // Writes a format byte followed by a big endian value
+    template <class T>
+    void put_big_endian(uint8_t format, T value)
+    {
+      if (auto position = claim(1 + sizeof(T)))
+      {
+        position[0] = format;
+        store_big_endian(position + 1, value);
+      }
+    }
 
     template <typename T>
       requires IsNVPValue<T>
@@ -310,8 +415,7 @@ namespace msgpack
       {
         auto recursive_packer = Packer<nvp_packing>{};
         const_cast<T &>(value).pack(recursive_packer);
-        auto vec = recursive_packer.vector();
-        serialized_object.insert(serialized_object.end(), vec.begin(), vec.end());
+        put(recursive_packer.data(), recursive_packer.size());
       }
     }
 
@@ -334,27 +438,7 @@ namespace msgpack
     template <class T>
     void pack_map(const T &map)
     {
-      if (map.size() < 16)
-      {
-        auto size_mask = uint8_t(0b10000000);
-        serialized_object.emplace_back(uint8_t(map.size() | size_mask));
-      }
-      else if (map.size() < std::numeric_limits<uint16_t>::max())
-      {
-        serialized_object.emplace_back(map16);
-        for (auto i = sizeof(uint16_t); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(map.size() >> (8U * (i - 1)) & 0xff));
-        }
-      }
-      else if (map.size() < std::numeric_limits<uint32_t>::max())
-      {
-        serialized_object.emplace_back(map32);
-        for (auto i = sizeof(uint32_t); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(map.size() >> (8U * (i - 1)) & 0xff));
-        }
-      }
+      pack_map_header(map.size());
       for (const auto &elem : map)
       {
         pack_type(std::get<0>(elem));
@@ -364,78 +448,23 @@ namespace msgpack
 
     void pack_map(std::map<std::string, skip> map)
     {
-      if (map.size() < 16)
-      {
-        auto size_mask = uint8_t(0b10000000);
-        serialized_object.emplace_back(uint8_t(map.size() | size_mask));
-      }
-      else if (map.size() < std::numeric_limits<uint16_t>::max())
-      {
-        serialized_object.emplace_back(map16);
-        for (auto i = sizeof(uint16_t); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(map.size() >> (8U * (i - 1)) & 0xff));
-        }
-      }
-      else if (map.size() < std::numeric_limits<uint32_t>::max())
-      {
-        serialized_object.emplace_back(map32);
-        for (auto i = sizeof(uint32_t); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(map.size() >> (8U * (i - 1)) & 0xff));
-        }
-      }
-    }
-
-    std::bitset<64> twos_complement(int64_t value)
-    {
-      if (value < 0)
-      {
-        auto abs_v = llabs(value);
-        return ~abs_v + 1;
-      }
-      else
-      {
-        return {(uint64_t)value};
-      }
+      pack_map_header(map.size());
     }
 
-    std::bitset<32> twos_complement(int32_t value)
+    void pack_map_header(std::size_t size)
     {
-      if (value < 0)
-      {
-        auto abs_v = abs(value);
-        return ~abs_v + 1;
-      }
-      else
-      {
-        return {(uint32_t)value};
-      }
-    }
-
-    std::bitset<16> twos_complement(int16_t value)
-    {
-      if (value < 0)
-      {
-        auto abs_v = abs(value);
-        return ~abs_v + 1;
-      }
-      else
+      if (size < 16)
       {
-        return {(uint16_t)value};
+        auto size_mask = uint8_t(0b10000000);
+        put(uint8_t(size | size_mask));
       }
-    }
-
-    std::bitset<8> twos_complement(int8_t value)
-    {
-      if (value < 0)
+      else if (size < std::numeric_limits<uint16_t>::max())
       {
-        auto abs_v = abs(value);
-        return ~abs_v + 1;
+        put_big_endian(map16, uint16_t(size));
       }
-      else
+      else if (size < std::numeric_limits<uint32_t>::max())
       {
-        return {(uint8_t)value};
+        put_big_endian(map32, uint32_t(size));
       }
     }
 
@@ -447,9 +476,9 @@ namespace msgpack
     {
       if (value > 31 || value < -32)
       {
-        serialized_object.emplace_back(int8);
+        put(int8);
       }
-      serialized_object.emplace_back(uint8_t(twos_complement(value).to_ulong()));
+      put(uint8_t(value));
     }
 
     void pack_type(const int16_t &value)
@@ -460,12 +489,7 @@ namespace msgpack
       }
       else
       {
-        serialized_object.emplace_back(int16);
-        auto serialize_value = uint16_t(twos_complement(value).to_ulong());
-        for (auto i = sizeof(value); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(serialize_value >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(int16, uint16_t(value));
       }
     }
 
@@ -477,12 +501,7 @@ namespace msgpack
       }
       else
       {
-        serialized_object.emplace_back(int32);
-        auto serialize_value = uint32_t(twos_complement(value).to_ulong());
-        for (auto i = sizeof(value); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(serialize_value >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(int32, uint32_t(value));
       }
     }
 
@@ -494,12 +513,7 @@ namespace msgpack
       }
       else
       {
-        serialized_object.emplace_back(int64);
-        auto serialize_value = uint64_t(twos_complement(value).to_ullong());
-        for (auto i = sizeof(value); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(serialize_value >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(int64, uint64_t(value));
       }
     }
 
@@ -507,12 +521,11 @@ namespace msgpack
     {
       if (value <= 0x7f)
       {
-        serialized_object.emplace_back(value);
+        put(value);
       }
       else
       {
-        serialized_object.emplace_back(uint8);
-        serialized_object.emplace_back(value);
+        put_big_endian(uint8, value);
       }
     }
 
@@ -520,11 +533,7 @@ namespace msgpack
     {
       if (value > std::numeric_limits<uint8_t>::max())
       {
-        serialized_object.emplace_back(uint16);
-        for (auto i = sizeof(value); i > 0U; --i)
-        {
-          serialized_object.emplace_back(uint8_t(value >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(uint16, value);
       }
       else
       {
@@ -536,11 +545,7 @@ namespace msgpack
     {
       if (value > std::numeric_limits<uint16_t>::max())
       {
-        serialized_object.emplace_back(uint32);
-        for (auto i = sizeof(value); i > 0U; --i)
-        {
-          serialized_object.emplace_back(uint8_t(value >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(uint32, value);
       }
       else
       {
@@ -552,11 +557,7 @@ namespace msgpack
     {
       if (value > std::numeric_limits<uint32_t>::max())
       {
-        serialized_object.emplace_back(uint64);
-        for (auto i = sizeof(value); i > 0U; --i)
-        {
-          serialized_object.emplace_back(uint8_t(value >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(uint64, value);
       }
       else
       {
@@ -566,18 +567,18 @@ namespace msgpack
 
     void pack_type(const std::nullptr_t & /*value*/)
     {
-      serialized_object.emplace_back(nil);
+      put(nil);
     }
 
     void pack_type(const bool &value)
     {
       if (value)
       {
-        serialized_object.emplace_back(true_bool);
+        put(true_bool);
       }
       else
       {
-        serialized_object.emplace_back(false_bool);
+        put(false_bool);
       }
     }
 
@@ -586,36 +587,14 @@ namespace msgpack
       double integral_part;
       auto fractional_remainder = float(modf(value, &integral_part));
 
-      if (fractional_remainder == 0)
+      // NaN, infinities and values outside of int64 fail the range check and keep their float encoding
+      if (fractional_remainder == 0 && integral_part >= -0x1p63 && integral_part < 0x1p63)
       { // Just pack as int
         pack_type(int64_t(integral_part));
       }
       else
       {
-        static_assert(std::numeric_limits<float>::radix == 2); // TODO: Handle decimal floats
-        auto exponent = ilogb(value);
-        float full_mantissa = value / float(scalbn(1.0, exponent));
-        auto sign_mask = std::bitset<32>(uint32_t(std::signbit(full_mantissa)) << 31);
-        auto excess_127_exponent_mask = std::bitset<32>(uint32_t(exponent + 127) << 23);
-        auto normalized_mantissa_mask = std::bitset<32>();
-        float implied_mantissa = fabs(full_mantissa) - 1.0f;
-        for (auto i = 23U; i > 0; --i)
-        {
-          integral_part = 0;
-          implied_mantissa *= 2;
-          implied_mantissa = float(modf(implied_mantissa, &integral_part));
-          if (uint8_t(integral_part) == 1)
-          {
-            normalized_mantissa_mask |= std::bitset<32>(uint32_t(1 << (i - 1)));
-          }
-        }
-
-        uint32_t ieee754_float32 = (sign_mask | excess_127_exponent_mask | normalized_mantissa_mask).to_ulong();
-        serialized_object.emplace_back(float32);
-        for (auto i = sizeof(uint32_t); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(ieee754_float32 >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(float32, std::bit_cast<uint32_t>(value));
       }
     }
 
@@ -624,107 +603,127 @@ namespace msgpack
       double integral_part;
       double fractional_remainder = modf(value, &integral_part);
 
-      if (fractional_remainder == 0)
+      if (fractional_remainder == 0 && integral_part >= -0x1p63 && integral_part < 0x1p63)
       { // Just pack as int
         pack_type(int64_t(integral_part));
       }
       else
       {
-        static_assert(std::numeric_limits<float>::radix == 2); // TODO: Handle decimal floats
-        auto exponent = ilogb(value);
-        double full_mantissa = value / scalbn(1.0, exponent);
-        auto sign_mask = std::bitset<64>(uint64_t(std::signbit(full_mantissa)) << 63);
-        auto excess_127_exponent_mask = std::bitset<64>(uint64_t(exponent + 1023) << 52);
-        auto normalized_mantissa_mask = std::bitset<64>();
-        double implied_mantissa = fabs(full_mantissa) - 1.0f;
+        put_big_endian(float64, std::bit_cast<uint64_t>(value));
+      }
+    }
 
-        for (auto i = 52U; i > 0; --i)
-        {
-          integral_part = 0;
-          implied_mantissa *= 2;
-          implied_mantissa = modf(implied_mantissa, &integral_part);
-          if (uint8_t(integral_part) == 1)
-          {
-            normalized_mantissa_mask |= std::bitset<64>(uint64_t(1) << (i - 1));
-          }
-        }
-        auto ieee754_float64 = (sign_mask | excess_127_exponent_mask | normalized_mantissa_mask).to_ullong();
-        serialized_object.emplace_back(float64);
-        for (auto i = sizeof(ieee754_float64); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(ieee754_float64 >> (8U * (i - 1)) & 0xff));
-        }
+    // Arrays of floats are written in one block, every element keeps its IEEE 754 encoding
+    // so the size is known up front and whole numbers do not go through the int checks
+    void pack_type(const std::vector<double> &value)
+    {
+      pack_type(std::span<const double>(value));
+    }
+
+    void pack_type(const std::span<const double> &value)
+    {
+      pack_float_array<uint64_t>(float64, value);
+    }
+
+    void pack_type(const std::vector<float> &value)
+    {
+      pack_type(std::span<const float>(value));
+    }
+
+    void pack_type(const std::span<const float> &value)
+    {
+      pack_float_array<uint32_t>(float32, value);
+    }
+
+    template <class Bits, class T>
+    void pack_float_array(uint8_t format, std::span<const T> array)
+    {
+      pack_array_header(array.size());
+      auto position = claim(array.size() * (1 + sizeof(Bits)));
+      if (position == nullptr)
+      {
+        return;
+      }
+      for (T elem : array)
+      {
+        *position++ = format;
+        store_big_endian(position, std::bit_cast<Bits>(elem));
+        position += sizeof(Bits);
+      }
+    }
+
+    void pack_type(const std::vector<int64_t> &value)
+    {
+      pack_type(std::span<const int64_t>(value));
+    }
+
+    void pack_type(const std::span<const int64_t> &value)
+    {
+      pack_array_header(value.size());
+      if (!external)
+      {
+        serialized_object.reserve(serialized_object.size() + value.size() * (1 + sizeof(int64_t)));
+      }
+      for (int64_t elem : value)
+      {
+        pack_type(elem);
       }
     }
 
     void pack_type(const std::string &value)
+    {
+      pack_type(std::string_view(value));
+    }
+
+    void pack_type(const std::string_view &value)
     {
       if (value.size() < 32)
       {
-        serialized_object.emplace_back(uint8_t(value.size()) | 0b10100000);
+        put(uint8_t(value.size() | 0b10100000));
       }
       else if (value.size() < std::numeric_limits<uint8_t>::max())
       {
-        serialized_object.emplace_back(str8);
-        serialized_object.emplace_back(uint8_t(value.size()));
+        put_big_endian(str8, uint8_t(value.size()));
       }
       else if (value.size() < std::numeric_limits<uint16_t>::max())
       {
-        serialized_object.emplace_back(str16);
-        for (auto i = sizeof(uint16_t); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(value.size() >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(str16, uint16_t(value.size()));
       }
       else if (value.size() < std::numeric_limits<uint32_t>::max())
       {
-        serialized_object.emplace_back(str32);
-        for (auto i = sizeof(uint32_t); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(value.size() >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(str32, uint32_t(value.size()));
       }
       else
       {
         return; // Give up if string is too long
       }
-      for (char i : value)
-      {
-        serialized_object.emplace_back(static_cast<uint8_t>(i));
-      }
+      put(reinterpret_cast<const uint8_t *>(value.data()), value.size());
     }
 
     void pack_type(const std::vector<uint8_t> &value)
+    {
+      pack_type(std::span<const uint8_t>(value));
+    }
+
+    void pack_type(const std::span<const uint8_t> &value)
     {
       if (value.size() < std::numeric_limits<uint8_t>::max())
       {
-        serialized_object.emplace_back(bin8);
-        serialized_object.emplace_back(uint8_t(value.size()));
+        put_big_endian(bin8, uint8_t(value.size()));
       }
       else if (value.size() < std::numeric_limits<uint16_t>::max())
       {
-        serialized_object.emplace_back(bin16);
-        for (auto i = sizeof(uint16_t); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(value.size() >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(bin16, uint16_t(value.size()));
       }
       else if (value.size() < std::numeric_limits<uint32_t>::max())
       {
-        serialized_object.emplace_back(bin32);
-        for (auto i = sizeof(uint32_t); i > 0; --i)
-        {
-          serialized_object.emplace_back(uint8_t(value.size() >> (8U * (i - 1)) & 0xff));
-        }
+        put_big_endian(bin32, uint32_t(value.size()));
       }
       else
       {
         return; // Give up if vector is too large
       }
-      for (const auto &elem : value)
-      {
-        serialized_object.emplace_back(elem);
-      }
+      put(value.data(), value.size());
     }
   };
 
@@ -816,6 +815,39 @@ namespace msgpack
       return next == uint8 || next == uint16 || next == uint32 || next == uint64;
     }
 
+    // Reads an array header, the size is checked against the remaining data so it is safe to reserve
+    std::size_t unpack_array_size()
+    {
+      std::size_t array_size = 0;
+      auto format = safe_data();
+      if (format == array32)
+      {
+        if (auto position = take(1 + sizeof(uint32_t)))
+        {
+          array_size = load_big_endian<uint32_t>(position + 1);
+        }
+      }
+      else if (format == array16)
+      {
+        if (auto position = take(1 + sizeof(uint16_t)))
+        {
+          array_size = load_big_endian<uint16_t>(position + 1);
+        }
+      }
+      else
+      {
+        array_size = format & 0b00001111;
+        safe_increment();
+      }
+      // every element takes at least one byte
+      if (data_pointer > data_end || array_size > std::size_t(data_end - data_pointer))
+      {
+        ec = UnpackerError::OutOfRange;
+        return 0;
+      }
+      return array_size;
+    }
+
     std::error_code ec{};
 
   private:
@@ -844,6 +876,20 @@ namespace msgpack
       }
     }
 
+    // Consumes count bytes and returns where they start, or nullptr if the data ends before them
+    const uint8_t *take(std::size_t count)
+    {
+      if (data_pointer > data_end || std::size_t(data_end - data_pointer) < count)
+      {
+        ec = UnpackerError::OutOfRange;
+        return nullptr;
+      }
+      auto position = data_pointer;
+      data_pointer += count;
+      bytes_consumed += count;
+      return position;
+    }
+
     template <class T>
     void unpack_type(T &value)
     {
@@ -883,49 +929,16 @@ namespace msgpack
     void unpack_array(T &array)
     {
       using ValueType = typename T::value_type;
-      if (safe_data() == array32)
+      std::size_t array_size = unpack_array_size();
+      if constexpr (requires { array.reserve(array_size); })
       {
-        safe_increment();
-        std::size_t array_size = 0;
-        for (auto i = sizeof(uint32_t); i > 0; --i)
-        {
-          array_size += uint32_t(safe_data()) << 8 * (i - 1);
-          safe_increment();
-        }
-        std::vector<uint32_t> x{};
-        for (auto i = 0U; i < array_size; ++i)
-        {
-          ValueType val{};
-          unpack_type(val);
-          array.emplace_back(val);
-        }
+        array.reserve(array.size() + array_size);
       }
-      else if (safe_data() == array16)
+      for (auto i = 0U; i < array_size && !ec; ++i)
       {
-        safe_increment();
-        std::size_t array_size = 0;
-        for (auto i = sizeof(uint16_t); i > 0; --i)
-        {
-          array_size += uint16_t(safe_data()) << 8 * (i - 1);
-          safe_increment();
-        }
-        for (auto i = 0U; i < array_size; ++i)
-        {
-          ValueType val{};
-          unpack_type(val);
-          array.emplace_back(val);
-        }
-      }
-      else
-      {
-        std::size_t array_size = safe_data() & 0b00001111;
-        safe_increment();
-        for (auto i = 0U; i < array_size; ++i)
-        {
-          ValueType val{};
-          unpack_type(val);
-          array.emplace_back(val);
-        }
+        ValueType val{};
+        unpack_type(val);
+        array.emplace_back(val);
       }
     }
 
@@ -1167,20 +1180,9 @@ namespace msgpack
       {
       case int64:
       {
-        safe_increment();
-        std::bitset<64> bits;
-        for (auto i = sizeof(value); i > 0; --i)
-        {
-          bits |= std::bitset<8>(safe_data()).to_ullong() << 8 * (i - 1);
-          safe_increment();
-        }
-        if (bits[63])
+        if (auto position = take(1 + sizeof(uint64_t)))
         {
-          value = -1 * ((~bits).to_ullong() + 1);
-        }
-        else
-        {
-          value = bits.to_ullong();
+          value = int64_t(load_big_endian<uint64_t>(position + 1));
         }
         break;
       }
@@ -1365,11 +1367,9 @@ namespace msgpack
       switch (flag)
       {
       case uint64:
-        safe_increment();
-        for (auto i = sizeof(uint64_t); i > 0; --i)
+        if (auto position = take(1 + sizeof(uint64_t)))
         {
-          value += uint64_t(safe_data()) << 8 * (i - 1);
-          safe_increment();
+          value = load_big_endian<uint64_t>(position + 1);
         }
         break;
       case uint32:
@@ -1454,37 +1454,21 @@ namespace msgpack
     {
       if (safe_data() == float32)
       {
-        safe_increment();
-        uint32_t data = 0;
-        for (auto i = sizeof(uint32_t); i > 0; --i)
-        {
-          data += safe_data() << 8 * (i - 1);
-          safe_increment();
-        }
-        auto bits = std::bitset<32>(data);
-        auto mantissa = 1.0f;
-        for (auto i = 23U; i > 0; --i)
-        {
-          if (bits[i - 1])
-          {
-            mantissa += 1.0f / (1 << (24 - i));
-          }
-        }
-        if (bits[31])
-        {
-          mantissa *= -1;
-        }
-        uint8_t exponent = 0;
-        for (auto i = 0U; i < 8; ++i)
+        if (auto position = take(1 + sizeof(uint32_t)))
         {
-          exponent += bits[i + 23] << i;
+          value = std::bit_cast<float>(load_big_endian<uint32_t>(position + 1));
         }
-        exponent -= 127;
-        value = ldexp(mantissa, exponent);
+      }
+      else if (safe_data() == float64)
+      {
+        double val = 0;
+        unpack_type(val);
+        value = float(val);
       }
       else
       {
-        if (safe_data() == int8 || safe_data() == int16 || safe_data() == int32 || safe_data() == int64)
+        auto format = safe_data();
+        if (format >= 0xe0 || format == int8 || format == int16 || format == int32 || format == int64)
         {
           int64_t val = 0;
           unpack_type(val);
@@ -1503,135 +1487,170 @@ namespace msgpack
     {
       if (safe_data() == float64)
       {
-        safe_increment();
-        uint64_t data = 0;
-        for (auto i = sizeof(uint64_t); i > 0; --i)
-        {
-          data += uint64_t(safe_data()) << 8 * (i - 1);
-          safe_increment();
-        }
-        auto bits = std::bitset<64>(data);
-        auto mantissa = 1.0;
-        for (auto i = 52U; i > 0; --i)
+        if (auto position = take(1 + sizeof(uint64_t)))
         {
-          if (bits[i - 1])
-          {
-            mantissa += 1.0 / (uint64_t(1) << (53 - i));
-          }
+          value = std::bit_cast<double>(load_big_endian<uint64_t>(position + 1));
         }
-        if (bits[63])
-        {
-          mantissa *= -1;
-        }
-        uint16_t exponent = 0;
-        for (auto i = 0U; i < 11; ++i)
-        {
-          exponent += bits[i + 52] << i;
-        }
-        exponent -= 1023;
-        value = ldexp(mantissa, exponent);
+      }
+      else if (safe_data() == float32)
+      {
+        float val = 0;
+        unpack_type(val);
+        value = val;
       }
       else
       {
-        if (safe_data() == int8 || safe_data() == int16 || safe_data() == int32 || safe_data() == int64)
+        auto format = safe_data();
+        if (format >= 0xe0 || format == int8 || format == int16 || format == int32 || format == int64)
         {
           int64_t val = 0;
           unpack_type(val);
-          value = float(val);
+          value = double(val);
         }
         else
         {
           uint64_t val = 0;
           unpack_type(val);
-          value = float(val);
+          value = double(val);
         }
       }
     }
 
-    void unpack_type(std::string &value)
+    // Homogeneous number arrays decode the common element formats inline and only
+    // fall back to the per element decoding for the others
+    void unpack_type(std::vector<double> &value)
     {
-      std::size_t str_size = 0;
-      if (safe_data() == str32)
+      std::size_t array_size = unpack_array_size();
+      value.reserve(value.size() + array_size);
+      for (auto i = 0U; i < array_size && !ec; ++i)
       {
-        safe_increment();
-        for (auto i = sizeof(uint32_t); i > 0; --i)
+        if (data_end - data_pointer > int64_t(sizeof(uint64_t)) && *data_pointer == float64)
         {
-          str_size += uint32_t(safe_data()) << 8 * (i - 1);
-          safe_increment();
+          value.push_back(std::bit_cast<double>(load_big_endian<uint64_t>(take(1 + sizeof(uint64_t)) + 1)));
+          continue;
         }
+        double val = 0;
+        unpack_type(val);
+        value.push_back(val);
       }
-      else if (safe_data() == str16)
+    }
+
+    void unpack_type(std::vector<float> &value)
+    {
+      std::size_t array_size = unpack_array_size();
+      value.reserve(value.size() + array_size);
+      for (auto i = 0U; i < array_size && !ec; ++i)
       {
-        safe_increment();
-        for (auto i = sizeof(uint16_t); i > 0; --i)
+        if (data_end - data_pointer > int64_t(sizeof(uint32_t)) && *data_pointer == float32)
         {
-          str_size += uint16_t(safe_data()) << 8 * (i - 1);
+          value.push_back(std::bit_cast<float>(load_big_endian<uint32_t>(take(1 + sizeof(uint32_t)) + 1)));
+          continue;
+        }
+        float val = 0;
+        unpack_type(val);
+        value.push_back(val);
+      }
+    }
+
+    void unpack_type(std::vector<int64_t> &value)
+    {
+      std::size_t array_size = unpack_array_size();
+      value.reserve(value.size() + array_size);
+      for (auto i = 0U; i < array_size && !ec; ++i)
+      {
+        uint8_t format = safe_data();
+        if (format <= 0x7f || format >= 0xe0)
+        { // positive and negative fixint
+          value.push_back(int8_t(format));
           safe_increment();
+          continue;
         }
+        int64_t val = 0;
+        unpack_type(val);
+        value.push_back(val);
       }
-      else if (safe_data() == str8)
+    }
+
+    void unpack_type(std::string &value)
+    {
+      std::string_view view;
+      unpack_type(view);
+      value.assign(view);
+    }
+
+    // The view points into the unpacked data, nothing is copied
+    void unpack_type(std::string_view &value)
+    {
+      std::size_t str_size = 0;
+      auto format = safe_data();
+      if (format == str32)
       {
-        safe_increment();
-        for (auto i = sizeof(uint8_t); i > 0; --i)
+        if (auto position = take(1 + sizeof(uint32_t)))
         {
-          str_size += uint8_t(safe_data()) << 8 * (i - 1);
-          safe_increment();
+          str_size = load_big_endian<uint32_t>(position + 1);
         }
       }
-      else
+      else if (format == str16)
       {
-        str_size = safe_data() & 0b00001111;
-        safe_increment();
+        if (auto position = take(1 + sizeof(uint16_t)))
+        {
+          str_size = load_big_endian<uint16_t>(position + 1);
+        }
       }
-      if (data_pointer + str_size <= data_end)
+      else if (format == str8)
       {
-        value = std::string{data_pointer, data_pointer + str_size};
-        safe_increment(str_size);
+        if (auto position = take(1 + sizeof(uint8_t)))
+        {
+          str_size = position[1];
+        }
       }
       else
       {
-        ec = UnpackerError::OutOfRange;
+        str_size = format & 0b00011111;
+        safe_increment();
+      }
+      if (auto position = take(str_size))
+      {
+        value = std::string_view(reinterpret_cast<const char *>(position), str_size);
       }
     }
 
     void unpack_type(std::vector<uint8_t> &value)
+    {
+      std::span<const uint8_t> view;
+      unpack_type(view);
+      value.assign(view.begin(), view.end());
+    }
+
+    // The view points into the unpacked data, nothing is copied
+    void unpack_type(std::span<const uint8_t> &value)
     {
       std::size_t bin_size = 0;
-      if (safe_data() == bin32)
+      auto format = safe_data();
+      if (format == bin32)
       {
-        safe_increment();
-        for (auto i = sizeof(uint32_t); i > 0; --i)
+        if (auto position = take(1 + sizeof(uint32_t)))
         {
-          bin_size += uint32_t(safe_data()) << 8 * (i - 1);
-          safe_increment();
+          bin_size = load_big_endian<uint32_t>(position + 1);
         }
       }
-      else if (safe_data() == bin16)
+      else if (format == bin16)
       {
-        safe_increment();
-        for (auto i = sizeof(uint16_t); i > 0; --i)
+        if (auto position = take(1 + sizeof(uint16_t)))
         {
-          bin_size += uint16_t(safe_data()) << 8 * (i - 1);
-          safe_increment();
+          bin_size = load_big_endian<uint16_t>(position + 1);
         }
       }
       else
       {
-        safe_increment();
-        for (auto i = sizeof(uint8_t); i > 0; --i)
+        if (auto position = take(1 + sizeof(uint8_t)))
         {
-          bin_size += uint8_t(safe_data()) << 8 * (i - 1);
-          safe_increment();
+          bin_size = position[1];
         }
       }
-      if (data_pointer + bin_size <= data_end)
+      if (auto position = take(bin_size))
       {
-        value = std::vector<uint8_t>{data_pointer, data_pointer + bin_size};
-        safe_increment(bin_size);
-      }
-      else
-      {
-        ec = UnpackerError::OutOfRange;
+        value = std::span<const uint8_t>(position, bin_size);
       }
     }
   };
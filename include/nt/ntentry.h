@@ -20,6 +20,8 @@ public:
     bool close();
 
     NTDataValue get();
+    /// @brief Returns the latest value without copying it, empty if no value was received
+    NTValueSnapshot getSnapshot();
     bool getBoolean(bool defaultValue);
     double getDouble(double defaultValue);
     float getFloat(float defaultValue);
@@ -6,15 +6,26 @@
 #include <FreeRTOS.h>
 #include <task.h>
 #include <semphr.h>
+#include <pico/time.h>
 #include <vector>
+#include <atomic>
+#include <span>
+#include <string_view>
 
 #include "../msgpack/msgpack.hpp"
+#include "ntjson.hpp"
 
 #include "../wsserver.h"
 #include "../websocket.h"
+#include "../udpsocket.h"
+#include "subscriptiontrie.h"
 
-static constexpr std::size_t MAX_CLIENT_TEXT_CACHE_LENGTH = 512;
-static constexpr std::size_t MAX_CLIENT_BINARY_CACHE_LENGTH = 512;
+static constexpr std::size_t MAX_CLIENT_UDP_CACHE_LENGTH = 512;
+/// @brief The client slot of the server itself, after the WebSocket client slots
+static constexpr WsClientId NT_SELF_CLIENT_ID = WS_SERVER_MAX_CLIENT_COUNT;
+static constexpr std::size_t NT_MAX_CLIENT_COUNT = WS_SERVER_MAX_CLIENT_COUNT + 1;
+
+class Radio;
 
 enum class NTDataType : uint8_t
 {
@@ -37,9 +48,23 @@ enum class NTDataType : uint8_t
     Unassigned = 99 // [Null] implementation based (not part of api)
 };
 
+/// @brief Payload bytes of strings, binary data and arrays that are stored inside a NTDataValue instead of the heap
+static constexpr std::size_t NT_VALUE_INLINE_SIZE = 16;
+
+/// @brief A NetworkTables value, scalars and small payloads are stored inline
+/// @note Strings, binary data and arrays are kept in a single owned payload block.
+/// Bool arrays are packed into bits, string arrays are stored as offsets followed by the characters
 struct NTDataValue
 {
     NTDataType type;
+
+private:
+    /// @brief Set if the payload is in the heap block instead of inline
+    bool external = false;
+    /// @brief Element count of arrays, byte count of strings and binary data
+    uint32_t length = 0;
+
+public:
     union
     {
         bool b;
@@ -47,22 +72,34 @@ struct NTDataValue
         int64_t i;
         float f32;
         uint64_t ui;
+        /// @brief The payload block when it does not fit inline, read through the accessors
+        uint8_t *heap;
+        /// @brief The inline payload, read through the accessors
+        alignas(8) uint8_t small[NT_VALUE_INLINE_SIZE];
     };
-    std::string str;
-    std::vector<bool> bArray;
-    std::vector<double> f64Array;
-    std::vector<int64_t> iArray;
-    std::vector<float> f32Array;
-    std::vector<std::string> strArray;
-    std::vector<uint8_t> bin;
 
     NTDataType getAPIType() const;
     inline bool isValid() const { return type != NTDataType::Unassigned; }
 
+    /// @brief Returns the number of elements of an array, or bytes of a string or binary value
+    inline std::size_t size() const { return length; }
+    std::string_view str() const { return {(const char *)payload(), length}; }
+    std::span<const uint8_t> bin() const { return {payload(), length}; }
+    std::span<const double> f64Array() const { return {(const double *)payload(), length}; }
+    std::span<const int64_t> iArray() const { return {(const int64_t *)payload(), length}; }
+    std::span<const float> f32Array() const { return {(const float *)payload(), length}; }
+    bool boolAt(std::size_t index) const { return (payload()[index / 8] >> (index % 8)) & 1; }
+    std::string_view strAt(std::size_t index) const;
+    std::vector<bool> bArray() const;
+    std::vector<std::string> strArray() const;
+
     void unpack(msgpack::Unpacker<false> &unpacker);
     void pack(msgpack::Packer<false> &packer) const;
 
+    /// @brief Copies the data of a value with the same API type, the payload block is reused if it has the same size
     void assign(const NTDataValue &other);
+    /// @brief Takes the data of a value with the same API type without copying the payload
+    void assign(NTDataValue &&other);
 
     NTDataValue(NTDataType type, msgpack::Unpacker<false> &unpacker);
     /// @brief Creates a NTDataValue of a type and default/empty value
@@ -71,18 +108,79 @@ struct NTDataValue
     NTDataValue(double f64);
     NTDataValue(int64_t i);
     NTDataValue(float f32);
-    NTDataValue(std::string str);
-    NTDataValue(NTDataType type, std::string str);
-    NTDataValue(std::vector<uint8_t> bin);
-    NTDataValue(NTDataType type, std::vector<uint8_t> bin);
+    NTDataValue(std::string_view str);
+    NTDataValue(NTDataType type, std::string_view str);
+    NTDataValue(std::span<const uint8_t> bin);
+    NTDataValue(NTDataType type, std::span<const uint8_t> bin);
     NTDataValue(uint64_t ui);
-    NTDataValue(std::vector<bool> bArray);
-    NTDataValue(std::vector<double> f64Array);
-    NTDataValue(std::vector<int64_t> iArray);
-    NTDataValue(std::vector<float> f32Array);
-    NTDataValue(std::vector<std::string> strArray);
+    NTDataValue(const std::vector<bool> &bArray);
+    NTDataValue(std::span<const double> f64Array);
+    NTDataValue(std::span<const int64_t> iArray);
+    NTDataValue(std::span<const float> f32Array);
+    NTDataValue(const std::vector<std::string> &strArray);
     NTDataValue(const NTDataValue &other);
+    NTDataValue(NTDataValue &&other);
+    NTDataValue &operator=(const NTDataValue &other);
+    NTDataValue &operator=(NTDataValue &&other);
     ~NTDataValue();
+
+private:
+    inline const uint8_t *payload() const { return external ? heap : small; }
+    inline uint8_t *payload() { return external ? heap : small; }
+    /// @brief Returns the size of the payload in bytes
+    std::size_t payloadSize() const;
+    /// @brief Sets the length and makes room for a payload, the contents are undefined
+    uint8_t *allocate(std::size_t count, std::size_t bytes);
+    void setBytes(const void *data, std::size_t count);
+    void release();
+    /// @brief Copies the length and payload of a value, keeps the type
+    void copy(const NTDataValue &other);
+    /// @brief Moves the length and payload of a value, keeps the type and leaves the other value empty
+    void take(NTDataValue &other);
+};
+
+/// @brief Immutable, reference counted NTDataValue shared by the topic store, the encoders and the local subscribers
+/// @note Copying a snapshot only increments the reference count, the value itself is never copied.
+/// Snapshots shared between tasks are swapped with `store` and read with `load`
+class NTValueSnapshot
+{
+public:
+    /// @brief Creates an empty snapshot that holds no value
+    NTValueSnapshot() = default;
+    explicit NTValueSnapshot(NTDataValue &&value);
+    NTValueSnapshot(const NTValueSnapshot &other);
+    NTValueSnapshot(NTValueSnapshot &&other) noexcept : block(other.block) { other.block = nullptr; }
+    NTValueSnapshot &operator=(const NTValueSnapshot &other);
+    NTValueSnapshot &operator=(NTValueSnapshot &&other) noexcept;
+    ~NTValueSnapshot();
+
+    inline const NTDataValue &get() const { return block->value; }
+    inline const NTDataValue &operator*() const { return block->value; }
+    inline const NTDataValue *operator->() const { return &block->value; }
+    inline explicit operator bool() const { return block != nullptr; }
+
+    /// @brief Returns true if no other snapshot shares the value
+    inline bool unique() const { return block != nullptr && block->references.load(std::memory_order_acquire) == 1; }
+    /// @brief Returns the value for changing it in place, only allowed while the snapshot is unique
+    inline NTDataValue &mutableValue() { return block->value; }
+
+    /// @brief Takes a reference to a snapshot that another task may replace with `store`
+    static NTValueSnapshot load(const NTValueSnapshot &shared);
+    /// @brief Replaces a snapshot that another task may read with `load`, the previous value is released outside the critical section
+    static void store(NTValueSnapshot &shared, NTValueSnapshot value);
+
+private:
+    struct Block
+    {
+        std::atomic<uint32_t> references;
+        NTDataValue value;
+
+        Block(NTDataValue &&value) : references(1), value(std::move(value)) {}
+    };
+
+    Block *block = nullptr;
+
+    void release();
 };
 
 class NetworkTableInstance
@@ -100,6 +198,10 @@ public:
 
     void startClient(std::string_view url);
     void startServer();
+    /// @brief Starts the server without waiting for the radio link
+    /// @param radio The radio to wait for, must outlive the server. Null binds right away
+    /// @note Topics, publishers and subscribers work locally right away, the server binds its sockets once the link is up
+    void startServer(Radio *radio);
 
     void stop();
     void close();
@@ -110,7 +212,7 @@ public:
     int64_t getServerTimeOffset();
     uint64_t getServerTime();
 
-    void _handleFrame(const Guid &guid, const WebSocketFrame &frame);
+    void _handleFrame(WsClientId clientId, const WebSocketFrame &frame);
 
     bool sendRTT();
 
@@ -123,10 +225,13 @@ public:
 
     struct SubscriptionOptions
     {
+        /// @brief The minimum interval between value updates of a topic in milliseconds, 0 sends every update (received in seconds)
         int32_t periodic;
         bool all;
         bool topicsonly;
         bool prefix;
+        /// @brief The client UDP port to send value updates to, 0 to use the WebSocket (implementation based)
+        int32_t udp;
 
         template <class T>
         void pack(T &pack)
@@ -136,7 +241,7 @@ public:
     };
 
     static constexpr SubscriptionOptions SubscriptionOptions_DEFAULT = {
-        100, false, false, false};
+        100, false, false, false, 0};
 
     static constexpr TopicProperties TopicProperties_DEFAULT = {
         false, false, true};
@@ -156,19 +261,74 @@ public:
 private:
     WsServer *server;
     WebSocket *client;
+    /// @brief The socket for UDP value updates, null if disabled
+    UdpSocket *udpSocket = nullptr;
     NetworkMode networkMode;
 
+    /// @brief The radio the server waits for before binding its sockets
+    Radio *bindRadio = nullptr;
+    /// @brief True while the server sockets wait to be bound
+    volatile bool bindPending = false;
+    /// @brief Handle to the task waiting for the radio link, null when it is not running
+    volatile TaskHandle_t bindTask = nullptr;
+    /// @brief When the server was started, used to report startup times
+    absolute_time_t serverStartTime = 0;
+    bool firstClientConnected = false;
+
+    /// @brief The next instance in the list of instances waiting for their radio link
+    NetworkTableInstance *nextBindWaiter = nullptr;
+
+    /// @brief Binds the WebSocket server and UDP socket and advertises the server
+    /// @note The state mutex must be held
+    void bindServer();
+    /// @brief Used internally to bind the server once the radio link is up
+    void waitAndBindServer();
+    /// @brief Adds or removes the instance from the instances woken by the link up event of their radio
+    void setBindWaiter(bool waiting);
+    /// @brief Registered with Radio::linkUp, wakes the bind tasks of the instances waiting for the radio
+    static void onRadioLinkUp(Radio *radio, uint32_t linkUpTimeMs, void *args);
+
+    /// @brief True while the periodic update task should run
+    volatile bool periodicRunning = false;
+    /// @brief Handle to the periodic update task, null when it is not running
+    volatile TaskHandle_t periodicTask = nullptr;
+    /// @brief When the periodic update task wakes up in microseconds since boot, UINT64_MAX while it waits for a pending update
+    /// @note Guarded by the state mutex
+    uint64_t periodicWakeUs = UINT64_MAX;
+    /// @brief Used internally to send the pending value updates when their subscription periods have passed
+    void runPeriodicUpdates();
+
     /// @brief Mutex to prevent multithreaded internal state access
     SemaphoreHandle_t stateMutex;
 
+    struct ClientData;
+    struct Subscription;
+
+    /// @brief A subscription that matches a topic
+    struct TopicSubscriber
+    {
+        ClientData *client;
+        Subscription *subscription;
+
+        bool operator==(const TopicSubscriber &other) const = default;
+    };
+
     struct Topic
     {
         std::string name;
-        NTDataValue value;
+        /// @brief The current value, replaced as a whole on update unless no one else holds it
+        NTValueSnapshot value;
         uint32_t publisherCount;
         TopicProperties properties = TopicProperties_DEFAULT;
-
-        Topic(std::string name, NTDataValue value) : name(name), value(value), publisherCount(0)
+        /// @brief Incremented on every value update, lets UDP clients drop stale updates
+        uint32_t sequence = 0;
+        /// @brief Dense index of the topic, assigned at creation, indexes topicHandles and the per-client topic tables
+        uint32_t handle = 0;
+        /// @brief The subscriptions matching the topic, valid while subscribersCached is set
+        mutable std::vector<TopicSubscriber> subscribers = {};
+        mutable bool subscribersCached = false;
+
+        Topic(std::string name, NTDataValue value) : name(std::move(name)), value(std::move(value)), publisherCount(0)
         {
         }
 
@@ -229,6 +389,8 @@ private:
     {
         int32_t uid;
         std::string topic;
+        /// @brief The handle of the published topic, resolved once the topic exists
+        uint32_t topicHandle = 0;
 
         Publisher(int32_t uid, std::string topic) : uid(uid), topic(topic)
         {
@@ -241,29 +403,96 @@ private:
         }
     };
 
+    /// @brief A serialized value update waiting to be sent
+    struct QueuedUpdate
+    {
+        std::vector<uint8_t> bin = {};
+        bool udp = false;
+    };
+
+    /// @brief A ring of NT_ALL_QUEUE_DEPTH value updates of a topic, the oldest are dropped when full
+    struct ValueQueue
+    {
+        QueuedUpdate *slots = nullptr;
+        uint16_t head = 0;
+        uint16_t count = 0;
+        /// @brief The bytes held by the queued updates, part of the queuedBytes of the client
+        size_t bytes = 0;
+        /// @brief True if the newest update did not fit the client budget, the current value follows the queue
+        bool behind = false;
+    };
+
     struct ClientTopicData
     {
-        int64_t id;
-        bool initialPublish;
+        /// @brief The topic id announced to the client, -1 if not announced
+        int64_t id = -1;
+        bool initialPublish = false;
+        /// @brief True if a value update waits for the subscription period, the topic then holds the newest value
+        bool pending = false;
+        /// @brief The timestamp of the newest pending update
+        uint64_t pendingTime = 0;
+        /// @brief When the last value update was sent in microseconds since boot
+        uint64_t lastSentUs = 0;
+        /// @brief The subscription period of the pending update in milliseconds
+        uint32_t periodMs = 0;
+        /// @brief Every value change for `all` subscriptions, allocated on the first queued update
+        ValueQueue *queue = nullptr;
+        /// @brief The number of queued updates dropped because the queue or the client budget was full
+        uint32_t overflowCount = 0;
     };
 
     struct ClientData
     {
         Guid guid;
+        /// @brief The WebSocket client id, also the index in clients
+        WsClientId id;
         std::string name;
 
         std::unordered_map<int32_t, Subscription *> subscriptions;
         std::unordered_map<int32_t, Publisher *> publishers;
-        std::unordered_map<std::string, ClientTopicData> topicData;
+        /// @brief Per-topic state indexed by topic handle
+        std::vector<ClientTopicData> topicData;
+        /// @brief Handles of the topics with a pending value update
+        std::vector<uint32_t> pendingTopics;
+        /// @brief The bytes held by the value queues of the client, limited to NT_CLIENT_QUEUE_BUDGET
+        size_t queuedBytes = 0;
+        /// @brief The number of queued updates dropped for the client
+        uint32_t overflowCount = 0;
 
         int64_t nextTopicIdAssigned = 0;
 
-        std::string textCache = {};
-        std::vector<uint8_t> binaryCache = {};
+        /// @brief Outbound text messages in an open JSON array, flushed at its adaptive limit
+        WebSocketFrameBuffer textCache;
+        /// @brief Outbound binary messages, flushed at its adaptive limit
+        WebSocketFrameBuffer binaryCache;
+
+        /// @brief The UDP endpoint of the client, the port is 0 if the client did not opt in
+        ip_addr_t udpAddress = {};
+        uint16_t udpPort = 0;
+        std::vector<uint8_t> udpCache = {};
+
+        /// @brief Returns the state of a topic, growing the table if needed
+        inline ClientTopicData &getTopicData(uint32_t handle)
+        {
+            if (handle >= topicData.size())
+                topicData.resize(handle + 1);
+            return topicData[handle];
+        }
+
+        /// @brief Returns true if the topic has been announced to the client
+        inline bool isAnnounced(uint32_t handle) const
+        {
+            return handle < topicData.size() && topicData[handle].id >= 0;
+        }
     };
 
     std::unordered_map<std::string, Topic *> topics = {};
-    std::unordered_map<Guid, ClientData *> clients = {};
+    /// @brief All topics indexed by their handle
+    std::vector<Topic *> topicHandles = {};
+    /// @brief The topic patterns of all subscriptions
+    SubscriptionTrie<TopicSubscriber> subscriptionTrie;
+    /// @brief Connected clients indexed by their WebSocket client id, the server itself at NT_SELF_CLIENT_ID
+    ClientData *clients[NT_MAX_CLIENT_COUNT] = {};
     ClientData thisClient;
     int64_t serverTimeOffset;
 
@@ -282,87 +511,159 @@ private:
         }
         else
         {
-            Topic *topic = new Topic(name, value);
+            Topic *topic = new Topic(name, std::move(value));
             topic->properties = properties;
+            topic->handle = topicHandles.size();
             topics[name] = topic;
+            topicHandles.push_back(topic);
             return topic;
         }
     }
 
-    bool isSubscribed(Subscription *subscription, std::string name);
-    bool isSubscribed(const std::unordered_map<int32_t, Subscription *> &subscriptions, std::string name, bool requireNotTopicsOnly = false, Subscription **out_subscription = nullptr);
+    /// @brief Returns the topic with a name, or null if it does not exist
+    inline Topic *findTopic(const std::string &name)
+    {
+        auto search = topics.find(name);
+        return search != topics.end() ? search->second : nullptr;
+    }
+
+    /// @brief Returns the subscriptions matching a topic, computed from the trie once and cached until they change
+    const std::vector<TopicSubscriber> &getSubscribers(const Topic *topic);
+    /// @brief Returns the subscription of a client that wants values of a topic, or null
+    Subscription *getValueSubscription(ClientData *client, const Topic *topic);
+    /// @brief Returns the shortest period of the subscriptions of a client that want values of a topic
+    /// @param out_all Set to true if one of the subscriptions wants all value changes
+    uint32_t getUpdatePeriod(ClientData *client, const Topic *topic, bool *out_all);
+    /// @brief Sends a value update to a client right away, or holds it until the subscription period has passed
+    bool scheduleTopicUpdate(ClientData *client, const Topic *topic, uint64_t time);
+    /// @brief Sends the pending value updates whose subscription period has passed
+    /// @return When the next pending update is due in microseconds since boot, UINT64_MAX if none is pending
+    uint64_t sendPendingUpdates();
+    /// @brief Appends a value update to the queue of an `all` subscription
+    void queueTopicUpdate(ClientData *client, const Topic *topic, uint64_t time);
+    /// @brief Moves all queued updates of a topic into the client caches, in order
+    void drainQueue(ClientData *client, uint32_t handle);
+    /// @brief Drops the held updates of topics a client no longer wants values of, and applies the remaining subscription periods
+    void prunePendingUpdates(ClientData *client);
+    /// @brief Drops the held update and the value queue of a topic
+    void dropPendingUpdate(ClientData *client, uint32_t handle);
+    /// @brief Frees the value queue of a topic and returns its bytes to the client budget
+    void releaseQueue(ClientData *client, ClientTopicData &data);
+
+    /// @brief Returns true if the next value update of a topic goes to the client over UDP
+    bool isUdpUpdate(ClientData *client, const Topic *topic);
+    /// @brief Serializes a value update for a client
+    /// @param udp True if the update goes over UDP, it then carries the topic sequence number
+    void packTopicUpdate(ClientData *client, const Topic *topic, uint64_t time, bool udp, msgpack::Packer<false> &packer);
+    /// @brief Appends a serialized value update to the WebSocket or UDP cache of a client
+    void cacheTopicUpdate(ClientData *client, const std::vector<uint8_t> &bin, bool udp);
+    /// @brief Packs a WebSocket value update straight into the binary cache of a client
+    /// @return False if the update does not fit the frame buffer, nothing was cached
+    bool cacheTopicUpdateInPlace(ClientData *client, const Topic *topic, uint64_t time);
+    /// @brief Replaces the value of a topic with a value of the same API type, keeps the type of the topic
+    /// @note The snapshot is changed in place while no local subscriber holds on to it
+    void setTopicValue(Topic *topic, NTDataValue &&value);
+
+    /// @brief Creates or replaces a subscription of a client and indexes it
+    Subscription *setSubscription(ClientData *client, int32_t subuid, const std::vector<std::string> &topics, SubscriptionOptions options);
+    /// @brief Removes a subscription of a client from the index
+    /// @return The subscription to be deleted by the caller, or null if it does not exist
+    Subscription *takeSubscription(ClientData *client, int32_t subuid);
+    /// @brief Adds or removes the patterns of a subscription and invalidates the subscribers of the affected topics
+    void indexSubscription(ClientData *client, Subscription *subscription, bool add);
+
+    bool isSubscribed(const Subscription *subscription, const std::string &name);
+    bool isSubscribed(ClientData *client, const Topic *topic, bool requireNotTopicsOnly = false, Subscription **out_subscription = nullptr);
 
     AnnouncedTopic announceTopicSelfSync(const Topic *topic, bool *out_success);
     bool announceTopicSelf(const Topic *topic);
-    bool announceTopic(const Guid &guid, const Topic *topic);
-    bool announceTopic(const Guid &guid, const Topic *topic, int32_t pubuid);
+    bool announceTopic(WsClientId clientId, const Topic *topic);
+    bool announceTopic(WsClientId clientId, const Topic *topic, int32_t pubuid);
     bool announceTopic(const Topic *topic);
-    bool announceTopic(const Topic *topic, const Guid &publisherGuid, int32_t pubuid);
+    bool announceTopic(const Topic *topic, WsClientId publisherId, int32_t pubuid);
     bool announceCachedTopicsSelf();
-    bool announceCachedTopics(const Guid &guid);
+    bool announceCachedTopics(WsClientId clientId);
 
     bool unannounceTopicSelf(const Topic *topic);
-    bool unannounceTopic(const Guid &guid, const Topic *topic);
+    bool unannounceTopic(WsClientId clientId, const Topic *topic);
     bool unannounceTopic(const Topic *topic);
 
     bool sendTopicUpdateSelf(const Topic *topic, uint64_t time);
     bool sendTopicUpdateSelf(const Topic *topic);
     bool sendTopicUpdate(const Topic *topic, uint64_t time);
     bool sendTopicUpdate(const Topic *topic);
-    bool sendTopicUpdate(const Guid &guid, const Topic *topic, uint64_t time);
-    bool sendTopicUpdate(const Guid &guid, const Topic *topic);
+    bool sendTopicUpdate(WsClientId clientId, const Topic *topic, uint64_t time);
+    bool sendTopicUpdate(WsClientId clientId, const Topic *topic);
     void publishInitialValuesSelf();
-    void publishInitialValues(const Guid &guid);
+    void publishInitialValues(WsClientId clientId);
 
     bool publishTopic(std::string name, NTDataValue value, TopicProperties properties = TopicProperties_DEFAULT);
     AnnouncedTopic publishTopicSelfSync(std::string name, NTDataValue value, TopicProperties properties, bool *out_success);
-    bool publishTopic(std::string name, NTDataValue value, const Guid &publisherGuid, int32_t pubuid, TopicProperties properties = TopicProperties_DEFAULT);
+    bool publishTopic(std::string name, NTDataValue value, WsClientId publisherId, int32_t pubuid, TopicProperties properties = TopicProperties_DEFAULT);
 
     bool sendPropertyUpdateSelf(const Topic *topic);
-    bool sendPropertyUpdate(const Guid &guid, const Topic *topic, bool ack);
+    bool sendPropertyUpdate(WsClientId clientId, const Topic *topic, bool ack);
 
     bool updateTopicProperties(const Topic *topic);
-    bool updateTopicProperties(const Topic *topic, const Guid &updaterGuid);
+    bool updateTopicProperties(const Topic *topic, WsClientId updaterId);
 
     size_t nextClientWithName(std::string_view name);
-
-    void flushText(ClientData *client)
-    {
-        flushText(client, MAX_CLIENT_TEXT_CACHE_LENGTH);
-    }
-
-    void flushText(ClientData *client, std::size_t uncachedSize);
+    /// @brief Frees a client and clears its slot, does nothing if the slot is free
+    void removeClient(WsClientId clientId);
+
+    /// @brief Closes the JSON array in the text cache and sends it
+    void flushText(ClientData *client);
+    /// @brief Returns a packer appending one message to the JSON array in the text cache, opening it if needed
+    /// @param out_mark Set to the cache length before the message, passed to endText
+    json::Packer<WebSocketFrameBuffer> beginText(ClientData *client, std::size_t *out_mark);
+    /// @brief Sends the messages before the mark if the new message made the cache exceed its length
+    void endText(ClientData *client, std::size_t mark);
+    /// @brief Packs the persistent, retained and cached properties as an object
+    static void packProperties(json::Packer<WebSocketFrameBuffer> &packer, std::string_view key, const TopicProperties &properties);
+    /// @brief Packs an announce message, the pubuid is only included if not null
+    static void packAnnounce(json::Packer<WebSocketFrameBuffer> &packer, const Topic *topic, int64_t id, const int32_t *pubuid);
 
     void flushText()
     {
         for (auto client : clients)
         {
-            if (!isSelf(client.second))
-                flushText(client.second);
+            if (client != nullptr && !isSelf(client))
+                flushText(client);
         }
     }
 
-    void flushBinary(ClientData *client)
-    {
-        flushBinary(client, MAX_CLIENT_BINARY_CACHE_LENGTH);
-    }
-
+    /// @brief Sends the binary cache
+    void flushBinary(ClientData *client);
+    /// @brief Sends the binary cache if the uncached bytes would make it exceed its limit
     void flushBinary(ClientData *client, std::size_t uncachedSize);
 
     void flushBinary()
     {
         for (auto client : clients)
         {
-            if (!isSelf(client.second))
-                flushBinary(client.second);
+            if (client != nullptr && !isSelf(client))
+            {
+                flushBinary(client);
+                flushUdp(client);
+            }
         }
     }
 
+    void flushUdp(ClientData *client)
+    {
+        flushUdp(client, MAX_CLIENT_UDP_CACHE_LENGTH);
+    }
+
+    void flushUdp(ClientData *client, std::size_t uncachedSize);
+
+    bool isUdpSubscribed(ClientData *client, const Topic *topic);
+    void updateClientUdpEndpoint(ClientData *client);
+
     void updateClientsMetaTopic();
     void updateServerSubMetaTopic();
     void updateServerPubMetaTopic();
-    void updateClientSubMetaTopic(const Guid &guid);
-    void updateClientPubMetaTopic(const Guid &guid);
+    void updateClientSubMetaTopic(WsClientId clientId);
+    void updateClientPubMetaTopic(WsClientId clientId);
     void updateTopicSubMetaTopic(std::string name);
     void updateTopicPubMetaTopic(std::string name);
 
@@ -378,12 +679,14 @@ public:
     void updateTopic(int32_t id, NTDataValue value);
     void updateTopic(int32_t id, NTDataValue value, uint64_t time);
     void flush();
+    /// @brief Returns the number of value updates of `all` subscriptions dropped because a client fell behind
+    uint32_t getQueueOverflowCount();
 
     /// @brief Custom args for the NetworkTable callbacks, set by the user
     void *callbackArgs = nullptr;
 
     /// @brief Callback for topic updates, contains the NetworkTable instance, id of the topic, timestamp, and value
-    typedef bool (*NTTopicUpdateCallback)(NetworkTableInstance *nt, int64_t id, uint64_t timestamp, const NTDataValue &value, void *args);
+    typedef bool (*NTTopicUpdateCallback)(NetworkTableInstance *nt, int64_t id, uint64_t timestamp, const NTValueSnapshot &value, void *args);
     /// @brief Called whenever a topic is updated
     NTTopicUpdateCallback topicUpdateCallback = nullptr;
     /// @brief Callback for topic announcements, contains the NetworkTable instance, and the announced topic
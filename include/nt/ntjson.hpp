@@ -5,433 +5,660 @@
 #ifndef NT_JSON_HPP
 #define NT_JSON_HPP
 
+#include <stdint.h>
 #include <string>
+#include <string_view>
+#include <array>
+#include <bit>
 #include <charconv>
 #include <concepts>
-#include <system_error>
 
 namespace json
 {
-    enum class UnpackerError
-    {
-        OutOfRange = 1
-    };
+    using namespace std::literals;
 
-    struct UnpackerErrCategory : public std::error_category
+    /// @brief A compile-time perfect hash of a fixed set of strings
+    /// @note The seed is searched at compile time so every string gets its own slot,
+    /// a lookup hashes the string once and compares it with a single candidate
+    template <std::size_t N>
+    class PerfectHash
     {
     public:
-        const char *name() const noexcept override
+        consteval PerfectHash(const std::array<std::string_view, N> &words) : words(words)
         {
-            return "unpacker";
-        };
-
-        std::string message(int ev) const override
-        {
-            switch (static_cast<json::UnpackerError>(ev))
+            for (seed = 1;; seed++)
             {
-            case json::UnpackerError::OutOfRange:
-                return "tried to dereference out of range during deserialization";
-            default:
-                return "(unrecognized error)";
+                slots.fill(-1);
+
+                bool collision = false;
+                for (std::size_t i = 0; i < N && !collision; i++)
+                {
+                    int8_t &slot = slots[hash(words[i], seed) & (SLOT_COUNT - 1)];
+                    collision = slot >= 0;
+                    slot = i;
+                }
+
+                if (!collision)
+                    break;
             }
-        };
-    };
+        }
 
-    inline std::error_code make_error_code(json::UnpackerError e)
-    {
-        static UnpackerErrCategory theUnpackerErrCategory;
-        return {static_cast<int>(e), theUnpackerErrCategory};
-    }
-};
+        /// @brief Returns the index of a string in the set, or -1 if it is not in the set
+        constexpr int find(std::string_view str) const
+        {
+            int8_t slot = slots[hash(str, seed) & (SLOT_COUNT - 1)];
+            return slot >= 0 && words[slot] == str ? slot : -1;
+        }
 
-namespace std
-{
-    template <>
-    struct is_error_code_enum<json::UnpackerError> : public true_type
-    {
-    };
-}
+    private:
+        static_assert(N > 0 && N < 128);
+        /// @brief Twice the number of strings rounded up to a power of two, so a seed is found quickly
+        static constexpr std::size_t SLOT_COUNT = std::bit_ceil(N * 2);
 
-namespace json
-{
-    using namespace std::literals;
+        std::array<std::string_view, N> words;
+        std::array<int8_t, SLOT_COUNT> slots = {};
+        uint32_t seed = 0;
 
-    template <typename T>
-    concept CharType = std::is_same_v<T, char>;
+        static constexpr uint32_t hash(std::string_view str, uint32_t seed)
+        {
+            // FNV-1a with the seed as the offset basis
+            uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+            for (char c : str)
+                h = (h ^ (uint8_t)c) * 16777619u;
+            return h ^ (h >> 15);
+        }
+    };
 
-    enum DataType : uint8_t
+    template <std::size_t N>
+    PerfectHash(const std::array<std::string_view, N> &) -> PerfectHash<N>;
+
+    enum class Token : uint8_t
     {
-        Array,
+        /// @brief No token was read yet, or the end of the input or an error was hit
+        None,
+        ArrayBegin,
         ArrayEnd,
-        Object,
+        ObjectBegin,
         ObjectEnd,
+        /// @brief An object key, the value follows as the next token
+        Key,
         Str,
+        Int,
+        Double,
         True,
         False,
-        Int,
         Null
     };
 
-    class Unpacker
+    /// @brief A validating single-pass JSON tokenizer
+    /// @note Strings without escapes point into the input, escaped strings are decoded into a buffer
+    /// that is reused by the next string. Numbers without fraction or exponent that fit into 64 bits are read as Int
+    class Tokenizer
     {
     public:
-        Unpacker() : data_pointer(nullptr), data_end(nullptr) {};
+        /// @brief The maximum nesting depth of arrays and objects
+        static constexpr uint8_t MAX_DEPTH = 32;
 
-        Unpacker(const uint8_t *data_start, std::size_t bytes)
-            : data_pointer(data_start), data_end(data_start + bytes) {};
+        Tokenizer(const uint8_t *data, std::size_t size) : data_pointer(data), data_end(data + size) {}
 
-        void set_data(const uint8_t *pointer, std::size_t size)
+        /// @brief Reads the next token
+        /// @return False at the end of the input or if the input is invalid, see has_error
+        bool next()
         {
-            data_pointer = pointer;
-            data_end = data_pointer + size;
+            current = Token::None;
+            if (failed)
+                return false;
+
+            skip_whitespace();
+            if (data_pointer == data_end)
+            {
+                // truncated input is an error, trailing whitespace is not
+                failed = depth > 0 || expect != Expect::Done;
+                return false;
+            }
+
+            char c = *data_pointer;
+            switch (expect)
+            {
+            case Expect::Done:
+                return fail();
+            case Expect::CommaOrEnd:
+                if (c == ',')
+                {
+                    data_pointer++;
+                    skip_whitespace();
+                    return in_object() ? read_key() : read_value();
+                }
+                return read_end(c);
+            case Expect::KeyOrEnd:
+                if (c == '}')
+                    return read_end(c);
+                return read_key();
+            case Expect::ValueOrEnd:
+                if (c == ']')
+                    return read_end(c);
+                return read_value();
+            default:
+                return read_value();
+            }
         }
 
-        void unpack_array()
+        /// @brief Skips the value of the current token, nested arrays and objects included
+        /// @return False if the input ended or is invalid
+        bool skip()
         {
-            safe_find_after('[');
+            if (current != Token::ArrayBegin && current != Token::ObjectBegin)
+                return !failed;
+
+            uint8_t target = depth - 1;
+            while (next())
+            {
+                if (depth == target && (current == Token::ArrayEnd || current == Token::ObjectEnd))
+                    return true;
+            }
+            return false;
         }
 
-        void unpack_array_end()
+        /// @brief Returns the last read token
+        inline Token token() const { return current; }
+        /// @brief Returns the text of the last Key or Str token
+        inline std::string_view string() const { return text; }
+        /// @brief Returns the value of the last Int token
+        inline int64_t int_value() const { return integer; }
+        /// @brief Returns the value of the last Int or Double token
+        inline double double_value() const { return current == Token::Int ? (double)integer : floating; }
+        /// @brief Returns true if the last token was a number
+        inline bool is_number() const { return current == Token::Int || current == Token::Double; }
+        /// @brief Returns true if the last token was true or false
+        inline bool is_bool() const { return current == Token::True || current == Token::False; }
+        /// @brief Returns true if the input is invalid
+        inline bool has_error() const { return failed; }
+
+    private:
+        enum class Expect : uint8_t
         {
-            safe_find_after(']');
+            Value,
+            ValueOrEnd,
+            KeyOrEnd,
+            CommaOrEnd,
+            Done
+        };
+
+        const uint8_t *data_pointer;
+        const uint8_t *data_end;
+
+        Token current = Token::None;
+        Expect expect = Expect::Value;
+        bool failed = false;
+        uint8_t depth = 0;
+        /// @brief One bit per nesting level, set for objects
+        uint32_t object_bits = 0;
+
+        std::string_view text;
+        int64_t integer = 0;
+        double floating = 0;
+        /// @brief Holds the last decoded string with escapes
+        std::string escaped;
+
+        inline bool fail()
+        {
+            failed = true;
+            current = Token::None;
+            return false;
         }
 
-        void unpack_object()
+        inline bool in_object() const
         {
-            safe_find_after('{');
+            return depth > 0 && (object_bits >> (depth - 1)) & 1;
         }
 
-        void unpack_object_end()
+        inline bool emit(Token token)
         {
-            safe_find_after('}');
+            current = token;
+            return true;
         }
 
-        std::string_view unpack_key()
+        inline void after_value()
         {
-            safe_find_after('"');
-            if (ec == UnpackerError::OutOfRange)
-                return ""sv;
+            expect = depth > 0 ? Expect::CommaOrEnd : Expect::Done;
+        }
 
-            const uint8_t *keyBegin = data_pointer;
-            safe_find('"');
-            if (ec == UnpackerError::OutOfRange)
-                return ""sv;
+        inline void skip_whitespace()
+        {
+            while (data_pointer < data_end &&
+                   (*data_pointer == ' ' || *data_pointer == '\n' || *data_pointer == '\r' || *data_pointer == '\t'))
+                data_pointer++;
+        }
 
-            std::string_view key((const char *)keyBegin, data_pointer - keyBegin);
-            safe_increment();
+        bool push(bool object)
+        {
+            if (depth >= MAX_DEPTH)
+                return fail();
 
-            return key;
+            if (object)
+                object_bits |= 1u << depth;
+            else
+                object_bits &= ~(1u << depth);
+            depth++;
+
+            data_pointer++;
+            expect = object ? Expect::KeyOrEnd : Expect::ValueOrEnd;
+            return emit(object ? Token::ObjectBegin : Token::ArrayBegin);
         }
 
-        inline std::string_view unpack_string() { return unpack_key(); }
+        bool read_end(char c)
+        {
+            bool object = in_object();
+            if (depth == 0 || c != (object ? '}' : ']'))
+                return fail();
+
+            depth--;
+            data_pointer++;
+            after_value();
+            return emit(object ? Token::ObjectEnd : Token::ArrayEnd);
+        }
 
-        int32_t unpack_int()
+        bool read_key()
         {
-            safe_find('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '-', '.');
-            if (ec == UnpackerError::OutOfRange)
-                return 0;
+            if (data_pointer == data_end || *data_pointer != '"' || !read_string())
+                return fail();
 
-            const uint8_t *begin = data_pointer;
-            safe_find(',', '}');
-            if (ec == UnpackerError::OutOfRange)
-                return 0;
+            skip_whitespace();
+            if (data_pointer == data_end || *data_pointer != ':')
+                return fail();
+            data_pointer++;
+
+            expect = Expect::Value;
+            return emit(Token::Key);
+        }
 
-            std::string_view asStr((const char *)begin, data_pointer - begin);
+        bool read_value()
+        {
+            if (data_pointer == data_end)
+                return fail();
 
-            int32_t i;
-            if (std::from_chars(asStr.data(), asStr.data() + asStr.size(), i).ec == std::errc::invalid_argument)
+            switch (*data_pointer)
             {
-                ec = UnpackerError::OutOfRange;
-                return 0;
+            case '{':
+                return push(true);
+            case '[':
+                return push(false);
+            case '"':
+                if (!read_string())
+                    return fail();
+                after_value();
+                return emit(Token::Str);
+            case 't':
+                return read_literal("true"sv, Token::True);
+            case 'f':
+                return read_literal("false"sv, Token::False);
+            case 'n':
+                return read_literal("null"sv, Token::Null);
+            default:
+                return read_number();
             }
-
-            return i;
         }
 
-        bool unpack_bool()
+        bool read_literal(std::string_view literal, Token token)
         {
-            char c;
-            do
-            {
-                c = safe_data();
-                if (ec == UnpackerError::OutOfRange)
-                    break;
+            if ((std::size_t)(data_end - data_pointer) < literal.length() ||
+                std::string_view((const char *)data_pointer, literal.length()) != literal)
+                return fail();
 
-                switch (c)
-                {
-                case 't':
-                    if (data_pointer + 3 < data_end && data_pointer[1] == 'r' && data_pointer[2] == 'u' && data_pointer[3] == 'e')
-                    {
-                        data_pointer += 4;
-                        return true;
-                    }
-                    break;
-                case 'f':
-                    if (data_pointer + 4 < data_end && data_pointer[1] == 'a' && data_pointer[2] == 'l' && data_pointer[3] == 's' && data_pointer[4] == 'e')
-                    {
-                        data_pointer += 5;
-                        return false;
-                    }
-                    break;
-                default:
-                    break;
-                }
-
-                ec = safe_peek_increment(data_pointer);
-            } while (ec != UnpackerError::OutOfRange);
-
-            return false;
+            data_pointer += literal.length();
+            after_value();
+            return emit(token);
         }
 
-        /// @brief Unpacks a bool or sets a default value if null
-        /// @param out_value The value which is set to the bool or default value
-        /// @param default_value The default value to use when null
-        /// @return True if unpack was successful, false if default value was used instead.
-        inline bool unpack_default_bool(bool *out_value, bool default_value)
+        bool read_number()
         {
-            if (peek_type() == Null)
+            const uint8_t *begin = data_pointer;
+            bool integral = true;
+
+            if (data_pointer < data_end && *data_pointer == '-')
+                data_pointer++;
+
+            // no leading zeros
+            if (data_pointer < data_end && *data_pointer == '0')
+                data_pointer++;
+            else if (!skip_digits())
+                return fail();
+
+            if (data_pointer < data_end && *data_pointer == '.')
             {
-                *out_value = default_value;
-                return false;
+                data_pointer++;
+                integral = false;
+                if (!skip_digits())
+                    return fail();
             }
-            else
+
+            if (data_pointer < data_end && (*data_pointer == 'e' || *data_pointer == 'E'))
             {
-                *out_value = unpack_bool();
-                return true;
+                data_pointer++;
+                integral = false;
+                if (data_pointer < data_end && (*data_pointer == '+' || *data_pointer == '-'))
+                    data_pointer++;
+                if (!skip_digits())
+                    return fail();
             }
-        }
 
-        /// @brief Unpacks a bool and sets a value if it is not null
-        /// @param value Reference to a bool which is set if the next value is not null
-        /// @return True if unpack was successful, false if the value was unchanged.
-        inline bool unpack_default_bool(bool &value)
-        {
-            return unpack_default_bool(&value, value);
-        }
+            const char *first = (const char *)begin;
+            const char *last = (const char *)data_pointer;
+            after_value();
 
-        DataType peek_type() const
-        {
-            DataType type;
-            if (peek_type(&type) == UnpackerError::OutOfRange)
-                return Null;
-            else
-                return type;
-        }
+            if (integral && std::from_chars(first, last, integer).ec == std::errc())
+                return emit(Token::Int);
 
-        inline bool is_bool(DataType type) const
-        {
-            return type == True || type == False;
+            // fractions, exponents and integers out of range
+            if (std::from_chars(first, last, floating).ec != std::errc())
+                return fail();
+            return emit(Token::Double);
         }
 
-        inline bool is_bool_or_null(DataType type) const
+        /// @brief Skips one or more digits
+        inline bool skip_digits()
         {
-            return is_bool(type) || type == Null;
+            const uint8_t *begin = data_pointer;
+            while (data_pointer < data_end && *data_pointer >= '0' && *data_pointer <= '9')
+                data_pointer++;
+            return data_pointer != begin;
         }
 
-        std::error_code peek_type(DataType *type) const
+        /// @brief Reads a string starting at the opening quote
+        bool read_string()
         {
-            const uint8_t *ptr = data_pointer;
-            std::error_code ec{};
+            const uint8_t *begin = ++data_pointer;
 
-            char c;
-            do
+            // fast path, strings without escapes point into the input
+            while (data_pointer < data_end && *data_pointer != '"' && *data_pointer != '\\')
             {
-                ec = safe_peek(ptr, (uint8_t &)c);
-                if (ec == UnpackerError::OutOfRange)
-                    break;
+                if (*data_pointer < 0x20)
+                    return false;
+                data_pointer++;
+            }
 
-                switch (c)
-                {
-                case '[':
-                    *type = Array;
-                    return ec;
-                case ']':
-                    *type = ArrayEnd;
-                    return ec;
-                case '{':
-                    *type = Object;
-                    return ec;
-                case '}':
-                    *type = ObjectEnd;
-                    return ec;
-                case '"':
-                    *type = Str;
-                    return ec;
-                case '0':
-                case '1':
-                case '2':
-                case '3':
-                case '4':
-                case '5':
-                case '6':
-                case '7':
-                case '8':
-                case '9':
-                case '-':
-                case '.':
-                    *type = Int;
-                    return ec;
-                case 't':
-                    if (ptr + 3 < data_end && ptr[1] == 'r' && ptr[2] == 'u' && ptr[3] == 'e')
-                    {
-                        *type = True;
-                        return ec;
-                    }
-                    break;
-                case 'f':
-                    if (ptr + 4 < data_end && ptr[1] == 'a' && ptr[2] == 'l' && ptr[3] == 's' && ptr[4] == 'e')
-                    {
-                        *type = False;
-                        return ec;
-                    }
-                    break;
-                case 'n':
-                    if (ptr + 3 < data_end && ptr[1] == 'u' && ptr[2] == 'l' && ptr[3] == 'l')
-                    {
-                        *type = Null;
-                        return ec;
-                    }
-                    break;
-                default:
-                    break;
-                }
+            if (data_pointer == data_end)
+                return false;
 
-                ec = safe_peek_increment(ptr);
-            } while (ec != UnpackerError::OutOfRange);
+            if (*data_pointer == '"')
+            {
+                text = std::string_view((const char *)begin, data_pointer - begin);
+                data_pointer++;
+                return true;
+            }
 
-            return ec;
+            escaped.assign((const char *)begin, data_pointer - begin);
+            while (data_pointer < data_end)
+            {
+                uint8_t c = *data_pointer++;
+                if (c == '"')
+                {
+                    text = escaped;
+                    return true;
+                }
+                else if (c < 0x20)
+                {
+                    return false;
+                }
+                else if (c != '\\')
+                {
+                    escaped.push_back(c);
+                }
+                else if (!read_escape())
+                {
+                    return false;
+                }
+            }
+            return false;
         }
 
-        std::error_code ec{};
+        /// @brief Decodes the escape sequence after a backslash
+        bool read_escape()
+        {
+            if (data_pointer == data_end)
+                return false;
 
-    private:
-        const uint8_t *data_pointer;
-        const uint8_t *data_end;
+            switch (*data_pointer++)
+            {
+            case '"':
+                escaped.push_back('"');
+                return true;
+            case '\\':
+                escaped.push_back('\\');
+                return true;
+            case '/':
+                escaped.push_back('/');
+                return true;
+            case 'b':
+                escaped.push_back('\b');
+                return true;
+            case 'f':
+                escaped.push_back('\f');
+                return true;
+            case 'n':
+                escaped.push_back('\n');
+                return true;
+            case 'r':
+                escaped.push_back('\r');
+                return true;
+            case 't':
+                escaped.push_back('\t');
+                return true;
+            case 'u':
+                break;
+            default:
+                return false;
+            }
 
-        uint8_t safe_data()
-        {
-            if (data_pointer < data_end)
-                return *data_pointer;
-            ec = UnpackerError::OutOfRange;
-            return 0;
-        }
+            uint32_t code;
+            if (!read_hex(&code))
+                return false;
 
-        std::error_code safe_peek(const uint8_t *ptr, uint8_t &data) const
-        {
-            if (ptr < data_end)
+            if (code >= 0xd800 && code < 0xdc00)
             {
-                data = *ptr;
-                return {};
+                // a high surrogate must be followed by a low surrogate
+                uint32_t low;
+                if (data_end - data_pointer < 2 || data_pointer[0] != '\\' || data_pointer[1] != 'u')
+                    return false;
+                data_pointer += 2;
+                if (!read_hex(&low) || low < 0xdc00 || low >= 0xe000)
+                    return false;
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
             }
-            else
+            else if (code >= 0xdc00 && code < 0xe000)
             {
-                return UnpackerError::OutOfRange;
+                return false;
             }
-        }
 
-        void safe_increment(int64_t bytes = 1)
-        {
-            if (data_end - data_pointer >= 0)
+            // UTF-8
+            if (code < 0x80)
             {
-                data_pointer += bytes;
+                escaped.push_back(code);
             }
-            else
+            else if (code < 0x800)
             {
-                ec = UnpackerError::OutOfRange;
+                escaped.push_back(0xc0 | (code >> 6));
+                escaped.push_back(0x80 | (code & 0x3f));
             }
-        }
-
-        std::error_code safe_peek_increment(const uint8_t *&ptr, int64_t bytes = 1) const
-        {
-            if (data_end - ptr >= 0)
+            else if (code < 0x10000)
             {
-                ptr += bytes;
-                return {};
+                escaped.push_back(0xe0 | (code >> 12));
+                escaped.push_back(0x80 | ((code >> 6) & 0x3f));
+                escaped.push_back(0x80 | (code & 0x3f));
             }
             else
             {
-                return UnpackerError::OutOfRange;
+                escaped.push_back(0xf0 | (code >> 18));
+                escaped.push_back(0x80 | ((code >> 12) & 0x3f));
+                escaped.push_back(0x80 | ((code >> 6) & 0x3f));
+                escaped.push_back(0x80 | (code & 0x3f));
             }
+            return true;
         }
 
-        inline void safe_find_after(char ch)
+        /// @brief Reads the 4 hex digits of a \u escape
+        bool read_hex(uint32_t *out_code)
         {
-            char c;
-            do
-            {
-                c = safe_data();
-                safe_increment();
-            } while (ec != UnpackerError::OutOfRange && c != ch);
+            if (data_end - data_pointer < 4)
+                return false;
+
+            auto result = std::from_chars((const char *)data_pointer, (const char *)data_pointer + 4, *out_code, 16);
+            if (result.ec != std::errc() || result.ptr != (const char *)data_pointer + 4)
+                return false;
+
+            data_pointer += 4;
+            return true;
         }
+    };
 
-        inline void safe_find(char ch)
+    /// @brief Appends JSON to a buffer without temporaries
+    /// @tparam Buffer A std::string or any buffer with empty, back, push_back and append(const char *, size_t)
+    /// @note Separators are inserted automatically, a packer can resume writing into an open array or object.
+    /// Nothing is allocated once the buffer has reserved enough capacity
+    template <typename Buffer = std::string>
+    class Packer
+    {
+    public:
+        /// @brief Creates a packer that appends to a buffer
+        /// @param buffer The buffer to append to, may already contain an open array or object
+        Packer(Buffer &buffer) : buffer(buffer)
         {
-            char c;
-            do
+            if (!buffer.empty())
             {
-                c = safe_data();
-                if (c == ch)
-                    break;
-                safe_increment();
-            } while (ec != UnpackerError::OutOfRange);
+                char last = buffer.back();
+                needs_comma = last != '[' && last != '{' && last != ':' && last != ',';
+            }
         }
 
-        template <CharType... Matches>
-        inline void safe_find(Matches... match)
+        void pack_array()
         {
-            ec = safe_peek_find(data_pointer, match...);
+            separate();
+            buffer.push_back('[');
+            needs_comma = false;
         }
 
-        inline std::error_code safe_peek_find_after(char ch, const uint8_t **data_pointer) const
+        void pack_array_end()
         {
-            std::error_code ec{};
-            *data_pointer = this->data_pointer;
-            char c;
-            do
-            {
-                ec = safe_peek(*data_pointer, (uint8_t &)c);
-                if (ec == UnpackerError::OutOfRange)
-                    break;
-                ec = safe_peek_increment(*data_pointer);
-            } while (ec != UnpackerError::OutOfRange && c != ch);
-            return ec;
+            buffer.push_back(']');
+            needs_comma = true;
         }
 
-        inline std::error_code safe_peek_find(char ch, const uint8_t *&data_pointer) const
+        void pack_object()
         {
-            std::error_code ec{};
-            char c;
-            do
-            {
-                ec = safe_peek(data_pointer, (uint8_t &)c);
-                if (ec == UnpackerError::OutOfRange || c == ch)
-                    break;
-                ec = safe_peek_increment(data_pointer);
-            } while (ec != UnpackerError::OutOfRange);
-            return ec;
+            separate();
+            buffer.push_back('{');
+            needs_comma = false;
+        }
+
+        void pack_object_end()
+        {
+            buffer.push_back('}');
+            needs_comma = true;
+        }
+
+        /// @brief Packs an object key, the key is not escaped
+        void pack_key(std::string_view key)
+        {
+            separate();
+            buffer.push_back('"');
+            append(key);
+            append("\":"sv);
+            needs_comma = false;
         }
 
-        template <CharType... Matches>
-        inline std::error_code safe_peek_find(const uint8_t *&data_pointer, Matches... match) const
+        /// @brief Packs a string, escaping quotes, backslashes and control characters
+        void pack_string(std::string_view str)
         {
-            std::error_code ec{};
-            char c;
-            do
+            separate();
+            buffer.push_back('"');
+
+            // copy runs of plain characters at once
+            size_t run = 0;
+            for (size_t i = 0; i < str.length(); i++)
             {
-                ec = safe_peek(data_pointer, (uint8_t &)c);
-                if (ec == UnpackerError::OutOfRange)
-                    break;
+                uint8_t c = str[i];
+                if (c >= 0x20 && c != '"' && c != '\\')
+                    continue;
 
-                // test each match
-                for (const auto p : {match...})
-                {
-                    if (c == p)
-                        return ec;
-                }
+                buffer.append(str.data() + run, i - run);
+                escape(c);
+                run = i + 1;
+            }
+            buffer.append(str.data() + run, str.length() - run);
+
+            buffer.push_back('"');
+            needs_comma = true;
+        }
+
+        void pack_int(int64_t i)
+        {
+            separate();
+            char str[20];
+            auto result = std::to_chars(str, str + sizeof(str), i);
+            buffer.append(str, result.ptr - str);
+            needs_comma = true;
+        }
+
+        void pack_bool(bool b)
+        {
+            separate();
+            append(b ? "true"sv : "false"sv);
+            needs_comma = true;
+        }
+
+        void pack_null()
+        {
+            separate();
+            append("null"sv);
+            needs_comma = true;
+        }
 
-                ec = safe_peek_increment(data_pointer);
-            } while (ec != UnpackerError::OutOfRange);
-            return ec;
+    private:
+        Buffer &buffer;
+        bool needs_comma = false;
+
+        inline void append(std::string_view str)
+        {
+            buffer.append(str.data(), str.length());
+        }
+
+        inline void separate()
+        {
+            if (needs_comma)
+                buffer.push_back(',');
+        }
+
+        void escape(uint8_t c)
+        {
+            buffer.push_back('\\');
+            switch (c)
+            {
+            case '"':
+            case '\\':
+                buffer.push_back(c);
+                break;
+            case '\b':
+                buffer.push_back('b');
+                break;
+            case '\f':
+                buffer.push_back('f');
+                break;
+            case '\n':
+                buffer.push_back('n');
+                break;
+            case '\r':
+                buffer.push_back('r');
+                break;
+            case '\t':
+                buffer.push_back('t');
+                break;
+            default:
+                constexpr char hex[] = "0123456789abcdef";
+                append("u00"sv);
+                buffer.push_back(hex[c >> 4]);
+                buffer.push_back(hex[c & 0xf]);
+                break;
+            }
         }
     };
 };
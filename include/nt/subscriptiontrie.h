@@ -0,0 +1,181 @@
+#ifndef _SUBSCRIPTION_TRIE_H_
+#define _SUBSCRIPTION_TRIE_H_
+
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+/// @brief A radix trie of NetworkTables subscription patterns
+/// @note Matching a name walks the trie once, independent of the number of patterns.
+/// Like NT4, the empty prefix pattern does not match names starting with '$'
+template <typename T>
+class SubscriptionTrie
+{
+public:
+    SubscriptionTrie() = default;
+
+    /// @brief Frees all nodes
+    ~SubscriptionTrie()
+    {
+        clear();
+    }
+
+    SubscriptionTrie(const SubscriptionTrie &) = delete;
+    SubscriptionTrie &operator=(const SubscriptionTrie &) = delete;
+
+    /// @brief Adds a value for a pattern
+    /// @param pattern The topic name or prefix
+    /// @param prefix True if the pattern matches all names starting with it
+    /// @param value The value reported for matching names
+    void insert(std::string_view pattern, bool prefix, const T &value)
+    {
+        Node *node = &root;
+        while (!pattern.empty())
+        {
+            Node *child = findChild(node, pattern[0]);
+            if (child == nullptr)
+            {
+                // no shared prefix, the rest becomes a new leaf
+                child = new Node();
+                child->label = pattern;
+                node->children.push_back(child);
+                node = child;
+                break;
+            }
+
+            size_t common = commonLength(child->label, pattern);
+            if (common < child->label.length())
+            {
+                // split the edge at the end of the shared prefix
+                Node *mid = new Node();
+                mid->label = child->label.substr(0, common);
+                child->label.erase(0, common);
+                mid->children.push_back(child);
+                *std::find(node->children.begin(), node->children.end(), child) = mid;
+                child = mid;
+            }
+
+            node = child;
+            pattern.remove_prefix(common);
+        }
+
+        (prefix ? node->prefix : node->exact).push_back(value);
+    }
+
+    /// @brief Removes one value of a pattern, empty leaves are freed
+    /// @return False if the pattern had no such value
+    bool remove(std::string_view pattern, bool prefix, const T &value)
+    {
+        return removeFrom(&root, pattern, prefix, value);
+    }
+
+    /// @brief Calls a callback for the value of every pattern that matches a name
+    /// @param name The topic name
+    /// @param callback Called with a const T &
+    template <typename F>
+    void match(std::string_view name, F callback) const
+    {
+        const Node *node = &root;
+
+        // the empty prefix does not match meta-topics
+        if (name.empty() || name[0] != '$')
+        {
+            for (const T &value : node->prefix)
+                callback(value);
+        }
+
+        while (!name.empty())
+        {
+            node = findChild(node, name[0]);
+            if (node == nullptr || !name.starts_with(node->label))
+                return;
+
+            name.remove_prefix(node->label.length());
+            for (const T &value : node->prefix)
+                callback(value);
+        }
+
+        for (const T &value : node->exact)
+            callback(value);
+    }
+
+    /// @brief Removes all patterns
+    void clear()
+    {
+        for (Node *child : root.children)
+            freeNode(child);
+        root.children.clear();
+        root.exact.clear();
+        root.prefix.clear();
+    }
+
+private:
+    struct Node
+    {
+        /// @brief The edge from the parent, empty for the root
+        std::string label;
+        std::vector<Node *> children;
+        /// @brief Values of the patterns ending here
+        std::vector<T> exact;
+        /// @brief Values of the prefix patterns ending here
+        std::vector<T> prefix;
+    };
+
+    Node root;
+
+    static Node *findChild(const Node *node, char c)
+    {
+        for (Node *child : node->children)
+        {
+            if (child->label[0] == c)
+                return child;
+        }
+        return nullptr;
+    }
+
+    static size_t commonLength(std::string_view a, std::string_view b)
+    {
+        size_t i = 0;
+        while (i < a.length() && i < b.length() && a[i] == b[i])
+            i++;
+        return i;
+    }
+
+    static void freeNode(Node *node)
+    {
+        for (Node *child : node->children)
+            freeNode(child);
+        delete node;
+    }
+
+    bool removeFrom(Node *node, std::string_view pattern, bool prefix, const T &value)
+    {
+        if (pattern.empty())
+        {
+            std::vector<T> &values = prefix ? node->prefix : node->exact;
+            auto it = std::find(values.begin(), values.end(), value);
+            if (it == values.end())
+                return false;
+            values.erase(it);
+            return true;
+        }
+
+        Node *child = findChild(node, pattern[0]);
+        if (child == nullptr || !pattern.starts_with(child->label))
+            return false;
+
+        if (!removeFrom(child, pattern.substr(child->label.length()), prefix, value))
+            return false;
+
+        if (child->children.empty() && child->exact.empty() && child->prefix.empty())
+        {
+            node->children.erase(std::find(node->children.begin(), node->children.end(), child));
+            delete child;
+        }
+        return true;
+    }
+};
+
+#endif
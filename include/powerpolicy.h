@@ -0,0 +1,64 @@
+#ifndef _POWER_POLICY_H_
+#define _POWER_POLICY_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// The wake latency of power save is about one beacon interval per listened beacon
+constexpr uint32_t POWER_POLICY_BEACON_INTERVAL_MS = 103;
+// The maximum number of beacons the radio sleeps through in power save
+constexpr uint32_t POWER_POLICY_MAX_LISTEN_BEACONS = 10;
+
+/// @brief The wifi power mode
+enum class WifiPowerMode
+{
+    /// @brief The radio stays awake, lowest latency
+    Performance,
+    /// @brief The radio sleeps between beacons, highest latency
+    PowerSave
+};
+
+/// @brief Decides the wifi power mode from traffic activity, independent of the wifi driver
+/// @note Switches to performance as soon as a window has enough frames, and back to power save only after a longer idle time
+class WifiPowerPolicy
+{
+public:
+    /// @brief Creates a new policy
+    /// @param latencyBudgetMs The maximum wake latency allowed in power save, less than one beacon interval disables power save
+    /// @param windowMs The length of the window frames are counted in
+    /// @param activeFrames The number of frames in a window that switch to performance
+    /// @param idleTimeoutMs How long no window may reach activeFrames before switching to power save
+    WifiPowerPolicy(uint32_t latencyBudgetMs, uint32_t windowMs = 1000, uint32_t activeFrames = 3, uint32_t idleTimeoutMs = 5000);
+
+    /// @brief Feeds new activity into the policy
+    /// @param nowMs The current time in milliseconds
+    /// @param frames The number of frames since the last update
+    /// @return The power mode to use
+    WifiPowerMode update(uint32_t nowMs, uint32_t frames);
+
+    /// @brief Switches to performance and restarts the idle time, e.g. for a new link
+    /// @param nowMs The current time in milliseconds
+    void reset(uint32_t nowMs);
+
+    /// @brief Returns the current power mode
+    WifiPowerMode getMode();
+    /// @brief Sets the maximum wake latency allowed in power save
+    void setLatencyBudget(uint32_t latencyBudgetMs);
+    /// @brief Returns the maximum wake latency allowed in power save
+    uint32_t getLatencyBudget();
+    /// @brief Returns the number of beacons the radio may sleep through within the latency budget, 0 if power save is disabled
+    uint32_t getListenBeacons();
+
+private:
+    uint32_t latencyBudgetMs;
+    uint32_t windowMs;
+    uint32_t activeFrames;
+    uint32_t idleTimeoutMs;
+
+    WifiPowerMode mode = WifiPowerMode::Performance;
+    uint32_t windowStartMs = 0;
+    uint32_t windowFrames = 0;
+    uint32_t lastActiveMs = 0;
+};
+
+#endif
@@ -2,25 +2,143 @@
 #define _RADIO_H_
 
 #include <stdlib.h>
+#include <atomic>
+#include <FreeRTOS.h>
+#include <task.h>
 #include "dhcpserver.h"
+#include "mdnsresponder.h"
+#include "eventhandler.h"
+#include "powerpolicy.h"
+
+// The timeout of a join attempt with a full scan
+constexpr uint32_t RADIO_JOIN_TIMEOUT_MS = 30000;
+// The timeout of a join attempt to the last known access point
+constexpr uint32_t RADIO_FAST_JOIN_TIMEOUT_MS = 5000;
+// The first and maximum delay between failed join attempts, doubled after every failure
+constexpr uint32_t RADIO_BACKOFF_MIN_MS = 500;
+constexpr uint32_t RADIO_BACKOFF_MAX_MS = 30000;
+// How often the link status is polled while joining, and checked while the link is up
+constexpr uint32_t RADIO_JOIN_POLL_MS = 100;
+constexpr uint32_t RADIO_LINK_CHECK_MS = 1000;
+// The timeout of the channel scan in access point mode
+constexpr uint32_t RADIO_CHANNEL_SCAN_TIMEOUT_MS = 5000;
+// How long the radio stays awake after traffic in power save
+constexpr uint32_t RADIO_POWER_SAVE_SLEEP_RET_MS = 200;
+
+/// @brief The state of the wifi link
+enum class RadioLinkState
+{
+    /// @brief Not connected, waiting for the next join attempt
+    Down,
+    /// @brief A join attempt is in progress
+    Joining,
+    /// @brief Connected and the interface has an IP address
+    Up,
+    /// @brief Gave up after NET_RETRY_COUNT failed join attempts
+    Failed
+};
 
 /// @brief Wifi Radio that uses cyw43 driver
 class Radio
 {
 public:
     /// @brief Initializes wifi driver and connects to or creates a network
-    Radio();
+    /// @param waitForLink Blocks until the link is up or failed, otherwise the network is joined in the background
+    Radio(bool waitForLink = true);
     /// @brief Deinitializes the wifi driver
     ~Radio();
 
+    /// @brief Starts joining the network in the background, does nothing if already started
+    /// @note In station mode a lost link is rejoined automatically, first to the last access point and channel
+    void start();
     /// @brief Deinitializes the wifi driver
+    /// @note Must not be called from a link callback
     void deinit();
     /// @brief Returns true if the radio is initialized
     bool isInitialized();
+    /// @brief Returns true if the link is up
+    bool isLinkUp();
+    /// @brief Returns the current link state
+    RadioLinkState getLinkState();
+    /// @brief Blocks until the link is up
+    /// @param timeoutMs The timeout in milliseconds
+    /// @return False if the link failed or the timeout was hit
+    bool waitForLinkUp(uint32_t timeoutMs);
+    /// @brief Returns the milliseconds it took from the start or the last link loss until the link was up
+    uint32_t getLinkUpTime();
+    /// @brief Returns the mDNS responder, or null if disabled
+    MdnsResponder *getMdnsResponder();
+
+    /// @brief Reads the received signal strength of the station link
+    /// @param out_rssi Set to the signal strength in dBm
+    /// @return False if not connected or in access point mode
+    bool getRssi(int32_t *out_rssi);
+    /// @brief Returns the cyw43 link status of the interface, see CYW43_LINK_*
+    int getLinkStatus();
+    /// @brief Returns the current wifi channel, or -1 if unknown
+    int getChannel();
+    /// @brief Returns the number of associated stations in access point mode, otherwise -1
+    int getStationCount();
+
+    /// @brief Reports traffic to the power policy, wakes the radio from power save if needed
+    /// @param frames The number of sent or received frames
+    /// @note The default radio registers it with ws_server_set_activity_callback, so it is called for every received frame
+    void notifyActivity(uint32_t frames = 1);
+    /// @brief Sets the maximum wake latency allowed in power save, less than one beacon interval (~100 ms) disables power save
+    void setLatencyBudget(uint32_t latencyBudgetMs);
+    /// @brief Returns the current wifi power mode
+    WifiPowerMode getPowerMode();
+
+    /// @brief Returns the first created radio
+    static Radio *getDefault();
+
+    /// @brief Custom args for the link callbacks, set by the user
+    void *callbackArgs = nullptr;
+    /// @brief Callback for link up events, contains the Radio instance and the time it took to bring the link up
+    typedef void (*LinkUpCallback)(Radio *radio, uint32_t linkUpTimeMs, void *args);
+    /// @brief Called from the link task whenever the link is up
+    EventHandler<LinkUpCallback> linkUp;
+    /// @brief Callback for link down events, contains the Radio instance and the cyw43 link status
+    typedef void (*LinkDownCallback)(Radio *radio, int status, void *args);
+    /// @brief Called from the link task whenever an established link is lost
+    EventHandler<LinkDownCallback> linkDown;
+
+    /// @brief Used internally to run the link state machine
+    void runLink();
 
 private:
     bool initialized;
     dhcp_server_t dhcp_server;
+    MdnsResponder *mdns = nullptr;
+
+    volatile RadioLinkState linkState = RadioLinkState::Down;
+    volatile bool linkRunning = false;
+    /// @brief Handle to the link task, null when it is not running
+    volatile TaskHandle_t linkTask = nullptr;
+    uint32_t linkUpTimeMs = 0;
+
+    /// @brief The access point of the last established link, used for fast reconnects
+    uint8_t lastBssid[6];
+    uint32_t lastChannel;
+    bool hasLastBssid = false;
+
+    WifiPowerPolicy powerPolicy;
+    /// @brief The power mode applied to the driver
+    volatile WifiPowerMode powerMode = WifiPowerMode::Performance;
+    std::atomic<uint32_t> activityFrames = 0;
+    uint32_t lastActivityFrames = 0;
+
+    /// @brief Makes a single join attempt
+    /// @param fast Join the last access point on its channel without scanning
+    /// @return CYW43_LINK_UP on success, otherwise the failed status
+    int join(bool fast);
+    /// @brief Blocks until the established link is lost
+    /// @return The link status
+    int waitForLinkDown();
+    /// @brief Feeds the activity since the last call into the power policy and applies its mode
+    void updatePowerMode(bool force);
+
+    static void netifCallback(struct netif *netif);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,71 @@
+#ifndef _RADIO_TELEMETRY_H_
+#define _RADIO_TELEMETRY_H_
+
+#include <stdlib.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include "radio.h"
+#include "nt/ntinstance.h"
+#include "nt/ntpublisher.h"
+
+/// @brief The default period between two link quality samples
+constexpr uint32_t RADIO_TELEMETRY_DEFAULT_PERIOD_MS = 1000;
+
+/// @brief Periodically samples the wifi link quality and publishes it as $radio/... topics
+/// @note A topic is created by the first sample that reads its value, so $radio/rssi only exists in station mode and
+/// $radio/stations only in access point mode. A sample only publishes the values that changed. Publishing allocates
+/// a new value snapshot while a local subscriber holds the previous one, and packs the update of `all` subscriptions into a queue
+class RadioTelemetry
+{
+public:
+    /// @brief Takes the first sample, which creates the $radio topics, and starts sampling
+    /// @param radio The radio to sample, must outlive the telemetry
+    /// @param nt The instance to publish to, must outlive the telemetry
+    /// @param periodMs The period between two samples in milliseconds
+    RadioTelemetry(Radio *radio, NetworkTableInstance *nt, uint32_t periodMs = RADIO_TELEMETRY_DEFAULT_PERIOD_MS);
+    /// @brief Stops sampling and unpublishes the $radio topics
+    ~RadioTelemetry();
+
+    /// @brief Sets the period between two samples
+    void setPeriod(uint32_t periodMs);
+    /// @brief Reads the radio state and publishes the values that changed
+    void sample();
+
+    /// @brief Used internally to run the sampler
+    void run();
+
+private:
+    /// @brief A published value and the last value sent for it
+    struct Value
+    {
+        const char *name;
+        /// @brief Null until the first sample with a value
+        NTPublisher *publisher = nullptr;
+        int64_t last = 0;
+    };
+
+    Radio *radio;
+    NetworkTableInstance *nt;
+    volatile uint32_t periodMs;
+    volatile bool running;
+    /// @brief Handle to the sampler task, null when it is not running
+    volatile TaskHandle_t task = nullptr;
+
+    /// @brief The received signal strength in dBm, station mode only
+    Value rssi = {"$radio/rssi"};
+    /// @brief The cyw43 link status, see CYW43_LINK_*
+    Value linkStatus = {"$radio/linkStatus"};
+    Value channel = {"$radio/channel"};
+    /// @brief The number of associated stations, access point mode only
+    Value stations = {"$radio/stations"};
+    /// @brief 1 while the radio is in power save
+    Value powerSave = {"$radio/powerSave"};
+    /// @brief The milliseconds it took to bring the link up the last time
+    Value linkUpTime = {"$radio/linkUpTimeMs"};
+
+    /// @brief Publishes a value if it changed, the first value creates the topic
+    /// @return True if the value was published
+    bool set(Value &value, int64_t current);
+};
+
+#endif
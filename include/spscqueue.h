@@ -0,0 +1,85 @@
+#ifndef _SPSC_QUEUE_H_
+#define _SPSC_QUEUE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+
+/// @brief A bounded lock-free queue for exactly one producer and one consumer thread
+template <typename T>
+class SpscQueue
+{
+public:
+    /// @brief Creates a new queue
+    /// @param capacity The maximum number of elements in the queue
+    SpscQueue(size_t capacity) : slots(capacity + 1), head(0), tail(0)
+    {
+        array = new T[slots];
+    }
+
+    /// @brief Frees the queue storage
+    ~SpscQueue()
+    {
+        delete[] array;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    /// @brief Adds an element to the queue (producer only)
+    /// @param item The element to add
+    /// @return False if the queue is full
+    bool Push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = t + 1 == slots ? 0 : t + 1;
+        if (next == head.load(std::memory_order_acquire))
+            return false; // full
+
+        array[t] = item;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief Removes the oldest element from the queue (consumer only)
+    /// @param out_item Set to the removed element
+    /// @return False if the queue is empty
+    bool Pop(T &out_item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false; // empty
+
+        out_item = array[h];
+        head.store(h + 1 == slots ? 0 : h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief Returns the current number of elements in the queue
+    size_t Count() const
+    {
+        size_t h = head.load(std::memory_order_acquire);
+        size_t t = tail.load(std::memory_order_acquire);
+        return t >= h ? t - h : slots - h + t;
+    }
+
+    /// @brief Returns true if the queue has no elements
+    bool Empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    /// @brief Returns the maximum number of elements in the queue
+    size_t Capacity() const
+    {
+        return slots - 1;
+    }
+
+private:
+    size_t slots;
+    T *array;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+};
+
+#endif
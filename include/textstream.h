@@ -3,11 +3,25 @@
 
 #include <stdlib.h>
 #include <string>
+#include <string_view>
 #include "tcpclient.h"
 
 // The default size of the TextStream buffer
 constexpr size_t DEFAULT_TEXTSTREAM_BUFFER_SIZE = 128;
 
+/// @brief Result of a TextStream read operation
+enum class TextStreamResult
+{
+    /// @brief A full line was read
+    Ok,
+    /// @brief The TcpClient timed out before a full line was received
+    Timeout,
+    /// @brief The TcpClient was disconnected or had a socket error
+    Disconnected,
+    /// @brief The line exceeded the maximum line length and was discarded
+    LineTooLong
+};
+
 /// @brief Provides a way to use std::string with TcpClient
 class TextStream
 {
@@ -17,18 +31,28 @@ public:
     TextStream(TcpClient *source);
     /// @brief Create a new TextStream based on a TcpClient
     /// @param source The client to read/write from
-    /// @param bufferSize A custom buffer size to use
+    /// @param bufferSize A custom buffer size to use (also the maximum line length)
     TextStream(TcpClient *source, size_t bufferSize);
+    /// @brief Create a new TextStream based on a TcpClient
+    /// @param source The client to read/write from
+    /// @param bufferSize A custom buffer size to use
+    /// @param maxLineLength The maximum length of a line (must not exceed bufferSize)
+    TextStream(TcpClient *source, size_t bufferSize, size_t maxLineLength);
     /// @brief Free the internal buffer
     ~TextStream();
 
     /// @brief Reads a line from the TcpClient
-    /// @return A std::string containing the line
-    std::string readLine();
+    /// @return A view of the line, valid until the next read
+    std::string_view readLine();
     /// @brief Reads a line from the TcpClient
     /// @param timeout The timeout passed to the TcpClient
-    /// @return A std::string containing the line (empty on timeout)
-    std::string readLine(uint32_t timeout);
+    /// @return A view of the line, valid until the next read (empty on timeout)
+    std::string_view readLine(uint32_t timeout);
+    /// @brief Reads a line from the TcpClient
+    /// @param timeout The timeout passed to the TcpClient
+    /// @param out_result Set to the result of the read (can be null)
+    /// @return A view of the line, valid until the next read (empty on error)
+    std::string_view readLine(uint32_t timeout, TextStreamResult *out_result);
 
     /// @brief Writes a std::string to the TcpClient
     /// @param str The string to write
@@ -42,12 +66,27 @@ public:
 private:
     TcpClient *source;
     size_t bufferSize;
+    size_t maxLineLength;
     uint8_t *buffer;
 
-    ssize_t rpos = 0;
-    ssize_t rend = 0;
-    ssize_t rstart = 0;
-    ssize_t end = 0;
+    /// @brief Index of the first unread byte in the ring buffer
+    size_t head = 0;
+    /// @brief Number of unread bytes in the ring buffer
+    size_t count = 0;
+    /// @brief Number of unread bytes already scanned for a line ending
+    size_t scanned = 0;
+    /// @brief Number of bytes used by the last returned line, released on the next read
+    size_t consumed = 0;
+    /// @brief True if the last line ended with CR and a following LF should be skipped
+    bool skipLF = false;
+    /// @brief True if the rest of an overlong line is being discarded
+    bool discarding = false;
+
+    /// @brief Drops bytes from the front of the ring buffer
+    void drop(size_t len);
+    /// @brief Finds the next CR or LF in the unscanned part of the ring buffer
+    /// @return The offset from head, or count if none was found
+    size_t findLineEnd();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,8 +2,30 @@
 #define _UDP_SOCKET_H_
 
 #include <stdlib.h>
+#include <FreeRTOS.h>
+#include <task.h>
 #include <lwip/netif.h>
 #include <lwip/ip4_addr.h>
+#include <lwip/pbuf.h>
+#include "spscqueue.h"
+
+// The maximum number of queued Datagrams whose pbufs are freed under a single lwIP lock
+constexpr size_t UDP_SOCKET_RECEIVE_BATCH_SIZE = 8;
+// The maximum number of zero-copy sends per socket that can wait for completion at once
+constexpr size_t UDP_SOCKET_MAX_PENDING_SENDS = 8;
+// The maximum number of multicast groups a socket can join
+constexpr size_t UDP_SOCKET_MAX_MULTICAST_GROUPS = 4;
+
+class UdpSocket;
+
+/// @brief A contiguous part of a Datagram payload
+struct DatagramSegment
+{
+    /// @brief The segment data
+    const void *data;
+    /// @brief The length of the segment
+    uint16_t length;
+};
 
 /// @brief Represents a UDP payload, together with a target address and por
 struct Datagram
@@ -30,8 +52,14 @@ struct Datagram
     /// @param address The target address to broadcast to
     /// @param port The target port to broadcast to
     Datagram(const void *data, uint16_t length, const ip_addr_t *address, uint16_t port);
+    /// @brief Create a new Datagram that views a received pbuf chain without copying
+    /// @param chain The pbuf chain holding the payload
+    /// @param address The address the Datagram was received from
+    /// @param port The port the Datagram was received from
+    Datagram(struct pbuf *chain, const ip_addr_t *address, uint16_t port);
 
     /// @brief The payload data
+    /// @note A received payload that spans multiple pbufs is copied into a single pbuf before the receive callback
     const void *data;
     /// @brief The length of the payload
     uint16_t length;
@@ -39,6 +67,40 @@ struct Datagram
     const ip_addr_t *address;
     /// @brief the target port of this Datagram
     uint16_t port;
+    /// @brief The pbuf chain of a received Datagram, owned by the socket unless taken with takePbuf()
+    struct pbuf *chain = nullptr;
+    /// @brief True if ownership of the pbuf chain was taken with takePbuf()
+    bool pbufTaken = false;
+
+    /// @brief Returns true if the whole payload can be accessed through data
+    bool isContiguous();
+    /// @brief Copies a part of the payload into a buffer
+    /// @param buffer The buffer to copy to
+    /// @param length The maximum number of bytes to copy
+    /// @param offset The payload offset to start copying from
+    /// @return The number of bytes copied
+    uint16_t copyTo(void *buffer, uint16_t length, uint16_t offset = 0);
+    /// @brief Takes ownership of the pbuf chain, so it is not freed after the receive callback returns
+    /// @return The pbuf chain, which must be released with pbuf_free(), or null if there is none
+    /// @note The data and segments of this Datagram remain valid until the pbuf chain is freed
+    struct pbuf *takePbuf();
+
+    /// @brief Iterates over the contiguous segments of the payload
+    struct SegmentIterator
+    {
+        const struct pbuf *p;
+        const void *data;
+        uint16_t length;
+
+        DatagramSegment operator*() const;
+        SegmentIterator &operator++();
+        bool operator!=(const SegmentIterator &other) const;
+    };
+
+    /// @brief Returns an iterator to the first payload segment
+    SegmentIterator begin();
+    /// @brief Returns an iterator past the last payload segment
+    SegmentIterator end();
 
     /// @brief Create a new Datagram with the same address and port
     /// @param data The new payload
@@ -52,6 +114,34 @@ struct Datagram
     Datagram asReply(const void *data, uint16_t length);
 };
 
+/// @brief Counters of a UdpSocket, only updated from the lwIP thread
+struct UdpSocketStats
+{
+    /// @brief The number of Datagrams received
+    uint32_t received;
+    /// @brief The number of Datagrams dropped because the receive queue was full, or a chained payload could not be copied
+    uint32_t dropped;
+    /// @brief The highest number of Datagrams waiting in the receive queue
+    uint32_t queueHighWater;
+    /// @brief The number of zero-copy sends rejected because all pending send slots were taken
+    uint32_t sendSlotsExhausted;
+};
+
+/// @brief This callback is called once the network stack no longer references the buffer of a zero-copy send
+typedef void (*UdpSocketSendCallback)(UdpSocket *socket, const void *data, void *args);
+
+/// @brief A zero-copy send waiting for the network stack to release its buffer
+struct UdpPendingSend
+{
+    /// @brief The lwIP custom pbuf referencing the caller's buffer, must be the first member
+    struct pbuf_custom custom;
+    UdpSocket *socket;
+    const void *data;
+    UdpSocketSendCallback callback;
+    void *args;
+    bool inUse;
+};
+
 /// @brief A UDP socket implementation
 class UdpSocket
 {
@@ -84,14 +174,94 @@ public:
     /// @return True if succeeded
     /// @note  This overwrites the existing address of the Datagram
     bool broadcast(Datagram *datagram);
-    /// @brief Sends a Datagram to a specific address and port
+    /// @brief Sends a Datagram to a multicast group using the Datagram's port.
+    ///        A single copy is transmitted, only hosts that joined the group receive it.
     /// @param datagram The datagram to send
+    /// @param group The multicast group address
+    /// @return True if succeeded
+    /// @note  This overwrites the existing address of the Datagram
+    bool multicast(Datagram *datagram, const ip_addr_t *group);
+    /// @brief Sends a Datagram to a specific address and port
+    /// @param datagram The datagram to send, or to the connected remote if the address is null
     /// @return True if succeeded
     bool sendDatagram(Datagram *datagram);
+    /// @brief Sends a Datagram without copying its payload
+    /// @param datagram The datagram to send, or to the connected remote if the address is null
+    /// @param callback Called exactly once, when the payload buffer may be reused (can be null)
+    /// @param args Custom args passed to the callback
+    /// @return True if succeeded
+    /// @note The payload must stay valid until the callback is called. The callback may run on the lwIP thread
+    ///       or with the lwIP lock held, so it must not block
+    bool sendDatagramRef(Datagram *datagram, UdpSocketSendCallback callback, void *args);
+    /// @brief Sends a batch of Datagrams under a single lwIP lock without copying their payloads
+    /// @param datagrams The datagrams to send
+    /// @param count The number of datagrams
+    /// @return The number of datagrams sent successfully
+    size_t sendMany(Datagram *datagrams, size_t count);
+    /// @brief Joins a multicast group on all network interfaces, so the socket receives Datagrams sent to it
+    /// @param group The multicast group address
+    /// @return True if succeeded
+    bool joinMulticastGroup(const ip_addr_t *group);
+    /// @brief Leaves a multicast group joined with joinMulticastGroup()
+    /// @param group The multicast group address
+    /// @return True if succeeded
+    bool leaveMulticastGroup(const ip_addr_t *group);
+    /// @brief Sets the time-to-live of sent multicast Datagrams (default 1, the local network only)
+    /// @param ttl The number of hops
+    void setMulticastTtl(uint8_t ttl);
+    /// @brief Sets if sent multicast Datagrams are also delivered to joined groups on this device
+    /// @param loopback True to enable loopback
+    void setMulticastLoopback(bool loopback);
+
+    /// @brief Returns the broadcast address of the local network interface
+    /// @note The address is cached and only recomputed when the interface address changes
+    const ip_addr_t *getBroadcastAddress();
+
+    /// @brief Queue received Datagrams instead of calling receiveCallback from the lwIP thread
+    /// @param depth The maximum number of queued Datagrams, further Datagrams are dropped
+    /// @return True if succeeded
+    /// @note The queued Datagrams are passed to receiveCallback by processReceiveQueue()
+    bool enableReceiveQueue(size_t depth);
+    /// @brief Calls receiveCallback for queued Datagrams from the calling task
+    /// @param maxCount The maximum number of Datagrams to process
+    /// @param timeout The time in ms to wait for a Datagram if the queue is empty
+    /// @return The number of Datagrams processed
+    /// @note Only one task may process the receive queue
+    size_t processReceiveQueue(size_t maxCount, uint32_t timeout);
 
     // Internal socket reference
     struct udp_pcb *udp;
 
+    /// @brief A received Datagram waiting in the receive queue
+    struct QueuedDatagram
+    {
+        struct pbuf *chain;
+        ip_addr_t address;
+        uint16_t port;
+    };
+
+    /// @brief The receive queue, null unless enabled
+    SpscQueue<QueuedDatagram> *receiveQueue = nullptr;
+    /// @brief The task waiting in processReceiveQueue()
+    volatile TaskHandle_t receiveTask = nullptr;
+
+    /// @brief Receive, drop and send slot counters of this socket
+    UdpSocketStats stats = {};
+
+    /// @brief Slots for zero-copy sends waiting for completion
+    UdpPendingSend pendingSends[UDP_SOCKET_MAX_PENDING_SENDS] = {};
+
+    /// @brief The multicast groups joined by this socket, left on deinit
+    ip_addr_t multicastGroups[UDP_SOCKET_MAX_MULTICAST_GROUPS] = {};
+    size_t multicastGroupCount = 0;
+
+    /// @brief The cached broadcast address and the interface address and netmask it was computed from
+    ip_addr_t broadcastAddress = {};
+    u32_t broadcastSourceIp = 0;
+    u32_t broadcastSourceNetmask = 0;
+    /// @brief False until the broadcast address is computed, an unconfigured interface also has a zero address and netmask
+    bool broadcastCached = false;
+
     /// @brief Custom args for the udp callbacks, set by the user
     void *callbackArgs = nullptr;
 
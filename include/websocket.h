@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <string>
+#include <algorithm>
 #include <FreeRTOS.h>
 #include <task.h>
 #include <semphr.h>
@@ -10,6 +11,21 @@
 #include "tcpclient.h"
 
 static constexpr size_t WEBSOCKET_MAX_PACKET_SIZE = TCP_MSS;
+/// @brief The largest frame header, with a 64-bit payload length and a masking key
+static constexpr size_t WEBSOCKET_MAX_HEADER_SIZE = 14;
+/// @brief The initial and minimum payload limit of a frame buffer
+static constexpr size_t WEBSOCKET_FRAME_BUFFER_MIN_LENGTH = 256;
+/// @brief The maximum payload limit of a frame buffer, a full frame still fits one TCP segment
+static constexpr size_t WEBSOCKET_FRAME_BUFFER_MAX_LENGTH = WEBSOCKET_MAX_PACKET_SIZE - WEBSOCKET_MAX_HEADER_SIZE;
+/// @brief How many flushes in a row must use less than a quarter of the limit before it is halved
+static constexpr uint8_t WEBSOCKET_FRAME_BUFFER_SHRINK_FLUSHES = 8;
+/// @brief The length of a Sec-WebSocket-Accept key
+static constexpr size_t WEBSOCKET_ACCEPT_KEY_LENGTH = 28;
+
+/// @brief Computes the Sec-WebSocket-Accept key of a Sec-WebSocket-Key, without allocating
+/// @param key The Sec-WebSocket-Key
+/// @param out_acceptKey Set to the accept key, not null terminated
+void websocket_accept_key(std::string_view key, char out_acceptKey[WEBSOCKET_ACCEPT_KEY_LENGTH]);
 
 /// @brief Supported message formats for websocket communication
 enum class WebSocketMessageType
@@ -93,6 +109,78 @@ typedef struct WebSocketFrame
     }
 } WebSocketFrame;
 
+/// @brief A reusable outbound payload buffer with room for the frame header in front of it
+/// @note The payload is sent in place with a single write. The limit the owner flushes at adapts to the traffic,
+/// doubling whenever the buffer runs full up to one TCP segment, and halving after a run of small flushes
+class WebSocketFrameBuffer
+{
+public:
+    WebSocketFrameBuffer() = default;
+    /// @brief Frees the buffer
+    ~WebSocketFrameBuffer();
+
+    WebSocketFrameBuffer(const WebSocketFrameBuffer &) = delete;
+    WebSocketFrameBuffer &operator=(const WebSocketFrameBuffer &) = delete;
+    WebSocketFrameBuffer(WebSocketFrameBuffer &&other);
+    WebSocketFrameBuffer &operator=(WebSocketFrameBuffer &&other);
+
+    /// @brief Returns the payload
+    inline uint8_t *data() { return buffer + WEBSOCKET_MAX_HEADER_SIZE; }
+    /// @brief Returns the payload length
+    inline size_t size() const { return length; }
+    inline bool empty() const { return length == 0; }
+    /// @brief Returns the last payload byte, the buffer must not be empty
+    inline char back() const { return buffer[WEBSOCKET_MAX_HEADER_SIZE + length - 1]; }
+    /// @brief Returns the payload length the owner should flush at
+    inline size_t limit() const { return currentLimit; }
+    /// @brief Returns the free space after the payload, valid until the buffer grows
+    inline uint8_t *tail() { return data() + length; }
+    /// @brief Returns the number of bytes that fit after the payload without growing
+    inline size_t available() const { return capacity - length; }
+    /// @brief Adds bytes written to `tail()` to the payload
+    inline void commit(size_t count) { length += count; }
+
+    /// @return False if out of memory, the byte is dropped and the buffer is marked as failed
+    bool push_back(char c);
+    /// @return False if out of memory, the bytes are dropped and the buffer is marked as failed
+    bool append(const char *data, size_t length);
+    /// @return False if out of memory, the bytes are dropped and the buffer is marked as failed
+    bool append(const uint8_t *data, size_t length);
+    /// @brief Removes payload bytes, moving the rest to the front
+    void erase(size_t position, size_t count);
+    /// @brief Shortens the payload and clears the failed mark, used to drop a partially written message
+    inline void truncate(size_t length)
+    {
+        this->length = std::min(this->length, length);
+        writeFailed = false;
+    }
+    /// @brief Clears the payload and the failed mark, keeping the memory
+    inline void clear() { truncate(0); }
+    /// @brief Returns true if a write was dropped since the last clear or truncate, the payload may end in a partial message
+    inline bool failed() const { return writeFailed; }
+    /// @brief Grows the buffer to hold a payload of at least the current limit and a few extra bytes
+    void reserve();
+
+    /// @brief Adapts the limit to the payload length of a flush, call before clearing the buffer
+    /// @param full True if the buffer was flushed because the next message did not fit
+    void adapt(bool full);
+
+private:
+    /// @brief The header room followed by the payload
+    uint8_t *buffer = nullptr;
+    size_t length = 0;
+    /// @brief The payload capacity
+    size_t capacity = 0;
+    size_t currentLimit = WEBSOCKET_FRAME_BUFFER_MIN_LENGTH;
+    uint8_t smallFlushes = 0;
+    /// @brief Set when a write is dropped because the buffer could not grow
+    bool writeFailed = false;
+
+    /// @brief Grows the payload capacity to at least minCapacity
+    /// @return False if out of memory, the buffer is unchanged
+    bool grow(size_t minCapacity);
+};
+
 /// @brief A WebSocket implementation
 class WebSocket
 {
@@ -161,6 +249,13 @@ public:
     /// @param messageType Determines how to interpret the binary message
     /// @return True if succeeded
     bool send(const std::vector<uint8_t> &data, WebSocketMessageType messageType = WebSocketMessageType::Binary);
+    /// @brief Send the start of a frame buffer's payload, the header is written into the room in front of it
+    /// @param buffer The frame buffer, a masked payload is masked in place
+    /// @param length The number of payload bytes to send
+    /// @param messageType Determines how to interpret the message
+    /// @return True if succeeded
+    /// @note Sent with a single write and no copy, unless the frame has to be fragmented
+    bool send(WebSocketFrameBuffer &buffer, size_t length, WebSocketMessageType messageType);
 
     /// @brief Runs the WebSocket message loop on the calling thread, blocking execution until the socket is closed
     void joinMessageLoop();
@@ -14,8 +14,25 @@
 #include <vector>
 #include <queue>
 
+#ifndef PICO_RADIO_MAX_CLIENTS
+#define PICO_RADIO_MAX_CLIENTS (10) // set by PICO_RADIO_MAX_CLIENTS
+#endif
+
 /// @brief The maximum number of clients supported by this server
-constexpr int WS_SERVER_MAX_CLIENT_COUNT = 10;
+constexpr int WS_SERVER_MAX_CLIENT_COUNT = PICO_RADIO_MAX_CLIENTS;
+
+/// @brief Dense handle of a connected client, from 0 to WS_SERVER_MAX_CLIENT_COUNT - 1
+/// @note Ids are reused after a client disconnects, the guid stays unique
+typedef uint8_t WsClientId;
+/// @brief The id of no client
+constexpr WsClientId WS_INVALID_CLIENT_ID = 0xff;
+
+/// @brief Callback for traffic on any WsServer, contains the number of frames
+typedef void (*WsActivityCallback)(uint32_t frames, void *args);
+/// @brief Sets the one callback called for every frame received by any WsServer, the radio registers its power policy with it
+/// @param callback The callback, or null to remove it
+/// @param args Custom args for the callback, replaced together with the callback
+void ws_server_set_activity_callback(WsActivityCallback callback, void *args);
 
 /// @brief A WebSocket Server implementation
 class WsServer
@@ -26,13 +43,17 @@ public:
     {
         /// @brief The GUID of the client
         Guid guid;
+        /// @brief The slot of the client in the server
+        WsClientId id;
         /// @brief The WebSocket of the client
         WebSocket *ws;
         /// @brief The requested path by the client
         std::string requestedPath;
+        /// @brief The server the client is connected to
+        WsServer *server;
 
         ClientEntry();
-        ClientEntry(Guid guid, WebSocket *ws, std::string requestedPath);
+        ClientEntry(Guid guid, WsClientId id, WebSocket *ws, std::string requestedPath, WsServer *server);
     };
 
     /// @brief Create a new WebSocket server at a port
@@ -63,6 +84,16 @@ public:
     /// @brief Gracefully disconnects a client with guid
     void disconnectClient(const Guid &guid);
 
+    /// @brief Returns the client in a slot
+    /// @param id The id of the client
+    /// @return The client entry or null if the slot is free
+    inline ClientEntry *getClient(WsClientId id)
+    {
+        return id < WS_SERVER_MAX_CLIENT_COUNT ? clientSlots[id] : nullptr;
+    }
+    /// @brief Returns the id of the client with the specified guid, or WS_INVALID_CLIENT_ID
+    WsClientId getClientId(const Guid &guid);
+
     /// @brief Sends a ping frame to a client
     /// @param guid The guid of the client
     void ping(const Guid &guid);
@@ -92,6 +123,33 @@ public:
     /// @return True on success
     bool send(const Guid &guid, const std::vector<uint8_t> &data, WebSocketMessageType messageType = WebSocketMessageType::Binary);
 
+    /// @brief Sends a text message to a client
+    /// @param id The id of the client
+    /// @param data The message
+    /// @param messageType Usually WebSocketMessageType::Text
+    /// @return True on success
+    bool send(WsClientId id, std::string_view data, WebSocketMessageType messageType = WebSocketMessageType::Text);
+    /// @brief Sends a binary message to a client
+    /// @param id The id of the client
+    /// @param data The payload
+    /// @param length The length of the payload
+    /// @param messageType Determines how the binary data is interpreted
+    /// @return True on success
+    bool send(WsClientId id, const uint8_t *data, size_t length, WebSocketMessageType messageType = WebSocketMessageType::Binary);
+    /// @brief Sends a binary message to a client
+    /// @param id The id of the client
+    /// @param data The payload
+    /// @param messageType Determines how the binary data is interpreted
+    /// @return True on success
+    bool send(WsClientId id, const std::vector<uint8_t> &data, WebSocketMessageType messageType = WebSocketMessageType::Binary);
+    /// @brief Sends the start of a frame buffer's payload to a client in place
+    /// @param id The id of the client
+    /// @param buffer The frame buffer
+    /// @param length The number of payload bytes to send
+    /// @param messageType Determines how the message is interpreted
+    /// @return True on success
+    bool send(WsClientId id, WebSocketFrameBuffer &buffer, size_t length, WebSocketMessageType messageType);
+
     /// @brief List of currently connected clients
     std::vector<ClientEntry *>
         clients;
@@ -128,13 +186,22 @@ public:
     /// @brief Called whenever a data frame is received
     EventHandler<ClientReceivedCallback> messageReceived;
 
+    /// @brief Callback for client disconnected events, contains the WsServer instance, client entry and the status code+reason for closing
+    typedef void (*ClientEntryDisconnectedCallback)(WsServer *server, const ClientEntry *entry, WebSocketStatusCode statusCode, const std::string_view &reason, void *args);
+    /// @brief Called along with clientDisconnected, the entry carries the slot id of the client so no guid lookup is needed
+    EventHandler<ClientEntryDisconnectedCallback> clientEntryDisconnected;
+    /// @brief Callback for data frames, contains the WsServer instance, client entry and the received frame
+    typedef void (*ClientEntryReceivedCallback)(WsServer *server, const ClientEntry *entry, const WebSocketFrame &frame, void *args);
+    /// @brief Called along with messageReceived, the entry carries the slot id of the client so no guid lookup is needed
+    EventHandler<ClientEntryReceivedCallback> clientEntryMessageReceived;
+
 private:
     /// @brief The port it is listening on
     int port;
     /// @brief Underlying tcp socket
     TcpListener *listener;
-    /// @brief Handle to the accept connections task
-    TaskHandle_t acceptConnectionsTask;
+    /// @brief Handle to the accept connections task, null when it is not running
+    volatile TaskHandle_t acceptConnectionsTask = nullptr;
     /// @brief Handle to the dispatch queue task
     TaskHandle_t dispatchQueueTask;
     /// @brief True when the dispatch queue is running
@@ -142,6 +209,18 @@ private:
     /// @brief The HTTP response sent to the client when the request is not a valid WebSocket request
     std::string badRequestResponse;
 
+    /// @brief Connected clients indexed by their id
+    ClientEntry *clientSlots[WS_SERVER_MAX_CLIENT_COUNT];
+    /// @brief Bit mask of the reserved client ids
+    uint32_t usedClientIds;
+    static_assert(WS_SERVER_MAX_CLIENT_COUNT <= 32, "client ids must fit the usedClientIds mask");
+
+    /// @brief Reserves the lowest free client id
+    /// @return The id or WS_INVALID_CLIENT_ID if at capacity
+    WsClientId reserveClientId();
+    /// @brief Frees a client id and its slot
+    void releaseClientId(WsClientId id);
+
     enum class DispatchQueueElementType
     {
         Disconnect,
@@ -54,6 +54,11 @@
 #define LWIP_DNS 1
 #define LWIP_TCP_KEEPALIVE 1
 #define LWIP_NETIF_TX_SINGLE_PBUF 1
+// Allows zero-copy UDP sends to be notified when lwIP releases the caller's buffer
+#define LWIP_SUPPORT_CUSTOM_PBUF 1
+// Multicast group membership and multicast TX options for UdpSocket
+#define LWIP_IGMP 1
+#define LWIP_NETIF_LOOPBACK 1
 #define DHCP_DOES_ARP_CHECK 0
 #define LWIP_DHCP_DOES_ACD_CHECK 0
 
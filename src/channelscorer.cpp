@@ -0,0 +1,70 @@
+#include <string.h>
+#include <algorithm>
+#include "channelscorer.h"
+
+ChannelScorer::ChannelScorer()
+{
+    clear();
+}
+
+bool ChannelScorer::add(const uint8_t *bssid, int channel, int rssi)
+{
+    if (channel < 1 || channel > CHANNEL_SCORER_MAX_CHANNEL)
+        return false;
+
+    // a scan reports a network once per received beacon or probe response
+    for (size_t i = 0; i < networkCount; i++)
+    {
+        if (memcmp(bssids[i], bssid, 6) == 0)
+            return false;
+    }
+
+    // past the table, a crowded band still has to count, even if a network may then be counted twice
+    if (networkCount < CHANNEL_SCORER_MAX_NETWORKS)
+        memcpy(bssids[networkCount++], bssid, 6);
+    else
+        uncheckedCount++;
+
+    // -100 dBm and below barely interferes, but still counts as a network
+    uint32_t weight = std::clamp(rssi + 100, 1, 100);
+    for (int c = 1; c <= CHANNEL_SCORER_MAX_CHANNEL; c++)
+    {
+        int distance = abs(c - channel);
+        if (distance < CHANNEL_SCORER_OVERLAP)
+            scores[c] += weight * (CHANNEL_SCORER_OVERLAP - distance);
+    }
+    return true;
+}
+
+void ChannelScorer::clear()
+{
+    networkCount = 0;
+    uncheckedCount = 0;
+    memset(scores, 0, sizeof(scores));
+}
+
+uint32_t ChannelScorer::getScore(int channel)
+{
+    if (channel < 1 || channel > CHANNEL_SCORER_MAX_CHANNEL)
+        return UINT32_MAX;
+    return scores[channel];
+}
+
+int ChannelScorer::getBestChannel()
+{
+    // the non-overlapping channels first, so they win ties
+    static constexpr int order[] = {1, 6, 11, 2, 3, 4, 5, 7, 8, 9, 10};
+
+    int best = order[0];
+    for (int channel : order)
+    {
+        if (scores[channel] < scores[best])
+            best = channel;
+    }
+    return best;
+}
+
+size_t ChannelScorer::getNetworkCount()
+{
+    return networkCount + uncheckedCount;
+}
@@ -29,12 +29,17 @@
 //  https://tools.ietf.org/html/rfc2132 -- DHCP Options and BOOTP Vendor Extensions
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <errno.h>
 
 #include "cyw43_config.h"
 #include "dhcpserver.h"
+#include "flashstore.h"
 #include <lwip/udp.h>
+#include <pico/time.h>
+#include <FreeRTOS.h>
+#include <timers.h>
 
 #define DHCPDISCOVER (1)
 #define DHCPOFFER (2)
@@ -58,6 +63,7 @@
 #define DHCP_OPT_MAX_MSG_SIZE (57)
 #define DHCP_OPT_VENDOR_CLASS_ID (60)
 #define DHCP_OPT_CLIENT_ID (61)
+#define DHCP_OPT_RAPID_COMMIT (80) // RFC 4039
 #define DHCP_OPT_END (255)
 
 #define PORT_DHCP_SERVER (67)
@@ -87,6 +93,12 @@ typedef struct
     uint8_t options[312]; // optional parameters, variable, starts with magic
 } dhcp_msg_t;
 
+// The fixed options plus message type, rapid commit and end have to fit into a reply
+#define DHCP_REPLY_FIXED_OPT_SIZE (4 + 4 * 6 + 6)
+#define DHCP_REPLY_CLIENT_OPT_SIZE (3 + 2 + 1)
+_Static_assert(offsetof(dhcp_msg_t, options) + DHCP_REPLY_FIXED_OPT_SIZE + DHCP_REPLY_CLIENT_OPT_SIZE <= DHCPS_REPLY_SIZE,
+               "DHCPS_REPLY_SIZE is too small");
+
 static int dhcp_socket_new_dgram(struct udp_pcb **udp, void *cb_data, udp_recv_fn cb_udp_recv)
 {
     // family is AF_INET
@@ -126,13 +138,14 @@ static int dhcp_socket_sendto(struct udp_pcb **udp, struct netif *nif, const voi
         len = 0xffff;
     }
 
-    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    // the buffer outlives the send, lwIP copies a referenced pbuf if it has to queue it
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_REF);
     if (p == NULL)
     {
         return -ENOMEM;
     }
 
-    memcpy(p->payload, buf, len);
+    p->payload = (void *)buf;
 
     ip_addr_t dest;
     IP4_ADDR(ip_2_ip4(&dest), ip >> 24 & 0xff, ip >> 16 & 0xff, ip >> 8 & 0xff, ip & 0xff);
@@ -156,6 +169,129 @@ static int dhcp_socket_sendto(struct udp_pcb **udp, struct netif *nif, const voi
     return len;
 }
 
+static uint32_t dhcp_time_s(void)
+{
+    return time_us_64() / 1000000;
+}
+
+static bool dhcp_lease_is_free(const dhcp_server_lease_t *lease)
+{
+    return memcmp(lease->mac, "\x00\x00\x00\x00\x00\x00", MAC_LEN) == 0;
+}
+
+static bool dhcp_lease_is_expired(const dhcp_server_lease_t *lease)
+{
+    return (int32_t)(lease->expiry - dhcp_time_s()) < 0;
+}
+
+static uint32_t dhcp_mac_hash(const uint8_t *mac)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < MAC_LEN; i++)
+    {
+        hash = (hash ^ mac[i]) * 16777619u;
+    }
+    return hash % DHCPS_MAX_IP;
+}
+
+// Finds the lease of a MAC address by probing from its hash.
+// A REQUEST can take any address, so a lease may be off the probe chain of its MAC address.
+// The probe stops at the first free lease and falls back to a full scan, which only runs for unknown clients.
+static int dhcp_lease_find(dhcp_server_t *d, const uint8_t *mac)
+{
+    uint32_t i = dhcp_mac_hash(mac);
+    for (int n = 0; n < DHCPS_MAX_IP; n++, i = (i + 1) % DHCPS_MAX_IP)
+    {
+        if (memcmp(d->lease[i].mac, mac, MAC_LEN) == 0)
+        {
+            return i;
+        }
+        if (dhcp_lease_is_free(&d->lease[i]))
+        {
+            break;
+        }
+    }
+
+    for (i = 0; i < DHCPS_MAX_IP; i++)
+    {
+        if (memcmp(d->lease[i].mac, mac, MAC_LEN) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Finds a free or expired lease for a new MAC address, starting at its hash
+static int dhcp_lease_alloc(dhcp_server_t *d, const uint8_t *mac)
+{
+    uint32_t i = dhcp_mac_hash(mac);
+    for (int n = 0; n < DHCPS_MAX_IP; n++, i = (i + 1) % DHCPS_MAX_IP)
+    {
+        if (dhcp_lease_is_free(&d->lease[i]) || dhcp_lease_is_expired(&d->lease[i]))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Writes the leased MAC addresses to flash, called from the timer task
+static void dhcp_server_persist(void *arg, uint32_t unused)
+{
+    dhcp_server_t *d = arg;
+    (void)unused;
+
+    uint8_t macs[DHCPS_MAX_IP][MAC_LEN];
+
+    cyw43_arch_lwip_begin();
+    d->persist_pending = false;
+    for (int i = 0; i < DHCPS_MAX_IP; i++)
+    {
+        memcpy(macs[i], d->lease[i].mac, MAC_LEN);
+    }
+    cyw43_arch_lwip_end();
+
+    flash_store_write(FLASH_STORE_KEY_DHCP_LEASES, macs, sizeof(macs));
+}
+
+// Schedules writing the leases to flash, flash can't be programmed from the lwIP thread
+static void dhcp_server_schedule_persist(dhcp_server_t *d)
+{
+    if (d->persist_pending)
+    {
+        return;
+    }
+
+    d->persist_pending = xTimerPendFunctionCall(dhcp_server_persist, d, 0, 0) == pdPASS;
+}
+
+// Restores the leases written by dhcp_server_persist, so clients get their previous IP address.
+// They are restored as expired: a returning client still finds its lease, but the address can be
+// given to a new client when the pool is full, since the client may be gone.
+static void dhcp_server_restore(dhcp_server_t *d)
+{
+    uint8_t macs[DHCPS_MAX_IP][MAC_LEN];
+    if (!flash_store_read(FLASH_STORE_KEY_DHCP_LEASES, macs, sizeof(macs)))
+    {
+        return;
+    }
+
+    int count = 0;
+    uint32_t expiry = dhcp_time_s() - 1;
+    for (int i = 0; i < DHCPS_MAX_IP; i++)
+    {
+        memcpy(d->lease[i].mac, macs[i], MAC_LEN);
+        if (!dhcp_lease_is_free(&d->lease[i]))
+        {
+            d->lease[i].expiry = expiry;
+            count++;
+        }
+    }
+    printf("[DHCPS]: restored %d leases\n", count);
+}
+
 static uint8_t *opt_find(uint8_t *opt, uint8_t cmd)
 {
     for (int i = 0; i < 308 && opt[i] != DHCP_OPT_END;)
@@ -199,6 +335,89 @@ static void opt_write_u32(uint8_t **opt, uint8_t cmd, uint32_t val)
     *opt = o;
 }
 
+// Writes the options that are the same for every reply, called when the server is initialized
+static void dhcp_server_build_reply(dhcp_server_t *d)
+{
+    uint8_t *reply = d->reply;
+    memset(reply, 0, DHCPS_REPLY_SIZE);
+
+    reply[offsetof(dhcp_msg_t, op)] = DHCPOFFER; // BOOTREPLY
+    reply[offsetof(dhcp_msg_t, htype)] = 1;      // ethernet
+    reply[offsetof(dhcp_msg_t, hlen)] = MAC_LEN;
+    // the last byte is set per client
+    memcpy(reply + offsetof(dhcp_msg_t, yiaddr), &ip4_addr_get_u32(ip_2_ip4(&d->ip)), 4);
+
+    uint8_t *opt = reply + offsetof(dhcp_msg_t, options);
+    *opt++ = 99; // magic cookie
+    *opt++ = 130;
+    *opt++ = 83;
+    *opt++ = 99;
+    opt_write_n(&opt, DHCP_OPT_SERVER_ID, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip)));
+    opt_write_n(&opt, DHCP_OPT_SUBNET_MASK, 4, &ip4_addr_get_u32(ip_2_ip4(&d->nm)));
+    opt_write_n(&opt, DHCP_OPT_ROUTER, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip))); // aka gateway; can have mulitple addresses
+    opt_write_n(&opt, DHCP_OPT_DNS, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip)));    // this server is the dns
+    opt_write_u32(&opt, DHCP_OPT_IP_LEASE_TIME, DEFAULT_LEASE_TIME_S);
+    d->reply_opt_offset = opt - reply;
+}
+
+// Sends the precomputed reply with the fields of a client request
+static void dhcp_server_reply(dhcp_server_t *d, const dhcp_msg_t *request, uint8_t yi, uint8_t msg_type, bool rapid_commit)
+{
+    uint8_t *reply = d->reply;
+    memcpy(reply + offsetof(dhcp_msg_t, xid), &request->xid, sizeof(request->xid));
+    memcpy(reply + offsetof(dhcp_msg_t, flags), &request->flags, sizeof(request->flags));
+    memcpy(reply + offsetof(dhcp_msg_t, giaddr), request->giaddr, sizeof(request->giaddr));
+    memcpy(reply + offsetof(dhcp_msg_t, chaddr), request->chaddr, sizeof(request->chaddr));
+    reply[offsetof(dhcp_msg_t, yiaddr) + 3] = DHCPS_BASE_IP + yi;
+
+    uint8_t *opt = reply + d->reply_opt_offset;
+    opt_write_u8(&opt, DHCP_OPT_MSG_TYPE, msg_type);
+    if (rapid_commit)
+    {
+        *opt++ = DHCP_OPT_RAPID_COMMIT;
+        *opt++ = 0;
+    }
+    *opt++ = DHCP_OPT_END;
+    // clear what a longer previous reply left behind, the rest is padding
+    memset(opt, DHCP_OPT_PAD, d->reply_opt_offset + DHCP_REPLY_CLIENT_OPT_SIZE - (opt - reply));
+
+    struct netif *nif = ip_current_input_netif();
+    dhcp_socket_sendto(&d->udp, nif, reply, DHCPS_REPLY_SIZE, 0xffffffff, PORT_DHCP_CLIENT);
+}
+
+// Assigns a lease to a client, returns false if it is taken by another client
+static bool dhcp_lease_commit(dhcp_server_t *d, uint8_t yi, const uint8_t *mac)
+{
+    if (memcmp(d->lease[yi].mac, mac, MAC_LEN) == 0)
+    {
+        // MAC match, ok to use this IP address
+    }
+    else if (dhcp_lease_is_free(&d->lease[yi]) || dhcp_lease_is_expired(&d->lease[yi]))
+    {
+        // IP unused, ok to use this IP address, a client holds one lease at a time
+        int previous = dhcp_lease_find(d, mac);
+        if (previous >= 0)
+        {
+            memset(d->lease[previous].mac, 0, MAC_LEN);
+        }
+        memcpy(d->lease[yi].mac, mac, MAC_LEN);
+        dhcp_server_schedule_persist(d);
+
+        // renewals are not logged, clients renew every half lease time
+        const uint8_t *ip = (const uint8_t *)&ip4_addr_get_u32(ip_2_ip4(&d->ip));
+        printf("[DHCPS]: client connected: MAC=%02x:%02x:%02x:%02x:%02x:%02x IP=%u.%u.%u.%u\n",
+               mac[0], mac[1], mac[2], mac[3], mac[4], mac[5],
+               ip[0], ip[1], ip[2], DHCPS_BASE_IP + yi);
+    }
+    else
+    {
+        // IP already in use
+        return false;
+    }
+    d->lease[yi].expiry = dhcp_time_s() + DEFAULT_LEASE_TIME_S;
+    return true;
+}
+
 static void dhcp_server_process(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *src_addr, u16_t src_port)
 {
     dhcp_server_t *d = arg;
@@ -221,9 +440,6 @@ static void dhcp_server_process(void *arg, struct udp_pcb *upcb, struct pbuf *p,
         goto ignore_request;
     }
 
-    dhcp_msg.op = DHCPOFFER;
-    memcpy(&dhcp_msg.yiaddr, &ip4_addr_get_u32(ip_2_ip4(&d->ip)), 4);
-
     uint8_t *opt = (uint8_t *)&dhcp_msg.options;
     opt += 4; // assume magic cookie: 99, 130, 83, 99
 
@@ -238,39 +454,30 @@ static void dhcp_server_process(void *arg, struct udp_pcb *upcb, struct pbuf *p,
     {
     case DHCPDISCOVER:
     {
-        int yi = DHCPS_MAX_IP;
-        for (int i = 0; i < DHCPS_MAX_IP; ++i)
+        int yi = dhcp_lease_find(d, dhcp_msg.chaddr); // MAC match, use this IP address
+        if (yi < 0)
         {
-            if (memcmp(d->lease[i].mac, dhcp_msg.chaddr, MAC_LEN) == 0)
-            {
-                // MAC match, use this IP address
-                yi = i;
-                break;
-            }
-            if (yi == DHCPS_MAX_IP)
-            {
-                // Look for a free IP address
-                if (memcmp(d->lease[i].mac, "\x00\x00\x00\x00\x00\x00", MAC_LEN) == 0)
-                {
-                    // IP available
-                    yi = i;
-                }
-                uint32_t expiry = d->lease[i].expiry << 16 | 0xffff;
-                if ((int32_t)(expiry - cyw43_hal_ticks_ms()) < 0)
-                {
-                    // IP expired, reuse it
-                    memset(d->lease[i].mac, 0, MAC_LEN);
-                    yi = i;
-                }
-            }
+            // Look for a free or expired IP address, it is only taken on REQUEST
+            yi = dhcp_lease_alloc(d, dhcp_msg.chaddr);
         }
-        if (yi == DHCPS_MAX_IP)
+        if (yi < 0)
         {
             // No more IP addresses left
             goto ignore_request;
         }
-        dhcp_msg.yiaddr[3] = DHCPS_BASE_IP + yi;
-        opt_write_u8(&opt, DHCP_OPT_MSG_TYPE, DHCPOFFER);
+        if (opt_find(opt, DHCP_OPT_RAPID_COMMIT) != NULL)
+        {
+            // The client skips the offer, commit the lease and acknowledge right away
+            if (!dhcp_lease_commit(d, yi, dhcp_msg.chaddr))
+            {
+                goto ignore_request;
+            }
+            dhcp_server_reply(d, &dhcp_msg, yi, DHCPACK, true);
+        }
+        else
+        {
+            dhcp_server_reply(d, &dhcp_msg, yi, DHCPOFFER, false);
+        }
         break;
     }
 
@@ -293,27 +500,12 @@ static void dhcp_server_process(void *arg, struct udp_pcb *upcb, struct pbuf *p,
             // Should be NACK
             goto ignore_request;
         }
-        if (memcmp(d->lease[yi].mac, dhcp_msg.chaddr, MAC_LEN) == 0)
+        if (!dhcp_lease_commit(d, yi, dhcp_msg.chaddr))
         {
-            // MAC match, ok to use this IP address
-        }
-        else if (memcmp(d->lease[yi].mac, "\x00\x00\x00\x00\x00\x00", MAC_LEN) == 0)
-        {
-            // IP unused, ok to use this IP address
-            memcpy(d->lease[yi].mac, dhcp_msg.chaddr, MAC_LEN);
-        }
-        else
-        {
-            // IP already in use
             // Should be NACK
             goto ignore_request;
         }
-        d->lease[yi].expiry = (cyw43_hal_ticks_ms() + DEFAULT_LEASE_TIME_S * 1000) >> 16;
-        dhcp_msg.yiaddr[3] = DHCPS_BASE_IP + yi;
-        opt_write_u8(&opt, DHCP_OPT_MSG_TYPE, DHCPACK);
-        printf("[DHCPS]: client connected: MAC=%02x:%02x:%02x:%02x:%02x:%02x IP=%u.%u.%u.%u\n",
-               dhcp_msg.chaddr[0], dhcp_msg.chaddr[1], dhcp_msg.chaddr[2], dhcp_msg.chaddr[3], dhcp_msg.chaddr[4], dhcp_msg.chaddr[5],
-               dhcp_msg.yiaddr[0], dhcp_msg.yiaddr[1], dhcp_msg.yiaddr[2], dhcp_msg.yiaddr[3]);
+        dhcp_server_reply(d, &dhcp_msg, yi, DHCPACK, false);
         break;
     }
 
@@ -321,15 +513,6 @@ static void dhcp_server_process(void *arg, struct udp_pcb *upcb, struct pbuf *p,
         goto ignore_request;
     }
 
-    opt_write_n(&opt, DHCP_OPT_SERVER_ID, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip)));
-    opt_write_n(&opt, DHCP_OPT_SUBNET_MASK, 4, &ip4_addr_get_u32(ip_2_ip4(&d->nm)));
-    opt_write_n(&opt, DHCP_OPT_ROUTER, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip))); // aka gateway; can have mulitple addresses
-    opt_write_n(&opt, DHCP_OPT_DNS, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip)));    // this server is the dns
-    opt_write_u32(&opt, DHCP_OPT_IP_LEASE_TIME, DEFAULT_LEASE_TIME_S);
-    *opt++ = DHCP_OPT_END;
-    struct netif *nif = ip_current_input_netif();
-    dhcp_socket_sendto(&d->udp, nif, &dhcp_msg, opt - (uint8_t *)&dhcp_msg, 0xffffffff, PORT_DHCP_CLIENT);
-
 ignore_request:
     pbuf_free(p);
 }
@@ -339,6 +522,9 @@ void dhcp_server_init(dhcp_server_t *d, ip_addr_t *ip, ip_addr_t *nm)
     ip_addr_copy(d->ip, *ip);
     ip_addr_copy(d->nm, *nm);
     memset(d->lease, 0, sizeof(d->lease));
+    d->persist_pending = false;
+    dhcp_server_build_reply(d);
+    dhcp_server_restore(d);
     if (dhcp_socket_new_dgram(&d->udp, d, dhcp_server_process) != 0)
     {
         return;
@@ -0,0 +1,195 @@
+// A small record store in a reserved flash sector.
+//
+// Records are appended page by page, so updating a record only programs new pages.
+// The sector is only erased when it is full, keeping the latest record of every key.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <hardware/flash.h>
+#include <pico/flash.h>
+#include <FreeRTOS.h>
+
+#include "flashstore.h"
+
+#ifndef PICO_RADIO_FLASH_STORE_OFFSET
+// The last flash sector by default
+#define PICO_RADIO_FLASH_STORE_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#endif
+
+#define FLASH_STORE_MAGIC (0x53524450) // "PDRS"
+#define FLASH_STORE_PAGES (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define FLASH_STORE_TIMEOUT_MS (1000)
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t length;
+    uint8_t key;
+    uint8_t reserved;
+    uint32_t checksum;
+} flash_store_record_t;
+
+typedef struct
+{
+    uint32_t offset;
+    const uint8_t *data;
+    size_t length;
+    bool erase;
+} flash_store_op_t;
+
+static const uint8_t *flash_store_page(size_t page)
+{
+    return (const uint8_t *)(XIP_BASE + PICO_RADIO_FLASH_STORE_OFFSET + page * FLASH_PAGE_SIZE);
+}
+
+static size_t flash_store_record_pages(size_t length)
+{
+    return (sizeof(flash_store_record_t) + length + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE;
+}
+
+static uint32_t flash_store_checksum(const void *data, size_t length)
+{
+    // FNV-1a
+    const uint8_t *d = data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ d[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool flash_store_valid(const flash_store_record_t *record, size_t page)
+{
+    return record->magic == FLASH_STORE_MAGIC &&
+           page + flash_store_record_pages(record->length) <= FLASH_STORE_PAGES &&
+           record->checksum == flash_store_checksum(record + 1, record->length);
+}
+
+/// @brief Finds the latest valid record of a key
+/// @param key The record key
+/// @param out_free_page Set to the first unused page (can be null)
+/// @return The record or null if there is none
+static const flash_store_record_t *flash_store_find(uint8_t key, size_t *out_free_page)
+{
+    const flash_store_record_t *latest = NULL;
+    size_t page = 0;
+
+    while (page < FLASH_STORE_PAGES)
+    {
+        const flash_store_record_t *record = (const flash_store_record_t *)flash_store_page(page);
+        if (record->magic != FLASH_STORE_MAGIC)
+            break; // erased space
+
+        if (record->key == key && flash_store_valid(record, page))
+            latest = record;
+
+        page += flash_store_record_pages(record->length);
+    }
+
+    if (out_free_page != NULL)
+        *out_free_page = page < FLASH_STORE_PAGES ? page : FLASH_STORE_PAGES;
+    return latest;
+}
+
+static void flash_store_execute(void *param)
+{
+    flash_store_op_t *op = param;
+    if (op->erase)
+        flash_range_erase(op->offset, FLASH_SECTOR_SIZE);
+    flash_range_program(op->offset, op->data, op->length);
+}
+
+/// @brief Writes a record header and data into a RAM buffer
+static size_t flash_store_build(uint8_t *buf, uint8_t key, const void *data, size_t length)
+{
+    flash_store_record_t record = {
+        .magic = FLASH_STORE_MAGIC,
+        .length = length,
+        .key = key,
+        .reserved = 0xff,
+        .checksum = flash_store_checksum(data, length)};
+    memcpy(buf, &record, sizeof(record));
+    memcpy(buf + sizeof(record), data, length);
+    return flash_store_record_pages(length) * FLASH_PAGE_SIZE;
+}
+
+bool flash_store_read(uint8_t key, void *data, size_t length)
+{
+    const flash_store_record_t *record = flash_store_find(key, NULL);
+    if (record == NULL || record->length != length)
+        return false;
+
+    memcpy(data, record + 1, length);
+    return true;
+}
+
+bool flash_store_write(uint8_t key, const void *data, size_t length)
+{
+    size_t pages = flash_store_record_pages(length);
+    if (pages > FLASH_STORE_PAGES || length > 0xffff)
+        return false;
+
+    size_t freePage;
+    const flash_store_record_t *current = flash_store_find(key, &freePage);
+    if (current != NULL && current->length == length && memcmp(current + 1, data, length) == 0)
+        return true; // unchanged, save the flash
+
+    flash_store_op_t op;
+    uint8_t *buf;
+
+    if (freePage + pages <= FLASH_STORE_PAGES)
+    {
+        // append the record
+        buf = pvPortMalloc(pages * FLASH_PAGE_SIZE);
+        if (buf == NULL)
+            return false;
+        memset(buf, 0xff, pages * FLASH_PAGE_SIZE);
+
+        op.offset = PICO_RADIO_FLASH_STORE_OFFSET + freePage * FLASH_PAGE_SIZE;
+        op.length = flash_store_build(buf, key, data, length);
+        op.erase = false;
+    }
+    else
+    {
+        // sector full, rewrite it with the latest record of every other key
+        buf = pvPortMalloc(FLASH_SECTOR_SIZE);
+        if (buf == NULL)
+            return false;
+        memset(buf, 0xff, FLASH_SECTOR_SIZE);
+
+        size_t used = 0;
+        for (size_t page = 0; page < freePage;)
+        {
+            const flash_store_record_t *record = (const flash_store_record_t *)flash_store_page(page);
+            size_t recordPages = flash_store_record_pages(record->length);
+
+            if (record->key != key && flash_store_find(record->key, NULL) == record &&
+                used + recordPages + pages <= FLASH_STORE_PAGES)
+            {
+                memcpy(buf + used * FLASH_PAGE_SIZE, record, sizeof(flash_store_record_t) + record->length);
+                used += recordPages;
+            }
+
+            page += recordPages;
+        }
+
+        flash_store_build(buf + used * FLASH_PAGE_SIZE, key, data, length);
+
+        op.offset = PICO_RADIO_FLASH_STORE_OFFSET;
+        op.length = (used + pages) * FLASH_PAGE_SIZE;
+        op.erase = true;
+    }
+
+    op.data = buf;
+    int rc = flash_safe_execute(flash_store_execute, &op, FLASH_STORE_TIMEOUT_MS);
+    vPortFree(buf);
+
+    if (rc != 0)
+    {
+        printf("[RADIO] Failed to write flash store record %u: %d\n", key, rc);
+        return false;
+    }
+    return true;
+}
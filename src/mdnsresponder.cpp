@@ -0,0 +1,599 @@
+#include <pico/stdlib.h>
+#include <pico/cyw43_arch.h>
+#include <lwip/netif.h>
+#include <lwip/ip4_addr.h>
+#include <lwip/pbuf.h>
+#include <lwip/udp.h>
+#include <string>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include "mdnsresponder.h"
+
+using namespace std::literals;
+
+static constexpr uint16_t DNS_TYPE_A = 1;
+static constexpr uint16_t DNS_TYPE_PTR = 12;
+static constexpr uint16_t DNS_TYPE_TXT = 16;
+static constexpr uint16_t DNS_TYPE_SRV = 33;
+static constexpr uint16_t DNS_TYPE_ANY = 255;
+
+static constexpr uint16_t DNS_CLASS_IN = 1;
+static constexpr uint16_t DNS_CLASS_CACHE_FLUSH = 0x8000; // unique records in responses
+static constexpr uint16_t DNS_CLASS_UNICAST = 0x8000;     // unicast response requested in questions
+
+static constexpr uint16_t DNS_FLAGS_RESPONSE = 0x8000;
+static constexpr uint16_t DNS_FLAGS_AUTHORITATIVE = 0x0400;
+
+// recommended TTLs for host and other records (RFC 6762 section 10)
+static constexpr uint32_t MDNS_HOST_TTL = 120;
+static constexpr uint32_t MDNS_OTHER_TTL = 4500;
+// the maximum TTL of legacy unicast responses (RFC 6762 section 6.7)
+static constexpr uint32_t MDNS_LEGACY_TTL = 10;
+
+static const ip_addr_t MDNS_GROUP = IPADDR4_INIT_BYTES(224, 0, 0, 251);
+
+static MdnsResponder *defaultResponder = nullptr;
+
+/// @brief Writes DNS records into a fixed buffer
+struct dns_writer
+{
+    uint8_t *buf;
+    size_t size;
+    size_t pos;
+    bool ok;
+    /// @brief True for legacy unicast responses, which have no cache-flush bits and short TTLs
+    bool legacy;
+};
+
+static void dns_write_u8(dns_writer *w, uint8_t value)
+{
+    if (w->pos + 1 > w->size)
+    {
+        w->ok = false;
+        return;
+    }
+    w->buf[w->pos++] = value;
+}
+
+static void dns_write_u16(dns_writer *w, uint16_t value)
+{
+    dns_write_u8(w, value >> 8);
+    dns_write_u8(w, value & 0xff);
+}
+
+static void dns_write_u32(dns_writer *w, uint32_t value)
+{
+    dns_write_u16(w, value >> 16);
+    dns_write_u16(w, value & 0xffff);
+}
+
+static void dns_write_bytes(dns_writer *w, const void *data, size_t length)
+{
+    if (w->pos + length > w->size)
+    {
+        w->ok = false;
+        return;
+    }
+    memcpy(w->buf + w->pos, data, length);
+    w->pos += length;
+}
+
+/// @brief Writes all labels of a dotted name, without the terminating zero
+static void dns_write_labels(dns_writer *w, std::string_view name)
+{
+    while (!name.empty())
+    {
+        size_t dot = name.find('.');
+        std::string_view label = name.substr(0, dot);
+        if (label.empty() || label.length() > 63)
+        {
+            w->ok = false;
+            return;
+        }
+        dns_write_u8(w, label.length());
+        dns_write_bytes(w, label.data(), label.length());
+        name = dot == std::string_view::npos ? ""sv : name.substr(dot + 1);
+    }
+}
+
+/// @brief Writes a compression pointer to an earlier name
+static void dns_write_pointer(dns_writer *w, size_t offset)
+{
+    dns_write_u16(w, 0xc000 | offset);
+}
+
+static void dns_write_header(dns_writer *w, uint16_t questions, uint16_t answers, uint16_t additional)
+{
+    dns_write_u16(w, 0); // id
+    dns_write_u16(w, DNS_FLAGS_RESPONSE | DNS_FLAGS_AUTHORITATIVE);
+    dns_write_u16(w, questions);
+    dns_write_u16(w, answers);
+    dns_write_u16(w, 0); // authority records
+    dns_write_u16(w, additional);
+}
+
+/// @brief Writes a question, echoed in legacy unicast responses
+static void dns_write_question(dns_writer *w, std::string_view name, uint16_t type)
+{
+    dns_write_labels(w, name);
+    dns_write_u8(w, 0);
+    dns_write_u16(w, type);
+    dns_write_u16(w, DNS_CLASS_IN);
+}
+
+/// @brief Writes the type, class and TTL of a record, the name must already be written
+static void dns_write_record(dns_writer *w, uint16_t type, uint16_t cls, uint32_t ttl)
+{
+    if (w->legacy)
+    {
+        cls &= ~DNS_CLASS_CACHE_FLUSH;
+        ttl = std::min(ttl, MDNS_LEGACY_TTL);
+    }
+    dns_write_u16(w, type);
+    dns_write_u16(w, cls);
+    dns_write_u32(w, ttl);
+}
+
+/// @brief Reserves the rdlength of a record
+/// @return The offset of the rdlength, passed to dns_end_rdata()
+static size_t dns_begin_rdata(dns_writer *w)
+{
+    size_t offset = w->pos;
+    dns_write_u16(w, 0);
+    return offset;
+}
+
+/// @brief Sets the rdlength of a record to the length of the data written since dns_begin_rdata()
+static void dns_end_rdata(dns_writer *w, size_t offset)
+{
+    if (!w->ok)
+        return;
+    size_t length = w->pos - offset - 2;
+    w->buf[offset] = length >> 8;
+    w->buf[offset + 1] = length & 0xff;
+}
+
+/// @brief Writes the A record of a host
+static void dns_write_address(dns_writer *w, std::string_view hostname, u32_t address)
+{
+    dns_write_labels(w, hostname);
+    dns_write_labels(w, "local"sv);
+    dns_write_u8(w, 0);
+    dns_write_record(w, DNS_TYPE_A, DNS_CLASS_IN | DNS_CLASS_CACHE_FLUSH, MDNS_HOST_TTL);
+    size_t rdata = dns_begin_rdata(w);
+    dns_write_bytes(w, &address, 4); // already in network order
+    dns_end_rdata(w, rdata);
+}
+
+/// @brief Writes the PTR, SRV, TXT and A records of a service
+/// @param typeName The service type, e.g. "_networktables._tcp.local"
+static void dns_write_service(dns_writer *w, std::string_view hostname, std::string_view typeName, uint16_t port, u32_t address)
+{
+    // PTR <type>.local -> <hostname>.<type>.local
+    size_t typeOffset = w->pos;
+    dns_write_labels(w, typeName.substr(0, typeName.length() - ".local"sv.length()));
+    size_t localOffset = w->pos;
+    dns_write_labels(w, "local"sv);
+    dns_write_u8(w, 0);
+    dns_write_record(w, DNS_TYPE_PTR, DNS_CLASS_IN, MDNS_OTHER_TTL);
+    size_t rdata = dns_begin_rdata(w);
+    size_t instanceOffset = w->pos;
+    dns_write_labels(w, hostname);
+    dns_write_pointer(w, typeOffset);
+    dns_end_rdata(w, rdata);
+
+    // SRV <hostname>.<type>.local -> <hostname>.local:<port>
+    dns_write_pointer(w, instanceOffset);
+    dns_write_record(w, DNS_TYPE_SRV, DNS_CLASS_IN | DNS_CLASS_CACHE_FLUSH, MDNS_HOST_TTL);
+    rdata = dns_begin_rdata(w);
+    dns_write_u16(w, 0); // priority
+    dns_write_u16(w, 0); // weight
+    dns_write_u16(w, port);
+    size_t hostOffset = w->pos;
+    dns_write_labels(w, hostname);
+    dns_write_pointer(w, localOffset);
+    dns_end_rdata(w, rdata);
+
+    // empty TXT, required by DNS-SD
+    dns_write_pointer(w, instanceOffset);
+    dns_write_record(w, DNS_TYPE_TXT, DNS_CLASS_IN | DNS_CLASS_CACHE_FLUSH, MDNS_OTHER_TTL);
+    rdata = dns_begin_rdata(w);
+    dns_write_u8(w, 0);
+    dns_end_rdata(w, rdata);
+
+    // A <hostname>.local
+    dns_write_pointer(w, hostOffset);
+    dns_write_record(w, DNS_TYPE_A, DNS_CLASS_IN | DNS_CLASS_CACHE_FLUSH, MDNS_HOST_TTL);
+    rdata = dns_begin_rdata(w);
+    dns_write_bytes(w, &address, 4);
+    dns_end_rdata(w, rdata);
+}
+
+/// @brief Reads a possibly compressed name as a lowercase dotted string
+/// @param packet The DNS packet
+/// @param length The length of the packet
+/// @param offset The offset of the name, set to the offset after the name
+/// @param out Buffer of MDNS_MAX_NAME_LENGTH bytes for the name
+/// @param out_length Set to the length of the name
+/// @return False if the name is malformed
+static bool dns_read_name(const uint8_t *packet, size_t length, size_t *offset, char *out, size_t *out_length)
+{
+    size_t pos = *offset;
+    size_t outLength = 0;
+    int jumps = 0;
+    bool jumped = false;
+
+    while (true)
+    {
+        if (pos >= length)
+            return false;
+
+        uint8_t labelLength = packet[pos];
+        if ((labelLength & 0xc0) == 0xc0) // compression pointer
+        {
+            if (pos + 1 >= length || ++jumps > 16)
+                return false;
+            if (!jumped)
+                *offset = pos + 2;
+            jumped = true;
+            pos = ((labelLength & 0x3f) << 8) | packet[pos + 1];
+            continue;
+        }
+        if (labelLength & 0xc0)
+            return false;
+
+        pos++;
+        if (labelLength == 0)
+            break;
+
+        if (pos + labelLength > length || outLength + labelLength + 1 >= MDNS_MAX_NAME_LENGTH)
+            return false;
+
+        if (outLength > 0)
+            out[outLength++] = '.';
+        for (size_t i = 0; i < labelLength; i++)
+        {
+            out[outLength++] = tolower(packet[pos + i]);
+        }
+        pos += labelLength;
+    }
+
+    if (!jumped)
+        *offset = pos;
+    *out_length = outLength;
+    return true;
+}
+
+static std::string to_lower(std::string_view str)
+{
+    std::string lower(str);
+    for (auto &c : lower)
+    {
+        c = tolower(c);
+    }
+    return lower;
+}
+
+MdnsResponder::MdnsResponder(std::string_view hostname) : hostname(hostname)
+{
+    hostLocalName = to_lower(hostname) + ".local"s;
+
+    socket = new UdpSocket(MDNS_PORT);
+    if (!socket->isOpen())
+    {
+        printf("[RADIO] Failed to bind the mDNS socket\n");
+        return;
+    }
+
+    socket->joinMulticastGroup(&MDNS_GROUP);
+    socket->setMulticastTtl(255);
+    socket->callbackArgs = this;
+    socket->receiveCallback = receiveCallback;
+
+    if (defaultResponder == nullptr)
+        defaultResponder = this;
+
+    announce();
+    printf("[RADIO] mDNS responder started for '%s'\n", hostLocalName.c_str());
+}
+
+MdnsResponder::~MdnsResponder()
+{
+    if (defaultResponder == this)
+        defaultResponder = nullptr;
+
+    delete socket;
+}
+
+bool MdnsResponder::isOpen()
+{
+    return socket->isOpen();
+}
+
+MdnsResponder *MdnsResponder::getDefault()
+{
+    return defaultResponder;
+}
+
+bool MdnsResponder::addService(std::string_view type, uint16_t port)
+{
+    std::string typeName = to_lower(type) + ".local"s;
+
+    cyw43_arch_lwip_begin();
+
+    Service *service = nullptr;
+    for (auto &s : services)
+    {
+        if (s.active && s.typeName == typeName)
+        {
+            service = &s; // update the port of an existing service
+            break;
+        }
+        if (!s.active && service == nullptr)
+            service = &s;
+    }
+
+    if (service == nullptr)
+    {
+        cyw43_arch_lwip_end();
+        return false;
+    }
+
+    service->active = true;
+    service->port = port;
+    service->typeName = typeName;
+    service->instanceName = to_lower(hostname) + "."s + typeName;
+    buildServiceResponse(service);
+
+    cyw43_arch_lwip_end();
+
+    announce();
+    return true;
+}
+
+bool MdnsResponder::removeService(std::string_view type)
+{
+    std::string typeName = to_lower(type) + ".local"s;
+    bool removed = false;
+
+    cyw43_arch_lwip_begin();
+    for (auto &s : services)
+    {
+        if (s.active && s.typeName == typeName)
+        {
+            s.active = false;
+            s.responseLength = 0;
+            removed = true;
+        }
+    }
+    cyw43_arch_lwip_end();
+
+    return removed;
+}
+
+void MdnsResponder::announce()
+{
+    if (!socket->isOpen())
+        return;
+
+    cyw43_arch_lwip_begin();
+    updateResponses(false);
+
+    if (addressResponseLength > 0)
+        sendResponse(addressResponse, addressResponseLength, nullptr, false);
+
+    for (auto &s : services)
+    {
+        if (s.active && s.responseLength > 0)
+            sendResponse(s.response, s.responseLength, nullptr, false);
+    }
+    cyw43_arch_lwip_end();
+}
+
+void MdnsResponder::updateResponses(bool force)
+{
+    u32_t address = netif_ip4_addr(netif_default)->addr;
+    if (!force && address == cachedAddress && addressResponseLength > 0)
+        return;
+
+    cachedAddress = address;
+    buildAddressResponse();
+    for (auto &s : services)
+    {
+        if (s.active)
+            buildServiceResponse(&s);
+    }
+}
+
+void MdnsResponder::buildAddressResponse()
+{
+    addressResponseLength = 0;
+    if (cachedAddress == 0)
+        return; // no address yet
+
+    dns_writer w = {addressResponse, MDNS_MAX_RESPONSE_LENGTH, 0, true, false};
+    dns_write_header(&w, 0, 1, 0);
+    dns_write_address(&w, hostname, cachedAddress);
+
+    if (w.ok)
+        addressResponseLength = w.pos;
+}
+
+void MdnsResponder::buildServiceResponse(Service *service)
+{
+    service->responseLength = 0;
+    if (cachedAddress == 0)
+        return; // no address yet
+
+    dns_writer w = {service->response, MDNS_MAX_RESPONSE_LENGTH, 0, true, false};
+    dns_write_header(&w, 0, 1, 3);
+    dns_write_service(&w, hostname, service->typeName, service->port, cachedAddress);
+
+    if (w.ok)
+        service->responseLength = w.pos;
+}
+
+size_t MdnsResponder::buildLegacyResponse(Service *service, std::string_view question, uint16_t type)
+{
+    if (cachedAddress == 0)
+        return 0;
+
+    dns_writer w = {legacyResponse, MDNS_MAX_LEGACY_RESPONSE_LENGTH, 0, true, true};
+    if (service == nullptr)
+    {
+        dns_write_header(&w, 1, 1, 0);
+        dns_write_question(&w, question, type);
+        dns_write_address(&w, hostname, cachedAddress);
+    }
+    else
+    {
+        dns_write_header(&w, 1, 1, 3);
+        dns_write_question(&w, question, type);
+        dns_write_service(&w, hostname, service->typeName, service->port, cachedAddress);
+    }
+
+    return w.ok ? w.pos : 0;
+}
+
+void MdnsResponder::sendResponse(const uint8_t *response, size_t length, Datagram *query, bool unicast)
+{
+    // the response is sent in place, lwIP copies a referenced pbuf if it has to queue it
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, length, PBUF_REF);
+    if (p == NULL)
+        return;
+
+    p->payload = (void *)response;
+
+    if (unicast && query != nullptr)
+        udp_sendto(socket->udp, p, query->address, query->port);
+    else
+        udp_sendto(socket->udp, p, &MDNS_GROUP, MDNS_PORT);
+
+    pbuf_free(p);
+}
+
+void MdnsResponder::handleQuery(Datagram *datagram)
+{
+    const uint8_t *packet;
+    size_t length = datagram->length;
+
+    if (datagram->isContiguous())
+    {
+        packet = (const uint8_t *)datagram->data;
+    }
+    else
+    {
+        if (length > MDNS_MAX_QUERY_LENGTH)
+            return;
+        datagram->copyTo(queryBuffer, length);
+        packet = queryBuffer;
+    }
+
+    if (length < 12)
+        return;
+
+    uint16_t id = (packet[0] << 8) | packet[1];
+    uint16_t flags = (packet[2] << 8) | packet[3];
+    uint16_t questionCount = (packet[4] << 8) | packet[5];
+    if (flags & DNS_FLAGS_RESPONSE)
+        return; // responses of other hosts
+
+    updateResponses(false);
+
+    bool legacy = datagram->port != MDNS_PORT;
+    bool sendAddress = false;
+    bool unicastAddress = false;
+    bool sendService[MDNS_MAX_SERVICES] = {};
+    bool unicastService[MDNS_MAX_SERVICES] = {};
+    // the offsets of the questions echoed in legacy responses
+    size_t addressQuestion = 0;
+    size_t serviceQuestion[MDNS_MAX_SERVICES] = {};
+
+    char name[MDNS_MAX_NAME_LENGTH];
+    size_t nameLength;
+    size_t pos = 12;
+    for (uint16_t i = 0; i < questionCount; i++)
+    {
+        size_t questionOffset = pos;
+        if (!dns_read_name(packet, length, &pos, name, &nameLength) || pos + 4 > length)
+            return;
+
+        uint16_t type = (packet[pos] << 8) | packet[pos + 1];
+        uint16_t cls = (packet[pos + 2] << 8) | packet[pos + 3];
+        pos += 4;
+
+        bool unicast = legacy || (cls & DNS_CLASS_UNICAST);
+        std::string_view question(name, nameLength);
+
+        if (question == hostLocalName && (type == DNS_TYPE_A || type == DNS_TYPE_ANY))
+        {
+            if (!sendAddress)
+                addressQuestion = questionOffset;
+            sendAddress = true;
+            unicastAddress = unicastAddress || unicast;
+        }
+
+        for (size_t s = 0; s < MDNS_MAX_SERVICES; s++)
+        {
+            if (!services[s].active)
+                continue;
+
+            if ((question == services[s].typeName && (type == DNS_TYPE_PTR || type == DNS_TYPE_ANY)) ||
+                (question == services[s].instanceName && (type == DNS_TYPE_SRV || type == DNS_TYPE_TXT || type == DNS_TYPE_ANY)))
+            {
+                if (!sendService[s])
+                    serviceQuestion[s] = questionOffset;
+                sendService[s] = true;
+                unicastService[s] = unicastService[s] || unicast;
+            }
+        }
+    }
+
+    if (legacy)
+    {
+        // legacy resolvers expect the query id, the question and short lived records in a unicast reply
+        if (sendAddress)
+            sendLegacyResponse(nullptr, packet, length, addressQuestion, datagram, id);
+
+        for (size_t s = 0; s < MDNS_MAX_SERVICES; s++)
+        {
+            if (sendService[s])
+                sendLegacyResponse(&services[s], packet, length, serviceQuestion[s], datagram, id);
+        }
+        return;
+    }
+
+    if (sendAddress && addressResponseLength > 0)
+        sendResponse(addressResponse, addressResponseLength, datagram, unicastAddress);
+
+    for (size_t s = 0; s < MDNS_MAX_SERVICES; s++)
+    {
+        if (sendService[s] && services[s].responseLength > 0)
+            sendResponse(services[s].response, services[s].responseLength, datagram, unicastService[s]);
+    }
+}
+
+void MdnsResponder::sendLegacyResponse(Service *service, const uint8_t *packet, size_t length, size_t questionOffset, Datagram *query, uint16_t id)
+{
+    char name[MDNS_MAX_NAME_LENGTH];
+    size_t nameLength;
+    if (!dns_read_name(packet, length, &questionOffset, name, &nameLength))
+        return;
+    uint16_t type = (packet[questionOffset] << 8) | packet[questionOffset + 1];
+
+    size_t responseLength = buildLegacyResponse(service, std::string_view(name, nameLength), type);
+    if (responseLength > 0)
+    {
+        // only the legacy response echoes the query id, the precomputed ones keep id 0
+        legacyResponse[0] = id >> 8;
+        legacyResponse[1] = id & 0xff;
+        sendResponse(legacyResponse, responseLength, query, true);
+    }
+}
+
+void MdnsResponder::receiveCallback(UdpSocket *socket, Datagram *datagram, void *args)
+{
+    MdnsResponder *responder = (MdnsResponder *)args;
+    responder->handleQuery(datagram);
+}
@@ -13,11 +13,11 @@ NTEntry::NTEntry(NetworkTableInstance *nt, std::string topic) : nt(nt), publishi
 {
 }
 
-NTEntry::NTEntry(NetworkTableInstance *nt, std::string topic, NTDataValue defaultValue) : nt(nt), publishing(true), sub(nt, topic), pub(nt, topic, defaultValue)
+NTEntry::NTEntry(NetworkTableInstance *nt, std::string topic, NTDataValue defaultValue) : nt(nt), publishing(true), sub(nt, topic), pub(nt, topic, std::move(defaultValue))
 {
 }
 
-NTEntry::NTEntry(NetworkTableInstance *nt, std::string topic, NTDataValue defaultValue, NetworkTableInstance::TopicProperties properties) : nt(nt), publishing(true), pubProperties(properties), sub(nt, topic), pub(nt, topic, defaultValue, properties)
+NTEntry::NTEntry(NetworkTableInstance *nt, std::string topic, NTDataValue defaultValue, NetworkTableInstance::TopicProperties properties) : nt(nt), publishing(true), pubProperties(properties), sub(nt, topic), pub(nt, topic, std::move(defaultValue), properties)
 {
 }
 
@@ -52,6 +52,11 @@ NTDataValue NTEntry::get()
     return sub.get();
 }
 
+NTValueSnapshot NTEntry::getSnapshot()
+{
+    return sub.getSnapshot();
+}
+
 bool NTEntry::getBoolean(bool defaultValue)
 {
     return sub.getBoolean(defaultValue);
@@ -117,12 +122,12 @@ bool NTEntry::set(NTDataValue value)
     if (!publishing)
     {
         publishing = true;
-        new (&pub) NTPublisher(nt, getTopic().getName(), value, pubProperties);
+        new (&pub) NTPublisher(nt, getTopic().getName(), std::move(value), pubProperties);
         return true;
     }
     else
     {
-        return pub.set(value);
+        return pub.set(std::move(value));
     }
 }
 
@@ -131,12 +136,12 @@ bool NTEntry::set(NTDataValue value, uint64_t time)
     if (!publishing)
     {
         publishing = true;
-        new (&pub) NTPublisher(nt, getTopic().getName(), value, time, pubProperties);
+        new (&pub) NTPublisher(nt, getTopic().getName(), std::move(value), time, pubProperties);
         return true;
     }
     else
     {
-        return pub.set(value, time);
+        return pub.set(std::move(value), time);
     }
 }
 
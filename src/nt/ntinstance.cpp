@@ -3,6 +3,7 @@
 #include <string>
 #include <cstdarg>
 #include <cstring>
+#include <cmath>
 #include <algorithm>
 
 // Hardware headers
@@ -12,6 +13,9 @@
 #include "nt/ntjson.hpp"
 
 #include "nt/ntinstance.h"
+#include "mdnsresponder.h"
+#include "radio.h"
+#include "config.h"
 
 using namespace std::literals;
 
@@ -28,172 +32,320 @@ enum class MessageMethod
     Properties
 };
 
-MessageMethod parseMessageMethod(const std::string_view &str)
+/// @brief The message methods in the order of MessageMethod, after Unknown
+static constexpr json::PerfectHash messageMethods = std::array{
+    "publish"sv, "unpublish"sv, "setproperties"sv, "subscribe"sv,
+    "unsubscribe"sv, "announce"sv, "unannounce"sv, "properties"sv};
+
+MessageMethod parseMessageMethod(std::string_view str)
 {
-    if (str == "publish"sv)
-    {
-        return MessageMethod::Publish;
-    }
-    else if (str == "unpublish"sv)
-    {
-        return MessageMethod::UnPublish;
-    }
-    else if (str == "setproperties"sv)
-    {
-        return MessageMethod::SetProperties;
-    }
-    else if (str == "subscribe"sv)
-    {
-        return MessageMethod::Subscribe;
-    }
-    else if (str == "unsubscribe"sv)
-    {
-        return MessageMethod::UnSubscribe;
-    }
-    else if (str == "announce"sv)
-    {
-        return MessageMethod::Announce;
-    }
-    else if (str == "unannounce"sv)
-    {
-        return MessageMethod::UnAnnounce;
-    }
-    else if (str == "properties"sv)
-    {
-        return MessageMethod::Properties;
-    }
-    else
-    {
-        return MessageMethod::Unknown;
-    }
+    int index = messageMethods.find(str);
+    return index < 0 ? MessageMethod::Unknown : (MessageMethod)(index + 1);
 }
 
-std::string serializeMessageMethod(MessageMethod method)
+std::string_view serializeMessageMethod(MessageMethod method)
 {
     switch (method)
     {
     case MessageMethod::Publish:
-        return "publish"s;
+        return "publish"sv;
     case MessageMethod::UnPublish:
-        return "unpublish"s;
+        return "unpublish"sv;
     case MessageMethod::SetProperties:
-        return "setproperties"s;
+        return "setproperties"sv;
     case MessageMethod::Subscribe:
-        return "subscribe"s;
+        return "subscribe"sv;
     case MessageMethod::UnSubscribe:
-        return "unsubscribe"s;
+        return "unsubscribe"sv;
     case MessageMethod::Announce:
-        return "announce"s;
+        return "announce"sv;
     case MessageMethod::UnAnnounce:
-        return "unannounce"s;
+        return "unannounce"sv;
     case MessageMethod::Properties:
-        return "properties"s;
+        return "properties"sv;
     default:
-        return ""s;
+        return ""sv;
     }
 }
 
-std::string serializeDataType(NTDataType type)
+std::string_view serializeDataType(NTDataType type)
 {
     switch (type)
     {
     case NTDataType::Bool:
-        return "boolean"s;
+        return "boolean"sv;
     case NTDataType::Float64:
-        return "double"s;
+        return "double"sv;
     case NTDataType::Int:
     case NTDataType::UInt:
-        return "int"s;
+        return "int"sv;
     case NTDataType::Float32:
-        return "float"s;
+        return "float"sv;
     case NTDataType::Str:
-        return "string"s;
+        return "string"sv;
     case NTDataType::Json:
-        return "json"s;
+        return "json"sv;
     case NTDataType::Bin:
     case NTDataType::Raw:
-        return "raw"s;
+        return "raw"sv;
     case NTDataType::Msgpack:
-        return "msgpack"s;
+        return "msgpack"sv;
     case NTDataType::Protobuf:
-        return "protobuf"s;
+        return "protobuf"sv;
     case NTDataType::BoolArray:
-        return "boolean[]"s;
+        return "boolean[]"sv;
     case NTDataType::Float64Array:
-        return "double[]"s;
+        return "double[]"sv;
     case NTDataType::IntArray:
-        return "int[]"s;
+        return "int[]"sv;
     case NTDataType::Float32Array:
-        return "float[]"s;
+        return "float[]"sv;
     case NTDataType::StrArray:
-        return "string[]"s;
+        return "string[]"sv;
     default:
-        return ""s;
+        return ""sv;
     }
 }
 
+static constexpr json::PerfectHash dataTypeNames = std::array{
+    "boolean"sv, "double"sv, "int"sv, "float"sv, "string"sv, "json"sv, "raw"sv,
+    "msgpack"sv, "protobuf"sv, "boolean[]"sv, "double[]"sv, "int[]"sv, "float[]"sv, "string[]"sv};
+/// @brief The data types in the order of dataTypeNames
+static constexpr NTDataType dataTypes[] = {
+    NTDataType::Bool, NTDataType::Float64, NTDataType::Int, NTDataType::Float32, NTDataType::Str, NTDataType::Json, NTDataType::Bin,
+    NTDataType::Msgpack, NTDataType::Protobuf, NTDataType::BoolArray, NTDataType::Float64Array, NTDataType::IntArray, NTDataType::Float32Array, NTDataType::StrArray};
+
 NTDataType parseDataType(std::string_view str)
 {
-    if (str == "boolean"sv)
-    {
-        return NTDataType::Bool;
-    }
-    else if (str == "double"sv)
-    {
-        return NTDataType::Float64;
-    }
-    else if (str == "int"sv)
-    {
-        return NTDataType::Int;
-    }
-    else if (str == "float"sv)
-    {
-        return NTDataType::Float32;
-    }
-    else if (str == "string"sv)
-    {
-        return NTDataType::Str;
-    }
-    else if (str == "json"sv)
-    {
-        return NTDataType::Json;
-    }
-    else if (str == "raw"sv)
-    {
-        return NTDataType::Bin;
-    }
-    else if (str == "msgpack"sv)
-    {
-        return NTDataType::Msgpack;
-    }
-    else if (str == "protobuf"sv)
-    {
-        return NTDataType::Protobuf;
-    }
-    else if (str == "boolean[]"sv)
-    {
-        return NTDataType::BoolArray;
-    }
-    else if (str == "double[]"sv)
-    {
-        return NTDataType::Float64Array;
-    }
-    else if (str == "int[]"sv)
+    int index = dataTypeNames.find(str);
+    return index < 0 ? NTDataType::Bin : dataTypes[index];
+}
+
+/// @brief The params of a client message, the keys may be in any order and missing keys are flagged
+struct MessageParams
+{
+    std::string name;
+    int32_t pubuid;
+    int32_t subuid;
+    NTDataType type;
+    std::vector<std::string> topics;
+    NetworkTableInstance::SubscriptionOptions options;
+    NetworkTableInstance::TopicProperties properties;
+
+    bool hasName;
+    bool hasPubuid;
+    bool hasSubuid;
+    bool hasType;
+    bool hasTopics;
+    bool hasPersistent;
+    bool hasRetained;
+    bool hasCached;
+
+    /// @brief Clears the params for the next message, keeping the allocated strings
+    void reset()
     {
-        return NTDataType::IntArray;
+        name.clear();
+        topics.clear();
+        options = NetworkTableInstance::SubscriptionOptions_DEFAULT;
+        properties = NetworkTableInstance::TopicProperties_DEFAULT;
+        hasName = hasPubuid = hasSubuid = hasType = hasTopics = false;
+        hasPersistent = hasRetained = hasCached = false;
     }
-    else if (str == "float[]"sv)
+};
+
+enum class ParamKey
+{
+    Name,
+    Pubuid,
+    Subuid,
+    Type,
+    Topics,
+    Options,
+    Properties,
+    Update
+};
+
+static constexpr json::PerfectHash paramKeys = std::array{
+    "name"sv, "pubuid"sv, "subuid"sv, "type"sv, "topics"sv, "options"sv, "properties"sv, "update"sv};
+
+enum class OptionKey
+{
+    Periodic,
+    All,
+    TopicsOnly,
+    Prefix,
+    Udp
+};
+
+static constexpr json::PerfectHash optionKeys = std::array{
+    "periodic"sv, "all"sv, "topicsonly"sv, "prefix"sv, "udp"sv};
+
+enum class PropertyKey
+{
+    Persistent,
+    Retained,
+    Cached
+};
+
+static constexpr json::PerfectHash propertyKeys = std::array{
+    "persistent"sv, "retained"sv, "cached"sv};
+
+/// @brief Reads the current token as an int32
+/// @return False if it is not an integer or out of range
+static bool unpackInt32(const json::Tokenizer &tokenizer, int32_t *out_value)
+{
+    if (tokenizer.token() != json::Token::Int ||
+        tokenizer.int_value() < INT32_MIN || tokenizer.int_value() > INT32_MAX)
+        return false;
+
+    *out_value = tokenizer.int_value();
+    return true;
+}
+
+/// @brief Unpacks subscription options, the current token is the beginning of the object
+/// @return False if the input is invalid
+static bool unpackOptions(json::Tokenizer &tokenizer, NetworkTableInstance::SubscriptionOptions *options)
+{
+    while (tokenizer.next() && tokenizer.token() == json::Token::Key)
     {
-        return NTDataType::Float32Array;
+        int key = optionKeys.find(tokenizer.string());
+        if (!tokenizer.next())
+            return false;
+
+        switch ((OptionKey)key)
+        {
+        case OptionKey::Periodic:
+            // NT4 sends the period in seconds
+            if (tokenizer.is_number())
+                options->periodic = (int32_t)std::lround(tokenizer.double_value() * 1000);
+            break;
+        case OptionKey::All:
+            if (tokenizer.is_bool())
+                options->all = tokenizer.token() == json::Token::True;
+            break;
+        case OptionKey::TopicsOnly:
+            if (tokenizer.is_bool())
+                options->topicsonly = tokenizer.token() == json::Token::True;
+            break;
+        case OptionKey::Prefix:
+            if (tokenizer.is_bool())
+                options->prefix = tokenizer.token() == json::Token::True;
+            break;
+        case OptionKey::Udp:
+            unpackInt32(tokenizer, &options->udp);
+            break;
+        default:
+            break;
+        }
+
+        if (!tokenizer.skip()) // unknown keys and values of the wrong type
+            return false;
     }
-    else if (str == "string[]"sv)
+    return tokenizer.token() == json::Token::ObjectEnd;
+}
+
+/// @brief Unpacks topic properties, the current token is the beginning of the object
+/// @note Null values are ignored and leave the has flags unset
+/// @return False if the input is invalid
+static bool unpackProperties(json::Tokenizer &tokenizer, MessageParams *params)
+{
+    while (tokenizer.next() && tokenizer.token() == json::Token::Key)
     {
-        return NTDataType::StrArray;
+        int key = propertyKeys.find(tokenizer.string());
+        if (!tokenizer.next())
+            return false;
+
+        if (tokenizer.is_bool())
+        {
+            bool value = tokenizer.token() == json::Token::True;
+            switch ((PropertyKey)key)
+            {
+            case PropertyKey::Persistent:
+                params->properties.persistent = value;
+                params->hasPersistent = true;
+                break;
+            case PropertyKey::Retained:
+                params->properties.retained = value;
+                params->hasRetained = true;
+                break;
+            case PropertyKey::Cached:
+                params->properties.cached = value;
+                params->hasCached = true;
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (!tokenizer.skip())
+            return false;
     }
-    else
+    return tokenizer.token() == json::Token::ObjectEnd;
+}
+
+/// @brief Unpacks the params of a message, the current token is the beginning of the object
+/// @return False if the input is invalid
+static bool unpackParams(json::Tokenizer &tokenizer, MessageParams *params)
+{
+    while (tokenizer.next() && tokenizer.token() == json::Token::Key)
     {
-        return NTDataType::Bin;
+        int key = paramKeys.find(tokenizer.string());
+        if (!tokenizer.next())
+            return false;
+
+        json::Token token = tokenizer.token();
+        switch ((ParamKey)key)
+        {
+        case ParamKey::Name:
+            if (token == json::Token::Str)
+            {
+                params->name.assign(tokenizer.string());
+                params->hasName = true;
+            }
+            break;
+        case ParamKey::Pubuid:
+            params->hasPubuid = unpackInt32(tokenizer, &params->pubuid);
+            break;
+        case ParamKey::Subuid:
+            params->hasSubuid = unpackInt32(tokenizer, &params->subuid);
+            break;
+        case ParamKey::Type:
+            if (token == json::Token::Str)
+            {
+                params->type = parseDataType(tokenizer.string());
+                params->hasType = true;
+            }
+            break;
+        case ParamKey::Topics:
+            if (token == json::Token::ArrayBegin)
+            {
+                while (tokenizer.next() && tokenizer.token() != json::Token::ArrayEnd)
+                {
+                    if (tokenizer.token() == json::Token::Str)
+                        params->topics.emplace_back(tokenizer.string());
+                    else if (!tokenizer.skip())
+                        return false;
+                }
+                params->hasTopics = true;
+            }
+            break;
+        case ParamKey::Options:
+            if (token == json::Token::ObjectBegin && !unpackOptions(tokenizer, &params->options))
+                return false;
+            break;
+        case ParamKey::Properties:
+        case ParamKey::Update:
+            if (token == json::Token::ObjectBegin && !unpackProperties(tokenizer, params))
+                return false;
+            break;
+        default:
+            break;
+        }
+
+        if (!tokenizer.skip())
+            return false;
     }
+    return tokenizer.token() == json::Token::ObjectEnd;
 }
 
 NTDataType NTDataValue::getAPIType() const
@@ -214,6 +366,120 @@ NTDataType NTDataValue::getAPIType() const
     return type;
 }
 
+std::size_t NTDataValue::payloadSize() const
+{
+    switch (type)
+    {
+    case NTDataType::Str:
+    case NTDataType::Json:
+    case NTDataType::Bin:
+    case NTDataType::Raw:
+    case NTDataType::Msgpack:
+    case NTDataType::Protobuf:
+        return length;
+    case NTDataType::BoolArray:
+        return (length + 7) / 8;
+    case NTDataType::Float64Array:
+    case NTDataType::IntArray:
+        return length * sizeof(int64_t);
+    case NTDataType::Float32Array:
+        return length * sizeof(float);
+    case NTDataType::StrArray:
+        // the offset table ends with the length of all characters
+        return (length + 1) * sizeof(uint32_t) + ((const uint32_t *)payload())[length];
+    default:
+        return 0;
+    }
+}
+
+uint8_t *NTDataValue::allocate(std::size_t count, std::size_t bytes)
+{
+    release();
+    length = count;
+    if (bytes > NT_VALUE_INLINE_SIZE)
+    {
+        heap = new uint8_t[bytes];
+        external = true;
+    }
+    return payload();
+}
+
+void NTDataValue::setBytes(const void *data, std::size_t count)
+{
+    uint8_t *bytes = allocate(count, count);
+    if (count > 0)
+        std::memcpy(bytes, data, count);
+}
+
+void NTDataValue::release()
+{
+    if (external)
+    {
+        delete[] heap;
+        external = false;
+    }
+    length = 0;
+}
+
+void NTDataValue::copy(const NTDataValue &other)
+{
+    if (!other.external)
+    {
+        release();
+        length = other.length;
+        std::memcpy(small, other.small, sizeof(small)); // also copies scalars
+        return;
+    }
+
+    std::size_t bytes = other.payloadSize();
+    if (external && payloadSize() == bytes)
+    {
+        // updates of a topic usually keep their size, reuse the block
+        length = other.length;
+        std::memcpy(heap, other.heap, bytes);
+        return;
+    }
+
+    std::memcpy(allocate(other.length, bytes), other.heap, bytes);
+}
+
+void NTDataValue::take(NTDataValue &other)
+{
+    release();
+    external = other.external;
+    length = other.length;
+    std::memcpy(small, other.small, sizeof(small));
+
+    // an empty payload is valid for every type, including the offset table of string arrays
+    other.external = false;
+    other.length = 0;
+    std::memset(other.small, 0, sizeof(other.small));
+}
+
+std::string_view NTDataValue::strAt(std::size_t index) const
+{
+    const uint32_t *offsets = (const uint32_t *)payload();
+    const char *chars = (const char *)&offsets[length + 1];
+    return {&chars[offsets[index]], offsets[index + 1] - offsets[index]};
+}
+
+std::vector<bool> NTDataValue::bArray() const
+{
+    std::vector<bool> array(length);
+    for (std::size_t index = 0; index < length; index++)
+        array[index] = boolAt(index);
+    return array;
+}
+
+std::vector<std::string> NTDataValue::strArray() const
+{
+    std::vector<std::string> array;
+    array.reserve(length);
+    for (std::size_t index = 0; index < length; index++)
+        array.emplace_back(strAt(index));
+    return array;
+}
+
 void NTDataValue::unpack(msgpack::Unpacker<false> &unpacker)
 {
     switch (type)
@@ -236,40 +502,100 @@ void NTDataValue::unpack(msgpack::Unpacker<false> &unpacker)
         break;
     case NTDataType::Str:
     case NTDataType::Json:
-        str = {};
-        unpacker.process(str);
+    {
+        std::string_view view;
+        unpacker.process(view);
+        setBytes(view.data(), view.size());
         break;
+    }
     case NTDataType::Bin:
     case NTDataType::Raw:
     case NTDataType::Msgpack:
     case NTDataType::Protobuf:
-        bin = {};
-        unpacker.process(bin);
+    {
+        std::span<const uint8_t> view;
+        unpacker.process(view);
+        setBytes(view.data(), view.size());
         break;
+    }
     case NTDataType::UInt:
         ui = 0;
         unpacker.process(ui);
         break;
     case NTDataType::BoolArray:
-        bArray = {};
-        unpacker.process(bArray);
+    {
+        std::size_t count = unpacker.unpack_array_size();
+        uint8_t *bits = allocate(count, (count + 7) / 8);
+        std::memset(bits, 0, (count + 7) / 8);
+        for (std::size_t index = 0; index < count; index++)
+        {
+            bool value = false;
+            unpacker.process(value);
+            bits[index / 8] |= (uint8_t)value << (index % 8);
+        }
         break;
+    }
     case NTDataType::Float64Array:
-        f64Array = {};
-        unpacker.process(f64Array);
+    {
+        std::size_t count = unpacker.unpack_array_size();
+        double *values = (double *)allocate(count, count * sizeof(double));
+        for (std::size_t index = 0; index < count; index++)
+        {
+            values[index] = 0;
+            unpacker.process(values[index]);
+        }
         break;
+    }
     case NTDataType::IntArray:
-        iArray = {};
-        unpacker.process(iArray);
+    {
+        std::size_t count = unpacker.unpack_array_size();
+        int64_t *values = (int64_t *)allocate(count, count * sizeof(int64_t));
+        for (std::size_t index = 0; index < count; index++)
+        {
+            values[index] = 0;
+            unpacker.process(values[index]);
+        }
         break;
+    }
     case NTDataType::Float32Array:
-        f32Array = {};
-        unpacker.process(f32Array);
+    {
+        std::size_t count = unpacker.unpack_array_size();
+        float *values = (float *)allocate(count, count * sizeof(float));
+        for (std::size_t index = 0; index < count; index++)
+        {
+            values[index] = 0;
+            unpacker.process(values[index]);
+        }
         break;
+    }
     case NTDataType::StrArray:
-        strArray = {};
-        unpacker.process(strArray);
+    {
+        // measure the strings on a copy of the unpacker first, so the block is allocated once
+        auto measure = unpacker;
+        std::size_t count = measure.unpack_array_size();
+        std::size_t chars = 0;
+        for (std::size_t index = 0; index < count && !measure.ec; index++)
+        {
+            std::string_view view;
+            measure.process(view);
+            chars += view.size();
+        }
+
+        count = unpacker.unpack_array_size();
+        uint32_t *offsets = (uint32_t *)allocate(count, (count + 1) * sizeof(uint32_t) + chars);
+        char *data = (char *)&offsets[count + 1];
+        offsets[0] = 0;
+        for (std::size_t index = 0; index < count; index++)
+        {
+            std::string_view view;
+            unpacker.process(view);
+            if (unpacker.ec)
+                view = {};
+            view.copy(&data[offsets[index]], view.size());
+            offsets[index + 1] = offsets[index] + view.size();
+        }
         break;
+    }
     default:
         break;
     }
@@ -293,31 +619,35 @@ void NTDataValue::pack(msgpack::Packer<false> &packer) const
         break;
     case NTDataType::Str:
     case NTDataType::Json:
-        packer.process(str);
+        packer.process(str());
         break;
     case NTDataType::Bin:
     case NTDataType::Raw:
     case NTDataType::Msgpack:
     case NTDataType::Protobuf:
-        packer.process(bin);
+        packer.process(bin());
         break;
     case NTDataType::UInt:
         packer.process(ui);
         break;
     case NTDataType::BoolArray:
-        packer.process(bArray);
+        packer.pack_array_header(length);
+        for (std::size_t index = 0; index < length; index++)
+            packer.process(boolAt(index));
         break;
     case NTDataType::Float64Array:
-        packer.process(f64Array);
+        packer.process(f64Array());
         break;
     case NTDataType::IntArray:
-        packer.process(iArray);
+        packer.process(iArray());
         break;
     case NTDataType::Float32Array:
-        packer.process(f32Array);
+        packer.process(f32Array());
         break;
     case NTDataType::StrArray:
-        packer.process(strArray);
+        packer.pack_array_header(length);
+        for (std::size_t index = 0; index < length; index++)
+            packer.process(strAt(index));
         break;
     default:
         break;
@@ -333,119 +663,105 @@ NTDataValue::NTDataValue(NTDataType type, msgpack::Unpacker<false> &unpacker) :
 
 NTDataValue::NTDataValue(NTDataType type) : type(type)
 {
-    switch (type)
+    // zero scalars, empty payloads and the single offset of an empty string array
+    std::memset(small, 0, sizeof(small));
+}
+
+NTDataValue::NTDataValue(bool b) : type(NTDataType::Bool), b(b) {}
+NTDataValue::NTDataValue(double f64) : type(NTDataType::Float64), f64(f64) {}
+NTDataValue::NTDataValue(int64_t i) : type(NTDataType::Int), i(i) {}
+NTDataValue::NTDataValue(float f32) : type(NTDataType::Float32), f32(f32) {}
+NTDataValue::NTDataValue(uint64_t ui) : type(NTDataType::UInt), ui(ui) {}
+
+NTDataValue::NTDataValue(std::string_view str) : NTDataValue(NTDataType::Str, str) {}
+
+NTDataValue::NTDataValue(NTDataType type, std::string_view str) : type(type)
+{
+    setBytes(str.data(), str.size());
+}
+
+NTDataValue::NTDataValue(std::span<const uint8_t> bin) : NTDataValue(NTDataType::Bin, bin) {}
+
+NTDataValue::NTDataValue(NTDataType type, std::span<const uint8_t> bin) : type(type)
+{
+    setBytes(bin.data(), bin.size());
+}
+
+NTDataValue::NTDataValue(const std::vector<bool> &bArray) : type(NTDataType::BoolArray)
+{
+    uint8_t *bits = allocate(bArray.size(), (bArray.size() + 7) / 8);
+    std::memset(bits, 0, (bArray.size() + 7) / 8);
+    for (std::size_t index = 0; index < bArray.size(); index++)
+        bits[index / 8] |= (uint8_t)bArray[index] << (index % 8);
+}
+
+NTDataValue::NTDataValue(std::span<const double> f64Array) : type(NTDataType::Float64Array)
+{
+    setBytes(f64Array.data(), f64Array.size_bytes());
+    length = f64Array.size();
+}
+
+NTDataValue::NTDataValue(std::span<const int64_t> iArray) : type(NTDataType::IntArray)
+{
+    setBytes(iArray.data(), iArray.size_bytes());
+    length = iArray.size();
+}
+
+NTDataValue::NTDataValue(std::span<const float> f32Array) : type(NTDataType::Float32Array)
+{
+    setBytes(f32Array.data(), f32Array.size_bytes());
+    length = f32Array.size();
+}
+
+NTDataValue::NTDataValue(const std::vector<std::string> &strArray) : type(NTDataType::StrArray)
+{
+    std::size_t chars = 0;
+    for (const auto &str : strArray)
+        chars += str.size();
+
+    uint32_t *offsets = (uint32_t *)allocate(strArray.size(), (strArray.size() + 1) * sizeof(uint32_t) + chars);
+    char *data = (char *)&offsets[strArray.size() + 1];
+    offsets[0] = 0;
+    for (std::size_t index = 0; index < strArray.size(); index++)
     {
-    case NTDataType::Bool:
-        b = false;
-        break;
-    case NTDataType::Float64:
-        f64 = 0;
-        break;
-    case NTDataType::Int:
-        i = 0;
-        break;
-    case NTDataType::Float32:
-        f32 = 0;
-        break;
-    case NTDataType::Str:
-    case NTDataType::Json:
-        str = {};
-        break;
-    case NTDataType::Bin:
-    case NTDataType::Raw:
-    case NTDataType::Msgpack:
-    case NTDataType::Protobuf:
-        bin = std::vector<uint8_t>{};
-        break;
-    case NTDataType::UInt:
-        ui = 0;
-        break;
-    case NTDataType::BoolArray:
-        bArray = {};
-        break;
-    case NTDataType::Float64Array:
-        f64Array = {};
-        break;
-    case NTDataType::IntArray:
-        iArray = {};
-        break;
-    case NTDataType::Float32Array:
-        f32Array = {};
-        break;
-    case NTDataType::StrArray:
-        strArray = {};
-        break;
-    default:
-        break;
+        std::memcpy(&data[offsets[index]], strArray[index].data(), strArray[index].size());
+        offsets[index + 1] = offsets[index] + strArray[index].size();
     }
 }
 
-NTDataValue::NTDataValue(bool b) : type(NTDataType::Bool), b(b) {}
-NTDataValue::NTDataValue(double f64) : type(NTDataType::Float64), f64(f64) {}
-NTDataValue::NTDataValue(int64_t i) : type(NTDataType::Int), i(i) {}
-NTDataValue::NTDataValue(float f32) : type(NTDataType::Float32), f32(f32) {}
-NTDataValue::NTDataValue(std::string str) : type(NTDataType::Str), str(str) {}
-NTDataValue::NTDataValue(NTDataType type, std::string str) : type(type), str(str) {}
-NTDataValue::NTDataValue(std::vector<uint8_t> bin) : type(NTDataType::Bin), bin(bin) {}
-NTDataValue::NTDataValue(NTDataType type, std::vector<uint8_t> bin) : type(type), bin(bin) {}
-NTDataValue::NTDataValue(uint64_t ui) : type(NTDataType::UInt), ui(ui) {}
-NTDataValue::NTDataValue(std::vector<bool> bArray) : type(NTDataType::BoolArray), bArray(bArray) {}
-NTDataValue::NTDataValue(std::vector<double> f64Array) : type(NTDataType::Float64Array), f64Array(f64Array) {}
-NTDataValue::NTDataValue(std::vector<int64_t> iArray) : type(NTDataType::IntArray), iArray(iArray) {}
-NTDataValue::NTDataValue(std::vector<float> f32Array) : type(NTDataType::Float32Array), f32Array(f32Array) {}
-NTDataValue::NTDataValue(std::vector<std::string> strArray) : type(NTDataType::StrArray), strArray(strArray) {}
+NTDataValue::NTDataValue(const NTDataValue &other) : type(other.type)
+{
+    copy(other);
+}
+
+NTDataValue::NTDataValue(NTDataValue &&other) : type(other.type)
+{
+    take(other);
+}
+
+NTDataValue &NTDataValue::operator=(const NTDataValue &other)
+{
+    if (this != &other)
+    {
+        copy(other);
+        type = other.type;
+    }
+    return *this;
+}
 
-NTDataValue::NTDataValue(const NTDataValue &other) : type(other.type)
+NTDataValue &NTDataValue::operator=(NTDataValue &&other)
 {
-    switch (other.type)
+    if (this != &other)
     {
-    case NTDataType::Bool:
-        b = other.b;
-        break;
-    case NTDataType::Float64:
-        f64 = other.f64;
-        break;
-    case NTDataType::Int:
-        i = other.i;
-        break;
-    case NTDataType::Float32:
-        f32 = other.f32;
-        break;
-    case NTDataType::Str:
-    case NTDataType::Json:
-        str = other.str;
-        break;
-    case NTDataType::Bin:
-    case NTDataType::Raw:
-    case NTDataType::Msgpack:
-    case NTDataType::Protobuf:
-        bin = std::vector<uint8_t>(other.bin);
-        break;
-    case NTDataType::UInt:
-        ui = other.ui;
-        break;
-    case NTDataType::BoolArray:
-        bArray = other.bArray;
-        break;
-    case NTDataType::Float64Array:
-        f64Array = other.f64Array;
-        break;
-    case NTDataType::IntArray:
-        iArray = other.iArray;
-        break;
-    case NTDataType::Float32Array:
-        f32Array = other.f32Array;
-        break;
-    case NTDataType::StrArray:
-        strArray = other.strArray;
-        break;
-    default:
-        break;
+        take(other);
+        type = other.type;
     }
+    return *this;
 }
 
 NTDataValue::~NTDataValue()
 {
+    release();
 }
 
 void NTDataValue::assign(const NTDataValue &other)
@@ -456,58 +772,85 @@ void NTDataValue::assign(const NTDataValue &other)
         type = other.type;
 
     if (getAPIType() == other.getAPIType()) // matching type is required
+        copy(other);
+}
+
+void NTDataValue::assign(NTDataValue &&other)
+{
+    assert(other.isValid());
+
+    if (!isValid())
+        type = other.type;
+
+    if (getAPIType() == other.getAPIType())
+        take(other);
+}
+
+NTValueSnapshot::NTValueSnapshot(NTDataValue &&value) : block(new Block(std::move(value)))
+{
+}
+
+NTValueSnapshot::NTValueSnapshot(const NTValueSnapshot &other) : block(other.block)
+{
+    if (block)
+        block->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+NTValueSnapshot &NTValueSnapshot::operator=(const NTValueSnapshot &other)
+{
+    if (block != other.block)
     {
-        switch (other.type)
-        {
-        case NTDataType::Bool:
-            b = other.b;
-            break;
-        case NTDataType::Float64:
-            f64 = other.f64;
-            break;
-        case NTDataType::Int:
-            i = other.i;
-            break;
-        case NTDataType::Float32:
-            f32 = other.f32;
-            break;
-        case NTDataType::Str:
-        case NTDataType::Json:
-            str = other.str;
-            break;
-        case NTDataType::Bin:
-        case NTDataType::Raw:
-        case NTDataType::Msgpack:
-        case NTDataType::Protobuf:
-            bin = std::vector<uint8_t>(other.bin);
-            break;
-        case NTDataType::UInt:
-            ui = other.ui;
-            break;
-        case NTDataType::BoolArray:
-            bArray = other.bArray;
-            break;
-        case NTDataType::Float64Array:
-            f64Array = other.f64Array;
-            break;
-        case NTDataType::IntArray:
-            iArray = other.iArray;
-            break;
-        case NTDataType::Float32Array:
-            f32Array = other.f32Array;
-            break;
-        case NTDataType::StrArray:
-            strArray = other.strArray;
-            break;
-        default:
-            break;
-        }
+        if (other.block)
+            other.block->references.fetch_add(1, std::memory_order_relaxed);
+        release();
+        block = other.block;
+    }
+    return *this;
+}
+
+NTValueSnapshot &NTValueSnapshot::operator=(NTValueSnapshot &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        block = other.block;
+        other.block = nullptr;
     }
+    return *this;
+}
+
+NTValueSnapshot::~NTValueSnapshot()
+{
+    release();
+}
+
+void NTValueSnapshot::release()
+{
+    if (block && block->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete block;
+    block = nullptr;
+}
+
+NTValueSnapshot NTValueSnapshot::load(const NTValueSnapshot &shared)
+{
+    taskENTER_CRITICAL();
+    NTValueSnapshot snapshot(shared);
+    taskEXIT_CRITICAL();
+    return snapshot;
+}
+
+void NTValueSnapshot::store(NTValueSnapshot &shared, NTValueSnapshot value)
+{
+    taskENTER_CRITICAL();
+    std::swap(shared.block, value.block);
+    taskEXIT_CRITICAL();
+    // the previous value is released when `value` goes out of scope
 }
 
 static constexpr int NT4_SERVER_PORT = 5810;
 static constexpr std::string_view NT_PROTOCOL = "v4.1.networktables.first.wpi.edu"sv;
 static constexpr std::string_view NT_RTT_PROTOCOL = "rtt.networktables.first.wpi.edu"sv;
+static constexpr std::string_view NT_MDNS_SERVICE = "_networktables._tcp"sv;
 
 static constexpr TickType_t MUTEX_TIMEOUT = 1000;
 
@@ -534,22 +877,33 @@ void NetworkTableInstance::startClient(std::string_view url)
 }
 
 void NetworkTableInstance::startServer()
+{
+    startServer(nullptr);
+}
+
+void NetworkTableInstance::startServer(Radio *radio)
 {
     stop();
     if (!xSemaphoreTake(stateMutex, MUTEX_TIMEOUT))
         return;
     serverTimeOffset = 0;
+    serverStartTime = get_absolute_time();
+    firstClientConnected = false;
     server = new WsServer(NT4_SERVER_PORT);
     server->setBadRequestResponse("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 118\r\n\r\n<html><head><title>NetworkTables</title></head><body><p>WebSockets must be used to access NetworkTables.</body></html>"sv);
     server->callbackArgs = this;
     thisClient = {
         .guid = Guid(),
+        .id = NT_SELF_CLIENT_ID,
         .name = "fake_server"s,
         .subscriptions = {},
         .publishers = {},
         .topicData = {}};
     this->topics = {};
-    this->clients = {{thisClient.guid, &thisClient}};
+    this->topicHandles = {};
+    subscriptionTrie.clear();
+    std::fill(std::begin(this->clients), std::end(this->clients), nullptr);
+    this->clients[NT_SELF_CLIENT_ID] = &thisClient;
 
     // Accept NT_PROTOCOL or NT_RTT_PROTOCOL only
     server->protocolCallback = [](const std::vector<std::string> &requestedProtocols, void *args) -> std::string_view
@@ -571,6 +925,7 @@ void NetworkTableInstance::startServer()
 
                                 ClientData* data = new ClientData();
                                 data->guid = entry->guid;
+                                data->id = entry->id;
                                 std::size_t nameStart = entry->requestedPath.find("/nt/"sv) + 4;
                                 auto name = entry->requestedPath.substr(nameStart);
                                 
@@ -584,51 +939,80 @@ void NetworkTableInstance::startServer()
                                 data->publishers = {};
                                 data->subscriptions = {};
                                 data->topicData = {};
-                                inst->clients[entry->guid] = data;
+                                inst->removeClient(entry->id); // a stale client if its disconnect was missed
+                                inst->clients[entry->id] = data;
+
+                                if (!inst->firstClientConnected)
+                                {
+                                    inst->firstClientConnected = true;
+                                    printf("[RADIO] First NetworkTables client connected %u ms after start\n", (uint32_t)(absolute_time_diff_us(inst->serverStartTime, get_absolute_time()) / 1000));
+                                }
 
                                 inst->publishTopic("$clientsub$"s + data->name, NTDataValue(NTDataType::Msgpack, std::vector<uint8_t>{}), {.retained = true, .cached = true});
                                 inst->publishTopic("$clientpub$"s + data->name, NTDataValue(NTDataType::Msgpack, std::vector<uint8_t>{}), {.retained = true, .cached = true});
                                 inst->updateClientsMetaTopic();
-                                inst->updateClientSubMetaTopic(entry->guid);
-                                inst->updateClientPubMetaTopic(entry->guid);
+                                inst->updateClientSubMetaTopic(entry->id);
+                                inst->updateClientPubMetaTopic(entry->id);
                                 inst->flushText(data);
-                                inst->publishInitialValues(entry->guid);
+                                inst->publishInitialValues(entry->id);
                                 inst->flushBinary(data);
                                 xSemaphoreGive(inst->stateMutex); });
 
-    server->clientDisconnected.Add([](WsServer *server, const Guid &guid, WebSocketStatusCode statusCode, const std::string_view &reason, void *args)
+    server->clientEntryDisconnected.Add([](WsServer *server, const WsServer::ClientEntry *entry, WebSocketStatusCode statusCode, const std::string_view &reason, void *args)
                                    {
                                        NetworkTableInstance *inst = (NetworkTableInstance *)args;
                                        
                                         if (!xSemaphoreTake(inst->stateMutex, MUTEX_TIMEOUT))
                                             return;
 
-                                        auto search = inst->clients.find(guid);
-                                        if(search == inst->clients.end())
-                                            return;
-
-                                        ClientData *data = search->second;
-                                        inst->clients.erase(guid);
-                                        for (auto o : data->subscriptions)
-                                            delete o.second;
-                                        for (auto o : data->publishers)
-                                            delete o.second;
-                                        delete data;
-                                        inst->updateClientsMetaTopic();
-                                        inst->flushBinary();
+                                        // the id is reused by later clients, make sure it is still this one
+                                        ClientData *data = inst->clients[entry->id];
+                                        if (data != nullptr && data->guid == entry->guid)
+                                        {
+                                            inst->removeClient(entry->id);
+                                            inst->updateClientsMetaTopic();
+                                            inst->flushBinary();
+                                        }
                                         xSemaphoreGive(inst->stateMutex); });
 
-    server->messageReceived.Add([](WsServer *server, const Guid &guid, const WebSocketFrame &frame, void *args)
+    server->clientEntryMessageReceived.Add([](WsServer *server, const WsServer::ClientEntry *entry, const WebSocketFrame &frame, void *args)
                                 {
                                     if (!frame.isFragment)
                                     {
                                         NetworkTableInstance *inst = (NetworkTableInstance *)args;
-                                        inst->_handleFrame(guid, frame);
+                                        inst->_handleFrame(entry->id, frame);
                                     } });
 
-    server->start();
     networkMode = NetworkMode::Server;
 
+    // the handle is set before the task runs, so it can clear it when it ends
+    periodicRunning = true;
+    periodicWakeUs = UINT64_MAX;
+    xTaskCreate([](void *ins) -> void
+                { ((NetworkTableInstance *)ins)->runPeriodicUpdates(); vTaskDelete(NULL); },
+                "nt_periodic", configMINIMAL_STACK_SIZE * 4, this, 2, (TaskHandle_t *)&periodicTask);
+
+    bindRadio = radio;
+    bindPending = true;
+
+    if (radio == nullptr || radio->isLinkUp())
+    {
+        bindServer();
+    }
+    else
+    {
+        // registered before the task checks the link, so no link up event is missed
+        // the callback stays registered, later servers of the same radio reuse it
+        setBindWaiter(true);
+        if (radio->linkUp.Find(onRadioLinkUp) < 0)
+            radio->linkUp.Add(onRadioLinkUp);
+
+        // the handle is set before the task runs, so it can clear it when it ends
+        xTaskCreate([](void *ins) -> void
+                    { ((NetworkTableInstance *)ins)->waitAndBindServer(); vTaskDelete(NULL); },
+                    "nt_bind", configMINIMAL_STACK_SIZE * 2, this, 2, (TaskHandle_t *)&bindTask);
+    }
+
     publishTopic("$clients"s, NTDataValue(NTDataType::Msgpack, std::vector<uint8_t>{}), {.retained = true, .cached = true});
     publishTopic("$serversub"s, NTDataValue(NTDataType::Msgpack, std::vector<uint8_t>{}), {.retained = true, .cached = true});
     publishTopic("$serverpub"s, NTDataValue(NTDataType::Msgpack, std::vector<uint8_t>{}), {.retained = true, .cached = true});
@@ -642,7 +1026,124 @@ void NetworkTableInstance::startServer()
     xSemaphoreGive(stateMutex);
 }
 
-void NetworkTableInstance::_handleFrame(const Guid &guid, const WebSocketFrame &frame)
+void NetworkTableInstance::bindServer()
+{
+    bindPending = false;
+    server->start();
+    printf("[RADIO] NetworkTables server bound %u ms after start\n", (uint32_t)(absolute_time_diff_us(serverStartTime, get_absolute_time()) / 1000));
+
+    if (MdnsResponder::getDefault() != nullptr)
+        MdnsResponder::getDefault()->addService(NT_MDNS_SERVICE, NT4_SERVER_PORT);
+
+#if NT_UDP_PORT > 0
+    udpSocket = new UdpSocket(NT_UDP_PORT);
+    if (udpSocket->isOpen())
+    {
+        // clients opt in to UDP value updates through the "udp" subscription option
+        publishTopic("$udp"s, NTDataValue((int64_t)NT_UDP_PORT), {.retained = true, .cached = true});
+    }
+    else
+    {
+        printf("[RADIO] Failed to bind the NetworkTables UDP socket\n");
+        delete udpSocket;
+        udpSocket = nullptr;
+    }
+#endif
+}
+
+void NetworkTableInstance::waitAndBindServer()
+{
+    while (bindPending)
+    {
+        // woken by the link up event and stop(), the check covers a link that came up before the task was waiting
+        if (!bindRadio->isLinkUp())
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        if (!xSemaphoreTake(stateMutex, MUTEX_TIMEOUT))
+            continue;
+
+        // stop() may have cancelled the bind while waiting for the mutex
+        if (bindPending)
+        {
+            bindServer();
+            flushText();
+            flushBinary();
+        }
+        xSemaphoreGive(stateMutex);
+    }
+
+    setBindWaiter(false);
+    bindTask = nullptr;
+}
+
+/// @brief The instances waiting for their radio link, linked through nextBindWaiter
+static NetworkTableInstance *nt_bind_waiters = nullptr;
+
+void NetworkTableInstance::setBindWaiter(bool waiting)
+{
+    taskENTER_CRITICAL();
+    NetworkTableInstance **link = &nt_bind_waiters;
+    while (*link != nullptr && *link != this)
+        link = &(*link)->nextBindWaiter;
+
+    if (waiting && *link == nullptr)
+    {
+        nextBindWaiter = nullptr;
+        *link = this;
+    }
+    else if (!waiting && *link == this)
+    {
+        *link = nextBindWaiter;
+        nextBindWaiter = nullptr;
+    }
+    taskEXIT_CRITICAL();
+}
+
+void NetworkTableInstance::onRadioLinkUp(Radio *radio, uint32_t linkUpTimeMs, void *args)
+{
+    taskENTER_CRITICAL();
+    for (NetworkTableInstance *inst = nt_bind_waiters; inst != nullptr; inst = inst->nextBindWaiter)
+    {
+        TaskHandle_t task = inst->bindTask;
+        if (inst->bindRadio == radio && task != nullptr)
+            xTaskNotifyGive(task);
+    }
+    taskEXIT_CRITICAL();
+}
+
+void NetworkTableInstance::runPeriodicUpdates()
+{
+    while (periodicRunning)
+    {
+        if (!xSemaphoreTake(stateMutex, MUTEX_TIMEOUT))
+            continue;
+
+        // stop() may have ended the server while waiting for the mutex
+        TickType_t wait = portMAX_DELAY;
+        if (periodicRunning)
+        {
+            periodicWakeUs = sendPendingUpdates();
+            if (periodicWakeUs != UINT64_MAX)
+            {
+                // round up, waking before the due time would only find the update still held
+                uint64_t now = to_us_since_boot(get_absolute_time());
+                uint64_t waitUs = periodicWakeUs > now ? periodicWakeUs - now : 0;
+                wait = std::max<TickType_t>(1, pdMS_TO_TICKS((waitUs + 999) / 1000));
+            }
+        }
+        xSemaphoreGive(stateMutex);
+
+        // scheduleTopicUpdate() and stop() notify the task while it waits for a pending update
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+
+    periodicTask = nullptr;
+}
+
+void NetworkTableInstance::_handleFrame(WsClientId clientId, const WebSocketFrame &frame)
 {
     switch (frame.opcode)
     {
@@ -650,109 +1151,72 @@ void NetworkTableInstance::_handleFrame(const Guid &guid, const WebSocketFrame &
     {
         printf("%.*s\n", frame.payloadLength, frame.payload);
 
-        if (clients.find(guid) == clients.end())
+        if (clientId >= WS_SERVER_MAX_CLIENT_COUNT || clients[clientId] == nullptr)
             break;
 
-        std::vector<std::string> topics{};
-
-        auto unpacker = json::Unpacker();
-        unpacker.set_data(frame.payload, frame.payloadLength);
-        unpacker.unpack_array();
-        json::DataType nextType;
+        json::Tokenizer tokenizer(frame.payload, frame.payloadLength);
+        if (!tokenizer.next() || tokenizer.token() != json::Token::ArrayBegin)
+            break;
 
-        do
+        MessageParams params;
+        while (tokenizer.next() && tokenizer.token() == json::Token::ObjectBegin)
         {
-            unpacker.unpack_object(); // the message
-            unpacker.unpack_key();
-            auto method = unpacker.unpack_string();
-            unpacker.unpack_key();
-            unpacker.unpack_object(); // message params
-            switch (parseMessageMethod(method))
+            MessageMethod method = MessageMethod::Unknown;
+            params.reset();
+
+            bool valid = true;
+            while (valid && tokenizer.next() && tokenizer.token() == json::Token::Key)
+            {
+                bool isMethod = tokenizer.string() == "method"sv;
+                bool isParams = tokenizer.string() == "params"sv;
+                if (!tokenizer.next())
+                    break;
+
+                if (isMethod && tokenizer.token() == json::Token::Str)
+                    method = parseMessageMethod(tokenizer.string());
+                else if (isParams && tokenizer.token() == json::Token::ObjectBegin)
+                    valid = unpackParams(tokenizer, &params);
+                valid = valid && tokenizer.skip();
+            }
+
+            // a message is only handled once it is complete, invalid input drops the rest of the frame
+            if (!valid || tokenizer.token() != json::Token::ObjectEnd)
+                break;
+
+            switch (method)
             {
             case MessageMethod::Subscribe:
             {
                 if (networkMode != NetworkMode::Server)
                     break;
 
-                topics.clear();
-                int32_t subuid;
-                SubscriptionOptions options = SubscriptionOptions_DEFAULT; // TODO: replace default with already set options (if exist)
-                for (int i = 0; i < 3; i++)
-                {
-                    auto key = unpacker.unpack_key();
-                    if (key == "topics"sv)
-                    {
-                        unpacker.unpack_array();
-                        json::DataType type;
-                        while (
-                            unpacker.peek_type(&type) != json::UnpackerError::OutOfRange &&
-                            type != json::ArrayEnd)
-                        {
-                            topics.push_back(std::string(unpacker.unpack_string()));
-                        }
-                        unpacker.unpack_array_end();
-                    }
-                    else if (key == "subuid"sv)
-                    {
-                        subuid = unpacker.unpack_int();
-                    }
-                    else if (key == "options"sv)
-                    {
-                        unpacker.unpack_object();
-                        json::DataType type;
-                        while (
-                            unpacker.peek_type(&type) != json::UnpackerError::OutOfRange &&
-                            type != json::ObjectEnd)
-                        {
-                            auto mkey = unpacker.unpack_key();
-                            if (mkey == "periodic"sv && unpacker.peek_type() == json::Int)
-                            {
-                                options.periodic = unpacker.unpack_int();
-                            }
-                            else if (mkey == "all"sv && unpacker.is_bool(unpacker.peek_type()))
-                            {
-                                options.all = unpacker.unpack_bool();
-                            }
-                            else if (mkey == "topicsonly"sv && unpacker.is_bool(unpacker.peek_type()))
-                            {
-                                options.topicsonly = unpacker.unpack_bool();
-                            }
-                            else if (mkey == "prefix"sv && unpacker.is_bool(unpacker.peek_type()))
-                            {
-                                options.prefix = unpacker.unpack_bool();
-                            }
-                        }
-                        unpacker.unpack_object_end();
-                    }
-                }
+                if (!params.hasSubuid || !params.hasTopics)
+                    break;
 
                 if (!xSemaphoreTake(stateMutex, MUTEX_TIMEOUT))
                     return;
-                if (!clients[guid]->subscriptions[subuid])
-                {
-                    clients[guid]->subscriptions[subuid] = new Subscription(subuid, topics, options);
-                }
-                else
+                Subscription *sub = setSubscription(clients[clientId], params.subuid, params.topics, params.options);
+
+                if (params.options.udp > 0 && params.options.udp <= 0xffff)
                 {
-                    clients[guid]->subscriptions[subuid]->uid = subuid;
-                    clients[guid]->subscriptions[subuid]->topics = topics;
-                    clients[guid]->subscriptions[subuid]->options = options;
+                    clients[clientId]->udpPort = params.options.udp;
+                    updateClientUdpEndpoint(clients[clientId]);
                 }
 
-                updateClientSubMetaTopic(guid);
+                updateClientSubMetaTopic(clientId);
 
-                for (auto topic : this->topics)
+                for (const auto &topic : this->topics)
                 {
                     if (!topic.first.starts_with('$')) // don't update meta-topic subscriptions
                     {
-                        if (isSubscribed(clients[guid]->subscriptions[subuid], topic.first))
+                        if (isSubscribed(sub, topic.first))
                         {
                             updateTopicSubMetaTopic(topic.first);
                         }
                     }
                 }
 
-                announceCachedTopics(guid);
+                announceCachedTopics(clientId);
                 xSemaphoreGive(stateMutex);
                 break;
             }
@@ -761,74 +1225,38 @@ void NetworkTableInstance::_handleFrame(const Guid &guid, const WebSocketFrame &
                 if (networkMode != NetworkMode::Server)
                     break;
 
-                std::string topic;
-                int32_t pubuid;
-                NTDataType type;
-                TopicProperties properties = TopicProperties_DEFAULT;
-                for (int i = 0; i < 4; i++)
-                {
-                    auto key = unpacker.unpack_key();
-                    if (key == "name"sv)
-                    {
-                        topic = unpacker.unpack_string();
-                    }
-                    else if (key == "pubuid"sv)
-                    {
-                        pubuid = unpacker.unpack_int();
-                    }
-                    else if (key == "type"sv)
-                    {
-                        type = parseDataType(unpacker.unpack_string());
-                    }
-                    else if (key == "properties"sv)
-                    {
-                        unpacker.unpack_object();
-                        json::DataType type;
-                        while (
-                            unpacker.peek_type(&type) != json::UnpackerError::OutOfRange &&
-                            type != json::ObjectEnd)
-                        {
-                            auto mkey = unpacker.unpack_key();
-                            if (mkey == "persistent"sv && unpacker.is_bool(unpacker.peek_type()))
-                            {
-                                properties.persistent = unpacker.unpack_bool();
-                            }
-                            else if (mkey == "retained"sv && unpacker.is_bool(unpacker.peek_type()))
-                            {
-                                properties.retained = unpacker.unpack_bool();
-                            }
-                            else if (mkey == "cached"sv && unpacker.is_bool(unpacker.peek_type()))
-                            {
-                                properties.cached = unpacker.unpack_bool();
-                            }
-                        }
-                        unpacker.unpack_object_end();
-                    }
-                }
+                if (!params.hasName || !params.hasPubuid || !params.hasType)
+                    break;
+
+                const std::string &topic = params.name;
+                int32_t pubuid = params.pubuid;
 
                 if (!xSemaphoreTake(stateMutex, MUTEX_TIMEOUT))
                     return;
-                if (!clients[guid]->publishers[pubuid])
+                if (!clients[clientId]->publishers[pubuid])
                 {
-                    clients[guid]->publishers[pubuid] = new Publisher(pubuid, topic);
+                    clients[clientId]->publishers[pubuid] = new Publisher(pubuid, topic);
                 }
                 else
                 {
-                    clients[guid]->publishers[pubuid]->uid = pubuid;
-                    clients[guid]->publishers[pubuid]->topic = topic;
+                    clients[clientId]->publishers[pubuid]->uid = pubuid;
+                    clients[clientId]->publishers[pubuid]->topic = topic;
                 }
 
-                if (!this->topics.contains(topic))
+                Topic *top = findTopic(topic);
+                if (top == nullptr)
                 {
-                    publishTopic(topic, NTDataValue(type), guid, pubuid, properties);
+                    publishTopic(topic, NTDataValue(params.type), clientId, pubuid, params.properties);
+                    top = findTopic(topic);
                 }
                 else
                 {
                     // topic already published, just respond to client
-                    announceTopic(guid, this->topics[topic], pubuid);
+                    announceTopic(clientId, top, pubuid);
                 }
+                clients[clientId]->publishers[pubuid]->topicHandle = top->handle;
 
-                updateClientPubMetaTopic(guid);
+                updateClientPubMetaTopic(clientId);
                 updateTopicPubMetaTopic(topic);
                 xSemaphoreGive(stateMutex);
                 break;
@@ -838,23 +1266,17 @@ void NetworkTableInstance::_handleFrame(const Guid &guid, const WebSocketFrame &
                 if (networkMode != NetworkMode::Server)
                     break;
 
-                int32_t subuid;
-                auto key = unpacker.unpack_key();
-                if (key == "subuid"sv)
-                {
-                    subuid = unpacker.unpack_int();
-                }
+                if (!params.hasSubuid)
+                    break;
 
                 if (!xSemaphoreTake(stateMutex, MUTEX_TIMEOUT))
                     return;
-                auto sub = clients[guid]->subscriptions[subuid];
+                auto sub = takeSubscription(clients[clientId], params.subuid);
                 if (sub != nullptr)
                 {
-                    clients[guid]->subscriptions.erase(subuid);
+                    updateClientSubMetaTopic(clientId);
 
-                    updateClientSubMetaTopic(guid);
-
-                    for (auto topic : this->topics)
+                    for (const auto &topic : this->topics)
                     {
                         if (!topic.first.starts_with('$')) // don't update meta-topic subscriptions
                         {
@@ -875,20 +1297,17 @@ void NetworkTableInstance::_handleFrame(const Guid &guid, const WebSocketFrame &
                 if (networkMode != NetworkMode::Server)
                     break;
 
-                int32_t pubuid;
-                auto key = unpacker.unpack_key();
-                if (key == "pubuid"sv)
-                {
-                    pubuid = unpacker.unpack_int();
-                }
+                if (!params.hasPubuid)
+                    break;
 
                 if (!xSemaphoreTake(stateMutex, MUTEX_TIMEOUT))
                     return;
-                auto pub = clients[guid]->publishers[pubuid];
-                if (pub != nullptr)
+                auto it = clients[clientId]->publishers.find(params.pubuid);
+                if (it != clients[clientId]->publishers.end())
                 {
-                    clients[guid]->publishers.erase(pubuid);
-                    updateClientPubMetaTopic(guid);
+                    Publisher *pub = it->second;
+                    clients[clientId]->publishers.erase(it);
+                    updateClientPubMetaTopic(clientId);
                     updateTopicPubMetaTopic(pub->topic);
                     delete pub;
                 }
@@ -900,60 +1319,24 @@ void NetworkTableInstance::_handleFrame(const Guid &guid, const WebSocketFrame &
                 if (networkMode != NetworkMode::Server)
                     break;
 
-                std::string topic;
-                TopicProperties properties = TopicProperties_DEFAULT;
-                bool hasPersistent = false;
-                bool hasRetained = false;
-                bool hasCached = false;
-
-                for (int i = 0; i < 2; i++)
-                {
-                    auto key = unpacker.unpack_key();
-                    if (key == "name"sv)
-                    {
-                        topic = unpacker.unpack_string();
-                    }
-                    else if (key == "update"sv)
-                    {
-                        unpacker.unpack_object();
-                        json::DataType type;
-                        while (
-                            unpacker.peek_type(&type) != json::UnpackerError::OutOfRange &&
-                            type != json::ObjectEnd)
-                        {
-                            auto mkey = unpacker.unpack_key();
-                            if (mkey == "persistent"sv && unpacker.is_bool_or_null(unpacker.peek_type()))
-                            {
-                                hasPersistent = unpacker.unpack_default_bool(properties.persistent);
-                            }
-                            else if (mkey == "retained"sv && unpacker.is_bool_or_null(unpacker.peek_type()))
-                            {
-                                hasRetained = unpacker.unpack_default_bool(properties.retained);
-                            }
-                            else if (mkey == "cached"sv && unpacker.is_bool_or_null(unpacker.peek_type()))
-                            {
-                                hasCached = unpacker.unpack_default_bool(properties.cached);
-                            }
-                        }
-                        unpacker.unpack_object_end();
-                    }
-                }
+                if (!params.hasName)
+                    break;
 
                 if (!xSemaphoreTake(stateMutex, MUTEX_TIMEOUT))
                     return;
-                auto top = this->topics[topic];
+                auto top = findTopic(params.name);
 
                 if (top != nullptr)
                 {
                     // Set unchanged to existing values
-                    if (hasPersistent)
-                        top->properties.persistent = properties.persistent;
-                    if (hasRetained)
-                        top->properties.retained = properties.retained;
-                    if (hasCached)
-                        top->properties.cached = properties.cached;
-
-                    updateTopicProperties(top, guid);
+                    if (params.hasPersistent)
+                        top->properties.persistent = params.properties.persistent;
+                    if (params.hasRetained)
+                        top->properties.retained = params.properties.retained;
+                    if (params.hasCached)
+                        top->properties.cached = params.properties.cached;
+
+                    updateTopicProperties(top, clientId);
                 }
                 xSemaphoreGive(stateMutex);
 
@@ -962,16 +1345,12 @@ void NetworkTableInstance::_handleFrame(const Guid &guid, const WebSocketFrame &
             default:
                 break;
             }
-            unpacker.unpack_object_end(); // message params
-            unpacker.unpack_object_end(); // the message
-        } while (unpacker.ec != json::UnpackerError::OutOfRange && unpacker.peek_type(&nextType) != json::UnpackerError::OutOfRange && nextType != json::ArrayEnd);
-
-        unpacker.unpack_array_end();
+        }
 
         if (!xSemaphoreTake(stateMutex, MUTEX_TIMEOUT))
             return;
         flushText();
-        publishInitialValues(guid);
+        publishInitialValues(clientId);
         flushBinary();
         xSemaphoreGive(stateMutex);
         break;
@@ -1008,7 +1387,7 @@ void NetworkTableInstance::_handleFrame(const Guid &guid, const WebSocketFrame &
                         packer.process(timestamp);
                         packer.process(_type);
                         data.pack(packer);
-                        server->send(guid, packer.vector());
+                        server->send(clientId, packer.vector());
                         break;
                     }
                     case NetworkMode::Client:
@@ -1048,18 +1427,21 @@ void NetworkTableInstance::_handleFrame(const Guid &guid, const WebSocketFrame &
                         if (!xSemaphoreTake(stateMutex, MUTEX_TIMEOUT))
                             return;
 
-                        auto search = clients.find(guid);
-                        if (search == clients.end())
+                        auto client = clients[clientId];
+                        if (client == nullptr)
+                        {
+                            xSemaphoreGive(stateMutex);
                             break;
+                        }
 
-                        auto client = search->second;
-                        auto publisher = client->publishers[id];
-                        if (publisher != nullptr)
+                        auto search = client->publishers.find(id);
+                        if (search != client->publishers.end() && search->second != nullptr)
                         {
-                            auto topic = topics[publisher->topic];
+                            auto topic = topicHandles[search->second->topicHandle];
                             if (topic != nullptr)
                             {
-                                topic->value.assign(data);
+                                setTopicValue(topic, std::move(data));
+                                topic->sequence++;
                                 sendTopicUpdate(topic);
                             }
                         }
@@ -1106,23 +1488,23 @@ NetworkTableInstance::AnnouncedTopic NetworkTableInstance::announceTopicSelfSync
 {
     assert(networkMode == NetworkMode::Server);
 
-    if (!thisClient.topicData.contains(topic->name))
+    ClientTopicData &data = thisClient.getTopicData(topic->handle);
+    if (data.id < 0)
     {
-        thisClient.topicData[topic->name] = {
-            thisClient.nextTopicIdAssigned++,
-            false};
+        data.id = thisClient.nextTopicIdAssigned++;
+        data.initialPublish = false;
     }
     else
     {
         // TODO: reannouncement responds with the old id for now
     }
 
-    int64_t id = thisClient.topicData[topic->name].id;
+    int64_t id = data.id;
 
     AnnouncedTopic t{
         topic->name,
         id,
-        topic->value.type,
+        topic->value->type,
         topic->properties};
     *out_success = true;
     return t;
@@ -1142,18 +1524,54 @@ bool NetworkTableInstance::announceTopicSelf(const Topic *topic)
     return true;
 }
 
-bool NetworkTableInstance::announceTopic(const Guid &guid, const Topic *topic)
+void NetworkTableInstance::packProperties(json::Packer<WebSocketFrameBuffer> &packer, std::string_view key, const TopicProperties &properties)
+{
+    packer.pack_key(key);
+    packer.pack_object();
+    packer.pack_key("persistent"sv);
+    packer.pack_bool(properties.persistent);
+    packer.pack_key("retained"sv);
+    packer.pack_bool(properties.retained);
+    packer.pack_key("cached"sv);
+    packer.pack_bool(properties.cached);
+    packer.pack_object_end();
+}
+
+void NetworkTableInstance::packAnnounce(json::Packer<WebSocketFrameBuffer> &packer, const Topic *topic, int64_t id, const int32_t *pubuid)
+{
+    packer.pack_object();
+    packer.pack_key("method"sv);
+    packer.pack_string("announce"sv);
+    packer.pack_key("params"sv);
+    packer.pack_object();
+    packer.pack_key("name"sv);
+    packer.pack_string(topic->name);
+    packer.pack_key("id"sv);
+    packer.pack_int(id);
+    packer.pack_key("type"sv);
+    packer.pack_string(serializeDataType(topic->value->type));
+    if (pubuid != nullptr)
+    {
+        packer.pack_key("pubuid"sv);
+        packer.pack_int(*pubuid);
+    }
+    packProperties(packer, "properties"sv, topic->properties);
+    packer.pack_object_end();
+    packer.pack_object_end();
+}
+
+bool NetworkTableInstance::announceTopic(WsClientId clientId, const Topic *topic)
 {
     assert(networkMode == NetworkMode::Server);
 
-    ClientData *client = clients[guid];
+    ClientData *client = clients[clientId];
     assert(client != nullptr);
 
-    if (!client->topicData.contains(topic->name))
+    ClientTopicData &data = client->getTopicData(topic->handle);
+    if (data.id < 0)
     {
-        client->topicData[topic->name] = {
-            client->nextTopicIdAssigned++,
-            false};
+        data.id = client->nextTopicIdAssigned++;
+        data.initialPublish = false;
     }
     else
     {
@@ -1161,73 +1579,31 @@ bool NetworkTableInstance::announceTopic(const Guid &guid, const Topic *topic)
         return true;
     }
 
-    int64_t id = client->topicData[topic->name].id;
-    std::string text = "{\"method\":\"announce\",\"params\":{\"name\":\""s +
-                       topic->name +
-                       "\",\"id\":"s +
-                       std::to_string(id) +
-                       ",\"type\":\""s +
-                       serializeDataType(topic->value.type) +
-                       "\",\"properties\":{\"persistent\":"s +
-                       (topic->properties.persistent
-                            ? "true"s
-                            : "false"s) +
-                       ",\"retained\":"s +
-                       (topic->properties.retained
-                            ? "true"s
-                            : "false"s) +
-                       ",\"cached\":"s +
-                       (topic->properties.cached
-                            ? "true"s
-                            : "false"s) +
-                       "}}}"s;
-    flushText(client, text.length());
-    if (client->textCache.length() > 0)
-        client->textCache.append(","sv); // comma separator
-    client->textCache.append(text);
+    std::size_t mark;
+    auto packer = beginText(client, &mark);
+    packAnnounce(packer, topic, data.id, nullptr);
+    endText(client, mark);
     return true;
 }
 
-bool NetworkTableInstance::announceTopic(const Guid &guid, const Topic *topic, int32_t pubuid)
+bool NetworkTableInstance::announceTopic(WsClientId clientId, const Topic *topic, int32_t pubuid)
 {
     assert(networkMode == NetworkMode::Server);
 
-    ClientData *client = clients[guid];
+    ClientData *client = clients[clientId];
     assert(client != nullptr);
 
-    if (!client->topicData.contains(topic->name))
-    {
-        client->topicData[topic->name] = {
-            client->nextTopicIdAssigned++,
-            false};
-    }
-
-    int64_t id = client->topicData[topic->name].id;
-    std::string text = "{\"method\":\"announce\",\"params\":{\"name\":\""s +
-                       topic->name +
-                       "\",\"id\":"s +
-                       std::to_string(id) +
-                       ",\"type\":\""s +
-                       serializeDataType(topic->value.type) +
-                       "\",\"pubuid\":"s +
-                       std::to_string(pubuid) +
-                       ",\"properties\":{\"persistent\":"s +
-                       (topic->properties.persistent
-                            ? "true"s
-                            : "false"s) +
-                       ",\"retained\":"s +
-                       (topic->properties.retained
-                            ? "true"s
-                            : "false"s) +
-                       ",\"cached\":"s +
-                       (topic->properties.cached
-                            ? "true"s
-                            : "false"s) +
-                       "}}}"s;
-    flushText(client, text.length());
-    if (client->textCache.length() > 0)
-        client->textCache.append(","sv); // comma separator
-    client->textCache.append(text);
+    ClientTopicData &data = client->getTopicData(topic->handle);
+    if (data.id < 0)
+    {
+        data.id = client->nextTopicIdAssigned++;
+        data.initialPublish = false;
+    }
+
+    std::size_t mark;
+    auto packer = beginText(client, &mark);
+    packAnnounce(packer, topic, data.id, &pubuid);
+    endText(client, mark);
     return true;
 }
 
@@ -1235,12 +1611,12 @@ bool NetworkTableInstance::unannounceTopicSelf(const Topic *topic)
 {
     assert(networkMode == NetworkMode::Server);
 
-    if (!thisClient.topicData.contains(topic->name))
+    if (!thisClient.isAnnounced(topic->handle))
     {
         return false;
     }
 
-    int64_t id = thisClient.topicData[topic->name].id;
+    int64_t id = thisClient.topicData[topic->handle].id;
     if (topicUnAnnouncedCallback)
     {
         return topicUnAnnouncedCallback(this, topic->name, id, callbackArgs);
@@ -1248,28 +1624,35 @@ bool NetworkTableInstance::unannounceTopicSelf(const Topic *topic)
     return true;
 }
 
-bool NetworkTableInstance::unannounceTopic(const Guid &guid, const Topic *topic)
+bool NetworkTableInstance::unannounceTopic(WsClientId clientId, const Topic *topic)
 {
     assert(networkMode == NetworkMode::Server);
 
-    ClientData *client = clients[guid];
+    ClientData *client = clients[clientId];
     assert(client != nullptr);
 
-    if (!client->topicData.contains(topic->name))
+    if (!client->isAnnounced(topic->handle))
     {
         return false;
     }
 
-    int64_t id = client->topicData[topic->name].id;
-    std::string text = "{\"method\":\"unannounce\",\"params\":{\"name\":\""s +
-                       topic->name +
-                       "\",\"id\":"s +
-                       std::to_string(id) +
-                       "}}"s;
-    flushText(client, text.length());
-    if (client->textCache.length() > 0)
-        client->textCache.append(","sv); // comma separator
-    client->textCache.append(text);
+    // held updates must not follow the unannounce
+    dropPendingUpdate(client, topic->handle);
+
+    std::size_t mark;
+    auto packer = beginText(client, &mark);
+    packer.pack_object();
+    packer.pack_key("method"sv);
+    packer.pack_string("unannounce"sv);
+    packer.pack_key("params"sv);
+    packer.pack_object();
+    packer.pack_key("name"sv);
+    packer.pack_string(topic->name);
+    packer.pack_key("id"sv);
+    packer.pack_int(client->topicData[topic->handle].id);
+    packer.pack_object_end();
+    packer.pack_object_end();
+    endText(client, mark);
     return true;
 }
 
@@ -1283,39 +1666,37 @@ bool NetworkTableInstance::sendPropertyUpdateSelf(const Topic *topic)
     return true;
 }
 
-bool NetworkTableInstance::sendPropertyUpdate(const Guid &guid, const Topic *topic, bool ack)
+bool NetworkTableInstance::sendPropertyUpdate(WsClientId clientId, const Topic *topic, bool ack)
 {
     assert(networkMode == NetworkMode::Server);
 
-    ClientData *client = clients[guid];
+    ClientData *client = clients[clientId];
     assert(client != nullptr);
 
-    std::string text = "{\"method\":\"properties\",\"params\":{\"name\":\""s +
-                       topic->name +
-                       (ack ? "\",\"ack\":true"s : "\""s) +
-                       ",\"update\":{\"persistent\":"s +
-                       (topic->properties.persistent
-                            ? "true"s
-                            : "false"s) +
-                       ",\"retained\":"s +
-                       (topic->properties.retained
-                            ? "true"s
-                            : "false"s) +
-                       ",\"cached\":"s +
-                       (topic->properties.cached
-                            ? "true"s
-                            : "false"s) +
-                       "}}}"s;
-    flushText(client, text.length());
-    if (client->textCache.length() > 0)
-        client->textCache.append(","sv); // comma separator
-    client->textCache.append(text);
+    std::size_t mark;
+    auto packer = beginText(client, &mark);
+    packer.pack_object();
+    packer.pack_key("method"sv);
+    packer.pack_string("properties"sv);
+    packer.pack_key("params"sv);
+    packer.pack_object();
+    packer.pack_key("name"sv);
+    packer.pack_string(topic->name);
+    if (ack)
+    {
+        packer.pack_key("ack"sv);
+        packer.pack_bool(true);
+    }
+    packProperties(packer, "update"sv, topic->properties);
+    packer.pack_object_end();
+    packer.pack_object_end();
+    endText(client, mark);
     return true;
 }
 
-bool NetworkTableInstance::isSubscribed(Subscription *subscription, std::string name)
+bool NetworkTableInstance::isSubscribed(const Subscription *subscription, const std::string &name)
 {
-    for (auto top : subscription->topics)
+    for (const auto &top : subscription->topics)
     {
         if (subscription->options.prefix)
         {
@@ -1340,62 +1721,164 @@ bool NetworkTableInstance::isSubscribed(Subscription *subscription, std::string
     return false;
 }
 
-bool NetworkTableInstance::isSubscribed(const std::unordered_map<int32_t, Subscription *> &subscriptions, std::string name, bool requireNotTopicsOnly, Subscription **out_subscription)
+bool NetworkTableInstance::isSubscribed(ClientData *client, const Topic *topic, bool requireNotTopicsOnly, Subscription **out_subscription)
 {
-    for (auto sub : subscriptions)
+    for (const auto &subscriber : getSubscribers(topic))
     {
-        if (!requireNotTopicsOnly || !sub.second->options.topicsonly)
+        if (subscriber.client == client && (!requireNotTopicsOnly || !subscriber.subscription->options.topicsonly))
         {
-            for (auto top : sub.second->topics)
-            {
-                if (sub.second->options.prefix)
-                {
-                    if (name.starts_with('$'))
-                    {
-                        if (top.starts_with('$') && name.starts_with(top))
-                        {
-                            if (out_subscription != nullptr)
-                                *out_subscription = sub.second;
-                            return true;
-                        }
-                    }
-                    else if (top.length() == 0 || name.starts_with(top))
-                    {
-                        if (out_subscription != nullptr)
-                            *out_subscription = sub.second;
-                        return true;
-                    }
-                }
-                else if (name == top)
-                {
-                    if (out_subscription != nullptr)
-                        *out_subscription = sub.second;
-                    return true;
-                }
-            }
+            if (out_subscription != nullptr)
+                *out_subscription = subscriber.subscription;
+            return true;
         }
     }
 
     return false;
 }
 
+const std::vector<NetworkTableInstance::TopicSubscriber> &NetworkTableInstance::getSubscribers(const Topic *topic)
+{
+    if (!topic->subscribersCached)
+    {
+        topic->subscribers.clear();
+        subscriptionTrie.match(topic->name, [topic](const TopicSubscriber &subscriber)
+                               { topic->subscribers.push_back(subscriber); });
+        topic->subscribersCached = true;
+    }
+    return topic->subscribers;
+}
+
+NetworkTableInstance::Subscription *NetworkTableInstance::setSubscription(ClientData *client, int32_t subuid, const std::vector<std::string> &topics, SubscriptionOptions options)
+{
+    auto search = client->subscriptions.find(subuid);
+    Subscription *previous = search != client->subscriptions.end() ? search->second : nullptr;
+
+    // the replacement is indexed first, so topics it still covers keep their pending updates
+    Subscription *sub = new Subscription(subuid, topics, options);
+    client->subscriptions[subuid] = sub;
+    indexSubscription(client, sub, true);
+    if (previous != nullptr)
+    {
+        indexSubscription(client, previous, false);
+        delete previous;
+    }
+    prunePendingUpdates(client);
+    return sub;
+}
+
+NetworkTableInstance::Subscription *NetworkTableInstance::takeSubscription(ClientData *client, int32_t subuid)
+{
+    auto search = client->subscriptions.find(subuid);
+    if (search == client->subscriptions.end())
+        return nullptr;
+
+    Subscription *sub = search->second;
+    client->subscriptions.erase(search);
+    if (sub != nullptr)
+    {
+        indexSubscription(client, sub, false);
+        prunePendingUpdates(client);
+    }
+    return sub;
+}
+
+void NetworkTableInstance::prunePendingUpdates(ClientData *client)
+{
+    if (isSelf(client))
+        return;
+
+    bool wake = false;
+    for (size_t i = client->pendingTopics.size(); i-- > 0;)
+    {
+        uint32_t handle = client->pendingTopics[i];
+        const Topic *topic = topicHandles[handle];
+        ClientTopicData &data = client->topicData[handle];
+        if (!data.pending)
+            continue;
+
+        if (getValueSubscription(client, topic) == nullptr)
+        {
+            dropPendingUpdate(client, handle);
+        }
+        else
+        {
+            // the remaining subscriptions may have a shorter period
+            bool all;
+            uint32_t periodMs = getUpdatePeriod(client, topic, &all);
+            wake |= periodMs < data.periodMs;
+            data.periodMs = periodMs;
+        }
+    }
+
+    TaskHandle_t task = periodicTask;
+    if (wake && task != nullptr)
+    {
+        periodicWakeUs = 0;
+        xTaskNotifyGive(task);
+    }
+}
+
+void NetworkTableInstance::dropPendingUpdate(ClientData *client, uint32_t handle)
+{
+    ClientTopicData &data = client->topicData[handle];
+    if (data.pending)
+    {
+        data.pending = false;
+        std::erase(client->pendingTopics, handle);
+    }
+    releaseQueue(client, data);
+}
+
+void NetworkTableInstance::releaseQueue(ClientData *client, ClientTopicData &data)
+{
+    ValueQueue *queue = data.queue;
+    if (queue == nullptr)
+        return;
+
+    client->queuedBytes -= queue->bytes;
+    delete[] queue->slots;
+    delete queue;
+    data.queue = nullptr;
+}
+
+void NetworkTableInstance::indexSubscription(ClientData *client, Subscription *subscription, bool add)
+{
+    TopicSubscriber subscriber = {client, subscription};
+    for (const auto &pattern : subscription->topics)
+    {
+        if (add)
+            subscriptionTrie.insert(pattern, subscription->options.prefix, subscriber);
+        else
+            subscriptionTrie.remove(pattern, subscription->options.prefix, subscriber);
+    }
+
+    // only the topics matched by this subscription change their subscribers
+    for (Topic *topic : topicHandles)
+    {
+        if (topic->subscribersCached && isSubscribed(subscription, topic->name))
+            topic->subscribersCached = false;
+    }
+}
+
 bool NetworkTableInstance::announceTopic(const Topic *topic)
 {
     assert(networkMode == NetworkMode::Server);
     bool ok = true;
     for (auto client : clients)
     {
-        assert(client.second != nullptr);
-        if (isSubscribed(client.second->subscriptions, topic->name))
+        if (client == nullptr)
+            continue;
+
+        if (isSubscribed(client, topic))
         {
-            if (isSelf(client.second))
+            if (isSelf(client))
             {
                 if (!announceTopicSelf(topic))
                     ok = false;
             }
             else
             {
-                if (!announceTopic(client.first, topic))
+                if (!announceTopic(client->id, topic))
                     ok = false;
             }
         }
@@ -1403,28 +1886,30 @@ bool NetworkTableInstance::announceTopic(const Topic *topic)
     return ok;
 }
 
-bool NetworkTableInstance::announceTopic(const Topic *topic, const Guid &publisherGuid, int32_t pubuid)
+bool NetworkTableInstance::announceTopic(const Topic *topic, WsClientId publisherId, int32_t pubuid)
 {
     assert(networkMode == NetworkMode::Server);
     bool ok = true;
     for (auto client : clients)
     {
-        assert(client.second != nullptr);
-        if (client.first == publisherGuid)
+        if (client == nullptr)
+            continue;
+
+        if (client->id == publisherId)
         {
-            if (!announceTopic(client.first, topic, pubuid))
+            if (!announceTopic(client->id, topic, pubuid))
                 ok = false;
         }
-        else if (isSubscribed(client.second->subscriptions, topic->name))
+        else if (isSubscribed(client, topic))
         {
-            if (isSelf(client.second))
+            if (isSelf(client))
             {
                 if (!announceTopicSelf(topic))
                     ok = false;
             }
             else
             {
-                if (!announceTopic(client.first, topic))
+                if (!announceTopic(client->id, topic))
                     ok = false;
             }
         }
@@ -1437,28 +1922,28 @@ bool NetworkTableInstance::announceCachedTopicsSelf()
     assert(networkMode == NetworkMode::Server);
     bool ok = true;
 
-    for (auto topic : topics)
+    for (Topic *topic : topicHandles)
     {
-        if (topic.second->properties.cached && isSubscribed(thisClient.subscriptions, topic.second->name))
+        if (topic->properties.cached && isSubscribed(&thisClient, topic))
         {
-            if (!announceTopicSelf(topic.second)) // announce topic if cached and subscribed
+            if (!announceTopicSelf(topic)) // announce topic if cached and subscribed
                 ok = false;
         }
     }
     return ok;
 }
 
-bool NetworkTableInstance::announceCachedTopics(const Guid &guid)
+bool NetworkTableInstance::announceCachedTopics(WsClientId clientId)
 {
     assert(networkMode == NetworkMode::Server);
     bool ok = true;
-    ClientData *client = clients[guid];
+    ClientData *client = clients[clientId];
     assert(client != nullptr);
-    for (auto topic : topics)
+    for (Topic *topic : topicHandles)
     {
-        if (topic.second->properties.cached && isSubscribed(client->subscriptions, topic.second->name))
+        if (topic->properties.cached && isSubscribed(client, topic))
         {
-            if (!announceTopic(guid, topic.second)) // announce topic if cached and subscribed
+            if (!announceTopic(clientId, topic)) // announce topic if cached and subscribed
                 ok = false;
         }
     }
@@ -1471,17 +1956,19 @@ bool NetworkTableInstance::unannounceTopic(const Topic *topic)
     bool ok = true;
     for (auto client : clients)
     {
-        assert(client.second != nullptr);
-        if (isSubscribed(client.second->subscriptions, topic->name))
+        if (client == nullptr)
+            continue;
+
+        if (isSubscribed(client, topic))
         {
-            if (isSelf(client.second))
+            if (isSelf(client))
             {
                 if (!unannounceTopicSelf(topic))
                     ok = false;
             }
             else
             {
-                if (!unannounceTopic(client.first, topic))
+                if (!unannounceTopic(client->id, topic))
                     ok = false;
             }
         }
@@ -1494,10 +1981,8 @@ bool NetworkTableInstance::sendTopicUpdateSelf(const Topic *topic, uint64_t time
     assert(networkMode == NetworkMode::Server);
     if (topicUpdateCallback)
     {
-        int64_t id = thisClient.topicData[topic->name].id;
-        NTDataValue value = NTDataValue(topic->value.getAPIType()); // empty value of API type
-        value.assign(topic->value);                                 // copy the data
-        return topicUpdateCallback(this, id, time, value, callbackArgs);
+        int64_t id = thisClient.getTopicData(topic->handle).id;
+        return topicUpdateCallback(this, id, time, topic->value, callbackArgs); // shares the snapshot, nothing is copied
     }
     return true;
 }
@@ -1507,33 +1992,264 @@ bool NetworkTableInstance::sendTopicUpdateSelf(const Topic *topic)
     return sendTopicUpdateSelf(topic, getServerTime());
 }
 
-bool NetworkTableInstance::sendTopicUpdate(const Guid &guid, const Topic *topic, uint64_t time)
+bool NetworkTableInstance::isUdpUpdate(ClientData *client, const Topic *topic)
 {
-    assert(networkMode == NetworkMode::Server);
+    // the initial value is always sent reliably over the WebSocket
+    return client->getTopicData(topic->handle).initialPublish && isUdpSubscribed(client, topic);
+}
 
-    auto packer = msgpack::Packer();
-    auto client = clients[guid];
-    assert(client != nullptr);
+void NetworkTableInstance::packTopicUpdate(ClientData *client, const Topic *topic, uint64_t time, bool udp, msgpack::Packer<false> &packer)
+{
+    ClientTopicData &data = client->getTopicData(topic->handle);
 
-    int64_t id = client->topicData[topic->name].id;
-    uint8_t _type = (uint8_t)topic->value.getAPIType();
-    packer.clear();
-    packer.pack_array_header(4);
+    int64_t id = data.id;
+    uint8_t _type = (uint8_t)topic->value->getAPIType();
+    packer.pack_array_header(udp ? 5 : 4);
     packer.process(id);
     packer.process(time);
     packer.process(_type);
-    topic->value.pack(packer);
-    client->topicData[topic->name].initialPublish = true;
+    topic->value->pack(packer);
+    if (udp)
+        packer.process(topic->sequence);
+    data.initialPublish = true;
+}
+
+void NetworkTableInstance::cacheTopicUpdate(ClientData *client, const std::vector<uint8_t> &bin, bool udp)
+{
+    if (udp)
+    {
+        flushUdp(client, bin.size());
+        client->udpCache.insert(std::end(client->udpCache), std::begin(bin), std::end(bin));
+    }
+    else
+    {
+        flushBinary(client, bin.size());
+        if (!client->binaryCache.append(bin.data(), bin.size()))
+        {
+            // nothing was written, the update is dropped
+            printf("[RADIO] Out of memory, dropped a value update to client %u\n", (unsigned int)client->id);
+        }
+    }
+}
+
+void NetworkTableInstance::setTopicValue(Topic *topic, NTDataValue &&value)
+{
+    // nobody else holds the snapshot, reuse it and its payload block
+    if (topic->value.unique())
+    {
+        topic->value.mutableValue().assign(std::move(value));
+        return;
+    }
+
+    const NTDataValue &current = *topic->value;
+    if (current.isValid())
+    {
+        if (current.getAPIType() != value.getAPIType()) // matching type is required
+            return;
+        value.type = current.type;
+    }
+    topic->value = NTValueSnapshot(std::move(value));
+}
+
+bool NetworkTableInstance::cacheTopicUpdateInPlace(ClientData *client, const Topic *topic, uint64_t time)
+{
+    WebSocketFrameBuffer &cache = client->binaryCache;
+    cache.reserve();
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        // an update may only go past the limit when it is alone in the frame
+        std::size_t room = cache.available();
+        if (!cache.empty())
+            room = std::min(room, cache.size() < cache.limit() ? cache.limit() - cache.size() : 0);
+        if (room == 0 && cache.empty())
+            return false;
+
+        msgpack::Packer packer(cache.tail(), room);
+        packTopicUpdate(client, topic, time, false, packer);
+        if (!packer.overflowed())
+        {
+            cache.commit(packer.size());
+            return true;
+        }
+        if (cache.empty())
+            return false;
+
+        // the update needs more than the room that was left, send the cached updates and retry
+        flushBinary(client, room + 1);
+    }
+    return false;
+}
+
+bool NetworkTableInstance::sendTopicUpdate(WsClientId clientId, const Topic *topic, uint64_t time)
+{
+    assert(networkMode == NetworkMode::Server);
+
+    auto client = clients[clientId];
+    assert(client != nullptr);
+
+    client->topicData[topic->handle].lastSentUs = to_us_since_boot(get_absolute_time());
+
+    bool udp = isUdpUpdate(client, topic);
+    if (!udp && cacheTopicUpdateInPlace(client, topic, time))
+        return true;
+
+    // UDP updates and updates larger than the frame buffer are packed separately
+    auto packer = msgpack::Packer();
+    packTopicUpdate(client, topic, time, udp, packer);
+    cacheTopicUpdate(client, packer.vector(), udp);
+    return true;
+}
+
+bool NetworkTableInstance::sendTopicUpdate(WsClientId clientId, const Topic *topic)
+{
+    return sendTopicUpdate(clientId, topic, getServerTime());
+}
 
-    auto bin = packer.vector();
-    flushBinary(client, bin.size());
-    client->binaryCache.insert(std::end(client->binaryCache), std::begin(bin), std::end(bin));
+bool NetworkTableInstance::scheduleTopicUpdate(ClientData *client, const Topic *topic, uint64_t time)
+{
+    ClientTopicData &data = client->getTopicData(topic->handle);
+    bool all;
+    uint32_t periodMs = getUpdatePeriod(client, topic, &all);
+    uint64_t now = to_us_since_boot(get_absolute_time());
+
+    // the first update after a quiet period goes out right away
+    if (!data.pending && now - data.lastSentUs >= (uint64_t)periodMs * 1000)
+        return sendTopicUpdate(client->id, topic, time);
+
+    // hold the update, the topic keeps the newest value until the period has passed
+    data.pendingTime = time;
+    // every change is kept for `all` subscriptions
+    if (all)
+        queueTopicUpdate(client, topic, time);
+    data.periodMs = periodMs;
+    if (!data.pending)
+    {
+        data.pending = true;
+        client->pendingTopics.push_back(topic->handle);
+
+        // wake the periodic update task if it sleeps past the due time of the update
+        uint64_t dueUs = data.lastSentUs + (uint64_t)periodMs * 1000;
+        TaskHandle_t task = periodicTask;
+        if (dueUs < periodicWakeUs && task != nullptr)
+        {
+            periodicWakeUs = dueUs;
+            xTaskNotifyGive(task);
+        }
+    }
     return true;
 }
 
-bool NetworkTableInstance::sendTopicUpdate(const Guid &guid, const Topic *topic)
+void NetworkTableInstance::queueTopicUpdate(ClientData *client, const Topic *topic, uint64_t time)
+{
+    ClientTopicData &data = client->getTopicData(topic->handle);
+    if (data.queue == nullptr)
+    {
+        data.queue = new ValueQueue();
+        data.queue->slots = new QueuedUpdate[NT_ALL_QUEUE_DEPTH];
+    }
+    ValueQueue *queue = data.queue;
+
+    QueuedUpdate update;
+    update.udp = isUdpUpdate(client, topic);
+    auto packer = msgpack::Packer();
+    packTopicUpdate(client, topic, time, update.udp, packer);
+    update.bin = packer.vector();
+
+    // drop the oldest updates of the topic while the queue is full, or while the client budget is
+    // full and the update fits once the topic's own updates make room for it
+    bool evict = client->queuedBytes - queue->bytes + update.bin.size() <= NT_CLIENT_QUEUE_BUDGET;
+    while (queue->count > 0 && (queue->count == NT_ALL_QUEUE_DEPTH || (evict && client->queuedBytes + update.bin.size() > NT_CLIENT_QUEUE_BUDGET)))
+    {
+        QueuedUpdate &oldest = queue->slots[queue->head];
+        client->queuedBytes -= oldest.bin.size();
+        queue->bytes -= oldest.bin.size();
+        oldest.bin = {};
+        queue->head = (queue->head + 1) % NT_ALL_QUEUE_DEPTH;
+        queue->count--;
+        data.overflowCount++;
+        client->overflowCount++;
+    }
+
+    // the budget is used up by other topics, the queued updates of the topic are kept and the
+    // newest value is sent from the topic after them
+    if (client->queuedBytes + update.bin.size() > NT_CLIENT_QUEUE_BUDGET)
+    {
+        queue->behind = true;
+        data.overflowCount++;
+        client->overflowCount++;
+        return;
+    }
+
+    client->queuedBytes += update.bin.size();
+    queue->bytes += update.bin.size();
+    queue->slots[(queue->head + queue->count) % NT_ALL_QUEUE_DEPTH] = std::move(update);
+    queue->count++;
+    queue->behind = false;
+}
+
+void NetworkTableInstance::drainQueue(ClientData *client, uint32_t handle)
+{
+    ClientTopicData &data = client->topicData[handle];
+    ValueQueue *queue = data.queue;
+
+    // in order, the binary cache is flushed into frames whenever it is full
+    while (queue->count > 0)
+    {
+        QueuedUpdate &update = queue->slots[queue->head];
+        cacheTopicUpdate(client, update.bin, update.udp);
+        client->queuedBytes -= update.bin.size();
+        queue->bytes -= update.bin.size();
+        update.bin = {};
+        queue->head = (queue->head + 1) % NT_ALL_QUEUE_DEPTH;
+        queue->count--;
+    }
+
+    if (queue->behind)
+    {
+        queue->behind = false;
+        sendTopicUpdate(client->id, topicHandles[handle], data.pendingTime);
+    }
+
+    data.lastSentUs = to_us_since_boot(get_absolute_time());
+}
+
+uint64_t NetworkTableInstance::sendPendingUpdates()
 {
-    return sendTopicUpdate(guid, topic, getServerTime());
+    uint64_t now = to_us_since_boot(get_absolute_time());
+    uint64_t nextDueUs = UINT64_MAX;
+
+    for (auto client : clients)
+    {
+        if (client == nullptr || isSelf(client) || client->pendingTopics.empty())
+            continue;
+
+        size_t kept = 0;
+        for (uint32_t handle : client->pendingTopics)
+        {
+            ClientTopicData &data = client->topicData[handle];
+            if (!data.pending)
+                continue;
+
+            if (now - data.lastSentUs >= (uint64_t)data.periodMs * 1000)
+            {
+                data.pending = false;
+                if (data.queue != nullptr && (data.queue->count > 0 || data.queue->behind))
+                    drainQueue(client, handle);
+                else
+                    sendTopicUpdate(client->id, topicHandles[handle], data.pendingTime);
+            }
+            else
+            {
+                client->pendingTopics[kept++] = handle;
+                nextDueUs = std::min(nextDueUs, data.lastSentUs + (uint64_t)data.periodMs * 1000);
+            }
+        }
+        client->pendingTopics.resize(kept);
+    }
+
+    flushBinary();
+    return nextDueUs;
 }
 
 bool NetworkTableInstance::sendTopicUpdate(const Topic *topic, uint64_t time)
@@ -1542,22 +2258,24 @@ bool NetworkTableInstance::sendTopicUpdate(const Topic *topic, uint64_t time)
 
     for (auto client : clients)
     {
-        assert(client.second != nullptr);
-        if (client.second->topicData.contains(topic->name))
+        if (client == nullptr)
+            continue;
+
+        if (client->isAnnounced(topic->handle))
         {
-            auto t = client.second->topicData[topic->name];
+            const ClientTopicData &t = client->topicData[topic->handle];
 
             // send updates for already published OR unpublished and only! subscribed-value topics
-            if (t.initialPublish || (!t.initialPublish && isSubscribed(client.second->subscriptions, topic->name, true /* requireNotTopicsOnly */)))
+            if (t.initialPublish || getValueSubscription(client, topic) != nullptr)
             {
-                if (isSelf(client.second))
+                if (isSelf(client))
                 {
                     if (!sendTopicUpdateSelf(topic, time))
                         return false;
                 }
                 else
                 {
-                    if (!sendTopicUpdate(client.first, topic, time))
+                    if (!scheduleTopicUpdate(client, topic, time))
                         return false;
                 }
             }
@@ -1574,7 +2292,7 @@ bool NetworkTableInstance::sendTopicUpdate(const Topic *topic)
 
 bool NetworkTableInstance::publishTopic(std::string name, NTDataValue value, TopicProperties properties)
 {
-    Topic *topic = getOrCreateTopic(name, value, properties);
+    Topic *topic = getOrCreateTopic(name, std::move(value), properties);
     if (!announceTopic(topic))
         return false;
 
@@ -1593,7 +2311,7 @@ bool NetworkTableInstance::publishTopic(std::string name, NTDataValue value, Top
 
 NetworkTableInstance::AnnouncedTopic NetworkTableInstance::publishTopicSelfSync(std::string name, NTDataValue value, TopicProperties properties, bool *out_success)
 {
-    Topic *topic = getOrCreateTopic(name, value, properties);
+    Topic *topic = getOrCreateTopic(name, std::move(value), properties);
     AnnouncedTopic t = {{}, -1, NTDataType::Bool, {}};
     *out_success = false;
 
@@ -1610,20 +2328,20 @@ NetworkTableInstance::AnnouncedTopic NetworkTableInstance::publishTopicSelfSync(
         updateTopicPubMetaTopic(name);
     }
 
-    int64_t id = thisClient.topicData[topic->name].id;
+    int64_t id = thisClient.getTopicData(topic->handle).id;
 
     *out_success = true;
     return {
         topic->name,
         id,
-        topic->value.type,
+        topic->value->type,
         topic->properties};
 }
 
-bool NetworkTableInstance::publishTopic(std::string name, NTDataValue value, const Guid &publisherGuid, int32_t pubuid, TopicProperties properties)
+bool NetworkTableInstance::publishTopic(std::string name, NTDataValue value, WsClientId publisherId, int32_t pubuid, TopicProperties properties)
 {
-    Topic *topic = getOrCreateTopic(name, value, properties);
-    if (!announceTopic(topic, publisherGuid, pubuid))
+    Topic *topic = getOrCreateTopic(name, std::move(value), properties);
+    if (!announceTopic(topic, publisherId, pubuid))
         return false;
 
     if (!name.starts_with('$'))
@@ -1645,17 +2363,19 @@ bool NetworkTableInstance::updateTopicProperties(const Topic *topic)
     bool ok = true;
     for (auto client : clients)
     {
-        assert(client.second != nullptr);
-        if (isSubscribed(client.second->subscriptions, topic->name))
+        if (client == nullptr)
+            continue;
+
+        if (isSubscribed(client, topic))
         {
-            if (isSelf(client.second))
+            if (isSelf(client))
             {
                 if (!sendPropertyUpdateSelf(topic))
                     ok = false;
             }
             else
             {
-                if (!sendPropertyUpdate(client.first, topic, false))
+                if (!sendPropertyUpdate(client->id, topic, false))
                     ok = false;
             }
         }
@@ -1663,22 +2383,25 @@ bool NetworkTableInstance::updateTopicProperties(const Topic *topic)
     return ok;
 }
 
-bool NetworkTableInstance::updateTopicProperties(const Topic *topic, const Guid &updaterGuid)
+bool NetworkTableInstance::updateTopicProperties(const Topic *topic, WsClientId updaterId)
 {
     assert(networkMode == NetworkMode::Server);
     bool ok = true;
     for (auto client : clients)
     {
-        if (isSubscribed(client.second->subscriptions, topic->name))
+        if (client == nullptr)
+            continue;
+
+        if (isSubscribed(client, topic))
         {
-            if (isSelf(client.second))
+            if (isSelf(client))
             {
                 if (!sendPropertyUpdateSelf(topic))
                     ok = false;
             }
             else
             {
-                if (!sendPropertyUpdate(client.first, topic, client.first == updaterGuid))
+                if (!sendPropertyUpdate(client->id, topic, client->id == updaterId))
                     ok = false;
             }
         }
@@ -1692,10 +2415,13 @@ size_t NetworkTableInstance::nextClientWithName(std::string_view name)
 
     for (auto client : clients)
     {
-        if (!isSelf(client.second) && client.second->name.starts_with(name) && client.second->name.find('@') == name.length())
+        if (client == nullptr)
+            continue;
+
+        if (!isSelf(client) && client->name.starts_with(name) && client->name.find('@') == name.length())
         {
             size_t i;
-            if (std::from_chars(client.second->name.data() + name.length() + 1, client.second->name.data() + client.second->name.size(), i).ec != std::errc::invalid_argument)
+            if (std::from_chars(client->name.data() + name.length() + 1, client->name.data() + client->name.size(), i).ec != std::errc::invalid_argument)
             {
                 num = std::max(num, i + 1);
             }
@@ -1705,29 +2431,51 @@ size_t NetworkTableInstance::nextClientWithName(std::string_view name)
     return num;
 }
 
+void NetworkTableInstance::removeClient(WsClientId clientId)
+{
+    ClientData *data = clients[clientId];
+    if (data == nullptr)
+        return;
+
+    clients[clientId] = nullptr;
+    for (auto &topic : data->topicData)
+        releaseQueue(data, topic);
+    for (auto o : data->subscriptions)
+    {
+        if (o.second != nullptr)
+            indexSubscription(data, o.second, false);
+        delete o.second;
+    }
+    for (auto o : data->publishers)
+        delete o.second;
+    delete data;
+}
+
 void NetworkTableInstance::publishInitialValuesSelf()
 {
-    for (auto topic : thisClient.topicData)
+    for (uint32_t handle = 0; handle < thisClient.topicData.size(); handle++)
     {
         // send updates for unpublished and only! subscribed-value topics
-        if (!topic.second.initialPublish && isSubscribed(thisClient.subscriptions, topic.first, true /* requireNotTopicsOnly */))
+        Topic *topic = topicHandles[handle];
+        if (thisClient.isAnnounced(handle) && !thisClient.topicData[handle].initialPublish && getValueSubscription(&thisClient, topic) != nullptr)
         {
-            sendTopicUpdateSelf(topics[topic.first]);
+            sendTopicUpdateSelf(topic);
         }
     }
 }
 
-void NetworkTableInstance::publishInitialValues(const Guid &guid)
+void NetworkTableInstance::publishInitialValues(WsClientId clientId)
 {
-    auto client = clients[guid];
+    auto client = clients[clientId];
     assert(client != nullptr);
 
-    for (auto topic : client->topicData)
+    for (uint32_t handle = 0; handle < client->topicData.size(); handle++)
     {
         // send updates for unpublished and only! subscribed-value topics
-        if (!topic.second.initialPublish && isSubscribed(client->subscriptions, topic.first, true /* requireNotTopicsOnly */))
+        Topic *topic = topicHandles[handle];
+        if (client->isAnnounced(handle) && !client->topicData[handle].initialPublish && getValueSubscription(client, topic) != nullptr)
         {
-            sendTopicUpdate(guid, topics[topic.first]);
+            sendTopicUpdate(clientId, topic);
         }
     }
 }
@@ -1747,9 +2495,19 @@ void NetworkTableInstance::stop()
     }
     case NetworkMode::Server:
     {
-        server->stop();
+        bindPending = false;
+        periodicRunning = false;
+        if (server->isListening())
+            server->stop();
         delete server;
         server = nullptr;
+        if (MdnsResponder::getDefault() != nullptr)
+            MdnsResponder::getDefault()->removeService(NT_MDNS_SERVICE);
+        if (udpSocket != nullptr)
+        {
+            delete udpSocket;
+            udpSocket = nullptr;
+        }
         break;
     }
     default:
@@ -1758,6 +2516,19 @@ void NetworkTableInstance::stop()
 
     networkMode = NetworkMode::Starting;
     xSemaphoreGive(stateMutex);
+
+    // wait for a pending bind and the periodic updates to notice the cancellation
+    TaskHandle_t task;
+    while ((task = periodicTask) != nullptr)
+    {
+        xTaskNotifyGive(task);
+        vTaskDelay(1);
+    }
+    while ((task = bindTask) != nullptr)
+    {
+        xTaskNotifyGive(task);
+        vTaskDelay(1);
+    }
 }
 
 void NetworkTableInstance::close()
@@ -1796,24 +2567,139 @@ uint64_t NetworkTableInstance::getServerTime()
         return get_absolute_time() - (uint64_t)(-serverTimeOffset);
 }
 
-void NetworkTableInstance::flushText(ClientData *client, std::size_t uncachedSize)
+void NetworkTableInstance::flushText(ClientData *client)
+{
+    WebSocketFrameBuffer &cache = client->textCache;
+    if (!cache.empty())
+    {
+        // without the closing bracket the array is not valid JSON, the messages are dropped
+        if (!cache.push_back(']'))
+        {
+            printf("[RADIO] Out of memory, dropped %u bytes of messages to client %u\n", (unsigned int)cache.size(), (unsigned int)client->id);
+            cache.clear();
+            return;
+        }
+        server->send(client->id, cache, cache.size(), WebSocketMessageType::Text);
+        cache.adapt(false);
+        cache.clear();
+    }
+}
+
+json::Packer<WebSocketFrameBuffer> NetworkTableInstance::beginText(ClientData *client, std::size_t *out_mark)
+{
+    client->textCache.reserve();
+    *out_mark = client->textCache.size();
+
+    json::Packer packer(client->textCache);
+    if (*out_mark == 0)
+        packer.pack_array(); // messages are encased in a json array
+    return packer;
+}
+
+void NetworkTableInstance::endText(ClientData *client, std::size_t mark)
+{
+    WebSocketFrameBuffer &cache = client->textCache;
+    if (cache.failed())
+    {
+        // the buffer could not grow, the message is partial and must not be sent
+        printf("[RADIO] Out of memory, dropped a message to client %u\n", (unsigned int)client->id);
+        cache.truncate(mark);
+        return;
+    }
+    if (mark <= 1 || cache.size() + 1 /* ']' */ <= cache.limit())
+        return;
+
+    // close the array at the separator before the new message and send the messages before it
+    cache.data()[mark] = ']';
+    server->send(client->id, cache, mark + 1, WebSocketMessageType::Text);
+    cache.adapt(true);
+    cache.erase(1, mark);
+}
+
+void NetworkTableInstance::flushBinary(ClientData *client)
 {
-    client->textCache.reserve(MAX_CLIENT_TEXT_CACHE_LENGTH);
-    if (client->textCache.length() > 0 && client->textCache.length() + uncachedSize + 2 /* '[' around ']' */ > MAX_CLIENT_TEXT_CACHE_LENGTH)
+    WebSocketFrameBuffer &cache = client->binaryCache;
+    if (!cache.empty())
     {
-        server->send(client->guid, "["s + client->textCache + "]"s /* encase messages in json array */);
-        client->textCache.clear();
+        server->send(client->id, cache, cache.size(), WebSocketMessageType::Binary);
+        cache.adapt(false);
+        cache.clear();
     }
 }
 
 void NetworkTableInstance::flushBinary(ClientData *client, std::size_t uncachedSize)
 {
-    client->binaryCache.reserve(MAX_CLIENT_BINARY_CACHE_LENGTH);
-    if (client->binaryCache.size() > 0 && client->binaryCache.size() + uncachedSize > MAX_CLIENT_BINARY_CACHE_LENGTH)
+    WebSocketFrameBuffer &cache = client->binaryCache;
+    cache.reserve();
+    if (!cache.empty() && cache.size() + uncachedSize > cache.limit())
+    {
+        server->send(client->id, cache, cache.size(), WebSocketMessageType::Binary);
+        cache.adapt(true);
+        cache.clear();
+    }
+}
+
+void NetworkTableInstance::flushUdp(ClientData *client, std::size_t uncachedSize)
+{
+    client->udpCache.reserve(MAX_CLIENT_UDP_CACHE_LENGTH);
+    if (client->udpCache.size() > 0 && client->udpCache.size() + uncachedSize > MAX_CLIENT_UDP_CACHE_LENGTH)
+    {
+        // updates are dropped on failure, UDP clients only use the latest value
+        Datagram datagram(client->udpCache.data(), client->udpCache.size(), &client->udpAddress, client->udpPort);
+        udpSocket->sendDatagram(&datagram);
+        client->udpCache.clear();
+    }
+}
+
+bool NetworkTableInstance::isUdpSubscribed(ClientData *client, const Topic *topic)
+{
+    if (udpSocket == nullptr || client->udpPort == 0 || topic->name.starts_with('$'))
+        return false;
+
+    Subscription *sub = getValueSubscription(client, topic);
+    return sub != nullptr && sub->options.udp > 0;
+}
+
+uint32_t NetworkTableInstance::getUpdatePeriod(ClientData *client, const Topic *topic, bool *out_all)
+{
+    bool found = false;
+    uint32_t periodMs = 0;
+    *out_all = false;
+
+    for (const auto &subscriber : getSubscribers(topic))
+    {
+        if (subscriber.client == client && !subscriber.subscription->options.topicsonly)
+        {
+            uint32_t period = (uint32_t)std::max(subscriber.subscription->options.periodic, (int32_t)0);
+            periodMs = found ? std::min(periodMs, period) : period;
+            found = true;
+            if (subscriber.subscription->options.all)
+                *out_all = true;
+        }
+    }
+
+    return periodMs;
+}
+
+NetworkTableInstance::Subscription *NetworkTableInstance::getValueSubscription(ClientData *client, const Topic *topic)
+{
+    Subscription *sub = nullptr;
+    isSubscribed(client, topic, true /* requireNotTopicsOnly */, &sub);
+    return sub;
+}
+
+void NetworkTableInstance::updateClientUdpEndpoint(ClientData *client)
+{
+    auto entry = server->getClient(client->id);
+    if (entry == nullptr || entry->guid != client->guid)
     {
-        server->send(client->guid, client->binaryCache);
-        client->binaryCache.clear();
+        client->udpPort = 0; // the client is gone
+        return;
     }
+
+    // UDP updates go to the address of the WebSocket connection
+    auto addr = entry->ws->getSocketAddress();
+    ip4_addr_set_u32(ip_2_ip4(&client->udpAddress), addr.sin_addr.s_addr);
 }
 
 struct ClientsMetaTopic
@@ -1831,9 +2717,9 @@ struct ClientsMetaTopic
 void NetworkTableInstance::updateClientsMetaTopic()
 {
     size_t clientCount = 0;
-    for (auto client : server->clients)
+    for (WsClientId id = 0; id < WS_SERVER_MAX_CLIENT_COUNT; id++)
     {
-        if (clients.contains(client->guid))
+        if (clients[id] != nullptr && server->getClient(id) != nullptr)
         {
             clientCount++;
         }
@@ -1841,20 +2727,21 @@ void NetworkTableInstance::updateClientsMetaTopic()
 
     auto packer = msgpack::Packer<true>();
     packer.pack_array_header(clientCount);
-    for (auto client : server->clients)
+    for (WsClientId id = 0; id < WS_SERVER_MAX_CLIENT_COUNT; id++)
     {
-        if (clients.contains(client->guid))
+        auto entry = server->getClient(id);
+        if (clients[id] != nullptr && entry != nullptr)
         {
-            auto addr = client->ws->getSocketAddress();
+            auto addr = entry->ws->getSocketAddress();
             std::string host = ip4addr_ntoa((ip4_addr_t *)&addr.sin_addr);
-            ClientsMetaTopic topic = {clients[client->guid]->name, host + ":"s + std::to_string(addr.sin_port)};
+            ClientsMetaTopic topic = {clients[id]->name, host + ":"s + std::to_string(addr.sin_port)};
             topic.pack(packer);
         }
     }
 
     auto t = topics["$clients"s];
     assert(t != nullptr);
-    t->value.bin = packer.vector();
+    setTopicValue(t, NTDataValue(NTDataType::Msgpack, packer.vector()));
     sendTopicUpdate(t);
 }
 
@@ -1869,7 +2756,7 @@ void NetworkTableInstance::updateServerSubMetaTopic()
 
     auto t = topics["$serversub"s];
     assert(t != nullptr);
-    t->value.bin = packer.vector();
+    setTopicValue(t, NTDataValue(NTDataType::Msgpack, packer.vector()));
     sendTopicUpdate(t);
 }
 
@@ -1884,14 +2771,14 @@ void NetworkTableInstance::updateServerPubMetaTopic()
 
     auto t = topics["$serverpub"s];
     assert(t != nullptr);
-    t->value.bin = packer.vector();
+    setTopicValue(t, NTDataValue(NTDataType::Msgpack, packer.vector()));
     sendTopicUpdate(t);
 }
 
-void NetworkTableInstance::updateClientSubMetaTopic(const Guid &guid)
+void NetworkTableInstance::updateClientSubMetaTopic(WsClientId clientId)
 {
     auto packer = msgpack::Packer<true>();
-    ClientData *client = clients[guid];
+    ClientData *client = clients[clientId];
 
     packer.pack_array_header(client->subscriptions.size());
     for (auto sub : client->subscriptions)
@@ -1901,14 +2788,14 @@ void NetworkTableInstance::updateClientSubMetaTopic(const Guid &guid)
 
     auto t = topics["$clientsub$"s + client->name];
     assert(t != nullptr);
-    t->value.bin = packer.vector();
+    setTopicValue(t, NTDataValue(NTDataType::Msgpack, packer.vector()));
     sendTopicUpdate(t);
 }
 
-void NetworkTableInstance::updateClientPubMetaTopic(const Guid &guid)
+void NetworkTableInstance::updateClientPubMetaTopic(WsClientId clientId)
 {
     auto packer = msgpack::Packer<true>();
-    ClientData *client = clients[guid];
+    ClientData *client = clients[clientId];
 
     packer.pack_array_header(client->publishers.size());
     for (auto pub : client->publishers)
@@ -1918,20 +2805,25 @@ void NetworkTableInstance::updateClientPubMetaTopic(const Guid &guid)
 
     auto t = topics["$clientpub$"s + client->name];
     assert(t != nullptr);
-    t->value.bin = packer.vector();
+    setTopicValue(t, NTDataValue(NTDataType::Msgpack, packer.vector()));
     sendTopicUpdate(t);
 }
 
 void NetworkTableInstance::updateTopicSubMetaTopic(std::string name)
 {
     std::vector<TopicSubscription> subs = {};
+    Topic *topic = findTopic(name);
+    assert(topic != nullptr);
 
     for (auto client : clients)
     {
+        if (client == nullptr)
+            continue;
+
         Subscription *sub;
-        if (!isSelf(client.second) && isSubscribed(client.second->subscriptions, name, false, &sub))
+        if (!isSelf(client) && isSubscribed(client, topic, false, &sub))
         {
-            subs.push_back(TopicSubscription(client.second->name, sub->uid, sub->options));
+            subs.push_back(TopicSubscription(client->name, sub->uid, sub->options));
         }
     }
 
@@ -1944,7 +2836,7 @@ void NetworkTableInstance::updateTopicSubMetaTopic(std::string name)
 
     auto t = topics["$sub$"s + name];
     assert(t != nullptr);
-    t->value.bin = packer.vector();
+    setTopicValue(t, NTDataValue(NTDataType::Msgpack, packer.vector()));
     sendTopicUpdate(t);
 }
 
@@ -1954,13 +2846,16 @@ void NetworkTableInstance::updateTopicPubMetaTopic(std::string name)
 
     for (auto client : clients)
     {
-        if (!isSelf(client.second))
+        if (client == nullptr)
+            continue;
+
+        if (!isSelf(client))
         {
-            for (auto pub : client.second->publishers)
+            for (auto pub : client->publishers)
             {
                 if (pub.second->topic == name)
                 {
-                    pubs.push_back(TopicPublisher(client.second->name, pub.second->uid));
+                    pubs.push_back(TopicPublisher(client->name, pub.second->uid));
                 }
             }
         }
@@ -1975,7 +2870,7 @@ void NetworkTableInstance::updateTopicPubMetaTopic(std::string name)
 
     auto t = topics["$pub$"s + name];
     assert(t != nullptr);
-    t->value.bin = packer.vector();
+    setTopicValue(t, NTDataValue(NTDataType::Msgpack, packer.vector()));
     sendTopicUpdate(t);
 }
 
@@ -1987,16 +2882,7 @@ void NetworkTableInstance::subscribe(std::vector<std::string> topics, int32_t su
     {
     case NetworkMode::Server:
     {
-        if (!thisClient.subscriptions[subuid])
-        {
-            thisClient.subscriptions[subuid] = new Subscription(subuid, topics, options);
-        }
-        else
-        {
-            thisClient.subscriptions[subuid]->uid = subuid;
-            thisClient.subscriptions[subuid]->topics = topics;
-            thisClient.subscriptions[subuid]->options = options;
-        }
+        setSubscription(&thisClient, subuid, topics, options);
 
         updateServerSubMetaTopic();
         announceCachedTopicsSelf();
@@ -2021,10 +2907,9 @@ void NetworkTableInstance::unsubscribe(int32_t subuid)
     {
     case NetworkMode::Server:
     {
-        auto sub = thisClient.subscriptions[subuid];
+        auto sub = takeSubscription(&thisClient, subuid);
         if (sub != nullptr)
         {
-            thisClient.subscriptions.erase(subuid);
             updateServerSubMetaTopic();
             delete sub;
         }
@@ -2061,15 +2946,18 @@ NetworkTableInstance::AnnouncedTopic NetworkTableInstance::publish(std::string n
         AnnouncedTopic topic = {{}, -1, NTDataType::Bool, {}};
         bool success;
 
-        if (!this->topics.contains(name))
+        Topic *top = findTopic(name);
+        if (top == nullptr)
         {
             topic = publishTopicSelfSync(name, NTDataValue(type), properties, &success);
+            top = findTopic(name);
         }
         else
         {
             // topic already published, just respond to client
-            topic = announceTopicSelfSync(this->topics[name], &success);
+            topic = announceTopicSelfSync(top, &success);
         }
+        thisClient.publishers[pubuid]->topicHandle = top->handle;
 
         updateServerPubMetaTopic();
         xSemaphoreGive(stateMutex);
@@ -2122,7 +3010,7 @@ NetworkTableInstance::TopicProperties NetworkTableInstance::setProperties(std::s
     {
     case NetworkMode::Server:
     {
-        auto top = this->topics[name];
+        auto top = findTopic(name);
 
         if (top != nullptr)
         {
@@ -2151,13 +3039,14 @@ void NetworkTableInstance::updateTopic(int32_t id, NTDataValue value, uint64_t t
     {
     case NetworkMode::Server:
     {
-        auto publisher = thisClient.publishers[id];
-        if (publisher != nullptr)
+        auto search = thisClient.publishers.find(id);
+        if (search != thisClient.publishers.end() && search->second != nullptr)
         {
-            auto topic = topics[publisher->topic];
+            auto topic = topicHandles[search->second->topicHandle];
             if (topic != nullptr)
             {
-                topic->value.assign(value);
+                setTopicValue(topic, std::move(value));
+                topic->sequence++;
                 sendTopicUpdate(topic, time);
             }
         }
@@ -2175,7 +3064,25 @@ void NetworkTableInstance::updateTopic(int32_t id, NTDataValue value, uint64_t t
 
 void NetworkTableInstance::updateTopic(int32_t id, NTDataValue value)
 {
-    updateTopic(id, value, getServerTime());
+    updateTopic(id, std::move(value), getServerTime());
+}
+
+uint32_t NetworkTableInstance::getQueueOverflowCount()
+{
+    if (!xSemaphoreTake(stateMutex, MUTEX_TIMEOUT))
+        return 0;
+
+    uint32_t count = 0;
+    if (networkMode == NetworkMode::Server)
+    {
+        for (auto client : clients)
+        {
+            if (client != nullptr)
+                count += client->overflowCount;
+        }
+    }
+    xSemaphoreGive(stateMutex);
+    return count;
 }
 
 void NetworkTableInstance::flush()
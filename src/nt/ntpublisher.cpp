@@ -25,7 +25,7 @@ NTPublisher::NTPublisher(NetworkTableInstance *nt, std::string topic, NTDataValu
                                                                                                           defaultValue.type,
                                                                                                           NetworkTableInstance::TopicProperties_DEFAULT))
 {
-    set(defaultValue);
+    set(std::move(defaultValue));
 }
 
 NTPublisher::NTPublisher(NetworkTableInstance *nt, std::string topic, NTDataValue defaultValue, uint64_t time) : nt(nt),
@@ -37,7 +37,7 @@ NTPublisher::NTPublisher(NetworkTableInstance *nt, std::string topic, NTDataValu
                                                                                                                          defaultValue.type,
                                                                                                                          NetworkTableInstance::TopicProperties_DEFAULT))
 {
-    set(defaultValue, time);
+    set(std::move(defaultValue), time);
 }
 
 NTPublisher::NTPublisher(NetworkTableInstance *nt, std::string topic, NTDataValue defaultValue, NetworkTableInstance::TopicProperties properties) : nt(nt),
@@ -49,7 +49,7 @@ NTPublisher::NTPublisher(NetworkTableInstance *nt, std::string topic, NTDataValu
                                                                                                                                                             defaultValue.type,
                                                                                                                                                             properties))
 {
-    set(defaultValue);
+    set(std::move(defaultValue));
 }
 
 NTPublisher::NTPublisher(NetworkTableInstance *nt, std::string topic, NTDataValue defaultValue, uint64_t time, NetworkTableInstance::TopicProperties properties) : nt(nt),
@@ -61,7 +61,7 @@ NTPublisher::NTPublisher(NetworkTableInstance *nt, std::string topic, NTDataValu
                                                                                                                                                                            defaultValue.type,
                                                                                                                                                                            properties))
 {
-    set(defaultValue, time);
+    set(std::move(defaultValue), time);
 }
 
 NTPublisher::~NTPublisher()
@@ -82,7 +82,7 @@ bool NTPublisher::set(NTDataValue value)
     if (topic.getType() != value.getAPIType())
         return false;
 
-    nt->updateTopic(pubuid, value);
+    nt->updateTopic(pubuid, std::move(value));
     return true;
 }
 
@@ -92,7 +92,7 @@ bool NTPublisher::set(NTDataValue value, uint64_t time)
     if (topic.getType() != value.getAPIType())
         return false;
 
-    nt->updateTopic(pubuid, value, time);
+    nt->updateTopic(pubuid, std::move(value), time);
     return true;
 }
 
@@ -25,13 +25,17 @@ struct TopicCallbackData
 
     struct UpdateData
     {
-        NTDataValue value = NTDataValue(NTDataType::Unassigned);
+        /// @brief Shared with the topic store, read by user tasks through `NTValueSnapshot::load`
+        NTValueSnapshot value = {};
         uint64_t timestamp;
     };
 
     std::unordered_map<int64_t, UpdateData> updates = {};
 };
 
+/// @brief Guards NT_topicCallbacks and the topics of the subscribers, the callbacks insert from the NT task while user tasks read
+/// @note Taken after the state mutex of the instance by the callbacks, user tasks never hold both
+static SemaphoreHandle_t NT_callbackMutex = NULL;
 static std::unordered_map<NetworkTableInstance *, TopicCallbackData> NT_topicCallbacks = {};
 
 static bool NT_topicAnnouncedCallback(
@@ -39,12 +43,14 @@ static bool NT_topicAnnouncedCallback(
     const NetworkTableInstance::AnnouncedTopic &topic,
     void *args)
 {
+    xSemaphoreTake(NT_callbackMutex, portMAX_DELAY);
     auto &queue = NT_topicCallbacks[nt].topics[topic.name].announce;
     while (!queue.empty())
     {
         queue.front()->_assignTopic(topic);
         queue.pop();
     }
+    xSemaphoreGive(NT_callbackMutex);
 
     return true;
 }
@@ -55,12 +61,14 @@ static bool NT_topicUnAnnouncedCallback(
     int64_t id,
     void *args)
 {
+    xSemaphoreTake(NT_callbackMutex, portMAX_DELAY);
     auto &queue = NT_topicCallbacks[nt].topics[name].unannounce;
     while (!queue.empty())
     {
         queue.front()->_unassignTopic();
         queue.pop();
     }
+    xSemaphoreGive(NT_callbackMutex);
 
     return true;
 }
@@ -69,13 +77,38 @@ static bool NT_topicUpdateCallback(
     NetworkTableInstance *nt,
     int64_t id,
     uint64_t timestamp,
-    const NTDataValue &value,
+    const NTValueSnapshot &value,
     void *args)
 {
-    NT_topicCallbacks[nt].updates[id] = {value, timestamp};
+    // only a reference is taken, the snapshot of the previous value is released once no reader holds it
+    xSemaphoreTake(NT_callbackMutex, portMAX_DELAY);
+    auto &update = NT_topicCallbacks[nt].updates[id];
+    NTValueSnapshot::store(update.value, value);
+    update.timestamp = timestamp;
+    xSemaphoreGive(NT_callbackMutex);
     return true;
 }
 
+/// @brief Returns the latest value of the topic of a subscriber, or an empty snapshot if none was received
+static NTValueSnapshot NT_loadValue(NetworkTableInstance *nt, const NTTopic &topic)
+{
+    NTValueSnapshot value = {};
+    xSemaphoreTake(NT_callbackMutex, portMAX_DELAY);
+    auto callbacks = NT_topicCallbacks.find(nt);
+    if (callbacks != NT_topicCallbacks.end())
+    {
+        // the topic is assigned by the announce callback, its id is read under the same mutex
+        auto search = callbacks->second.updates.find(topic.getId());
+        if (search != callbacks->second.updates.end())
+            value = NTValueSnapshot::load(search->second.value);
+    }
+    xSemaphoreGive(NT_callbackMutex);
+
+    if (!value || !value->isValid())
+        return {};
+    return value;
+}
+
 NTSubscriber::NTSubscriber() : nt(nullptr), topic(nullptr, ""s)
 {
 }
@@ -83,6 +116,25 @@ NTSubscriber::NTSubscriber() : nt(nullptr), topic(nullptr, ""s)
 NTSubscriber::NTSubscriber(NetworkTableInstance *nt, std::string topic) : nt(nt), topic(nt, topic)
 {
     assert(nt != nullptr);
+    if (!NT_callbackMutex)
+    {
+        // the first subscribers may be created by several tasks at once, only one mutex is kept
+        SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+        taskENTER_CRITICAL();
+        if (!NT_callbackMutex)
+        {
+            NT_callbackMutex = mutex;
+            mutex = NULL;
+        }
+        taskEXIT_CRITICAL();
+
+        if (mutex)
+        {
+            vSemaphoreDelete(mutex);
+        }
+    }
+
+    xSemaphoreTake(NT_callbackMutex, portMAX_DELAY);
     if (!NT_topicCallbacks.contains(nt))
     {
         NT_topicCallbacks[nt] = {
@@ -99,6 +151,7 @@ NTSubscriber::NTSubscriber(NetworkTableInstance *nt, std::string topic) : nt(nt)
 
     NT_topicCallbacks[nt].topics[topic].announce.push(this);
     NT_topicCallbacks[nt].topics[topic].unannounce.push(this);
+    xSemaphoreGive(NT_callbackMutex);
 
     nt->subscribe(
         {topic},
@@ -131,131 +184,139 @@ bool NTSubscriber::close()
 NTDataValue NTSubscriber::get()
 {
     assert(nt != nullptr);
-    auto &updates = NT_topicCallbacks[nt].updates;
-    if (!updates.contains(topic.getId()))
+    auto value = NT_loadValue(nt, topic);
+    if (!value)
     {
         return NTDataValue(NTDataType::Unassigned);
     }
 
-    return updates[topic.getId()].value;
+    NTDataValue copy = NTDataValue(value->getAPIType()); // empty value of API type
+    copy.assign(*value);                                 // copy the data
+    return copy;
+}
+
+NTValueSnapshot NTSubscriber::getSnapshot()
+{
+    assert(nt != nullptr);
+    return NT_loadValue(nt, topic);
 }
 
 bool NTSubscriber::getBoolean(bool defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.getAPIType() != NTDataType::Bool)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->getAPIType() != NTDataType::Bool)
         return defaultValue;
     else
-        return value.b;
+        return value->b;
 }
 
 double NTSubscriber::getDouble(double defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.getAPIType() != NTDataType::Float64)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->getAPIType() != NTDataType::Float64)
         return defaultValue;
     else
-        return value.f64;
+        return value->f64;
 }
 
 float NTSubscriber::getFloat(float defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.getAPIType() != NTDataType::Float32)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->getAPIType() != NTDataType::Float32)
         return defaultValue;
     else
-        return value.f32;
+        return value->f32;
 }
 
 int64_t NTSubscriber::getInt(int64_t defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.type != NTDataType::Int)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->getAPIType() != NTDataType::Int)
         return defaultValue;
     else
-        return value.i;
+        return value->i;
 }
 
 uint64_t NTSubscriber::getUInt(uint64_t defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.type != NTDataType::UInt)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->type != NTDataType::UInt)
         return defaultValue;
     else
-        return value.ui;
+        return value->ui;
 }
 
 std::string NTSubscriber::getString(std::string defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.getAPIType() != NTDataType::Str)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->getAPIType() != NTDataType::Str)
         return defaultValue;
     else
-        return value.str;
+        return std::string(value->str());
 }
 
 std::vector<bool> NTSubscriber::getBooleanArray(std::vector<bool> defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.getAPIType() != NTDataType::BoolArray)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->getAPIType() != NTDataType::BoolArray)
         return defaultValue;
     else
-        return value.bArray;
+        return value->bArray();
 }
 
 std::vector<double> NTSubscriber::getDoubleArray(std::vector<double> defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.getAPIType() != NTDataType::Float64Array)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->getAPIType() != NTDataType::Float64Array)
         return defaultValue;
     else
-        return value.f64Array;
+        return std::vector<double>(value->f64Array().begin(), value->f64Array().end());
 }
 
 std::vector<float> NTSubscriber::getFloatArray(std::vector<float> defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.getAPIType() != NTDataType::Float32Array)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->getAPIType() != NTDataType::Float32Array)
         return defaultValue;
     else
-        return value.f32Array;
+        return std::vector<float>(value->f32Array().begin(), value->f32Array().end());
 }
 
 std::vector<int64_t> NTSubscriber::getIntArray(std::vector<int64_t> defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.getAPIType() != NTDataType::IntArray)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->getAPIType() != NTDataType::IntArray)
         return defaultValue;
     else
-        return value.iArray;
+        return std::vector<int64_t>(value->iArray().begin(), value->iArray().end());
 }
 
 std::vector<std::string> NTSubscriber::getStringArray(std::vector<std::string> defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.getAPIType() != NTDataType::StrArray)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->getAPIType() != NTDataType::StrArray)
         return defaultValue;
     else
-        return value.strArray;
+        return value->strArray();
 }
 
 std::vector<uint8_t> NTSubscriber::getRaw(std::vector<uint8_t> defaultValue)
 {
     assert(nt != nullptr);
-    auto value = get();
-    if (!value.isValid() || value.getAPIType() != NTDataType::Bin)
+    auto value = NT_loadValue(nt, topic);
+    if (!value || value->getAPIType() != NTDataType::Bin)
         return defaultValue;
     else
-        return value.bin;
+        return std::vector<uint8_t>(value->bin().begin(), value->bin().end());
 }
\ No newline at end of file
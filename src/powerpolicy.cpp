@@ -0,0 +1,63 @@
+#include <algorithm>
+#include "powerpolicy.h"
+
+WifiPowerPolicy::WifiPowerPolicy(uint32_t latencyBudgetMs, uint32_t windowMs, uint32_t activeFrames, uint32_t idleTimeoutMs)
+    : latencyBudgetMs(latencyBudgetMs), windowMs(windowMs), activeFrames(activeFrames), idleTimeoutMs(idleTimeoutMs)
+{
+}
+
+WifiPowerMode WifiPowerPolicy::update(uint32_t nowMs, uint32_t frames)
+{
+    if (nowMs - windowStartMs >= windowMs)
+    {
+        windowStartMs = nowMs;
+        windowFrames = 0;
+    }
+    windowFrames += frames;
+
+    if (getListenBeacons() == 0)
+    {
+        // the latency budget does not allow power save
+        mode = WifiPowerMode::Performance;
+        lastActiveMs = nowMs;
+    }
+    else if (windowFrames >= activeFrames)
+    {
+        mode = WifiPowerMode::Performance;
+        lastActiveMs = nowMs;
+    }
+    else if (mode == WifiPowerMode::Performance && nowMs - lastActiveMs >= idleTimeoutMs)
+    {
+        mode = WifiPowerMode::PowerSave;
+    }
+
+    return mode;
+}
+
+void WifiPowerPolicy::reset(uint32_t nowMs)
+{
+    mode = WifiPowerMode::Performance;
+    windowStartMs = nowMs;
+    windowFrames = 0;
+    lastActiveMs = nowMs;
+}
+
+WifiPowerMode WifiPowerPolicy::getMode()
+{
+    return mode;
+}
+
+void WifiPowerPolicy::setLatencyBudget(uint32_t latencyBudgetMs)
+{
+    this->latencyBudgetMs = latencyBudgetMs;
+}
+
+uint32_t WifiPowerPolicy::getLatencyBudget()
+{
+    return latencyBudgetMs;
+}
+
+uint32_t WifiPowerPolicy::getListenBeacons()
+{
+    return std::min(latencyBudgetMs / POWER_POLICY_BEACON_INTERVAL_MS, POWER_POLICY_MAX_LISTEN_BEACONS);
+}
@@ -1,16 +1,24 @@
 #include <pico/stdlib.h>
 #include <pico/cyw43_arch.h>
+#include <hardware/watchdog.h>
 #include <FreeRTOS.h>
 #include <task.h>
 #include <string>
+#include <algorithm>
 #include <lwip/netif.h>
 #include <lwip/ip4_addr.h>
 #include <lwip/sockets.h>
 #include "radio.h"
+#include "wsserver.h"
+#include "channelscorer.h"
+#include "flashstore.h"
 #include "config.h"
 
 using namespace std::literals;
 
+// The power management value while traffic is flowing, no power save
+static constexpr uint32_t RADIO_PERFORMANCE_PM = CYW43_DEFAULT_PM & ~0xf;
+
 /// @brief Converts a lwip wifi status to a human-readable string
 static const char *status_name(int status)
 {
@@ -34,51 +42,95 @@ static const char *status_name(int status)
     return "unknown";
 }
 
-/// @brief Attempts to connect a wifi network with a timeout
-/// @param ssid The SSID of the network
-/// @param password The password of the network (empty for an open network)
-/// @param auth The auth level of the network
-/// @param until absolute timestamp for the timeout
-/// @return 0 on success, otherwise returns the status
-int wifi_connect_until(std::string_view ssid, std::string_view password, uint32_t auth, absolute_time_t until)
+/// @brief Returns the channel of an interface
+static uint32_t wifi_get_channel(int itf = CYW43_ITF_STA)
 {
-    // initiate the connection
-    int err = cyw43_wifi_join(&cyw43_state, ssid.length(), (const uint8_t *)ssid.data(), password.length(), (const uint8_t *)password.data(), auth, NULL, CYW43_CHANNEL_NONE);
-    if (err)
-        return err;
+    // channel info: hw, target and scan channel
+    uint8_t buf[12] = {0};
+    if (cyw43_ioctl(&cyw43_state, CYW43_IOCTL_GET_CHANNEL, sizeof(buf), buf, itf) != 0)
+        return CYW43_CHANNEL_NONE;
+
+    uint32_t channel;
+    memcpy(&channel, buf, sizeof(channel));
+    return channel;
+}
 
-    int status = CYW43_LINK_UP + 1;
-    while (status >= 0 && status != CYW43_LINK_UP) // continuously poll the wifi status until the timeout is hit or a connection is established
+#if PICO_RADIO_AP_CHANNEL_AUTO
+
+/// @brief Collects the networks of the channel scan, static because a timed out scan may still report results
+static ChannelScorer channel_scorer;
+
+static int channel_scan_result(void *env, const cyw43_ev_scan_result_t *result)
+{
+    ((ChannelScorer *)env)->add(result->bssid, result->channel, result->rssi);
+    return 0;
+}
+
+/// @brief Scans for networks and returns the least congested channel
+/// @note A warm boot uses the channel chosen by the last scan, stored in flash
+static uint32_t wifi_select_ap_channel()
+{
+    uint8_t cached;
+    if (watchdog_caused_reboot() && flash_store_read(FLASH_STORE_KEY_AP_CHANNEL, &cached, sizeof(cached)) &&
+        cached >= 1 && cached <= CHANNEL_SCORER_MAX_CHANNEL)
     {
-        int new_status = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
-        if (new_status != status)
-        {
-            status = new_status;
-            printf("[RADIO] Connect status: %s\n", status_name(status));
-            switch (status)
-            {
-            case CYW43_LINK_JOIN:
-            case CYW43_LINK_NOIP:
-                // pulse
-                break;
-            case CYW43_LINK_UP:
-                // on
-                break;
-            }
-        }
+        printf("[RADIO] Using cached channel %u\n", cached);
+        return cached;
+    }
 
-        if (time_reached(until))
-        {
-            return PICO_ERROR_TIMEOUT;
-        }
+    printf("[RADIO] Scanning for the least congested channel...\n");
+    channel_scorer.clear();
 
-        vTaskDelay(pdMS_TO_TICKS(100)); // prevent busy waiting and allow for dhcp retries
+    // scanning needs the station interface
+    cyw43_wifi_set_up(&cyw43_state, CYW43_ITF_STA, true, cyw43_arch_get_country_code());
+    cyw43_wifi_scan_options_t options = {0};
+    if (cyw43_wifi_scan(&cyw43_state, &options, &channel_scorer, channel_scan_result) == 0)
+    {
+        absolute_time_t until = make_timeout_time_ms(RADIO_CHANNEL_SCAN_TIMEOUT_MS);
+        while (cyw43_wifi_scan_active(&cyw43_state) && !time_reached(until))
+            vTaskDelay(pdMS_TO_TICKS(RADIO_JOIN_POLL_MS));
     }
-    return status == CYW43_LINK_UP ? 0 : status;
+    else
+    {
+        printf("[RADIO] Failed to start the channel scan\n");
+    }
+    cyw43_wifi_set_up(&cyw43_state, CYW43_ITF_STA, false, cyw43_arch_get_country_code());
+
+    int channel = channel_scorer.getBestChannel();
+    printf("[RADIO] Found %u networks, least congested channel %d (score %u)\n", channel_scorer.getNetworkCount(), channel, channel_scorer.getScore(channel));
+
+    uint8_t value = channel;
+    flash_store_write(FLASH_STORE_KEY_AP_CHANNEL, &value, sizeof(value));
+    return channel;
+}
+
+#endif
+
+/// @brief The radio that receives the netif callbacks
+static Radio *link_radio = nullptr;
+/// @brief The first created radio
+static Radio *default_radio = nullptr;
+
+/// @brief Returns the power management value of a power mode
+static uint32_t power_mode_pm(WifiPowerMode mode, uint32_t listenBeacons)
+{
+    if (mode == WifiPowerMode::Performance || listenBeacons == 0)
+        return RADIO_PERFORMANCE_PM;
+    // wake interval measured in beacons, announced to the access point as listen interval
+    return cyw43_pm_value(CYW43_PM2_POWERSAVE_MODE, RADIO_POWER_SAVE_SLEEP_RET_MS, listenBeacons, 0, listenBeacons);
 }
 
-Radio::Radio()
+Radio::Radio(bool waitForLink) : powerPolicy(PICO_RADIO_PM_LATENCY_BUDGET_MS)
 {
+    if (default_radio == nullptr)
+    {
+        default_radio = this;
+
+        // the frames of all WebSocket servers count as traffic for the power policy
+        ws_server_set_activity_callback([](uint32_t frames, void *args)
+                                        { ((Radio *)args)->notifyActivity(frames); }, this);
+    }
+
     printf("[RADIO] Initializing cyw43_arch (US)\n");
     if (cyw43_arch_init_with_country(CYW43_COUNTRY_USA))
     {
@@ -110,6 +162,17 @@ Radio::Radio()
 
 #endif
 
+#if PICO_RADIO_AP_CHANNEL_AUTO
+    uint32_t channel = wifi_select_ap_channel();
+#else
+    uint32_t channel = PICO_RADIO_AP_CHANNEL;
+#endif
+    if (channel != 0)
+    {
+        cyw43_wifi_ap_set_channel(&cyw43_state, channel);
+        printf("[RADIO] Set access point channel %u\n", channel);
+    }
+
     cyw43_wifi_set_up(&cyw43_state, CYW43_ITF_AP, true, cyw43_arch_get_country_code());
 
     ip4_addr_t local;
@@ -145,77 +208,361 @@ Radio::Radio()
     cyw43_arch_lwip_end();
 #endif
 
-    int retryCount = NET_RETRY_COUNT;
-    int connectResult = -1;
+#endif
+
+    cyw43_wifi_pm(&cyw43_state, RADIO_PERFORMANCE_PM);
+    printf("[RADIO] Wifi initialized!\n");
+
+#if PICO_RADIO_MDNS
+    mdns = new MdnsResponder(NET_HOSTNAME);
+#endif
+
+    initialized = true;
+    start();
+
+    if (waitForLink && !waitForLinkUp(UINT32_MAX))
+    {
+        printf("[RADIO] Failed to connect\n");
+        deinit();
+    }
+}
+
+Radio::~Radio()
+{
+    deinit();
+}
+
+void Radio::start()
+{
+    // a failed link can be started again
+    if (!initialized || (linkRunning && linkState != RadioLinkState::Failed))
+        return;
+
+#if WIFI_ACCESS_POINT
+
+    // the access point is up as soon as it is created
+    linkRunning = true;
+    linkState = RadioLinkState::Up;
+
+#else
+
+    linkRunning = true;
+    linkState = RadioLinkState::Down;
+    link_radio = this;
+
+    cyw43_arch_lwip_begin();
+    netif_set_link_callback(netif_default, netifCallback);
+    netif_set_status_callback(netif_default, netifCallback);
+    cyw43_arch_lwip_end();
+
+    // the handle is set before the task runs, so it can clear it when it ends
+    xTaskCreate([](void *ins) -> void
+                { ((Radio *)ins)->runLink(); vTaskDelete(NULL); },
+                "radio_link", configMINIMAL_STACK_SIZE * 2, this, 2, (TaskHandle_t *)&linkTask);
+
+#endif
+}
+
+void Radio::netifCallback(struct netif *netif)
+{
+    (void)netif;
+    // wake the link task instead of waiting for the next poll
+    Radio *radio = link_radio;
+    TaskHandle_t task = radio != nullptr ? radio->linkTask : nullptr;
+    if (task != nullptr)
+        xTaskNotifyGive(task);
+}
+
+int Radio::join(bool fast)
+{
+    linkState = RadioLinkState::Joining;
 
 #if !PICO_RADIO_OPEN
 
     char censoredPassword[WIFI_PASSWORD.length()];
     memset(censoredPassword, '*', WIFI_PASSWORD.length());
 
-    while (retryCount > 0 || retryCount == -1)
-    {
-        printf("[RADIO] Connecting to encrypted wifi '%.*s' / '%.*s'... (30 sec)\n", WIFI_SSID.length(), WIFI_SSID.data(), WIFI_PASSWORD.length(), censoredPassword);
-        connectResult = wifi_connect_until(WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK, make_timeout_time_ms(300000));
+    printf("[RADIO] Connecting to encrypted wifi '%.*s' / '%.*s'...%s\n", WIFI_SSID.length(), WIFI_SSID.data(), WIFI_PASSWORD.length(), censoredPassword, fast ? " (fast reconnect)" : "");
+    auto password = WIFI_PASSWORD;
+    uint32_t auth = CYW43_AUTH_WPA2_AES_PSK;
 
-        if (connectResult == 0)
-            break;
+#else
+
+    printf("[RADIO] Connecting to open wifi '%.*s'...%s\n", WIFI_SSID.length(), WIFI_SSID.data(), fast ? " (fast reconnect)" : "");
+    auto password = ""sv;
+    uint32_t auth = CYW43_AUTH_OPEN;
 
-        printf("[RADIO] Failed to connect: %i\n", connectResult);
-        printf("[RADIO] Retrying in 5 seconds...\n");
-        vTaskDelay(pdMS_TO_TICKS(5000));
+#endif
+
+    // a known BSSID and channel skips the scan
+    int err = cyw43_wifi_join(&cyw43_state, WIFI_SSID.length(), (const uint8_t *)WIFI_SSID.data(), password.length(), (const uint8_t *)password.data(), auth,
+                              fast ? lastBssid : NULL, fast ? lastChannel : CYW43_CHANNEL_NONE);
+    if (err)
+        return err < 0 ? err : CYW43_LINK_FAIL;
 
-        if (retryCount > 0)
-            retryCount--;
+    absolute_time_t until = make_timeout_time_ms(fast ? RADIO_FAST_JOIN_TIMEOUT_MS : RADIO_JOIN_TIMEOUT_MS);
+    int status = CYW43_LINK_UP + 1;
+    while (linkRunning)
+    {
+        int newStatus = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+        if (newStatus != status)
+        {
+            status = newStatus;
+            printf("[RADIO] Connect status: %s\n", status_name(status));
+        }
+
+        if (status == CYW43_LINK_UP || status < 0)
+            return status;
+        if (time_reached(until))
+            return PICO_ERROR_TIMEOUT;
+
+        // woken early by the netif callbacks, polling catches join failures and allows for dhcp retries
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RADIO_JOIN_POLL_MS));
     }
+    return CYW43_LINK_DOWN;
+}
 
-#else
+int Radio::waitForLinkDown()
+{
+    // a new link starts awake
+    powerPolicy.reset(to_ms_since_boot(get_absolute_time()));
+    updatePowerMode(true);
 
-    while (retryCount > 0 || retryCount == -1)
+    while (linkRunning)
     {
-        printf("[RADIO] Connecting to open wifi '%.*s'... (30 sec)\n", WIFI_SSID.length(), WIFI_SSID.data());
-        connectResult = wifi_connect_until(WIFI_SSID, ""sv, CYW43_AUTH_OPEN, make_timeout_time_ms(300000));
+        // woken by activity while in power save, otherwise the idle time is checked every period
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RADIO_LINK_CHECK_MS));
+        updatePowerMode(false);
+
+        int status = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+        if (status != CYW43_LINK_UP)
+            return status;
+    }
+    return CYW43_LINK_DOWN;
+}
+
+void Radio::runLink()
+{
+    int retryCount = NET_RETRY_COUNT;
+    uint32_t backoffMs = RADIO_BACKOFF_MIN_MS;
+    absolute_time_t outageStart = get_absolute_time();
+    bool fast = false;
 
-        if (connectResult == 0)
+    while (linkRunning)
+    {
+        int status = join(fast);
+        if (!linkRunning)
             break;
 
-        printf("[RADIO] Failed to connect: %i\n", connectResult);
-        printf("[RADIO] Retrying in 5 seconds...\n");
-        vTaskDelay(pdMS_TO_TICKS(5000));
+        if (status == CYW43_LINK_UP)
+        {
+            linkUpTimeMs = absolute_time_diff_us(outageStart, get_absolute_time()) / 1000;
+            hasLastBssid = cyw43_wifi_get_bssid(&cyw43_state, lastBssid) == 0;
+            lastChannel = wifi_get_channel();
+            linkState = RadioLinkState::Up;
+            printf("[RADIO] Link up after %u ms\n", linkUpTimeMs);
+
+            if (mdns != nullptr)
+                mdns->announce();
+            for (int i = 0; i < linkUp.Count(); i++)
+                linkUp.Get(i)(this, linkUpTimeMs, callbackArgs);
+
+            status = waitForLinkDown();
+            if (!linkRunning)
+                break;
+
+            printf("[RADIO] Link lost: %s\n", status_name(status));
+            linkState = RadioLinkState::Down;
+            for (int i = 0; i < linkDown.Count(); i++)
+                linkDown.Get(i)(this, status, callbackArgs);
+
+            // rejoin right away, trying the last access point first
+            retryCount = NET_RETRY_COUNT;
+            backoffMs = RADIO_BACKOFF_MIN_MS;
+            outageStart = get_absolute_time();
+            fast = hasLastBssid && lastChannel != CYW43_CHANNEL_NONE;
+            continue;
+        }
+
+        printf("[RADIO] Failed to connect: %i\n", status);
+        cyw43_wifi_leave(&cyw43_state, CYW43_ITF_STA);
+        linkState = RadioLinkState::Down;
+
+        if (fast)
+        {
+            // the access point moved, fall back to a full scan
+            fast = false;
+            continue;
+        }
+
+        if (retryCount > 0 && --retryCount == 0)
+        {
+            linkState = RadioLinkState::Failed;
+            break;
+        }
 
-        if (retryCount > 0)
-            retryCount--;
+        printf("[RADIO] Retrying in %u ms...\n", backoffMs);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(backoffMs));
+        backoffMs = std::min(backoffMs * 2, RADIO_BACKOFF_MAX_MS);
     }
 
-#endif
+    linkTask = nullptr;
+}
 
-    if (connectResult != 0)
-    {
-        printf("[RADIO] Failed to connect: %i\n", connectResult);
-        cyw43_arch_deinit();
-        initialized = false;
+void Radio::updatePowerMode(bool force)
+{
+    uint32_t frames = activityFrames.load(std::memory_order_relaxed);
+    WifiPowerMode mode = powerPolicy.update(to_ms_since_boot(get_absolute_time()), frames - lastActivityFrames);
+    lastActivityFrames = frames;
+
+    if (mode == powerMode && !force)
         return;
-    }
 
+    powerMode = mode;
+    cyw43_wifi_pm(&cyw43_state, power_mode_pm(mode, powerPolicy.getListenBeacons()));
+    printf("[RADIO] Power mode: %s\n", mode == WifiPowerMode::PowerSave ? "power save" : "performance");
+}
+
+void Radio::notifyActivity(uint32_t frames)
+{
+    activityFrames.fetch_add(frames, std::memory_order_relaxed);
+
+    // only wake the link task when the radio has to leave power save
+    TaskHandle_t task = linkTask;
+    if (powerMode == WifiPowerMode::PowerSave && task != nullptr)
+        xTaskNotifyGive(task);
+}
+
+void Radio::setLatencyBudget(uint32_t latencyBudgetMs)
+{
+    powerPolicy.setLatencyBudget(latencyBudgetMs);
+
+    TaskHandle_t task = linkTask;
+    if (task != nullptr)
+        xTaskNotifyGive(task);
+}
+
+WifiPowerMode Radio::getPowerMode()
+{
+    return powerMode;
+}
+
+bool Radio::getRssi(int32_t *out_rssi)
+{
+#if WIFI_ACCESS_POINT
+    return false;
+#else
+    if (linkState != RadioLinkState::Up)
+        return false;
+    return cyw43_wifi_get_rssi(&cyw43_state, out_rssi) == 0;
 #endif
+}
 
-    cyw43_wifi_pm(&cyw43_state, CYW43_DEFAULT_PM & ~0xf);
-    printf("[RADIO] Wifi initialized!\n");
+int Radio::getLinkStatus()
+{
+    if (!initialized)
+        return CYW43_LINK_DOWN;
+#if WIFI_ACCESS_POINT
+    return cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_AP);
+#else
+    return cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+#endif
+}
 
-    initialized = true;
+int Radio::getChannel()
+{
+    if (!initialized)
+        return -1;
+#if WIFI_ACCESS_POINT
+    uint32_t channel = wifi_get_channel(CYW43_ITF_AP);
+#else
+    if (linkState != RadioLinkState::Up)
+        return -1;
+    uint32_t channel = wifi_get_channel(CYW43_ITF_STA);
+#endif
+    return channel == CYW43_CHANNEL_NONE ? -1 : (int)channel;
 }
 
-Radio::~Radio()
+int Radio::getStationCount()
 {
-    if (initialized)
+#if WIFI_ACCESS_POINT
+    if (!initialized)
+        return -1;
+    int count = 0;
+    // without a buffer only the number of stations is returned
+    if (cyw43_wifi_ap_get_stas(&cyw43_state, &count, NULL) != 0)
+        return -1;
+    return count;
+#else
+    return -1;
+#endif
+}
+
+Radio *Radio::getDefault()
+{
+    return default_radio;
+}
+
+bool Radio::isLinkUp()
+{
+    return linkState == RadioLinkState::Up;
+}
+
+RadioLinkState Radio::getLinkState()
+{
+    return linkState;
+}
+
+bool Radio::waitForLinkUp(uint32_t timeoutMs)
+{
+    absolute_time_t until = make_timeout_time_ms(timeoutMs);
+    while (linkState != RadioLinkState::Up)
     {
-        cyw43_arch_deinit();
-        initialized = false;
+        if (linkState == RadioLinkState::Failed || !linkRunning || time_reached(until))
+            return false;
+        vTaskDelay(pdMS_TO_TICKS(RADIO_JOIN_POLL_MS));
     }
+    return true;
+}
+
+uint32_t Radio::getLinkUpTime()
+{
+    return linkUpTimeMs;
 }
 
 void Radio::deinit()
 {
+    if (linkRunning)
+    {
+        linkRunning = false;
+        TaskHandle_t task;
+        while ((task = linkTask) != nullptr)
+        {
+            xTaskNotifyGive(task);
+            vTaskDelay(1);
+        }
+
+#if !WIFI_ACCESS_POINT
+        cyw43_arch_lwip_begin();
+        netif_set_link_callback(netif_default, NULL);
+        netif_set_status_callback(netif_default, NULL);
+        cyw43_arch_lwip_end();
+        link_radio = nullptr;
+#endif
+    }
+
+    if (default_radio == this)
+    {
+        ws_server_set_activity_callback(nullptr, nullptr);
+        default_radio = nullptr;
+    }
+
+    if (mdns != nullptr)
+    {
+        delete mdns;
+        mdns = nullptr;
+    }
+
     if (initialized)
     {
         cyw43_arch_deinit();
@@ -226,4 +573,9 @@ void Radio::deinit()
 bool Radio::isInitialized()
 {
     return initialized;
+}
+
+MdnsResponder *Radio::getMdnsResponder()
+{
+    return mdns;
 }
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include <pico/stdlib.h>
+#include <string>
+#include "radiotelemetry.h"
+
+using namespace std::literals;
+
+static constexpr NetworkTableInstance::TopicProperties TELEMETRY_PROPERTIES = {
+    false, true, true};
+
+RadioTelemetry::RadioTelemetry(Radio *radio, NetworkTableInstance *nt, uint32_t periodMs) : radio(radio), nt(nt), periodMs(periodMs), running(true)
+{
+    // the topics are announced by the first sample, with a real value and only in the mode they apply to
+    sample();
+
+    // the handle is set before the task runs, so it can clear it when it ends
+    xTaskCreate([](void *ins) -> void
+                { ((RadioTelemetry *)ins)->run(); vTaskDelete(NULL); },
+                "radio_telemetry", configMINIMAL_STACK_SIZE * 2, this, 1, (TaskHandle_t *)&task);
+}
+
+RadioTelemetry::~RadioTelemetry()
+{
+    running = false;
+    TaskHandle_t t;
+    while ((t = task) != nullptr)
+    {
+        xTaskNotifyGive(t);
+        vTaskDelay(1);
+    }
+
+    for (Value *value : {&rssi, &linkStatus, &channel, &stations, &powerSave, &linkUpTime})
+    {
+        delete value->publisher;
+        value->publisher = nullptr;
+    }
+}
+
+void RadioTelemetry::setPeriod(uint32_t periodMs)
+{
+    this->periodMs = periodMs;
+}
+
+bool RadioTelemetry::set(Value &value, int64_t current)
+{
+    if (value.publisher == nullptr)
+    {
+        value.publisher = new NTPublisher(nt, std::string(value.name), NTDataValue(current), TELEMETRY_PROPERTIES);
+    }
+    else
+    {
+        if (value.last == current)
+            return false;
+
+        value.publisher->setInt(current);
+    }
+
+    value.last = current;
+    return true;
+}
+
+void RadioTelemetry::sample()
+{
+    bool changed = false;
+
+    int32_t rssiValue;
+    if (radio->getRssi(&rssiValue))
+        changed |= set(rssi, rssiValue);
+
+    changed |= set(linkStatus, radio->getLinkStatus());
+    changed |= set(channel, radio->getChannel());
+
+    int stationCount = radio->getStationCount();
+    if (stationCount >= 0)
+        changed |= set(stations, stationCount);
+
+    changed |= set(powerSave, radio->getPowerMode() == WifiPowerMode::PowerSave);
+    changed |= set(linkUpTime, radio->getLinkUpTime());
+
+    if (changed)
+        nt->flush();
+}
+
+void RadioTelemetry::run()
+{
+    while (running)
+    {
+        sample();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(periodMs));
+    }
+
+    task = nullptr;
+}
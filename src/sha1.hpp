@@ -23,26 +23,35 @@
 #define SHA1_HPP
 
 #include <cstdint>
+#include <cstring>
 #include <string>
-#include <lwip/ip4_addr.h>
+#include <string_view>
+#include <algorithm>
+
+static constexpr size_t BLOCK_INTS = 16; /* number of 32bit integers per SHA1 block */
+static constexpr size_t BLOCK_BYTES = BLOCK_INTS * 4;
+static constexpr size_t SHA1_DIGEST_BYTES = 20;
+
+/*
+ * A SHA1 context without allocations, cheap enough to live on the stack of every caller
+ */
 
 class SHA1
 {
 public:
     SHA1();
-    void update(const std::string &s);
-    std::string final();
+    void update(const uint8_t *data, size_t length);
+    void update(std::string_view s);
+    void final(uint8_t out_digest[SHA1_DIGEST_BYTES]);
 
 private:
     uint32_t digest[5];
-    std::string buffer;
+    uint8_t buffer[BLOCK_BYTES];
+    size_t bufferLength;
     uint64_t transforms;
 };
 
-static constexpr size_t BLOCK_INTS = 16; /* number of 32bit integers per SHA1 block */
-static constexpr size_t BLOCK_BYTES = BLOCK_INTS * 4;
-
-inline static void reset(uint32_t digest[], std::string &buffer, uint64_t &transforms)
+inline static void reset(uint32_t digest[], size_t &bufferLength, uint64_t &transforms)
 {
     /* SHA1 initialization constants */
     digest[0] = 0x67452301;
@@ -52,7 +61,7 @@ inline static void reset(uint32_t digest[], std::string &buffer, uint64_t &trans
     digest[4] = 0xc3d2e1f0;
 
     /* Reset counters */
-    buffer = "";
+    bufferLength = 0;
     transforms = 0;
 }
 
@@ -210,41 +219,45 @@ inline static void transform(uint32_t digest[], uint32_t block[BLOCK_INTS], uint
     transforms++;
 }
 
-inline static void buffer_to_block(const std::string &buffer, uint32_t block[BLOCK_INTS])
+inline static void buffer_to_block(const uint8_t buffer[BLOCK_BYTES], uint32_t block[BLOCK_INTS])
 {
-    /* Convert the std::string (byte buffer) to a uint32_t array (MSB) */
+    /* Convert the byte buffer to a uint32_t array (MSB) */
     for (size_t i = 0; i < BLOCK_INTS; i++)
     {
-        block[i] = (buffer[4 * i + 3] & 0xff) | (buffer[4 * i + 2] & 0xff) << 8 | (buffer[4 * i + 1] & 0xff) << 16 | (buffer[4 * i + 0] & 0xff) << 24;
+        block[i] = buffer[4 * i + 3] | buffer[4 * i + 2] << 8 | buffer[4 * i + 1] << 16 | (uint32_t)buffer[4 * i + 0] << 24;
     }
 }
 
 inline SHA1::SHA1()
 {
-    reset(digest, buffer, transforms);
+    reset(digest, bufferLength, transforms);
 }
 
-inline void SHA1::update(const std::string &s)
+inline void SHA1::update(const uint8_t *data, size_t length)
 {
-    size_t pos = 0;
-    while (true)
+    while (length > 0)
     {
-        char sbuf[BLOCK_BYTES];
-        size_t len = BLOCK_BYTES - buffer.size();
-        size_t actualLen = s.copy(sbuf, len, pos);
-        pos += actualLen;
-        buffer.append(sbuf, actualLen);
-        if (buffer.size() != BLOCK_BYTES)
+        size_t len = std::min(BLOCK_BYTES - bufferLength, length);
+        memcpy(buffer + bufferLength, data, len);
+        bufferLength += len;
+        data += len;
+        length -= len;
+        if (bufferLength != BLOCK_BYTES)
         {
             return;
         }
         uint32_t block[BLOCK_INTS];
         buffer_to_block(buffer, block);
         transform(digest, block, transforms);
-        buffer.clear();
+        bufferLength = 0;
     }
 }
 
+inline void SHA1::update(std::string_view s)
+{
+    update((const uint8_t *)s.data(), s.size());
+}
+
 /**
  * The MIT License (MIT)
  * Copyright (c) 2016-2024 tomykaira
@@ -268,7 +281,13 @@ inline void SHA1::update(const std::string &s)
  * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
-static std::string base64_encode(const uint8_t *data, size_t in_len)
+static constexpr size_t base64_length(size_t in_len)
+{
+    return 4 * ((in_len + 2) / 3);
+}
+
+/* Writes base64_length(in_len) characters to out, without a null terminator */
+static size_t base64_encode(const uint8_t *data, size_t in_len, char *out)
 {
     static constexpr char sEncodingTable[] = {
         'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
@@ -277,10 +296,8 @@ static std::string base64_encode(const uint8_t *data, size_t in_len)
         'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
         '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'};
 
-    size_t out_len = 4 * ((in_len + 2) / 3);
-    std::string ret(out_len, '\0');
     size_t i;
-    char *p = const_cast<char *>(ret.c_str());
+    char *p = out;
 
     for (i = 0; in_len > 2 && i < in_len - 2; i += 3)
     {
@@ -308,6 +325,13 @@ static std::string base64_encode(const uint8_t *data, size_t in_len)
         *p++ = '=';
     }
 
+    return p - out;
+}
+
+static std::string base64_encode(const uint8_t *data, size_t in_len)
+{
+    std::string ret(base64_length(in_len), '\0');
+    base64_encode(data, in_len, ret.data());
     return ret;
 }
 
@@ -315,18 +339,15 @@ static std::string base64_encode(const uint8_t *data, size_t in_len)
  * Add padding and return the message digest.
  */
 
-inline std::string SHA1::final()
+inline void SHA1::final(uint8_t out_digest[SHA1_DIGEST_BYTES])
 {
     /* Total number of hashed bits */
-    uint64_t total_bits = (transforms * BLOCK_BYTES + buffer.size()) * 8;
+    uint64_t total_bits = (transforms * BLOCK_BYTES + bufferLength) * 8;
 
     /* Padding */
-    buffer += (char)0x80;
-    size_t orig_size = buffer.size();
-    while (buffer.size() < BLOCK_BYTES)
-    {
-        buffer += (char)0x00;
-    }
+    buffer[bufferLength++] = 0x80;
+    size_t orig_size = bufferLength;
+    memset(buffer + bufferLength, 0, BLOCK_BYTES - bufferLength);
 
     uint32_t block[BLOCK_INTS];
     buffer_to_block(buffer, block);
@@ -345,19 +366,17 @@ inline std::string SHA1::final()
     block[BLOCK_INTS - 2] = (uint32_t)(total_bits >> 32);
     transform(digest, block, transforms);
 
-    /* base64 std::string */
-    // prepare for network transfer
-    digest[0] = htonl(digest[0]);
-    digest[1] = htonl(digest[1]);
-    digest[2] = htonl(digest[2]);
-    digest[3] = htonl(digest[3]);
-    digest[4] = htonl(digest[4]);
-    std::string result = base64_encode((uint8_t *)digest, sizeof(digest));
+    /* Big endian digest, ready for network transfer */
+    for (size_t i = 0; i < 5; i++)
+    {
+        out_digest[4 * i + 0] = digest[i] >> 24;
+        out_digest[4 * i + 1] = digest[i] >> 16;
+        out_digest[4 * i + 2] = digest[i] >> 8;
+        out_digest[4 * i + 3] = digest[i];
+    }
 
     /* Reset for next run */
-    reset(digest, buffer, transforms);
-
-    return result;
+    reset(digest, bufferLength, transforms);
 }
 
 #endif /* SHA1_HPP */
\ No newline at end of file
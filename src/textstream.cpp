@@ -1,5 +1,7 @@
 #include <pico/stdlib.h>
 #include <string>
+#include <cstring>
+#include <algorithm>
 #include <FreeRTOS.h>
 #include "textstream.h"
 #include "tcpclient.h"
@@ -10,8 +12,13 @@ TextStream::TextStream(TcpClient *source) : TextStream(source, DEFAULT_TEXTSTREA
 {
 }
 
-TextStream::TextStream(TcpClient *source, size_t bufferSize) : source(source), bufferSize(bufferSize)
+TextStream::TextStream(TcpClient *source, size_t bufferSize) : TextStream(source, bufferSize, bufferSize)
 {
+}
+
+TextStream::TextStream(TcpClient *source, size_t bufferSize, size_t maxLineLength) : source(source), bufferSize(bufferSize), maxLineLength(maxLineLength)
+{
+    assert(maxLineLength > 0 && maxLineLength <= bufferSize);
     buffer = (uint8_t *)pvPortMalloc(bufferSize);
     assert(buffer != nullptr);
 }
@@ -21,90 +28,141 @@ TextStream::~TextStream()
     vPortFree(buffer);
 }
 
-/// @brief Shifts the data in a buffer
-/// @param buf The buffer
+/// @brief Finds the first CR or LF in a buffer
+/// @param buf The buffer to search
 /// @param len The length of the buffer
-/// @param shift A signed offset to shift the data by
-void shift_buffer(uint8_t *buf, ssize_t len, ssize_t shift)
+/// @return A pointer to the line ending or null if none was found
+static const uint8_t *find_line_end(const uint8_t *buf, size_t len)
 {
-    if (shift < 0)
-    {
-        for (ssize_t i = 0; i < len; i++)
-        {
-            if (i + shift < len && i + shift >= 0)
-                buf[i + shift] = buf[i];
-        }
-    }
-    else
+    const uint8_t *cr = (const uint8_t *)memchr(buf, '\r', len);
+    const uint8_t *lf = (const uint8_t *)memchr(buf, '\n', cr == nullptr ? len : (size_t)(cr - buf)); // only search up to the CR
+    return lf != nullptr ? lf : cr;
+}
+
+void TextStream::drop(size_t len)
+{
+    head = (head + len) % bufferSize;
+    count -= len;
+    scanned = scanned > len ? scanned - len : 0;
+    if (count == 0)
+        head = 0; // keep the free space contiguous
+}
+
+size_t TextStream::findLineEnd()
+{
+    while (scanned < count)
     {
-        for (ssize_t i = len - 1; i >= 0; i--)
-        {
-            if (i + shift < len && i + shift >= 0)
-                buf[i + shift] = buf[i];
-        }
+        // scan the contiguous part of the ring buffer
+        size_t start = (head + scanned) % bufferSize;
+        size_t len = std::min(count - scanned, bufferSize - start);
+        const uint8_t *end = find_line_end(buffer + start, len);
+        if (end != nullptr)
+            return scanned + (end - (buffer + start));
+        scanned += len;
     }
+
+    return count;
 }
 
-std::string TextStream::readLine()
+std::string_view TextStream::readLine()
 {
     return readLine(TCP_INFINITE_TIMEOUT);
 }
 
-std::string TextStream::readLine(uint32_t timeout)
+std::string_view TextStream::readLine(uint32_t timeout)
+{
+    return readLine(timeout, nullptr);
+}
+
+std::string_view TextStream::readLine(uint32_t timeout, TextStreamResult *out_result)
 {
-    if (end < rend)
+    // release the previously returned line
+    drop(consumed);
+    consumed = 0;
+
+    while (true)
     {
-    check_line:
-        while (end < rend && buffer[end] != '\n' && buffer[end] != '\r')
-            end++;
-        if (end < rend && (buffer[end] == '\n' || buffer[end] == '\r'))
+        if (skipLF && count > 0) // special CR+LF handling
+        {
+            if (buffer[head] == '\n')
+                drop(1);
+            skipLF = false;
+        }
+
+        size_t end = findLineEnd();
+        if (end < count)
         {
-            std::string str = std::string((char *)(buffer + rstart), end - rstart);
+            size_t terminator = (head + end) % bufferSize;
+            skipLF = buffer[terminator] == '\r';
 
-            if (buffer[end] == '\r' && end + 1 < rend && buffer[end + 1] == '\n') // special CR+LF handling
+            if (discarding)
             {
-                end++;
+                // drop the rest of the overlong line
+                drop(end + 1);
+                discarding = false;
+                continue;
             }
 
-            end++;
-            rpos = end;
-            rstart = rpos;
+            if (end >= maxLineLength)
+            {
+                // the whole overlong line arrived in one read
+                drop(end + 1);
 
-            return str;
-        }
-    }
-    else
-    {
-        ssize_t unread = end - rstart;
-        rpos = unread;
-        shift_buffer(buffer, bufferSize, -rstart); // shift unread data to the start
-    }
+                if (out_result != nullptr)
+                    *out_result = TextStreamResult::LineTooLong;
+                return ""sv;
+            }
 
-    int rc;
+            if (head + end > bufferSize)
+            {
+                // line wraps around the end of the ring, make it contiguous
+                std::rotate(buffer, buffer + head, buffer + bufferSize);
+                head = 0;
+            }
 
-    while (source->isConnected() && (rc = source->readBytes(
-                                         buffer + rpos,     // make sure to write new data after existing
-                                         bufferSize - rpos, // make space for existing data
-                                         timeout)) > 0)
-    {
-        if (rc)
+            consumed = end + 1;
+            scanned = 0;
+
+            if (out_result != nullptr)
+                *out_result = TextStreamResult::Ok;
+            return std::string_view((const char *)(buffer + head), end);
+        }
+
+        if (discarding)
         {
-            rstart = 0;
-            rend = rpos + rc;
-            end = rpos;
+            drop(count);
+        }
+        else if (count >= maxLineLength)
+        {
+            drop(count);
+            discarding = true;
 
-            if (end < rend)
-            {
-                goto check_line;
-            }
+            if (out_result != nullptr)
+                *out_result = TextStreamResult::LineTooLong;
+            return ""sv;
         }
-        else
+
+        if (!source->isConnected())
         {
-            return "";
+            if (out_result != nullptr)
+                *out_result = TextStreamResult::Disconnected;
+            return ""sv;
         }
-    }
 
-    return "";
+        // read into the contiguous free space after the unread data
+        size_t tail = (head + count) % bufferSize;
+        size_t space = tail >= head && count < bufferSize ? bufferSize - tail : head - tail;
+
+        ssize_t rc = source->readBytes(buffer + tail, space, timeout);
+        if (rc <= 0)
+        {
+            if (out_result != nullptr)
+                *out_result = rc == 0 ? TextStreamResult::Timeout : TextStreamResult::Disconnected;
+            return ""sv;
+        }
+
+        count += rc;
+    }
 }
 
 bool TextStream::writeString(std::string str)
@@ -124,4 +182,4 @@ bool TextStream::writeString(std::string_view str)
     {
         return (size_t)rc == str.length();
     }
-}
\ No newline at end of file
+}
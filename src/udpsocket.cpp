@@ -3,9 +3,14 @@
 #include <lwip/netif.h>
 #include <lwip/ip4_addr.h>
 #include <lwip/udp.h>
+#include <lwip/igmp.h>
 #include <lwip/sockets.h>
 #include "udpsocket.h"
 #include <string>
+#include <cstring>
+#include <algorithm>
+#include <FreeRTOS.h>
+#include <task.h>
 
 using namespace std::literals;
 
@@ -37,6 +42,88 @@ Datagram::Datagram(const void *data, uint16_t length, const ip_addr_t *address,
 {
 }
 
+Datagram::Datagram(struct pbuf *chain, const ip_addr_t *address, uint16_t port) : data(chain->next == nullptr ? chain->payload : nullptr),
+                                                                                 length(chain->tot_len),
+                                                                                 address(address),
+                                                                                 port(port),
+                                                                                 chain(chain)
+{
+}
+
+bool Datagram::isContiguous()
+{
+    return data != nullptr;
+}
+
+uint16_t Datagram::copyTo(void *buffer, uint16_t length, uint16_t offset)
+{
+    if (chain != nullptr)
+    {
+        return pbuf_copy_partial(chain, buffer, length, offset);
+    }
+
+    if (offset >= this->length)
+    {
+        return 0;
+    }
+
+    uint16_t count = std::min<uint16_t>(length, this->length - offset);
+    memcpy(buffer, (const uint8_t *)data + offset, count);
+    return count;
+}
+
+struct pbuf *Datagram::takePbuf()
+{
+    if (chain == nullptr)
+    {
+        return nullptr;
+    }
+
+    pbufTaken = true;
+    return chain;
+}
+
+DatagramSegment Datagram::SegmentIterator::operator*() const
+{
+    if (p != nullptr)
+    {
+        return DatagramSegment{p->payload, p->len};
+    }
+    return DatagramSegment{data, length};
+}
+
+Datagram::SegmentIterator &Datagram::SegmentIterator::operator++()
+{
+    if (p != nullptr)
+    {
+        p = p->next;
+    }
+    else
+    {
+        data = nullptr; // a plain Datagram only has one segment
+    }
+    return *this;
+}
+
+bool Datagram::SegmentIterator::operator!=(const SegmentIterator &other) const
+{
+    return p != other.p || data != other.data;
+}
+
+Datagram::SegmentIterator Datagram::begin()
+{
+    if (chain != nullptr)
+    {
+        return SegmentIterator{chain, nullptr, 0};
+    }
+    return SegmentIterator{nullptr, data, length};
+}
+
+Datagram::SegmentIterator Datagram::end()
+{
+    return SegmentIterator{nullptr, nullptr, 0};
+}
+
 Datagram Datagram::asReply(void *data, uint16_t length)
 {
     return Datagram(data, length, this->address, this->port);
@@ -47,26 +134,35 @@ Datagram Datagram::asReply(const void *data, uint16_t length)
     return Datagram(data, length, this->address, this->port);
 }
 
-/// @brief
-/// @param udp
-/// @param datagram
-/// @return The number of bytes actually sent
-static int udp_send_datagram(struct udp_pcb **udp, Datagram *datagram)
+/// @brief Sends a pbuf to the Datagram's address, or to the connected remote if there is none
+/// @note Must be called with the lwIP lock held
+static err_t udp_send_pbuf(struct udp_pcb *udp, struct pbuf *p, Datagram *datagram)
 {
-    if (datagram->length > 0xffff)
+    if (datagram->address == nullptr)
     {
-        datagram->length = 0xffff;
+        return udp_send(udp, p); // connected destination, resolved once by udp_connect
     }
 
-    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, datagram->length, PBUF_RAM);
+    return udp_sendto(udp, p, datagram->address, datagram->port);
+}
+
+/// @brief Sends a Datagram by referencing its payload instead of copying it
+/// @param udp
+/// @param datagram
+/// @return The number of bytes actually sent
+/// @note Must be called with the lwIP lock held. lwIP copies PBUF_REF payloads
+///       whenever it needs to queue them, so the payload can be reused on return
+static int udp_send_datagram(struct udp_pcb *udp, Datagram *datagram)
+{
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, datagram->length, PBUF_REF);
     if (p == NULL)
     {
         return -ENOMEM;
     }
 
-    memcpy(p->payload, datagram->data, datagram->length);
+    p->payload = (void *)datagram->data;
 
-    err_t err = udp_sendto(*udp, p, datagram->address, datagram->port);
+    err_t err = udp_send_pbuf(udp, p, datagram);
 
     pbuf_free(p);
 
@@ -78,6 +174,22 @@ static int udp_send_datagram(struct udp_pcb **udp, Datagram *datagram)
     return datagram->length;
 }
 
+/// @brief Called by lwIP when the last reference to a zero-copy send is released
+/// @param p The custom pbuf of a UdpPendingSend
+static void udp_pending_send_free(struct pbuf *p)
+{
+    UdpPendingSend *pending = (UdpPendingSend *)p;
+
+    UdpSocketSendCallback callback = pending->callback;
+    UdpSocket *socket = pending->socket;
+    const void *data = pending->data;
+    void *args = pending->args;
+    pending->inUse = false;
+
+    if (callback != nullptr)
+        callback(socket, data, args);
+}
+
 /**
  * @brief This function is called when an UDP datagrm has been received.
  * @param arg The UdpSocket instance that received this
@@ -89,14 +201,71 @@ static int udp_send_datagram(struct udp_pcb **udp, Datagram *datagram)
 void udp_receive_callback(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
 {
     UdpSocket *sock = (UdpSocket *)arg;
+    sock->stats.received++;
+
+    // a payload spanning multiple pbufs is copied into one, so Datagram::data stays valid
+    if (p->next != NULL)
+    {
+        p = pbuf_coalesce(p, PBUF_RAW);
+        if (p->next != NULL)
+        {
+            sock->stats.dropped++;
+            pbuf_free(p);
+            return;
+        }
+    }
+
+    if (sock->receiveQueue != nullptr)
+    {
+        // hand the pbuf over to the application task
+        UdpSocket::QueuedDatagram entry;
+        entry.chain = p;
+        ip_addr_copy(entry.address, *addr);
+        entry.port = port;
+
+        if (!sock->receiveQueue->Push(entry))
+        {
+            sock->stats.dropped++;
+            pbuf_free(p);
+            return;
+        }
+
+        uint32_t queued = sock->receiveQueue->Count();
+        if (queued > sock->stats.queueHighWater)
+            sock->stats.queueHighWater = queued;
+
+        TaskHandle_t task = sock->receiveTask;
+        if (task != nullptr)
+            xTaskNotifyGive(task);
+        return;
+    }
+
     if (sock->receiveCallback != nullptr)
     {
-        Datagram datagram(p->payload, p->len, addr, port);
+        Datagram datagram(p, addr, port);
         sock->receiveCallback(sock, &datagram, sock->callbackArgs);
+        if (datagram.pbufTaken)
+            return; // the callback is now responsible for freeing the pbuf
     }
     pbuf_free(p);
 }
 
+/// @brief Frees a batch of pbufs under a single lwIP lock
+/// @param pbufs The pbufs to free
+/// @param count The number of pbufs
+static void free_pbufs(struct pbuf **pbufs, size_t count)
+{
+    if (count == 0)
+        return;
+
+    cyw43_arch_lwip_begin();
+    for (size_t i = 0; i < count; i++)
+    {
+        pbuf_free(pbufs[i]);
+    }
+    cyw43_arch_lwip_end();
+}
+
 UdpSocket::UdpSocket(int port)
 {
     udp = udp_new();
@@ -139,11 +308,7 @@ UdpSocket::UdpSocket(ip4_addr_t addr, int localPort, int remotePort)
 
 UdpSocket::~UdpSocket()
 {
-    if (udp != nullptr)
-    {
-        udp_remove(udp);
-        udp = nullptr;
-    }
+    deinit();
 }
 
 void UdpSocket::deinit()
@@ -153,6 +318,26 @@ void UdpSocket::deinit()
         udp_remove(udp);
         udp = nullptr;
     }
+
+    while (multicastGroupCount > 0)
+    {
+        leaveMulticastGroup(&multicastGroups[multicastGroupCount - 1]);
+    }
+
+    if (receiveQueue != nullptr)
+    {
+        // release the Datagrams that were never processed
+        QueuedDatagram entry;
+        cyw43_arch_lwip_begin();
+        while (receiveQueue->Pop(entry))
+        {
+            pbuf_free(entry.chain);
+        }
+        cyw43_arch_lwip_end();
+
+        delete receiveQueue;
+        receiveQueue = nullptr;
+    }
 }
 
 void UdpSocket::disconnect()
@@ -165,24 +350,235 @@ bool UdpSocket::isOpen()
     return udp != nullptr;
 }
 
+const ip_addr_t *UdpSocket::getBroadcastAddress()
+{
+    u32_t netmask = netif_ip4_netmask(cyw43_state.netif)->addr;
+    u32_t ip = netif_ip4_addr(cyw43_state.netif)->addr;
+
+    if (!broadcastCached || ip != broadcastSourceIp || netmask != broadcastSourceNetmask)
+    {
+        broadcastCached = true;
+        broadcastSourceIp = ip;
+        broadcastSourceNetmask = netmask;
+        ip4_addr_set_u32(ip_2_ip4(&broadcastAddress), ip | (~netmask)); // set all masked bits to 1
+    }
+
+    return &broadcastAddress;
+}
+
 bool UdpSocket::broadcast(Datagram *datagram)
 {
     assert(udp != nullptr);
 
-    u32_t netmask = netif_ip4_netmask(cyw43_state.netif)->addr;
-    u32_t ip = netif_ip4_addr(cyw43_state.netif)->addr;
-    u32_t broadcast = ip | (~netmask); // set all masked bits to 1
+    datagram->address = getBroadcastAddress();
 
-    ip4_addr_t addr = {};
-    addr.addr = broadcast;
-    datagram->address = &addr;
+    return sendDatagram(datagram);
+}
+
+bool UdpSocket::multicast(Datagram *datagram, const ip_addr_t *group)
+{
+    assert(udp != nullptr);
 
-    return udp_send_datagram(&udp, datagram) == datagram->length;
+    if (!ip_addr_ismulticast(group))
+    {
+        return false;
+    }
+
+    datagram->address = group;
+
+    return sendDatagram(datagram);
+}
+
+bool UdpSocket::joinMulticastGroup(const ip_addr_t *group)
+{
+    if (!ip_addr_ismulticast(group) || multicastGroupCount >= UDP_SOCKET_MAX_MULTICAST_GROUPS)
+    {
+        return false;
+    }
+
+    cyw43_arch_lwip_begin();
+    err_t err = igmp_joingroup(IP4_ADDR_ANY4, ip_2_ip4(group));
+    cyw43_arch_lwip_end();
+
+    if (err != ERR_OK)
+    {
+        printf("[RADIO] Failed to join multicast group %s (%d)\n", ipaddr_ntoa(group), err);
+        return false;
+    }
+
+    ip_addr_copy(multicastGroups[multicastGroupCount++], *group);
+    return true;
+}
+
+bool UdpSocket::leaveMulticastGroup(const ip_addr_t *group)
+{
+    for (size_t i = 0; i < multicastGroupCount; i++)
+    {
+        if (ip_addr_cmp(&multicastGroups[i], group))
+        {
+            cyw43_arch_lwip_begin();
+            err_t err = igmp_leavegroup(IP4_ADDR_ANY4, ip_2_ip4(group));
+            cyw43_arch_lwip_end();
+
+            // forget the group even on failure, so the slot can be reused
+            multicastGroups[i] = multicastGroups[--multicastGroupCount];
+            return err == ERR_OK;
+        }
+    }
+
+    return false;
+}
+
+void UdpSocket::setMulticastTtl(uint8_t ttl)
+{
+    assert(udp != nullptr);
+
+    cyw43_arch_lwip_begin();
+    udp_set_multicast_ttl(udp, ttl);
+    cyw43_arch_lwip_end();
+}
+
+void UdpSocket::setMulticastLoopback(bool loopback)
+{
+    assert(udp != nullptr);
+
+    cyw43_arch_lwip_begin();
+    if (loopback)
+        udp_set_flags(udp, UDP_FLAGS_MULTICAST_LOOP);
+    else
+        udp_clear_flags(udp, UDP_FLAGS_MULTICAST_LOOP);
+    cyw43_arch_lwip_end();
 }
 
 bool UdpSocket::sendDatagram(Datagram *datagram)
 {
     assert(udp != nullptr);
 
-    return udp_send_datagram(&udp, datagram) == datagram->length;
+    cyw43_arch_lwip_begin();
+    int rc = udp_send_datagram(udp, datagram);
+    cyw43_arch_lwip_end();
+
+    return rc == datagram->length;
+}
+
+bool UdpSocket::sendDatagramRef(Datagram *datagram, UdpSocketSendCallback callback, void *args)
+{
+    assert(udp != nullptr);
+
+    cyw43_arch_lwip_begin();
+
+    // slots are only taken and released with the lwIP lock held
+    UdpPendingSend *pending = nullptr;
+    for (size_t i = 0; i < UDP_SOCKET_MAX_PENDING_SENDS; i++)
+    {
+        if (!pendingSends[i].inUse)
+        {
+            pending = &pendingSends[i];
+            break;
+        }
+    }
+
+    if (pending == nullptr)
+    {
+        stats.sendSlotsExhausted++;
+        cyw43_arch_lwip_end();
+
+        if (callback != nullptr)
+            callback(this, datagram->data, args);
+        return false;
+    }
+
+    pending->inUse = true;
+    pending->socket = this;
+    pending->data = datagram->data;
+    pending->callback = callback;
+    pending->args = args;
+    pending->custom.custom_free_function = udp_pending_send_free;
+
+    struct pbuf *p = pbuf_alloced_custom(PBUF_RAW, datagram->length, PBUF_REF, &pending->custom,
+                                         (void *)datagram->data, datagram->length);
+
+    err_t err = udp_send_pbuf(udp, p, datagram);
+
+    pbuf_free(p); // calls the callback unless the driver still holds a reference
+    cyw43_arch_lwip_end();
+
+    return err == ERR_OK;
+}
+
+size_t UdpSocket::sendMany(Datagram *datagrams, size_t count)
+{
+    assert(udp != nullptr);
+
+    size_t sent = 0;
+
+    cyw43_arch_lwip_begin();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (udp_send_datagram(udp, &datagrams[i]) == datagrams[i].length)
+            sent++;
+    }
+    cyw43_arch_lwip_end();
+
+    return sent;
+}
+
+bool UdpSocket::enableReceiveQueue(size_t depth)
+{
+    if (receiveQueue != nullptr || depth == 0)
+    {
+        return false;
+    }
+
+    SpscQueue<QueuedDatagram> *queue = new SpscQueue<QueuedDatagram>(depth);
+
+    cyw43_arch_lwip_begin();
+    receiveQueue = queue;
+    cyw43_arch_lwip_end();
+
+    return true;
+}
+
+size_t UdpSocket::processReceiveQueue(size_t maxCount, uint32_t timeout)
+{
+    assert(receiveQueue != nullptr);
+
+    if (receiveQueue->Empty() && timeout > 0)
+    {
+        receiveTask = xTaskGetCurrentTaskHandle();
+        if (receiveQueue->Empty()) // a Datagram may have arrived before receiveTask was set
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout));
+        receiveTask = nullptr;
+    }
+
+    struct pbuf *release[UDP_SOCKET_RECEIVE_BATCH_SIZE];
+    size_t releaseCount = 0;
+    size_t processed = 0;
+
+    QueuedDatagram entry;
+    while (processed < maxCount && receiveQueue->Pop(entry))
+    {
+        processed++;
+
+        bool taken = false;
+        if (receiveCallback != nullptr)
+        {
+            Datagram datagram(entry.chain, &entry.address, entry.port);
+            receiveCallback(this, &datagram, callbackArgs);
+            taken = datagram.pbufTaken;
+        }
+
+        if (!taken)
+        {
+            release[releaseCount++] = entry.chain;
+            if (releaseCount == UDP_SOCKET_RECEIVE_BATCH_SIZE)
+            {
+                free_pbufs(release, releaseCount);
+                releaseCount = 0;
+            }
+        }
+    }
+
+    free_pbufs(release, releaseCount);
+    return processed;
 }
@@ -1,11 +1,11 @@
 #include <pico/stdlib.h>
 #include <cstring>
+#include <algorithm>
 #include <string>
 #include <pico/rand.h>
 #include <lwip/ip4_addr.h>
 #include <vector>
-#include <format>
-#include <ranges>
+#include <charconv>
 #include "config.h"
 #include "websocket.h"
 #include "tcpclient.h"
@@ -23,11 +23,20 @@
 
 using namespace std::literals;
 
-static SemaphoreHandle_t sha1_mutex = NULL;
-static SHA1 sha1 = SHA1();
-
 constexpr std::string_view WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"sv;
 
+void websocket_accept_key(std::string_view key, char out_acceptKey[WEBSOCKET_ACCEPT_KEY_LENGTH])
+{
+    // the context is on the stack, so concurrent handshakes do not have to wait for each other
+    SHA1 sha1;
+    sha1.update(key);
+    sha1.update(WS_GUID);
+
+    uint8_t digest[SHA1_DIGEST_BYTES];
+    sha1.final(digest);
+    base64_encode(digest, sizeof(digest), out_acceptKey);
+}
+
 WebSocket::WebSocket(TcpClient *tcp) : tcp(tcp)
 {
     sendMutex = xSemaphoreCreateMutex();
@@ -41,10 +50,10 @@ WebSocket::WebSocket(std::string_view url) : WebSocket(url, std::vector<std::str
 
 WebSocket::WebSocket(std::string_view url, std::vector<std::string> protocols)
 {
-    if (!sha1_mutex)
-    {
-        sha1_mutex = xSemaphoreCreateMutex();
-    }
+    // created up front, the destructor also runs after a failed handshake
+    sendMutex = xSemaphoreCreateMutex();
+    useMasking = true;
+    selfHostedMessageLoop = false;
 
     size_t host_start = url.find('/') + 2;
     size_t host_end = url.find('/', host_start);
@@ -77,9 +86,6 @@ WebSocket::WebSocket(std::string_view url, std::vector<std::string> protocols)
         return;
     }
 
-    sendMutex = xSemaphoreCreateMutex();
-    useMasking = true;
-
     selfHostedMessageLoop = true;
     xTaskCreate([](void *ins) -> void
                 { WebSocket *ws = (WebSocket *)ins;
@@ -122,12 +128,11 @@ bool WebSocket::initiateHandshake(std::string_view path, std::string_view host,
         return false;
     }
 
-    std::string line = stream->readLine(WEBSOCKET_TIMEOUT);
-    auto parts = std::views::split(line, " "sv);
-    auto iter = parts.begin();
-    iter++;
-    std::string status = std::string((*iter).begin(), (*iter).end());
-    if (status != "101"sv)
+    TextStreamResult result;
+    std::string_view line = stream->readLine(WEBSOCKET_TIMEOUT, &result);
+    size_t statusStart = line.find(' ');
+    if (result != TextStreamResult::Ok || statusStart == std::string_view::npos ||
+        line.substr(statusStart + 1, line.find(' ', statusStart + 1) - statusStart - 1) != "101"sv)
     {
         delete stream;
         return false;
@@ -140,17 +145,24 @@ bool WebSocket::initiateHandshake(std::string_view path, std::string_view host,
 
     do
     {
-        line = stream->readLine(WEBSOCKET_TIMEOUT);
+        line = stream->readLine(WEBSOCKET_TIMEOUT, &result);
+        if (result != TextStreamResult::Ok)
+        {
+            // an overlong or incomplete header block fails the handshake
+            delete stream;
+            return false;
+        }
+
         auto sep = line.find(':');
-        if (sep != std::string::npos)
+        if (sep != std::string_view::npos)
         {
-            std::string headerName = line.substr(0, sep);
+            std::string_view headerName = line.substr(0, sep);
 
             auto valueStart = line.find(' ', sep);
-            if (valueStart == std::string::npos)
+            if (valueStart == std::string_view::npos)
                 valueStart = sep;
 
-            std::string headerValue = line.substr(valueStart + 1);
+            std::string_view headerValue = line.substr(valueStart + 1);
 
             if (headerName == "Connection"sv && headerValue == "Upgrade"sv)
             {
@@ -177,12 +189,10 @@ bool WebSocket::initiateHandshake(std::string_view path, std::string_view host,
         return false;
     }
 
-    xSemaphoreTake(sha1_mutex, 1000);
-    sha1.update(keyStr.append(WS_GUID));
-    std::string handshakeKey = sha1.final();
-    xSemaphoreGive(sha1_mutex);
+    char handshakeKey[WEBSOCKET_ACCEPT_KEY_LENGTH];
+    websocket_accept_key(keyStr, handshakeKey);
 
-    if (acceptKey != handshakeKey)
+    if (acceptKey != std::string_view(handshakeKey, sizeof(handshakeKey)))
     {
         delete stream;
         return false;
@@ -602,7 +612,7 @@ bool WebSocket::send(const uint8_t *data, size_t length, WebSocketMessageType me
                     header.opcode = WebSocketOpCode::ContinuationFrame;
                     header.payloadLen = fragmentPayloadLength >= UINT16_MAX ? 127 : fragmentPayloadLength >= 126 ? 126
                                                                                                                  : fragmentPayloadLength;
-                    if (!sendFrame(header, data, fragmentPayloadLength, useMasking ? get_rand_32() : 0))
+                    if (!sendFrame(header, &data[length - bytesLeft], fragmentPayloadLength, useMasking ? get_rand_32() : 0))
                     {
                         return false;
                     }
@@ -637,6 +647,55 @@ bool WebSocket::send(const uint8_t *data, size_t length, WebSocketMessageType me
     }
 }
 
+bool WebSocket::send(WebSocketFrameBuffer &buffer, size_t length, WebSocketMessageType messageType)
+{
+    assert(isConnected() == true);
+    static_assert(WEBSOCKET_MAX_PACKET_SIZE < UINT16_MAX, "a single frame has a 16-bit payload length");
+
+    WebSocketFrameHeader header = {
+        messageType == WebSocketMessageType::Binary ? WebSocketOpCode::BinaryFrame : WebSocketOpCode::TextFrame, // opcode
+        0, 0, 0,                                                                                                  // RSVn
+        1,                                                                                                        // FIN
+        length >= 126 ? 126u : (unsigned int)length,
+        useMasking ? 1u : 0u};
+
+    size_t headerSize = 2 + (header.payloadLen == 126 ? sizeof(uint16_t) : 0) + (header.MASK ? sizeof(uint32_t) : 0);
+    if (headerSize + length > WEBSOCKET_MAX_PACKET_SIZE)
+    {
+        // too large for a single frame, fragmenting copies the payload
+        return send(buffer.data(), length, messageType);
+    }
+
+    // write the header right in front of the payload
+    uint8_t *frame = buffer.data() - headerSize;
+    size_t index = 0;
+    std::memcpy(&frame[index], &header, 2);
+    index += 2;
+
+    if (header.payloadLen == 126)
+    {
+        uint16_t len = htons((uint16_t)length);
+        std::memcpy(&frame[index], &len, sizeof(len));
+        index += sizeof(len);
+    }
+
+    if (header.MASK)
+    {
+        uint32_t maskingKey = get_rand_32();
+        std::memcpy(&frame[index], &maskingKey, sizeof(maskingKey));
+        maskPayload(buffer.data(), length, maskingKey);
+    }
+
+    if (!xSemaphoreTake(sendMutex, 1000))
+    {
+        return false;
+    }
+
+    ssize_t ret = tcp->writeBytes(frame, headerSize + length);
+    xSemaphoreGive(sendMutex);
+    return (size_t)ret == headerSize + length;
+}
+
 bool WebSocket::sendFrame(const WebSocketFrameHeader &header, const uint8_t *payload, size_t payloadLength, uint32_t maskingKey)
 {
     if (!xSemaphoreTake(sendMutex, 1000))
@@ -753,4 +812,131 @@ bool WebSocket::sendFrame(const WebSocketFrameHeader &header, const uint8_t *pay
 struct sockaddr_in WebSocket::getSocketAddress()
 {
     return tcp->getSocketAddress();
-}
\ No newline at end of file
+}
+
+WebSocketFrameBuffer::~WebSocketFrameBuffer()
+{
+    if (buffer != nullptr)
+        vPortFree(buffer);
+}
+
+WebSocketFrameBuffer::WebSocketFrameBuffer(WebSocketFrameBuffer &&other)
+{
+    *this = std::move(other);
+}
+
+WebSocketFrameBuffer &WebSocketFrameBuffer::operator=(WebSocketFrameBuffer &&other)
+{
+    if (this != &other)
+    {
+        if (buffer != nullptr)
+            vPortFree(buffer);
+
+        buffer = other.buffer;
+        length = other.length;
+        capacity = other.capacity;
+        currentLimit = other.currentLimit;
+        smallFlushes = other.smallFlushes;
+        writeFailed = other.writeFailed;
+
+        other.buffer = nullptr;
+        other.length = 0;
+        other.capacity = 0;
+    }
+    return *this;
+}
+
+bool WebSocketFrameBuffer::push_back(char c)
+{
+    if (length == capacity && !grow(length + 1))
+    {
+        writeFailed = true;
+        return false;
+    }
+
+    buffer[WEBSOCKET_MAX_HEADER_SIZE + length++] = c;
+    return true;
+}
+
+bool WebSocketFrameBuffer::append(const char *data, size_t length)
+{
+    return append((const uint8_t *)data, length);
+}
+
+bool WebSocketFrameBuffer::append(const uint8_t *data, size_t length)
+{
+    if (this->length + length > capacity && !grow(this->length + length))
+    {
+        writeFailed = true;
+        return false;
+    }
+
+    std::memcpy(&buffer[WEBSOCKET_MAX_HEADER_SIZE + this->length], data, length);
+    this->length += length;
+    return true;
+}
+
+void WebSocketFrameBuffer::erase(size_t position, size_t count)
+{
+    uint8_t *payload = data();
+    std::memmove(&payload[position], &payload[position + count], length - position - count);
+    length -= count;
+}
+
+void WebSocketFrameBuffer::reserve()
+{
+    // slack for a message that ends right after the limit
+    if (capacity < currentLimit + 8)
+        grow(currentLimit + 8);
+}
+
+void WebSocketFrameBuffer::adapt(bool full)
+{
+    if (full)
+    {
+        smallFlushes = 0;
+        currentLimit = std::min(currentLimit * 2, WEBSOCKET_FRAME_BUFFER_MAX_LENGTH);
+        return;
+    }
+
+    if (length >= currentLimit / 4)
+    {
+        smallFlushes = 0;
+        return;
+    }
+
+    if (++smallFlushes < WEBSOCKET_FRAME_BUFFER_SHRINK_FLUSHES || currentLimit == WEBSOCKET_FRAME_BUFFER_MIN_LENGTH)
+        return;
+
+    // the traffic went down, give the memory back
+    smallFlushes = 0;
+    currentLimit = std::max(currentLimit / 2, WEBSOCKET_FRAME_BUFFER_MIN_LENGTH);
+    if (capacity > currentLimit * 2)
+    {
+        uint8_t *newBuffer = (uint8_t *)pvPortMalloc(WEBSOCKET_MAX_HEADER_SIZE + currentLimit + 8);
+        if (newBuffer == nullptr)
+            return;
+
+        std::memcpy(&newBuffer[WEBSOCKET_MAX_HEADER_SIZE], data(), length);
+        vPortFree(buffer);
+        buffer = newBuffer;
+        capacity = currentLimit + 8;
+    }
+}
+
+bool WebSocketFrameBuffer::grow(size_t minCapacity)
+{
+    size_t newCapacity = std::max(minCapacity, capacity + capacity / 2);
+    uint8_t *newBuffer = (uint8_t *)pvPortMalloc(WEBSOCKET_MAX_HEADER_SIZE + newCapacity);
+    if (newBuffer == nullptr)
+        return false;
+
+    if (buffer != nullptr)
+    {
+        std::memcpy(&newBuffer[WEBSOCKET_MAX_HEADER_SIZE], data(), length);
+        vPortFree(buffer);
+    }
+    buffer = newBuffer;
+    capacity = newCapacity;
+    return true;
+}
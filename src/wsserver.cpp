@@ -14,32 +14,22 @@
 #include "wsserver.h"
 #include "tcpclient.h"
 #include "textstream.h"
-#include "sha1.hpp"
 
 using namespace std::literals;
 
-static SemaphoreHandle_t sha1_mutex = NULL;
-static SHA1 sha1 = SHA1();
-
-constexpr std::string_view WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"sv;
-
-WsServer::ClientEntry::ClientEntry() : guid(), ws(nullptr)
+WsServer::ClientEntry::ClientEntry() : guid(), id(WS_INVALID_CLIENT_ID), ws(nullptr), server(nullptr)
 {
 }
 
-WsServer::ClientEntry::ClientEntry(Guid guid, WebSocket *ws, std::string requestedPath) : guid(guid), ws(ws), requestedPath(requestedPath)
+WsServer::ClientEntry::ClientEntry(Guid guid, WsClientId id, WebSocket *ws, std::string requestedPath, WsServer *server) : guid(guid), id(id), ws(ws), requestedPath(requestedPath), server(server)
 {
 }
 
-WsServer::WsServer(int port) : clients(), port(port), dispatchQueueRunning(false), badRequestResponse("HTTP/1.1 400 Bad Request\r\n\r\n"sv), dispatchQueue()
+WsServer::WsServer(int port) : clients(), port(port), dispatchQueueRunning(false), badRequestResponse("HTTP/1.1 400 Bad Request\r\n\r\n"sv), clientSlots(), usedClientIds(0), dispatchQueue()
 {
     clients.reserve(WS_SERVER_MAX_CLIENT_COUNT);
 
     listener = nullptr;
-    if (!sha1_mutex)
-    {
-        sha1_mutex = xSemaphoreCreateMutex();
-    }
 }
 
 WsServer::~WsServer()
@@ -49,8 +39,14 @@ WsServer::~WsServer()
         clients[i]->ws->close();
     }
 
-    listener->stop();
-    delete listener;
+    if (listener != nullptr)
+    {
+        listener->stop();
+        // the accept task may still be waking up from the closed listener
+        while (acceptConnectionsTask != nullptr)
+            vTaskDelay(1);
+        delete listener;
+    }
 }
 
 void WsServer::setBadRequestResponse(std::string_view response)
@@ -86,45 +82,67 @@ inline void rtrim(std::string &s)
             s.end());
 }
 
+// The WebSocket callback args are the client entry, so no lookup is needed
 void ws_pong(WebSocket *ws, void *args, const uint8_t *payload, size_t payloadLength)
 {
-    WsServer *server = (WsServer *)args;
+    WsServer::ClientEntry *entry = (WsServer::ClientEntry *)args;
+    WsServer *server = entry->server;
     if (server->pongCallback != nullptr)
     {
-        const Guid &guid = (*std::find_if(server->clients.begin(), server->clients.end(), [ws](WsServer::ClientEntry *entry)
-                                          { return entry->ws == ws; }))
-                               ->guid;
-        server->pongCallback(server, guid, payload, payloadLength, server->callbackArgs);
+        server->pongCallback(server, entry->guid, payload, payloadLength, server->callbackArgs);
     }
 }
 
 void ws_close(WebSocket *ws, void *args, WebSocketStatusCode statusCode, const std::string_view &reason)
 {
-    WsServer *server = (WsServer *)args;
-    if (server->clientDisconnected.Count() > 0)
+    WsServer::ClientEntry *entry = (WsServer::ClientEntry *)args;
+    WsServer *server = entry->server;
+    for (int i = 0; i < server->clientDisconnected.Count(); i++)
     {
-        const Guid &guid = (*std::find_if(server->clients.begin(), server->clients.end(), [ws](WsServer::ClientEntry *entry)
-                                          { return entry->ws == ws; }))
-                               ->guid;
-        for (int i = 0; i < server->clientDisconnected.Count(); i++)
-        {
-            server->clientDisconnected.Get(i)(server, guid, statusCode, reason, server->callbackArgs);
-        }
+        server->clientDisconnected.Get(i)(server, entry->guid, statusCode, reason, server->callbackArgs);
+    }
+    for (int i = 0; i < server->clientEntryDisconnected.Count(); i++)
+    {
+        server->clientEntryDisconnected.Get(i)(server, entry, statusCode, reason, server->callbackArgs);
     }
 }
 
+static WsActivityCallback ws_activity_callback = nullptr;
+static void *ws_activity_args = nullptr;
+
+void ws_server_set_activity_callback(WsActivityCallback callback, void *args)
+{
+    taskENTER_CRITICAL();
+    ws_activity_callback = callback;
+    ws_activity_args = args;
+    taskEXIT_CRITICAL();
+}
+
+/// @brief Reports a frame to the activity callback
+static inline void ws_activity()
+{
+    // read as one unit, so a frame never sees a callback with the args of another one
+    taskENTER_CRITICAL();
+    WsActivityCallback callback = ws_activity_callback;
+    void *args = ws_activity_args;
+    taskEXIT_CRITICAL();
+
+    if (callback != nullptr)
+        callback(1, args);
+}
+
 void ws_received(WebSocket *ws, void *args, const WebSocketFrame &frame)
 {
-    WsServer *server = (WsServer *)args;
-    if (server->messageReceived.Count() > 0)
+    WsServer::ClientEntry *entry = (WsServer::ClientEntry *)args;
+    WsServer *server = entry->server;
+    ws_activity();
+    for (int i = 0; i < server->messageReceived.Count(); i++)
     {
-        const Guid &guid = (*std::find_if(server->clients.begin(), server->clients.end(), [ws](WsServer::ClientEntry *entry)
-                                          { return entry->ws == ws; }))
-                               ->guid;
-        for (int i = 0; i < server->messageReceived.Count(); i++)
-        {
-            server->messageReceived.Get(i)(server, guid, frame, server->callbackArgs);
-        }
+        server->messageReceived.Get(i)(server, entry->guid, frame, server->callbackArgs);
+    }
+    for (int i = 0; i < server->clientEntryMessageReceived.Count(); i++)
+    {
+        server->clientEntryMessageReceived.Get(i)(server, entry, frame, server->callbackArgs);
     }
 }
 
@@ -139,10 +157,17 @@ void WsServer::handleRawConnection(TcpClient *client)
     }
 
     TextStream *stream = new TextStream(client, 1024);
-    std::string line = stream->readLine(WEBSOCKET_TIMEOUT);
-    auto parts = std::views::split(line, " "sv);
-    auto iter = parts.begin();
-    std::string path = std::string((*iter).begin(), (*iter).end());
+    TextStreamResult result;
+    std::string_view line = stream->readLine(WEBSOCKET_TIMEOUT, &result);
+    if (result != TextStreamResult::Ok)
+    {
+        delete stream;
+        client->disconnect();
+        delete client;
+        return;
+    }
+
+    std::string path = std::string(line.substr(0, line.find(' ')));
 
     bool foundConnectionHeader = false;
     bool foundUpgradeHeader = false;
@@ -151,17 +176,20 @@ void WsServer::handleRawConnection(TcpClient *client)
 
     do
     {
-        line = stream->readLine(WEBSOCKET_TIMEOUT);
+        line = stream->readLine(WEBSOCKET_TIMEOUT, &result);
+        if (result != TextStreamResult::Ok)
+            break; // an overlong or incomplete header block is a bad request
+
         auto sep = line.find(':');
-        if (sep != std::string::npos)
+        if (sep != std::string_view::npos)
         {
-            std::string headerName = line.substr(0, sep);
+            std::string_view headerName = line.substr(0, sep);
 
             auto valueStart = line.find(' ', sep);
-            if (valueStart == std::string::npos)
+            if (valueStart == std::string_view::npos)
                 valueStart = sep;
 
-            std::string headerValue = line.substr(valueStart + 1);
+            std::string_view headerValue = line.substr(valueStart + 1);
 
             if (headerName == "Connection"sv && headerValue == "Upgrade"sv)
             {
@@ -182,17 +210,20 @@ void WsServer::handleRawConnection(TcpClient *client)
         }
     } while (!line.empty());
 
-    if (!foundConnectionHeader || !foundUpgradeHeader || clientKey.empty() || clients.size() == WS_SERVER_MAX_CLIENT_COUNT /* at capacity */)
+    WsClientId id = WS_INVALID_CLIENT_ID;
+    if (result == TextStreamResult::Ok && foundConnectionHeader && foundUpgradeHeader && !clientKey.empty())
+        id = reserveClientId(); // invalid if at capacity
+
+    if (id == WS_INVALID_CLIENT_ID)
     {
-        stream->writeString(badRequestResponse);
+        if (client->isConnected())
+            stream->writeString(badRequestResponse);
         delete stream;
     }
     else
     {
-        xSemaphoreTake(sha1_mutex, 1000);
-        sha1.update(clientKey.append(WS_GUID));
-        std::string handshakeKey = sha1.final();
-        xSemaphoreGive(sha1_mutex);
+        char handshakeKey[WEBSOCKET_ACCEPT_KEY_LENGTH];
+        websocket_accept_key(clientKey, handshakeKey);
 
         auto requestedProtocols = std::views::split(protocols, ","sv) | std::views::transform([](auto &&elem)
                                                                                               {
@@ -204,13 +235,13 @@ void WsServer::handleRawConnection(TcpClient *client)
 
         std::string acceptedProtocol = protocolCallback == nullptr ? ""s : std::string(protocolCallback(requestedProtocolsVec, callbackArgs));
 
-        std::string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-Websocket-Accept: "s +
-                               handshakeKey +
-                               "\r\n"s;
+        std::string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: "s;
+        response.append(handshakeKey, sizeof(handshakeKey));
+        response.append("\r\n"sv);
 
         if (!acceptedProtocol.empty())
         {
-            response.append("Sec-Websocket-Protocol: "s + acceptedProtocol + "\r\n"s);
+            response.append("Sec-WebSocket-Protocol: "s + acceptedProtocol + "\r\n"s);
         }
 
         response.append("\r\n"sv);
@@ -220,13 +251,14 @@ void WsServer::handleRawConnection(TcpClient *client)
 
         Guid guid = Guid::NewGuid();
         WebSocket *ws = new WebSocket(client);
-        ws->callbackArgs = this; // set args to reference of this instance
+        ClientEntry *entry = new ClientEntry(guid, id, ws, path, this);
+        ws->callbackArgs = entry; // set args to the client entry, it references this instance
         ws->serverProtocol = acceptedProtocol;
         ws->pongCallback = ws_pong;
         ws->closeCallback = ws_close;
         ws->receivedCallback = ws_received;
-        ClientEntry *entry = new ClientEntry(guid, ws, path);
 
+        clientSlots[id] = entry;
         clients.push_back(entry);
         if (clientConnected.Count() > 0)
         {
@@ -240,18 +272,20 @@ void WsServer::handleRawConnection(TcpClient *client)
 
         if (!ws->hasGracefullyClosed())
         {
-            if (clientDisconnected.Count() > 0)
+            for (int i = 0; i < clientDisconnected.Count(); i++)
             {
-                for (int i = 0; i < clientDisconnected.Count(); i++)
-                {
-                    clientDisconnected.Get(i)(this, guid, WebSocketStatusCode::ClosedAbnormally, "Message loop has ungracefully exited."sv, callbackArgs);
-                }
+                clientDisconnected.Get(i)(this, entry->guid, WebSocketStatusCode::ClosedAbnormally, "Message loop has ungracefully exited."sv, callbackArgs);
+            }
+            for (int i = 0; i < clientEntryDisconnected.Count(); i++)
+            {
+                clientEntryDisconnected.Get(i)(this, entry, WebSocketStatusCode::ClosedAbnormally, "Message loop has ungracefully exited."sv, callbackArgs);
             }
         }
 
         clients.erase(std::remove_if(clients.begin(), clients.end(),
                                      [entry](ClientEntry *i)
                                      { return i == entry; }));
+        releaseClientId(id);
         delete entry;
         delete ws;
         return;
@@ -281,6 +315,8 @@ void WsServer::acceptConnections()
             vTaskDelete(NULL); }, "wsclient", (uint32_t)WEBSOCKET_THREAD_STACK_SIZE, args, 3, &task);
         }
     }
+
+    acceptConnectionsTask = nullptr;
 }
 
 void WsServer::joinDispatchQueue()
@@ -331,9 +367,10 @@ void WsServer::start()
     assert(isListening() == false);
     listener = new TcpListener(port);
 
+    // the handle is set before the task runs, so it can clear it when it ends
     xTaskCreate([](void *ins) -> void
                 { ((WsServer *)ins)->acceptConnections(); vTaskDelete(NULL); },
-                "wsserver_task", configMINIMAL_STACK_SIZE, this, 2, &acceptConnectionsTask);
+                "wsserver_task", configMINIMAL_STACK_SIZE, this, 2, (TaskHandle_t *)&acceptConnectionsTask);
 }
 
 void WsServer::stop()
@@ -376,6 +413,46 @@ bool WsServer::isClientConnected(const Guid &guid)
     return false;
 }
 
+WsClientId WsServer::getClientId(const Guid &guid)
+{
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        if (clients[i]->guid == guid)
+        {
+            return clients[i]->id;
+        }
+    }
+
+    return WS_INVALID_CLIENT_ID;
+}
+
+WsClientId WsServer::reserveClientId()
+{
+    WsClientId id = WS_INVALID_CLIENT_ID;
+
+    taskENTER_CRITICAL();
+    for (WsClientId i = 0; i < WS_SERVER_MAX_CLIENT_COUNT; i++)
+    {
+        if ((usedClientIds & (1u << i)) == 0)
+        {
+            usedClientIds |= 1u << i;
+            id = i;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return id;
+}
+
+void WsServer::releaseClientId(WsClientId id)
+{
+    taskENTER_CRITICAL();
+    clientSlots[id] = nullptr;
+    usedClientIds &= ~(1u << id);
+    taskEXIT_CRITICAL();
+}
+
 void WsServer::disconnectClient(const Guid &guid)
 {
     if (portCHECK_IF_IN_ISR() && isDispatchQueueRunning())
@@ -458,15 +535,7 @@ bool WsServer::send(const Guid &guid, std::string_view data, WebSocketMessageTyp
         return true;
     }
 
-    for (size_t i = 0; i < clients.size(); i++)
-    {
-        if (clients[i]->guid == guid && clients[i]->ws->isConnected())
-        {
-            return clients[i]->ws->send(data, messageType);
-        }
-    }
-
-    return false;
+    return send(getClientId(guid), data, messageType);
 }
 
 bool WsServer::send(const Guid &guid, const uint8_t *data, size_t length, WebSocketMessageType messageType)
@@ -488,18 +557,66 @@ bool WsServer::send(const Guid &guid, const uint8_t *data, size_t length, WebSoc
         return true;
     }
 
-    for (size_t i = 0; i < clients.size(); i++)
-    {
-        if (clients[i]->guid == guid && clients[i]->ws->isConnected())
-        {
-            return clients[i]->ws->send(data, length, messageType);
-        }
-    }
-
-    return false;
+    return send(getClientId(guid), data, length, messageType);
 }
 
 bool WsServer::send(const Guid &guid, const std::vector<uint8_t> &data, WebSocketMessageType messageType)
 {
     return send(guid, data.data(), data.size(), messageType);
-}
\ No newline at end of file
+}
+
+bool WsServer::send(WsClientId id, std::string_view data, WebSocketMessageType messageType)
+{
+    ClientEntry *entry = getClient(id);
+    if (entry == nullptr)
+        return false;
+
+    // the dispatch queue keeps the guid, the id may be reused before it is dispatched
+    if (portCHECK_IF_IN_ISR() && isDispatchQueueRunning())
+        return send(entry->guid, data, messageType);
+
+    if (!entry->ws->isConnected())
+        return false;
+
+    ws_activity();
+    return entry->ws->send(data, messageType);
+}
+
+bool WsServer::send(WsClientId id, const uint8_t *data, size_t length, WebSocketMessageType messageType)
+{
+    ClientEntry *entry = getClient(id);
+    if (entry == nullptr)
+        return false;
+
+    // the dispatch queue keeps the guid, the id may be reused before it is dispatched
+    if (portCHECK_IF_IN_ISR() && isDispatchQueueRunning())
+        return send(entry->guid, data, length, messageType);
+
+    if (!entry->ws->isConnected())
+        return false;
+
+    ws_activity();
+    return entry->ws->send(data, length, messageType);
+}
+
+bool WsServer::send(WsClientId id, const std::vector<uint8_t> &data, WebSocketMessageType messageType)
+{
+    return send(id, data.data(), data.size(), messageType);
+}
+
+bool WsServer::send(WsClientId id, WebSocketFrameBuffer &buffer, size_t length, WebSocketMessageType messageType)
+{
+    ClientEntry *entry = getClient(id);
+    if (entry == nullptr)
+        return false;
+
+    // the dispatch queue copies the payload
+    if (portCHECK_IF_IN_ISR() && isDispatchQueueRunning())
+        return send(entry->guid, buffer.data(), length, messageType);
+
+    if (!entry->ws->isConnected())
+        return false;
+
+    ws_activity();
+    return entry->ws->send(buffer, length, messageType);
+}
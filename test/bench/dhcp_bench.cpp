@@ -0,0 +1,53 @@
+#include "testing.h"
+#include "dhcpclient.h"
+
+// DISCOVER→ACK handling time with a pool of 64 leases, built with DHCPS_MAX_IP=64.
+// A reply goes through the UDP output hook, which copies it like the driver would.
+
+static_assert(DHCPS_MAX_IP == 64, "dhcp_bench measures a pool of 64 leases");
+
+static void make_mac(int i, uint8_t *mac)
+{
+    uint8_t value[6] = {0x02, 0x00, 0x5e, 0x10, (uint8_t)(i >> 8), (uint8_t)i};
+    memcpy(mac, value, sizeof(value));
+}
+
+TEST(discover_to_ack_at_64_leases)
+{
+    DhcpTestServer server;
+    uint8_t mac[6];
+
+    // every lease taken, the returning clients are found through the hash table
+    for (int i = 0; i < DHCPS_MAX_IP; i++)
+    {
+        make_mac(i, mac);
+        int offered = server.discover(mac);
+        REQUIRE(offered >= 0);
+        REQUIRE(server.request(mac, offered) == offered);
+    }
+
+    int next = 0;
+    bool acked = true;
+    testing::measure("dhcp/discover_request_ack/64_leases", [&]()
+                     {
+        make_mac(next, mac);
+        next = (next + 1) % DHCPS_MAX_IP;
+        int offered = server.discover(mac);
+        acked &= offered >= 0 && server.request(mac, offered) == offered; });
+    CHECK(acked);
+
+    testing::measure("dhcp/rapid_commit/64_leases", [&]()
+                     {
+        make_mac(next, mac);
+        next = (next + 1) % DHCPS_MAX_IP;
+        acked &= server.discover(mac, true) >= 0 && server.lastType == DHCP_TEST_ACK; });
+    CHECK(acked);
+
+    // a full pool has no lease for a new client, the whole table is probed
+    make_mac(DHCPS_MAX_IP, mac);
+    testing::measure("dhcp/discover/64_leases_full_pool", [&]()
+                     { acked &= server.discover(mac) < 0; });
+    CHECK(acked);
+}
+
+TEST_MAIN()
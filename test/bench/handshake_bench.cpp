@@ -0,0 +1,33 @@
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include "testing.h"
+#include "websocket.h"
+
+using namespace std::literals;
+
+// Accept keys per second, the SHA-1 and Base64 work of every WebSocket handshake.
+
+/// @brief The nonce of the RFC 6455 handshake example and its accept key
+static constexpr std::string_view SAMPLE_KEY = "dGhlIHNhbXBsZSBub25jZQ=="sv;
+static constexpr std::string_view SAMPLE_ACCEPT_KEY = "s3pPLMBiTxaQ9kYGzzhZRbK+xOo="sv;
+
+TEST(accept_keys_per_second)
+{
+    char acceptKey[WEBSOCKET_ACCEPT_KEY_LENGTH];
+    websocket_accept_key(SAMPLE_KEY, acceptKey);
+    REQUIRE(std::string_view(acceptKey, sizeof(acceptKey)) == SAMPLE_ACCEPT_KEY);
+
+    // a different nonce each time, like separate connections
+    std::string key(SAMPLE_KEY);
+    uint32_t checksum = 0;
+    testing::measure("websocket accept key", [&]()
+                     {
+        key[0] = 'A' + (char)(checksum % 26);
+        websocket_accept_key(key, acceptKey);
+        checksum += (uint8_t)acceptKey[0]; });
+
+    CHECK(checksum > 0);
+}
+
+TEST_MAIN()
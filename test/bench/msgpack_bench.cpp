@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "testing.h"
+#include "msgpack/msgpack.hpp"
+
+// Encoding and decoding a 100 element double array, the payload of a double[] topic update.
+
+static constexpr size_t ELEMENT_COUNT = 100;
+
+TEST(double_array_of_100_elements)
+{
+    std::vector<double> values;
+    for (size_t i = 0; i < ELEMENT_COUNT; i++)
+        values.push_back((double)i * 0.37 + 0.1);
+
+    msgpack::Packer<false> reference;
+    reference.process(values);
+    std::vector<uint8_t> encoded = reference.vector();
+    // an array16 header and a float64 per element
+    CHECK_EQ(encoded.size(), (size_t)(3 + ELEMENT_COUNT * 9));
+
+    size_t packed = 0;
+    testing::measure("pack double[100] into a vector", [&]()
+                     {
+        msgpack::Packer<false> packer;
+        packer.process(values);
+        packed += packer.size(); });
+
+    uint8_t buffer[1024];
+    testing::measure("pack double[100] into a caller buffer", [&]()
+                     {
+        msgpack::Packer<false> packer(buffer, sizeof(buffer));
+        packer.process(values);
+        packed += packer.size(); });
+    CHECK(std::equal(encoded.begin(), encoded.end(), buffer));
+
+    size_t unpacked = 0;
+    testing::measure("unpack double[100]", [&]()
+                     {
+        msgpack::Unpacker<false> unpacker(encoded.data(), encoded.size());
+        std::vector<double> decoded;
+        unpacker.process(decoded);
+        unpacked += decoded.size(); });
+
+    std::vector<double> reused;
+    testing::measure("unpack double[100] into a reused vector", [&]()
+                     {
+        msgpack::Unpacker<false> unpacker(encoded.data(), encoded.size());
+        reused.clear();
+        unpacker.process(reused);
+        unpacked += reused.size(); });
+
+    CHECK(packed > 0);
+    CHECK(unpacked > 0);
+    CHECK(reused == values);
+}
+
+TEST_MAIN()
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+#include "testing.h"
+#include "ntclient.h"
+#include "nt/ntpublisher.h"
+
+using namespace std::literals;
+
+// Bytes and heap allocations per announce message for 1000 topics.
+// Every allocation of the process is counted while counting is on. The topics are created once
+// without a subscriber and once with a client subscribed to all of them, the difference is the
+// cost of announcing them. Their names start with '$', so no $sub$ and $pub$ meta topics are
+// published and updated for them. The written frames are counted and dropped.
+
+static constexpr int TOPIC_COUNT = 1000;
+
+static std::atomic<bool> counting = false;
+static std::atomic<uint64_t> allocations = 0;
+
+void *operator new(std::size_t size)
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    void *block = malloc(size == 0 ? 1 : size);
+    if (block == nullptr)
+        throw std::bad_alloc();
+    return block;
+}
+
+// frees the blocks of the operator new above, GCC warns about any free of an operator new result
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void *block) noexcept
+{
+    free(block);
+}
+
+void operator delete(void *block, std::size_t size) noexcept
+{
+    free(block);
+}
+#pragma GCC diagnostic pop
+
+/// @brief Returns the topic name of an index
+static std::string topic_name(int index)
+{
+    return "$bench/"s + std::to_string(index);
+}
+
+/// @brief Creates the topics and counts the allocations made meanwhile
+static uint64_t create_topics(NetworkTableInstance *nt, std::vector<NTPublisher *> &publishers)
+{
+    std::vector<std::string> names;
+    for (int i = 0; i < TOPIC_COUNT; i++)
+        names.push_back(topic_name(i));
+    publishers.reserve(TOPIC_COUNT);
+
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < TOPIC_COUNT; i++)
+        publishers.push_back(new NTPublisher(nt, names[i], NTDataValue(0.0)));
+    nt->flush();
+    counting = false;
+    return allocations;
+}
+
+TEST(bytes_and_allocations_per_announce)
+{
+    NetworkTableInstance *nt = new NetworkTableInstance();
+    nt->startServer();
+
+    // announces only go to clients with a matching subscription
+    static NtTestClient client;
+    REQUIRE(client.connect("dashboard"sv));
+    client.subscribe(1, "$bench/"sv, "{\"prefix\":true,\"topicsonly\":true}"sv);
+    client.poll();
+
+    uint64_t bytes = 0;
+    uint64_t frames = 0;
+    {
+        auto guard = hostsim::lock();
+        client.connection.onWrite = [&](const char *data, size_t size)
+        {
+            bytes += size;
+            frames++;
+        };
+    }
+
+    // the same topics on a server without clients
+    NetworkTableInstance *baselineNt = new NetworkTableInstance();
+    baselineNt->startServer();
+    std::vector<NTPublisher *> baselinePublishers;
+    uint64_t baseline = create_topics(baselineNt, baselinePublishers);
+
+    std::vector<NTPublisher *> publishers;
+    uint64_t announced = create_topics(nt, publishers);
+    // the server flushes its text cache only after handling a client text frame
+    client.sendText("[]"sv);
+    client.poll();
+
+    double bytesPerAnnounce = (double)bytes / TOPIC_COUNT;
+    double allocationsPerAnnounce = ((double)announced - (double)baseline) / TOPIC_COUNT;
+    printf("BENCH %-48s %12.1f bytes/announce (%llu frames)\n", "announce 1000 topics", bytesPerAnnounce, (unsigned long long)frames);
+    printf("BENCH %-48s %12.2f allocations/announce (%llu with, %llu without a subscriber)\n", "announce 1000 topics", allocationsPerAnnounce,
+           (unsigned long long)announced, (unsigned long long)baseline);
+
+    // the announces are packed into the reusable text cache and sent in large frames,
+    // each topic only allocates the list of its subscribers it caches
+    CHECK(frames < TOPIC_COUNT / 5);
+    CHECK(allocationsPerAnnounce < 1.25);
+}
+
+TEST_MAIN()
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <string>
+#include "testing.h"
+#include "ntclient.h"
+#include "nt/ntpublisher.h"
+
+using namespace std::literals;
+
+// Cost of fanning one value update out to 16 subscribed clients.
+// Built with PICO_RADIO_MAX_CLIENTS=16, the written frames are counted and dropped.
+
+static constexpr int CLIENT_COUNT = 16;
+
+TEST(fan_out_one_update_to_16_clients)
+{
+    static_assert(WS_SERVER_MAX_CLIENT_COUNT >= CLIENT_COUNT, "build the bench with PICO_RADIO_MAX_CLIENTS=16");
+
+    NetworkTableInstance *nt = new NetworkTableInstance();
+    nt->startServer();
+    NTPublisher publisher(nt, "/robot/pose"s, NTDataValue(0.0));
+
+    static NtTestClient clients[CLIENT_COUNT];
+    uint64_t frames[CLIENT_COUNT] = {};
+    for (int i = 0; i < CLIENT_COUNT; i++)
+    {
+        REQUIRE(clients[i].connect("fanout"s + std::to_string(i)));
+        clients[i].subscribe(1, "/robot/pose"sv, "{\"periodic\":0}"sv);
+        clients[i].poll();
+        REQUIRE(clients[i].topicId("/robot/pose"sv) >= 0);
+
+        auto guard = hostsim::lock();
+        clients[i].connection.onWrite = [&frames, i](const char *data, size_t size)
+        { frames[i]++; };
+    }
+
+    uint64_t published = 0;
+    double ns = testing::measure("fan-out update to 16 clients", [&]()
+                                 {
+        publisher.setDouble((double)++published);
+        nt->flush(); });
+    printf("BENCH %-48s %12.1f ns/client\n", "fan-out per client", ns / CLIENT_COUNT);
+
+    // every update reached every client as its own write
+    for (int i = 0; i < CLIENT_COUNT; i++)
+        CHECK_EQ(frames[i], published);
+}
+
+TEST_MAIN()
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "testing.h"
+#include "nt/ntjson.hpp"
+
+using namespace std::literals;
+
+// Messages per second of the NT4 text frame tokenizer on the batches a dashboard sends after connecting.
+// Every message is walked like the server does: the method is looked up through a perfect hash,
+// every params key is read and the values of the other keys are skipped.
+
+/// @brief The subscriptions of a dashboard opening a tab with a few widgets and the field view
+static const std::string_view SUBSCRIBE_BATCH = R"([
+{"method":"subscribe","params":{"topics":[""],"subuid":1,"options":{"topicsonly":true,"prefix":true}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/"],"subuid":2,"options":{"periodic":0.1,"prefix":true}}},
+{"method":"subscribe","params":{"topics":["/Shuffleboard/"],"subuid":3,"options":{"periodic":0.1,"prefix":true}}},
+{"method":"subscribe","params":{"topics":["/FMSInfo/"],"subuid":4,"options":{"periodic":0.5,"prefix":true}}},
+{"method":"subscribe","params":{"topics":["/LiveWindow/.status/LW Enabled"],"subuid":5,"options":{"periodic":0.1}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Field/Robot","/SmartDashboard/Field/.type"],"subuid":6,"options":{"periodic":0.02,"all":false}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Auto Chooser/options","/SmartDashboard/Auto Chooser/active","/SmartDashboard/Auto Chooser/selected","/SmartDashboard/Auto Chooser/default"],"subuid":7,"options":{"periodic":0.1}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Drive/Left Speed","/SmartDashboard/Drive/Right Speed","/SmartDashboard/Drive/Heading"],"subuid":8,"options":{"periodic":0.02,"all":true}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Arm/Angle","/SmartDashboard/Arm/Setpoint","/SmartDashboard/Arm/At Goal"],"subuid":9,"options":{"periodic":0.05}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Vision/Targets","/SmartDashboard/Vision/Latency µs"],"subuid":10,"options":{"periodic":0.05,"topicsonly":false}}},
+{"method":"subscribe","params":{"topics":["$clients","$serverpub","$serversub"],"subuid":11,"options":{"periodic":1,"prefix":false}}},
+{"method":"subscribe","params":{"topics":["/photonvision/"],"subuid":12,"options":{"periodic":0.1,"prefix":true,"all":false,"topicsonly":false}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Pose \"estimate\""],"subuid":13,"options":{"periodic":0.02}}},
+{"method":"subscribe","params":{"topics":["/CameraPublisher/"],"subuid":14,"options":{"periodic":1,"prefix":true}}},
+{"method":"unsubscribe","params":{"subuid":4}},
+{"method":"subscribe","params":{"topics":["/FMSInfo/"],"subuid":15,"options":{"periodic":1.0e0,"prefix":true}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Climber/"],"subuid":16,"options":{"periodic":0.25,"prefix":true}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Intake/Has Note","/SmartDashboard/Intake/Current"],"subuid":17,"options":{"periodic":0.05}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Shooter/RPM","/SmartDashboard/Shooter/Target RPM"],"subuid":18,"options":{"periodic":0.02,"all":true}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Battery"],"subuid":19,"options":{"periodic":0.5}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Match Time"],"subuid":20,"options":{"periodic":0.5}}},
+{"method":"subscribe","params":{"topics":["/SmartDashboard/Alerts/errors","/SmartDashboard/Alerts/warnings","/SmartDashboard/Alerts/infos"],"subuid":21,"options":{"periodic":0.25}}}
+])";
+
+/// @brief The publishers and property changes of the same dashboard, tuning values and choosers it writes back
+static const std::string_view PUBLISH_BATCH = R"([
+{"method":"publish","params":{"name":"/SmartDashboard/Auto Chooser/selected","pubuid":1,"type":"string","properties":{}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Arm/kP","pubuid":2,"type":"double","properties":{"persistent":true}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Arm/kI","pubuid":3,"type":"double","properties":{"persistent":true}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Arm/kD","pubuid":4,"type":"double","properties":{"persistent":true}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Arm/Setpoint Offset","pubuid":5,"type":"double","properties":{}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Drive/Slow Mode","pubuid":6,"type":"boolean","properties":{"retained":true}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Shooter/Target RPM","pubuid":7,"type":"double","properties":{"persistent":true,"retained":true}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Vision/Pipeline","pubuid":8,"type":"int","properties":{}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Field/Waypoints","pubuid":9,"type":"double[]","properties":{}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Climber/Enable ✓","pubuid":10,"type":"boolean","properties":{}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Notes","pubuid":11,"type":"string","properties":{"persistent":true}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Alerts/acknowledged","pubuid":12,"type":"string[]","properties":{}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Intake/Reverse","pubuid":13,"type":"boolean","properties":{}}},
+{"method":"publish","params":{"name":"/Shuffleboard/.metadata/Selected","pubuid":14,"type":"string","properties":{}}},
+{"method":"setproperties","params":{"name":"/SmartDashboard/Arm/kP","update":{"persistent":true,"cached":true}}},
+{"method":"setproperties","params":{"name":"/SmartDashboard/Notes","update":{"retained":null}}},
+{"method":"unpublish","params":{"pubuid":5}},
+{"method":"publish","params":{"name":"/SmartDashboard/Arm/Setpoint Offset","pubuid":15,"type":"double","properties":{"cached":false}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Auto Delay","pubuid":16,"type":"float","properties":{}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Raw/Config","pubuid":17,"type":"raw","properties":{}}},
+{"method":"publish","params":{"name":"/SmartDashboard/Drive/Max Speed","pubuid":18,"type":"double","properties":{"persistent":true}}},
+{"method":"setproperties","params":{"name":"/SmartDashboard/Drive/Max Speed","update":{"persistent":false}}}
+])";
+
+static constexpr json::PerfectHash METHODS = std::array{
+    "publish"sv, "unpublish"sv, "setproperties"sv, "subscribe"sv,
+    "unsubscribe"sv, "announce"sv, "unannounce"sv, "properties"sv};
+
+static constexpr json::PerfectHash PARAM_KEYS = std::array{
+    "name"sv, "pubuid"sv, "subuid"sv, "type"sv, "topics"sv, "options"sv, "properties"sv, "update"sv};
+
+/// @brief Walks the messages of a text frame like the server
+/// @return The number of messages with a known method, -1 if the frame is invalid
+static int walk_messages(std::string_view frame)
+{
+    json::Tokenizer tokenizer((const uint8_t *)frame.data(), frame.size());
+    if (!tokenizer.next() || tokenizer.token() != json::Token::ArrayBegin)
+        return -1;
+
+    int messages = 0;
+    while (tokenizer.next() && tokenizer.token() == json::Token::ObjectBegin)
+    {
+        int method = -1;
+        int keys = 0;
+        while (tokenizer.next() && tokenizer.token() == json::Token::Key)
+        {
+            bool isMethod = tokenizer.string() == "method"sv;
+            bool isParams = tokenizer.string() == "params"sv;
+            if (!tokenizer.next())
+                return -1;
+
+            if (isMethod && tokenizer.token() == json::Token::Str)
+            {
+                method = METHODS.find(tokenizer.string());
+            }
+            else if (isParams && tokenizer.token() == json::Token::ObjectBegin)
+            {
+                while (tokenizer.next() && tokenizer.token() == json::Token::Key)
+                {
+                    keys += PARAM_KEYS.find(tokenizer.string()) >= 0;
+                    if (!tokenizer.next() || !tokenizer.skip())
+                        return -1;
+                }
+            }
+            else if (!tokenizer.skip())
+            {
+                return -1;
+            }
+        }
+
+        if (tokenizer.token() != json::Token::ObjectEnd || keys == 0)
+            return -1;
+        messages += method >= 0;
+    }
+
+    if (tokenizer.token() != json::Token::ArrayEnd || tokenizer.next() || tokenizer.has_error())
+        return -1;
+    return messages;
+}
+
+TEST(messages_per_second_on_dashboard_batches)
+{
+    int subscribeMessages = walk_messages(SUBSCRIBE_BATCH);
+    int publishMessages = walk_messages(PUBLISH_BATCH);
+    CHECK_EQ(subscribeMessages, 22);
+    CHECK_EQ(publishMessages, 22);
+
+    int walked = 0;
+    double subscribeNs = testing::measure("subscribe batch (22 messages)", [&]()
+                                          { walked += walk_messages(SUBSCRIBE_BATCH); });
+    double publishNs = testing::measure("publish batch (22 messages)", [&]()
+                                        { walked += walk_messages(PUBLISH_BATCH); });
+    CHECK(walked > 0);
+
+    printf("BENCH %-48s %12.0f messages/s %8.1f MB/s\n", "subscribe batch", subscribeMessages * 1e9 / subscribeNs, SUBSCRIBE_BATCH.size() * 1e3 / subscribeNs);
+    printf("BENCH %-48s %12.0f messages/s %8.1f MB/s\n", "publish batch", publishMessages * 1e9 / publishNs, PUBLISH_BATCH.size() * 1e3 / publishNs);
+}
+
+TEST_MAIN()
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+#include "testing.h"
+#include "ntclient.h"
+#include "nt/ntpublisher.h"
+
+using namespace std::literals;
+
+// Update latency of the NT4 WebSocket path and the UDP fast path under 2% loss.
+// The real server produces the bytes, which are then carried over a simulated Wi-Fi hop:
+//  - every transmission, including retransmissions, is lost independently with the same probability
+//  - a fixed one-way delay, ACKs are never lost and sent right away by the receiver
+//  - the TCP sender follows lwIP: Nagle unless disabled, fast retransmit on the third duplicate ACK,
+//    a retransmission timeout of at least one 500 ms slow timer tick that doubles on every retry,
+//    after which every unacknowledged byte is sent again starting from a window of one segment
+// Latency is the time from publishing a value until the client holds it or a newer value.
+
+static constexpr uint32_t PUBLISH_PERIOD_MS = 10;
+static constexpr uint32_t PUBLISH_COUNT = 6000;
+static constexpr uint16_t CLIENT_UDP_PORT = 6811;
+
+struct LinkModel
+{
+    uint64_t oneWayUs = 2000;
+    double loss = 0.02;
+    uint64_t minRtoUs = 500000;
+    size_t mss = 1460;
+};
+
+/// @brief Deterministic losses, so runs are comparable
+class LossGenerator
+{
+public:
+    LossGenerator(uint64_t seed, double loss) : state(seed), threshold((uint64_t)(loss * (double)UINT64_MAX)) {}
+
+    bool lost()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull < threshold;
+    }
+
+private:
+    uint64_t state;
+    uint64_t threshold;
+};
+
+/// @brief A chunk of bytes the server wrote or sent
+struct Transmission
+{
+    uint64_t timeUs;
+    std::string data;
+};
+
+/// @brief Carries a byte stream over a lossy hop like a lwIP TCP sender
+/// @return The times the receiver's in-order position advanced, as (stream offset, time) pairs
+static std::vector<std::pair<size_t, uint64_t>> simulate_tcp(const std::vector<Transmission> &writes, const LinkModel &link, bool nagle, uint64_t seed)
+{
+    enum class EventType
+    {
+        Write,
+        Arrive,
+        Ack,
+        Timeout
+    };
+
+    struct Event
+    {
+        uint64_t time;
+        uint64_t order;
+        EventType type;
+        size_t a;
+        size_t b;
+
+        bool operator>(const Event &other) const { return time != other.time ? time > other.time : order > other.order; }
+    };
+
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    uint64_t order = 0;
+    auto schedule = [&](uint64_t time, EventType type, size_t a, size_t b)
+    { events.push({time, order++, type, a, b}); };
+
+    LossGenerator losses(seed, link.loss);
+    std::vector<std::pair<size_t, uint64_t>> delivered;
+
+    // sender
+    size_t written = 0, sndUna = 0, sndNxt = 0;
+    int dupAcks = 0;
+    uint64_t rto = link.minRtoUs;
+    uint64_t timerGeneration = 0;
+    bool timerArmed = false;
+    /// set after a timeout until everything sent before it is acknowledged, the window then limits the segments in flight
+    bool timeoutRecovery = false;
+    size_t recoverPoint = 0;
+    size_t window = 0;
+    size_t inFlight = 0;
+
+    // receiver
+    size_t rcvNxt = 0;
+    std::map<size_t, size_t> outOfOrder;
+
+    auto armTimer = [&](uint64_t now)
+    {
+        timerArmed = true;
+        schedule(now + rto, EventType::Timeout, ++timerGeneration, 0);
+    };
+    auto transmit = [&](uint64_t now, size_t start, size_t length)
+    {
+        if (!losses.lost())
+            schedule(now + link.oneWayUs, EventType::Arrive, start, length);
+        if (!timerArmed)
+            armTimer(now);
+    };
+    auto trySend = [&](uint64_t now)
+    {
+        while (sndNxt < written && (!timeoutRecovery || inFlight < window))
+        {
+            size_t unsent = written - sndNxt;
+            if (nagle && sndUna < sndNxt && unsent < link.mss)
+                break;
+            size_t length = std::min(unsent, link.mss);
+            transmit(now, sndNxt, length);
+            sndNxt += length;
+            inFlight++;
+        }
+    };
+
+    for (size_t i = 0; i < writes.size(); i++)
+        schedule(writes[i].timeUs, EventType::Write, i, 0);
+
+    while (!events.empty())
+    {
+        Event event = events.top();
+        events.pop();
+        uint64_t now = event.time;
+
+        switch (event.type)
+        {
+        case EventType::Write:
+            written += writes[event.a].data.size();
+            trySend(now);
+            break;
+        case EventType::Arrive:
+        {
+            size_t start = event.a;
+            size_t end = start + event.b;
+            if (start <= rcvNxt && end > rcvNxt)
+            {
+                rcvNxt = end;
+                for (auto it = outOfOrder.begin(); it != outOfOrder.end() && it->first <= rcvNxt; it = outOfOrder.erase(it))
+                    rcvNxt = std::max(rcvNxt, it->first + it->second);
+                delivered.push_back({rcvNxt, now});
+            }
+            else if (start > rcvNxt)
+            {
+                outOfOrder[start] = std::max(outOfOrder[start], event.b);
+            }
+            schedule(now + link.oneWayUs, EventType::Ack, rcvNxt, 0);
+            break;
+        }
+        case EventType::Ack:
+        {
+            size_t ack = event.a;
+            if (ack > sndUna)
+            {
+                sndUna = ack;
+                sndNxt = std::max(sndNxt, sndUna);
+                dupAcks = 0;
+                rto = link.minRtoUs;
+                inFlight = inFlight > 0 ? inFlight - 1 : 0;
+                if (timeoutRecovery)
+                {
+                    window++; // slow start
+                    timeoutRecovery = sndUna < recoverPoint;
+                }
+
+                timerArmed = false;
+                timerGeneration++;
+                if (sndUna < sndNxt)
+                    armTimer(now);
+                trySend(now);
+            }
+            else if (ack == sndUna && sndUna < sndNxt && ++dupAcks == 3)
+            {
+                transmit(now, sndUna, std::min(link.mss, sndNxt - sndUna));
+            }
+            break;
+        }
+        case EventType::Timeout:
+            if (event.a != timerGeneration || sndUna == sndNxt)
+                break;
+            rto = std::min<uint64_t>(rto * 2, 60000000);
+            timeoutRecovery = true;
+            recoverPoint = sndNxt;
+            sndNxt = sndUna;
+            window = 1;
+            inFlight = 0;
+            timerArmed = false;
+            trySend(now);
+            break;
+        }
+    }
+
+    return delivered;
+}
+
+/// @brief Latency percentiles of one path
+struct LatencyReport
+{
+    size_t lost = 0;
+    std::vector<uint64_t> latencies;
+
+    uint64_t percentile(double p) const
+    {
+        std::vector<uint64_t> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[std::min(sorted.size() - 1, (size_t)(p * (double)sorted.size()))];
+    }
+
+    void print(const char *name) const
+    {
+        printf("LATENCY %-28s p50 %7.1f ms  p99 %7.1f ms  p99.9 %7.1f ms  max %7.1f ms  (%zu updates never arrived)\n", name,
+               percentile(0.5) / 1000.0, percentile(0.99) / 1000.0, percentile(0.999) / 1000.0, percentile(1.0) / 1000.0, lost);
+    }
+};
+
+/// @brief Turns the arrival time of each published value into latencies
+/// @param arrivals The earliest arrival time of each value, 0 if it never arrived
+static LatencyReport report(const std::vector<uint64_t> &published, const std::vector<uint64_t> &arrivals)
+{
+    LatencyReport result;
+    uint64_t newerArrival = UINT64_MAX;
+    for (size_t i = published.size(); i-- > 0;)
+    {
+        if (arrivals[i] == 0)
+            result.lost++;
+        else
+            newerArrival = std::min(newerArrival, arrivals[i]);
+
+        // the last values may never be superseded
+        if (newerArrival != UINT64_MAX)
+            result.latencies.push_back(newerArrival - published[i]);
+    }
+    return result;
+}
+
+/// @brief Returns the value updates of a WebSocket byte stream with the stream offset of their frame end
+static std::vector<std::pair<size_t, NtTestUpdate>> parse_stream(const std::string &stream)
+{
+    std::vector<std::pair<size_t, NtTestUpdate>> updates;
+    size_t offset = 0;
+    while (offset + 2 <= stream.size())
+    {
+        uint8_t opcode = (uint8_t)stream[offset] & 0x0f;
+        size_t length = (uint8_t)stream[offset + 1] & 0x7f;
+        size_t header = 2;
+        if (length == 126)
+        {
+            length = ((size_t)(uint8_t)stream[offset + 2] << 8) | (uint8_t)stream[offset + 3];
+            header = 4;
+        }
+        else if (length == 127)
+        {
+            length = 0;
+            for (size_t i = 0; i < 8; i++)
+                length = (length << 8) | (uint8_t)stream[offset + 2 + i];
+            header = 10;
+        }
+
+        size_t end = offset + header + length;
+        if (opcode == 0x2)
+        {
+            std::vector<NtTestUpdate> frameUpdates;
+            nt_parse_updates((const uint8_t *)stream.data() + offset + header, length, 0, frameUpdates);
+            for (auto &update : frameUpdates)
+                updates.push_back({end, std::move(update)});
+        }
+        offset = end;
+    }
+    return updates;
+}
+
+TEST(p99_latency_under_two_percent_loss)
+{
+    std::vector<Transmission> udpSends;
+    hostsim::setUdpOutput([&](struct udp_pcb *pcb, const uint8_t *data, size_t length, const ip_addr_t *to, uint16_t port)
+                          {
+        if (port == CLIENT_UDP_PORT)
+            udpSends.push_back({hostsim::now(), std::string((const char *)data, length)});
+        return ERR_OK; });
+
+    NetworkTableInstance *nt = new NetworkTableInstance();
+    nt->startServer();
+    NTPublisher *publisher = new NTPublisher(nt, "/robot/pose"s, NTDataValue(0.0));
+
+    NtTestClient tcpClient;
+    NtTestClient udpClient;
+    REQUIRE(tcpClient.connect("tcp"sv));
+    REQUIRE(udpClient.connect("udp"sv));
+    tcpClient.subscribe(1, "/robot/pose"sv, "{\"periodic\":0}"sv);
+    udpClient.subscribe(1, "/robot/pose"sv, "{\"periodic\":0,\"udp\":"s + std::to_string(CLIENT_UDP_PORT) + "}"s);
+    tcpClient.poll();
+    udpClient.poll();
+    int64_t tcpId = tcpClient.topicId("/robot/pose"sv);
+    int64_t udpId = udpClient.topicId("/robot/pose"sv);
+    REQUIRE(tcpId >= 0 && udpId >= 0);
+
+    std::vector<Transmission> tcpWrites;
+    {
+        auto guard = hostsim::lock();
+        tcpClient.connection.onWrite = [&](const char *data, size_t size)
+        {
+            uint64_t now = hostsim::now();
+            if (!tcpWrites.empty() && tcpWrites.back().timeUs == now)
+                tcpWrites.back().data.append(data, size);
+            else
+                tcpWrites.push_back({now, std::string(data, size)});
+        };
+    }
+    udpSends.clear();
+
+    std::vector<uint64_t> published;
+    for (uint32_t i = 1; i <= PUBLISH_COUNT; i++)
+    {
+        published.push_back(hostsim::now());
+        publisher->setDouble((double)i);
+        nt->flush();
+        hostsim::sleepMs(PUBLISH_PERIOD_MS);
+    }
+    hostsim::sleepMs(100);
+
+    LinkModel link;
+    std::string stream;
+    for (const auto &write : tcpWrites)
+        stream += write.data;
+    auto updates = parse_stream(stream);
+
+    printf("%u updates at %u Hz, %.0f%% loss, %.1f ms one-way delay, %zu WebSocket writes, %zu datagrams\n", PUBLISH_COUNT,
+           1000 / PUBLISH_PERIOD_MS, link.loss * 100, link.oneWayUs / 1000.0, tcpWrites.size(), udpSends.size());
+
+    LatencyReport tcpReports[2];
+    for (int nagle = 1; nagle >= 0; nagle--)
+    {
+        auto delivered = simulate_tcp(tcpWrites, link, nagle, 1);
+        std::vector<uint64_t> arrivals(PUBLISH_COUNT, 0);
+        for (const auto &[end, update] : updates)
+        {
+            auto at = std::lower_bound(delivered.begin(), delivered.end(), std::make_pair(end, (uint64_t)0));
+            size_t index = (size_t)update.value.f64 - 1;
+            if (update.id == tcpId && at != delivered.end() && index < PUBLISH_COUNT)
+                arrivals[index] = at->second;
+        }
+        tcpReports[nagle] = report(published, arrivals);
+        tcpReports[nagle].print(nagle ? "websocket (lwIP Nagle)" : "websocket (TCP_NODELAY)");
+    }
+
+    LossGenerator udpLosses(2, link.loss);
+    std::vector<uint64_t> udpArrivals(PUBLISH_COUNT, 0);
+    int64_t newestSequence = -1;
+    size_t stale = 0;
+    for (const auto &send : udpSends)
+    {
+        if (udpLosses.lost())
+            continue;
+
+        std::vector<NtTestUpdate> received;
+        nt_parse_updates((const uint8_t *)send.data.data(), send.data.size(), send.timeUs + link.oneWayUs, received);
+        for (const auto &update : received)
+        {
+            // clients drop updates older than the newest they have
+            if (update.id != udpId || update.sequence <= newestSequence)
+            {
+                stale++;
+                continue;
+            }
+            newestSequence = update.sequence;
+            size_t index = (size_t)update.value.f64 - 1;
+            if (index < PUBLISH_COUNT)
+                udpArrivals[index] = update.receivedUs;
+        }
+    }
+    LatencyReport udpReport = report(published, udpArrivals);
+    udpReport.print("udp fast path");
+
+    CHECK_EQ(stale, (size_t)0);
+    CHECK(udpReport.percentile(0.99) < tcpReports[1].percentile(0.99));
+    CHECK(udpReport.percentile(0.99) < tcpReports[0].percentile(0.99));
+
+    // the server is stopped once it has seen the clients disconnect
+    tcpClient.disconnect();
+    udpClient.disconnect();
+    hostsim::sleepMs(100);
+    delete publisher;
+    nt->stop();
+    delete nt;
+    hostsim::setUdpOutput(nullptr);
+}
+
+TEST_MAIN()
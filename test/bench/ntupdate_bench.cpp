@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "testing.h"
+#include "ntclient.h"
+#include "nt/ntpublisher.h"
+
+using namespace std::literals;
+
+// Value updates per second of a server with 500 topics and 8 clients subscribed to all of them.
+// Client updates are handed to the server as decoded WebSocket frames, local updates go through NTPublisher.
+// The written frames are counted and dropped, the caches are flushed once per pass over the topics.
+
+static constexpr int TOPIC_COUNT = 500;
+static constexpr int CLIENT_COUNT = 8;
+
+/// @brief Returns the topic name of an index
+static std::string topic_name(int index)
+{
+    return "/SmartDashboard/bench/"s + std::to_string(index);
+}
+
+/// @brief Packs a double value update of a publisher like a NT4 client
+static std::vector<uint8_t> pack_update(int32_t pubuid, double value)
+{
+    msgpack::Packer<false> packer;
+    packer.pack_array_header(4);
+    int64_t id = pubuid;
+    int64_t time = 0;
+    uint8_t type = (uint8_t)NTDataType::Float64;
+    packer.process(id, time, type);
+    NTDataValue(value).pack(packer);
+    return packer.vector();
+}
+
+TEST(updates_with_500_topics_and_8_clients)
+{
+    NetworkTableInstance *nt = new NetworkTableInstance();
+    nt->startServer();
+
+    std::vector<NTPublisher *> publishers;
+    for (int i = 0; i < TOPIC_COUNT; i++)
+        publishers.push_back(new NTPublisher(nt, topic_name(TOPIC_COUNT + i), NTDataValue(0.0)));
+
+    static NtTestClient clients[CLIENT_COUNT];
+    uint64_t frames[CLIENT_COUNT] = {};
+    for (int i = 0; i < CLIENT_COUNT; i++)
+    {
+        REQUIRE(clients[i].connect("dashboard"s + std::to_string(i)));
+        clients[i].subscribe(1, "/SmartDashboard/"sv, "{\"prefix\":true,\"periodic\":0}"sv);
+        clients[i].poll();
+    }
+
+    // the first client to connect holds the first client id
+    constexpr WsClientId PUBLISHER_CLIENT_ID = 0;
+    for (int i = 0; i < TOPIC_COUNT; i++)
+        clients[0].publish(i + 1, topic_name(i), "double"sv);
+    for (int i = 0; i < CLIENT_COUNT; i++)
+    {
+        clients[i].poll();
+        REQUIRE(clients[i].announced.size() == 2 * TOPIC_COUNT);
+    }
+
+    for (int i = 0; i < CLIENT_COUNT; i++)
+    {
+        auto guard = hostsim::lock();
+        clients[i].connection.onWrite = [&frames, i](const char *data, size_t size)
+        { frames[i]++; };
+    }
+
+    std::vector<std::vector<uint8_t>> updates;
+    for (int i = 0; i < TOPIC_COUNT; i++)
+        updates.push_back(pack_update(i + 1, (double)i));
+
+    uint64_t count = 0;
+    double clientNs = testing::measure("client update, 500 topics x 8 clients", [&]()
+                                       {
+        std::vector<uint8_t> &update = updates[count % TOPIC_COUNT];
+        nt->_handleFrame(PUBLISHER_CLIENT_ID, WebSocketFrame(false, WebSocketOpCode::BinaryFrame, update.data(), update.size()));
+        if (++count % TOPIC_COUNT == 0)
+            nt->flush(); });
+
+    count = 0;
+    double localNs = testing::measure("local update, 500 topics x 8 clients", [&]()
+                                      {
+        publishers[count % TOPIC_COUNT]->setDouble((double)count);
+        if (++count % TOPIC_COUNT == 0)
+            nt->flush(); });
+
+    printf("BENCH %-48s %12.0f updates/s\n", "client update, sent to each client", CLIENT_COUNT * 1e9 / clientNs);
+    printf("BENCH %-48s %12.0f updates/s\n", "local update, sent to each client", CLIENT_COUNT * 1e9 / localNs);
+
+    // the updates were batched into frames, and every client still receives the newest value
+    nt->flush();
+    for (int i = 0; i < CLIENT_COUNT; i++)
+    {
+        CHECK(frames[i] > 0);
+        auto guard = hostsim::lock();
+        clients[i].connection.onWrite = nullptr;
+        clients[i].updates.clear();
+    }
+
+    std::vector<uint8_t> last = pack_update(TOPIC_COUNT, -1.0);
+    nt->_handleFrame(PUBLISHER_CLIENT_ID, WebSocketFrame(false, WebSocketOpCode::BinaryFrame, last.data(), last.size()));
+    nt->flush();
+    for (int i = 0; i < CLIENT_COUNT; i++)
+    {
+        int64_t id = clients[i].topicId(topic_name(TOPIC_COUNT - 1));
+        REQUIRE(clients[i].waitForUpdate(id, 100));
+        CHECK_EQ(clients[i].updates.back().value.f64, -1.0);
+    }
+}
+
+TEST_MAIN()
@@ -0,0 +1,60 @@
+#include <string>
+#include "testing.h"
+#include "faketcp.h"
+#include "textstream.h"
+
+using namespace std::literals;
+
+/// @brief A browser-like upgrade request of about 2 KB
+static std::string header_block()
+{
+    std::string block = "GET /nt/dashboard HTTP/1.1\r\n"
+                        "Host: 10.67.31.2:5810\r\n"
+                        "Connection: Upgrade\r\n"
+                        "Upgrade: websocket\r\n"
+                        "Sec-WebSocket-Version: 13\r\n"
+                        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                        "Sec-WebSocket-Protocol: v4.1.networktables.first.wpi.edu, networktables.first.wpi.edu\r\n"
+                        "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n"
+                        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/126.0.0.0 Safari/537.36\r\n"
+                        "Accept-Encoding: gzip, deflate\r\n"
+                        "Accept-Language: en-US,en;q=0.9\r\n"
+                        "Cache-Control: no-cache\r\n"
+                        "Pragma: no-cache\r\n"
+                        "Origin: http://10.67.31.5:8080\r\n";
+    for (int i = 0; block.size() < 2000; i++)
+        block += "X-Dashboard-Widget-" + std::to_string(i) + ": /SmartDashboard/Widgets/Layout/Tab/Column" + std::to_string(i) + "\r\n";
+    block += "\r\n";
+    return block;
+}
+
+static void bench_header(const char *name, size_t segmentSize)
+{
+    FakeTcpConnection connection;
+    connection.segmentSize = segmentSize;
+    connection.push(header_block());
+    TcpClient *client = faketcp::connect(&connection);
+
+    size_t lines = 0;
+    double ns = testing::measure(name, [&]()
+                                 {
+        connection.inputOffset = 0; // replay the block, only this thread reads it
+        TextStream stream(client, 1024);
+        TextStreamResult result;
+        while (!stream.readLine(1000, &result).empty())
+            lines++;
+        if (result != TextStreamResult::Ok)
+            abort(); });
+
+    printf("     %zu byte header block, %.1f MB/s\n", connection.input.size(), connection.input.size() / ns * 1e3);
+    CHECK(lines > 0);
+    delete client;
+}
+
+TEST(parse_2kb_header_block)
+{
+    bench_header("textstream/2kb_header/1460b_segments", 1460);
+    bench_header("textstream/2kb_header/128b_segments", 128);
+}
+
+TEST_MAIN()
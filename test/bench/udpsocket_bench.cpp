@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include "testing.h"
+#include "hostsim.h"
+#include "udpsocket.h"
+
+// Packets per second of small telemetry datagrams through UdpSocket on the host lwIP shim.
+// The driver output only counts the datagrams, so the numbers are the cost of the socket and lwIP path.
+
+static constexpr uint16_t PAYLOAD_LENGTH = 64;
+static constexpr size_t BATCH_SIZE = UDP_SOCKET_MAX_PENDING_SENDS;
+
+static void on_send_complete(UdpSocket *socket, const void *data, void *args)
+{
+    (*(uint64_t *)args)++;
+}
+
+TEST(packets_per_second)
+{
+    uint64_t sent = 0;
+    hostsim::setUdpOutput([&](struct udp_pcb *pcb, const uint8_t *data, size_t length, const ip_addr_t *to, uint16_t port)
+                          {
+        sent++;
+        return ERR_OK; });
+
+    UdpSocket socket(5900);
+    static uint8_t payload[PAYLOAD_LENGTH];
+    ip_addr_t to = IPADDR4_INIT_BYTES(10, 67, 31, 5);
+
+    testing::measure("udp send, copied", [&]()
+                     {
+        Datagram datagram(payload, PAYLOAD_LENGTH, &to, 5901);
+        socket.sendDatagram(&datagram); });
+
+    uint64_t completions = 0;
+    testing::measure("udp send, zero-copy", [&]()
+                     {
+        Datagram datagram(payload, PAYLOAD_LENGTH, &to, 5901);
+        socket.sendDatagramRef(&datagram, on_send_complete, &completions); });
+
+    double batchNs = testing::measure("udp sendMany, batch of 8", [&]()
+                                      {
+        Datagram batch[BATCH_SIZE] = {
+            {payload, PAYLOAD_LENGTH, &to, 5901}, {payload, PAYLOAD_LENGTH, &to, 5901},
+            {payload, PAYLOAD_LENGTH, &to, 5901}, {payload, PAYLOAD_LENGTH, &to, 5901},
+            {payload, PAYLOAD_LENGTH, &to, 5901}, {payload, PAYLOAD_LENGTH, &to, 5901},
+            {payload, PAYLOAD_LENGTH, &to, 5901}, {payload, PAYLOAD_LENGTH, &to, 5901}};
+        socket.sendMany(batch, BATCH_SIZE); });
+    printf("BENCH %-48s %12.0f packets/s\n", "udp sendMany, batch of 8", BATCH_SIZE * 1e9 / batchNs);
+
+    uint64_t sentBeforeBroadcast = sent;
+    testing::measure("udp broadcast", [&]()
+                     {
+        Datagram datagram(payload, PAYLOAD_LENGTH, 5901);
+        socket.broadcast(&datagram); });
+
+    CHECK(sentBeforeBroadcast > 0);
+    CHECK(sent > sentBeforeBroadcast);
+    // every zero-copy send was completed, the host driver releases the pbufs right away
+    CHECK(completions > 0);
+    CHECK_EQ(socket.stats.sendSlotsExhausted, 0u);
+
+    socket.deinit();
+    hostsim::setUdpOutput(nullptr);
+}
+
+TEST_MAIN()
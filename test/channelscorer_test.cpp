@@ -0,0 +1,87 @@
+#include <stddef.h>
+#include "testing.h"
+#include "channelscorer.h"
+
+struct ScanRecord
+{
+    uint8_t bssid[6];
+    int channel;
+    int rssi;
+};
+
+// A scan of an office floor, networks appear once per beacon or probe response
+static const ScanRecord OFFICE_SCAN[] = {
+    {{0x3c, 0x37, 0x86, 0x10, 0x00, 0x01}, 1, -45},
+    {{0x3c, 0x37, 0x86, 0x10, 0x00, 0x02}, 1, -61},
+    {{0x3c, 0x37, 0x86, 0x10, 0x00, 0x01}, 1, -47},
+    {{0x74, 0xac, 0xb9, 0x22, 0x41, 0x10}, 6, -52},
+    {{0x74, 0xac, 0xb9, 0x22, 0x41, 0x11}, 6, -55},
+    {{0x3c, 0x37, 0x86, 0x10, 0x00, 0x03}, 1, -70},
+    {{0x74, 0xac, 0xb9, 0x22, 0x41, 0x12}, 6, -66},
+    {{0x9c, 0x53, 0x22, 0x7a, 0x0b, 0x01}, 3, -75},
+    {{0x74, 0xac, 0xb9, 0x22, 0x41, 0x10}, 6, -53},
+    {{0xf4, 0x92, 0xbf, 0x01, 0x33, 0x70}, 11, -85},
+    {{0x74, 0xac, 0xb9, 0x22, 0x41, 0x13}, 6, -80},
+    {{0xf4, 0x92, 0xbf, 0x01, 0x33, 0x71}, 11, -88},
+    {{0x00, 0x1a, 0x2b, 0x3c, 0x4d, 0x5e}, 9, -90},
+    {{0x3c, 0x37, 0x86, 0x10, 0x00, 0x02}, 1, -60},
+    {{0xf4, 0x92, 0xbf, 0x01, 0x33, 0x70}, 11, -86},
+};
+
+TEST(picks_the_quietest_channel_of_a_recorded_scan)
+{
+    ChannelScorer scorer;
+    int added = 0;
+    for (const ScanRecord &record : OFFICE_SCAN)
+    {
+        if (scorer.add(record.bssid, record.channel, record.rssi))
+            added++;
+    }
+
+    // every repeated beacon is ignored
+    CHECK_EQ(added, 11);
+    CHECK_EQ(scorer.getNetworkCount(), (size_t)11);
+
+    CHECK_EQ(scorer.getBestChannel(), 11);
+    CHECK(scorer.getScore(11) < scorer.getScore(1));
+    CHECK(scorer.getScore(11) < scorer.getScore(6));
+    // channel 3 overlaps both crowded channels
+    CHECK(scorer.getScore(3) > scorer.getScore(1));
+}
+
+TEST(ignores_channels_outside_the_band)
+{
+    ChannelScorer scorer;
+    uint8_t bssid[6] = {0x02, 0, 0, 0, 0, 1};
+    CHECK(!scorer.add(bssid, 0, -40));
+    CHECK(!scorer.add(bssid, 13, -40));
+    CHECK_EQ(scorer.getNetworkCount(), (size_t)0);
+    CHECK_EQ(scorer.getScore(12), UINT32_MAX);
+}
+
+TEST(scores_networks_past_the_bssid_table)
+{
+    ChannelScorer scorer;
+    uint8_t bssid[6] = {0x02, 0, 0, 0, 0, 0};
+
+    // fill the table with barely audible networks on channel 1
+    for (size_t i = 0; i < CHANNEL_SCORER_MAX_NETWORKS; i++)
+    {
+        bssid[5] = (uint8_t)i;
+        REQUIRE(scorer.add(bssid, 1, -100));
+    }
+
+    // strong networks found after the table is full still crowd channel 6
+    bssid[4] = 1;
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        bssid[5] = i;
+        CHECK(scorer.add(bssid, 6, -40));
+    }
+
+    CHECK_EQ(scorer.getNetworkCount(), CHANNEL_SCORER_MAX_NETWORKS + 5);
+    CHECK_EQ(scorer.getScore(6), 5u * 60u * CHANNEL_SCORER_OVERLAP);
+    CHECK_EQ(scorer.getBestChannel(), 11);
+}
+
+TEST_MAIN()
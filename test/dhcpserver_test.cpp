@@ -0,0 +1,118 @@
+#include <stddef.h>
+#include <vector>
+#include "testing.h"
+#include "hostsim.h"
+#include "dhcpclient.h"
+
+TEST(offers_the_same_address_again_to_a_client)
+{
+    DhcpTestServer server;
+    uint8_t mac[6] = {0x02, 0, 0, 0, 0, 1};
+
+    int offered = server.discover(mac);
+    REQUIRE(offered >= 0);
+    CHECK_EQ(server.lastType, DHCP_TEST_OFFER);
+    CHECK_EQ(server.request(mac, offered), offered);
+    CHECK_EQ(server.lastType, DHCP_TEST_ACK);
+    CHECK_EQ(server.discover(mac), offered);
+}
+
+TEST(finds_a_requested_lease_off_the_probe_chain_of_its_mac)
+{
+    DhcpTestServer server;
+    uint8_t mac[6] = {0x02, 0, 0, 0, 0, 2};
+
+    // an address the client remembers from before, the lookup of its MAC starts at a free lease
+    int requested = (dhcp_test_mac_hash(mac) + 3) % DHCPS_MAX_IP;
+    CHECK_EQ(server.request(mac, requested), requested);
+    CHECK_EQ(server.lastType, DHCP_TEST_ACK);
+
+    CHECK_EQ(server.discover(mac), requested);
+    CHECK_EQ(server.lastType, DHCP_TEST_OFFER);
+    CHECK_EQ(server.countLeases(mac), 1);
+}
+
+TEST(releases_the_previous_lease_when_a_client_requests_another_address)
+{
+    DhcpTestServer server;
+    uint8_t mac[6] = {0x02, 0, 0, 0, 0, 3};
+
+    int offered = server.discover(mac);
+    REQUIRE(offered >= 0);
+    CHECK_EQ(server.request(mac, offered), offered);
+
+    int other = (offered + 5) % DHCPS_MAX_IP;
+    CHECK_EQ(server.request(mac, other), other);
+    CHECK_EQ(server.countLeases(mac), 1);
+    CHECK_EQ(server.discover(mac), other);
+
+    // the released address can be taken by another client
+    uint8_t otherMac[6] = {0x02, 0, 0, 0, 0, 4};
+    CHECK_EQ(server.request(otherMac, offered), offered);
+}
+
+TEST(rejects_a_request_for_an_address_leased_to_another_client)
+{
+    DhcpTestServer server;
+    uint8_t first[6] = {0x02, 0, 0, 0, 1, 1};
+    uint8_t second[6] = {0x02, 0, 0, 0, 1, 2};
+
+    int offered = server.discover(first);
+    REQUIRE(offered >= 0);
+    CHECK_EQ(server.request(first, offered), offered);
+    CHECK_EQ(server.request(second, offered), -1);
+}
+
+TEST(acknowledges_a_rapid_commit_discover)
+{
+    DhcpTestServer server;
+    uint8_t mac[6] = {0x02, 0, 0, 0, 2, 1};
+
+    int acked = server.discover(mac, true);
+    REQUIRE(acked >= 0);
+    CHECK_EQ(server.lastType, DHCP_TEST_ACK);
+    CHECK(server.lastRapidCommit);
+    CHECK_EQ(server.countLeases(mac), 1);
+}
+
+TEST(restores_persisted_leases)
+{
+    uint8_t mac[6] = {0x02, 0, 0, 0, 3, 1};
+    int leased;
+    {
+        DhcpTestServer server;
+        leased = (dhcp_test_mac_hash(mac) + 7) % DHCPS_MAX_IP;
+        CHECK_EQ(server.request(mac, leased), leased);
+    }
+
+    DhcpTestServer server(true);
+    CHECK_EQ(server.countLeases(mac), 1);
+    CHECK_EQ(server.discover(mac), leased);
+}
+
+TEST(gives_restored_leases_to_new_clients_when_the_pool_is_full)
+{
+    uint8_t mac[6] = {0x02, 0, 0, 0, 4, 0};
+    {
+        DhcpTestServer server;
+        for (int i = 0; i < DHCPS_MAX_IP; i++)
+        {
+            mac[5] = (uint8_t)i;
+            REQUIRE(server.discover(mac, true) >= 0);
+        }
+        mac[5] = DHCPS_MAX_IP;
+        CHECK_EQ(server.discover(mac), -1);
+    }
+
+    // the restored leases are expired, the clients may be gone
+    DhcpTestServer server(true);
+    mac[5] = 0;
+    int returning = server.discover(mac, true);
+    CHECK(returning >= 0);
+    mac[5] = DHCPS_MAX_IP;
+    int joined = server.discover(mac, true);
+    CHECK(joined >= 0);
+    CHECK(joined != returning);
+}
+
+TEST_MAIN()
@@ -0,0 +1,130 @@
+#include <string.h>
+#include "dhcpclient.h"
+#include "hostsim.h"
+
+// The offsets of a BOOTP message, see dhcp_msg_t
+static constexpr size_t DHCP_XID = 4;
+static constexpr size_t DHCP_YIADDR = 16;
+static constexpr size_t DHCP_CHADDR = 28;
+static constexpr size_t DHCP_OPTIONS = 236;
+static constexpr size_t DHCP_MESSAGE_SIZE = 300;
+
+static constexpr uint16_t DHCP_SERVER_PORT = 67;
+static constexpr uint16_t DHCP_CLIENT_PORT = 68;
+
+DhcpTestServer::DhcpTestServer(bool restore)
+{
+    if (!restore)
+        hostsim::eraseFlash();
+
+    hostsim::setUdpOutput([this](struct udp_pcb *pcb, const uint8_t *data, size_t length, const ip_addr_t *to, uint16_t port)
+                          {
+        if (port == DHCP_CLIENT_PORT)
+            replies.emplace_back((const char *)data, length);
+        return ERR_OK; });
+
+    ip_addr_t ip = IPADDR4_INIT_BYTES(10, 67, 31, 1);
+    ip_addr_t nm = IPADDR4_INIT_BYTES(255, 255, 255, 0);
+    dhcp_server_init(&server, &ip, &nm);
+}
+
+DhcpTestServer::~DhcpTestServer()
+{
+    // lets the timer task finish writing the leases
+    hostsim::sleepMs(1);
+    dhcp_server_deinit(&server);
+    hostsim::setUdpOutput(nullptr);
+}
+
+int DhcpTestServer::send(const uint8_t *mac, uint8_t type, int requestedLease, bool rapidCommit)
+{
+    uint8_t msg[DHCP_MESSAGE_SIZE] = {};
+    msg[0] = 1; // BOOTREQUEST
+    msg[1] = 1; // ethernet
+    msg[2] = 6;
+    uint32_t id = xid++;
+    memcpy(msg + DHCP_XID, &id, sizeof(id));
+    memcpy(msg + DHCP_CHADDR, mac, 6);
+
+    uint8_t *opt = msg + DHCP_OPTIONS;
+    *opt++ = 99; // magic cookie
+    *opt++ = 130;
+    *opt++ = 83;
+    *opt++ = 99;
+    *opt++ = 53; // message type
+    *opt++ = 1;
+    *opt++ = type;
+    if (requestedLease >= 0)
+    {
+        *opt++ = 50; // requested IP address
+        *opt++ = 4;
+        *opt++ = 10;
+        *opt++ = 67;
+        *opt++ = 31;
+        *opt++ = (uint8_t)(DHCPS_BASE_IP + requestedLease);
+    }
+    if (rapidCommit)
+    {
+        *opt++ = 80;
+        *opt++ = 0;
+    }
+    *opt++ = 255;
+
+    replies.clear();
+    ip_addr_t from = IPADDR4_INIT(0);
+    hostsim::deliverUdp(server.udp, msg, sizeof(msg), &from, DHCP_CLIENT_PORT);
+
+    lastType = 0;
+    lastRapidCommit = false;
+    if (replies.empty())
+        return -1;
+
+    const std::string &reply = replies.back();
+    if (reply.size() < DHCP_OPTIONS + 4 || memcmp(reply.data() + DHCP_XID, &id, sizeof(id)) != 0)
+        return -1;
+
+    for (size_t i = DHCP_OPTIONS + 4; i + 1 < reply.size() && (uint8_t)reply[i] != 255;)
+    {
+        uint8_t code = reply[i];
+        if (code == 0)
+        {
+            i++;
+            continue;
+        }
+        if (code == 53)
+            lastType = reply[i + 2];
+        else if (code == 80)
+            lastRapidCommit = true;
+        i += 2 + (uint8_t)reply[i + 1];
+    }
+    return (uint8_t)reply[DHCP_YIADDR + 3] - DHCPS_BASE_IP;
+}
+
+int DhcpTestServer::discover(const uint8_t *mac, bool rapidCommit)
+{
+    return send(mac, 1, -1, rapidCommit);
+}
+
+int DhcpTestServer::request(const uint8_t *mac, int lease)
+{
+    return send(mac, 3, lease, false);
+}
+
+int DhcpTestServer::countLeases(const uint8_t *mac) const
+{
+    int count = 0;
+    for (const dhcp_server_lease_t &lease : server.lease)
+    {
+        if (memcmp(lease.mac, mac, 6) == 0)
+            count++;
+    }
+    return count;
+}
+
+uint32_t dhcp_test_mac_hash(const uint8_t *mac)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 6; i++)
+        hash = (hash ^ mac[i]) * 16777619u;
+    return hash % DHCPS_MAX_IP;
+}
@@ -0,0 +1,48 @@
+#ifndef _DHCP_CLIENT_H_
+#define _DHCP_CLIENT_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "dhcpserver.h"
+
+#define DHCP_TEST_OFFER (2)
+#define DHCP_TEST_ACK (5)
+
+/// @brief A dhcp_server_t on 10.67.31.1 and a DHCP client talking to it through the lwIP shim
+/// @note Requests are passed straight to the receive callback of the server, replies are captured by the UDP output hook
+class DhcpTestServer
+{
+public:
+    /// @brief Initializes the server
+    /// @param restore Keeps the leases in the simulated flash, otherwise it is erased first
+    DhcpTestServer(bool restore = false);
+    ~DhcpTestServer();
+
+    /// @brief Sends a DISCOVER
+    /// @param rapidCommit Asks the server to skip the offer
+    /// @return The offered or acknowledged lease index, or -1 if the server did not reply
+    int discover(const uint8_t *mac, bool rapidCommit = false);
+    /// @brief Sends a REQUEST for a lease index
+    /// @return The acknowledged lease index, or -1 if the server did not reply
+    int request(const uint8_t *mac, int lease);
+    /// @brief Returns the number of leases held by a MAC address
+    int countLeases(const uint8_t *mac) const;
+
+    dhcp_server_t server;
+    /// @brief The message type of the last reply
+    uint8_t lastType = 0;
+    /// @brief True if the last reply had the rapid commit option
+    bool lastRapidCommit = false;
+
+private:
+    std::vector<std::string> replies;
+    uint32_t xid = 1;
+
+    int send(const uint8_t *mac, uint8_t type, int requestedLease, bool rapidCommit);
+};
+
+/// @brief The lease a DISCOVER of an unknown MAC address probes first, the FNV-1a hash of dhcpserver.c
+uint32_t dhcp_test_mac_hash(const uint8_t *mac);
+
+#endif
@@ -0,0 +1,257 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include "faketcp.h"
+#include "tcpclient.h"
+#include "tcplistener.h"
+
+// the socket of a fake TcpClient is the index of its connection
+static std::vector<FakeTcpConnection *> connections;
+static std::deque<FakeTcpConnection *> pendingAccepts;
+static std::deque<FakeTcpConnection *> pendingConnects;
+static hostsim::WaitQueue acceptable;
+
+void FakeTcpConnection::push(std::string_view data)
+{
+    auto guard = hostsim::lock();
+    input.append(data);
+    readable.wakeAll();
+}
+
+void FakeTcpConnection::closeInput()
+{
+    auto guard = hostsim::lock();
+    closeAtEnd = true;
+    readable.wakeAll();
+}
+
+std::string FakeTcpConnection::takeOutput()
+{
+    auto guard = hostsim::lock();
+    std::string taken;
+    taken.swap(output);
+    return taken;
+}
+
+bool FakeTcpConnection::waitForOutput(size_t length, uint32_t timeoutMs)
+{
+    auto guard = hostsim::lock();
+    uint64_t deadline = hostsim::deadlineAfterMs(timeoutMs);
+    while (output.size() < length && !disconnected)
+    {
+        if (!writable.wait(guard, deadline))
+            return false;
+    }
+    return output.size() >= length;
+}
+
+bool FakeTcpConnection::isDisconnected()
+{
+    auto guard = hostsim::lock();
+    return disconnected;
+}
+
+static FakeTcpConnection *connection_of(int sock)
+{
+    return connections.at(sock);
+}
+
+namespace faketcp
+{
+    TcpClient *connect(FakeTcpConnection *connection)
+    {
+        int sock;
+        {
+            auto guard = hostsim::lock();
+            sock = (int)connections.size();
+            connections.push_back(connection);
+        }
+
+        struct sockaddr_in sin = {};
+        sin.sin_family = AF_INET;
+        sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sin.sin_port = htons(50000 + sock);
+        return new TcpClient(sock, sin);
+    }
+
+    void queueAccept(FakeTcpConnection *connection)
+    {
+        auto guard = hostsim::lock();
+        pendingAccepts.push_back(connection);
+        acceptable.wakeAll();
+    }
+
+    void queueConnect(FakeTcpConnection *connection)
+    {
+        auto guard = hostsim::lock();
+        pendingConnects.push_back(connection);
+    }
+
+    void pair(FakeTcpConnection *a, FakeTcpConnection *b)
+    {
+        auto guard = hostsim::lock();
+        a->peer = b;
+        b->peer = a;
+    }
+}
+
+TcpClient::TcpClient(int sock, struct sockaddr_in sin) : sock(sock), sin(sin), connected(true)
+{
+}
+
+TcpClient::TcpClient(ip4_addr_t addr, int port) : sock(-1), connected(false)
+{
+    sin = {};
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = addr.addr;
+    sin.sin_port = htons(port);
+
+    auto guard = hostsim::lock();
+    if (pendingConnects.empty())
+    {
+        printf("[HOST] No fake connection queued for %s:%d\n", ip4addr_ntoa(&addr), port);
+        return;
+    }
+
+    sock = (int)connections.size();
+    connections.push_back(pendingConnects.front());
+    pendingConnects.pop_front();
+    connected = true;
+}
+
+TcpClient::~TcpClient()
+{
+    disconnect();
+}
+
+void TcpClient::disconnect()
+{
+    if (connected)
+    {
+        auto guard = hostsim::lock();
+        FakeTcpConnection *connection = connection_of(sock);
+        connection->disconnected = true;
+        connection->readable.wakeAll();
+        connection->writable.wakeAll();
+        if (connection->peer != nullptr)
+        {
+            connection->peer->closeAtEnd = true;
+            connection->peer->readable.wakeAll();
+        }
+        connected = false;
+    }
+}
+
+bool TcpClient::isConnected()
+{
+    return connected;
+}
+
+ssize_t TcpClient::readBytes(void *mem, size_t len)
+{
+    return readBytes(mem, len, TCP_INFINITE_TIMEOUT);
+}
+
+ssize_t TcpClient::readBytes(void *mem, size_t len, uint32_t timeout)
+{
+    assert(connected == true);
+
+    if (len <= 0)
+        return -1;
+
+    FakeTcpConnection *connection;
+    {
+        auto guard = hostsim::lock();
+        connection = connection_of(sock);
+        uint64_t deadline = hostsim::deadlineAfterMs(timeout);
+        while (connection->inputOffset == connection->input.size() && !connection->closeAtEnd && !connection->disconnected)
+        {
+            if (!connection->readable.wait(guard, deadline))
+                return 0; // hit timeout
+        }
+
+        size_t available = connection->input.size() - connection->inputOffset;
+        if (available > 0 && !connection->disconnected)
+        {
+            size_t n = std::min({len, available, connection->segmentSize});
+            memcpy(mem, connection->input.data() + connection->inputOffset, n);
+            connection->inputOffset += n;
+            return n;
+        }
+    }
+
+    disconnect(); // the peer closed its side
+    return -1;
+}
+
+ssize_t TcpClient::writeBytes(const void *data, size_t size)
+{
+    assert(connected == true);
+
+    auto guard = hostsim::lock();
+    FakeTcpConnection *connection = connection_of(sock);
+    if (connection->onWrite)
+    {
+        guard.unlock();
+        connection->onWrite((const char *)data, size);
+        return size;
+    }
+
+    if (connection->peer != nullptr)
+    {
+        connection->peer->input.append((const char *)data, size);
+        connection->peer->readable.wakeAll();
+    }
+    else
+    {
+        connection->output.append((const char *)data, size);
+    }
+    connection->writable.wakeAll();
+    return size;
+}
+
+struct sockaddr_in TcpClient::getSocketAddress()
+{
+    return sin;
+}
+
+TcpListener::TcpListener(int port) : sock(port), open(true)
+{
+}
+
+TcpListener::~TcpListener()
+{
+    stop();
+}
+
+void TcpListener::stop()
+{
+    auto guard = hostsim::lock();
+    open = false;
+    acceptable.wakeAll();
+}
+
+bool TcpListener::isOpen()
+{
+    return open;
+}
+
+TcpClient *TcpListener::acceptClient()
+{
+    FakeTcpConnection *connection;
+    {
+        auto guard = hostsim::lock();
+        while (pendingAccepts.empty())
+        {
+            if (!open)
+                return nullptr;
+            acceptable.wait(guard, hostsim::FOREVER);
+        }
+        connection = pendingAccepts.front();
+        pendingAccepts.pop_front();
+    }
+    return faketcp::connect(connection);
+}
@@ -0,0 +1,61 @@
+#ifndef _FAKE_TCP_H_
+#define _FAKE_TCP_H_
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <functional>
+#include "tcpclient.h"
+#include "hostsim.h"
+
+/// @brief A scripted TCP connection behind the fake TcpClient and TcpListener
+/// @note All fields are guarded by the host scheduler lock
+struct FakeTcpConnection
+{
+    /// @brief Bytes the TcpClient reads, appended with push()
+    std::string input;
+    size_t inputOffset = 0;
+    /// @brief The maximum number of bytes returned by a single read, like the segments of a real stream
+    size_t segmentSize = SIZE_MAX;
+    /// @brief True if reads fail once the input is consumed, like a peer that closed its side
+    bool closeAtEnd = false;
+    /// @brief Bytes written by the TcpClient
+    std::string output;
+    /// @brief True once the TcpClient disconnected
+    bool disconnected = false;
+    /// @brief If set, receives the written bytes instead of the output, called without the scheduler lock
+    std::function<void(const char *data, size_t size)> onWrite;
+    /// @brief If set, written bytes are pushed to the peer instead of the output, and a disconnect closes its input
+    FakeTcpConnection *peer = nullptr;
+    /// @brief Woken whenever input is pushed or the connection closes
+    hostsim::WaitQueue readable;
+    /// @brief Woken whenever output is written
+    hostsim::WaitQueue writable;
+
+    /// @brief Appends bytes for the TcpClient to read
+    void push(std::string_view data);
+    /// @brief Lets reads fail once the input is consumed
+    void closeInput();
+    /// @brief Returns and clears the written bytes
+    std::string takeOutput();
+    /// @brief Blocks until the TcpClient wrote at least a number of bytes, or disconnected
+    /// @return False if the timeout was hit first
+    bool waitForOutput(size_t length, uint32_t timeoutMs);
+    /// @brief Returns true once the TcpClient disconnected
+    bool isDisconnected();
+};
+
+namespace faketcp
+{
+    /// @brief Creates a TcpClient reading from and writing to a fake connection
+    /// @note The connection must outlive the client
+    TcpClient *connect(FakeTcpConnection *connection);
+    /// @brief Queues a fake connection for the next acceptClient() of the TcpListener
+    void queueAccept(FakeTcpConnection *connection);
+    /// @brief Queues a fake connection for the next outgoing TcpClient
+    void queueConnect(FakeTcpConnection *connection);
+    /// @brief Connects two fake connections back to back, like both ends of a TCP connection
+    void pair(FakeTcpConnection *a, FakeTcpConnection *b);
+}
+
+#endif
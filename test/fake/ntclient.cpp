@@ -0,0 +1,249 @@
+#include <string.h>
+#include "ntclient.h"
+
+using namespace std::literals;
+
+static constexpr uint8_t CLIENT_MASK[4] = {0x12, 0x34, 0x56, 0x78};
+
+bool NtTestClient::connect(std::string_view name)
+{
+    connection.push("GET /nt/"s + std::string(name) +
+                    " HTTP/1.1\r\nHost: 127.0.0.1:5810\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\n"
+                    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Protocol: v4.1.networktables.first.wpi.edu\r\n\r\n"s);
+    faketcp::queueAccept(&connection);
+
+    size_t headerEnd;
+    while ((headerEnd = pending.find("\r\n\r\n"sv)) == std::string::npos)
+    {
+        if (!connection.waitForOutput(1, 1000))
+            return false;
+        pending += connection.takeOutput();
+    }
+
+    bool accepted = pending.starts_with("HTTP/1.1 101"sv);
+    pending.erase(0, headerEnd + 4);
+    parseFrames();
+    return accepted;
+}
+
+void NtTestClient::disconnect()
+{
+    connection.closeInput();
+}
+
+static void send_frame(FakeTcpConnection &connection, uint8_t opcode, const uint8_t *payload, size_t length)
+{
+    std::string frame;
+    frame.push_back((char)(0x80 | opcode));
+    if (length < 126)
+    {
+        frame.push_back((char)(0x80 | length));
+    }
+    else if (length <= 0xffff)
+    {
+        frame.push_back((char)(0x80 | 126));
+        frame.push_back((char)(length >> 8));
+        frame.push_back((char)length);
+    }
+    else
+    {
+        frame.push_back((char)(0x80 | 127));
+        for (int shift = 56; shift >= 0; shift -= 8)
+            frame.push_back((char)(length >> shift));
+    }
+
+    frame.append((const char *)CLIENT_MASK, sizeof(CLIENT_MASK));
+    for (size_t i = 0; i < length; i++)
+        frame.push_back((char)(payload[i] ^ CLIENT_MASK[i % 4]));
+    connection.push(frame);
+}
+
+void NtTestClient::sendText(std::string_view json)
+{
+    send_frame(connection, 0x1, (const uint8_t *)json.data(), json.size());
+}
+
+void NtTestClient::sendBinary(const std::vector<uint8_t> &payload)
+{
+    send_frame(connection, 0x2, payload.data(), payload.size());
+}
+
+void NtTestClient::subscribe(int32_t subuid, std::string_view topic, std::string_view options)
+{
+    sendText("[{\"method\":\"subscribe\",\"params\":{\"topics\":[\""s + std::string(topic) + "\"],\"subuid\":"s +
+             std::to_string(subuid) + ",\"options\":"s + std::string(options) + "}}]"s);
+}
+
+void NtTestClient::unsubscribe(int32_t subuid)
+{
+    sendText("[{\"method\":\"unsubscribe\",\"params\":{\"subuid\":"s + std::to_string(subuid) + "}}]"s);
+}
+
+void NtTestClient::publish(int32_t pubuid, std::string_view topic, std::string_view type)
+{
+    sendText("[{\"method\":\"publish\",\"params\":{\"name\":\""s + std::string(topic) + "\",\"pubuid\":"s +
+             std::to_string(pubuid) + ",\"type\":\""s + std::string(type) + "\",\"properties\":{}}}]"s);
+}
+
+void NtTestClient::sendValue(int32_t pubuid, int64_t time, const NTDataValue &value)
+{
+    msgpack::Packer<false> packer;
+    packer.pack_array_header(4);
+    int64_t id = pubuid;
+    uint8_t type = (uint8_t)value.getAPIType();
+    packer.process(id, time, type);
+    value.pack(packer);
+    sendBinary(packer.vector());
+}
+
+void NtTestClient::poll(uint32_t quietMs)
+{
+    while (connection.waitForOutput(1, quietMs))
+    {
+        pending += connection.takeOutput();
+        parseFrames();
+        if (connection.isDisconnected())
+            break;
+    }
+}
+
+bool NtTestClient::waitForUpdate(int64_t id, uint32_t timeoutMs)
+{
+    uint64_t deadline = hostsim::deadlineAfterMs(timeoutMs);
+    size_t seen = 0;
+    while (true)
+    {
+        for (; seen < updates.size(); seen++)
+        {
+            if (updates[seen].id == id)
+                return true;
+        }
+
+        uint64_t now = hostsim::now();
+        if (now >= deadline || !connection.waitForOutput(1, (uint32_t)((deadline - now + 999) / 1000)))
+            return false;
+        pending += connection.takeOutput();
+        parseFrames();
+    }
+}
+
+int64_t NtTestClient::topicId(std::string_view name) const
+{
+    auto search = announced.find(name);
+    return search != announced.end() ? search->second : -1;
+}
+
+void NtTestClient::parseFrames()
+{
+    while (pending.size() >= 2)
+    {
+        uint8_t opcode = (uint8_t)pending[0] & 0x0f;
+        uint64_t length = (uint8_t)pending[1] & 0x7f;
+        size_t headerSize = 2;
+        if (length == 126)
+        {
+            if (pending.size() < 4)
+                return;
+            length = ((uint64_t)(uint8_t)pending[2] << 8) | (uint8_t)pending[3];
+            headerSize = 4;
+        }
+        else if (length == 127)
+        {
+            if (pending.size() < 10)
+                return;
+            length = 0;
+            for (size_t i = 0; i < 8; i++)
+                length = (length << 8) | (uint8_t)pending[2 + i];
+            headerSize = 10;
+        }
+
+        if (pending.size() < headerSize + length)
+            return;
+
+        std::string_view payload = std::string_view(pending).substr(headerSize, length);
+        if (opcode == 0x1)
+            parseText(payload);
+        else if (opcode == 0x2)
+            parseBinary(payload);
+        pending.erase(0, headerSize + length);
+    }
+}
+
+void NtTestClient::parseText(std::string_view payload)
+{
+    messages.emplace_back(payload);
+
+    json::Tokenizer tokenizer((const uint8_t *)payload.data(), payload.size());
+    int depth = 0;
+    std::string key;
+    std::string method;
+    std::string name;
+    int64_t id = -1;
+    while (tokenizer.next())
+    {
+        switch (tokenizer.token())
+        {
+        case json::Token::ArrayBegin:
+        case json::Token::ObjectBegin:
+            depth++;
+            break;
+        case json::Token::ArrayEnd:
+        case json::Token::ObjectEnd:
+            // the end of a message object in the top level array
+            if (--depth == 1)
+            {
+                if (method == "announce"sv)
+                    announced[name] = id;
+                else if (method == "unannounce"sv)
+                    announced.erase(name);
+                method.clear();
+            }
+            break;
+        case json::Token::Key:
+            key = tokenizer.string();
+            break;
+        case json::Token::Str:
+            if (key == "method"sv)
+                method = tokenizer.string();
+            else if (key == "name"sv)
+                name = tokenizer.string();
+            break;
+        case json::Token::Int:
+            if (key == "id"sv)
+                id = tokenizer.int_value();
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void nt_parse_updates(const uint8_t *data, size_t length, uint64_t receivedUs, std::vector<NtTestUpdate> &out_updates)
+{
+    msgpack::Unpacker<false> unpacker(data, length);
+    while (unpacker.bytes() < length && !unpacker.ec)
+    {
+        std::size_t size = unpacker.unpack_array_header();
+        if (size != 4 && size != 5)
+            break;
+
+        int64_t id = 0;
+        int64_t time = 0;
+        uint8_t type = 0;
+        unpacker.process(id, time, type);
+        NTDataValue value((NTDataType)type, unpacker);
+
+        int64_t sequence = -1;
+        if (size == 5)
+            unpacker.process(sequence);
+        if (unpacker.ec)
+            break;
+
+        out_updates.push_back({id, time, std::move(value), sequence, receivedUs});
+    }
+}
+
+void NtTestClient::parseBinary(std::string_view payload)
+{
+    nt_parse_updates((const uint8_t *)payload.data(), payload.size(), hostsim::now(), updates);
+}
@@ -0,0 +1,81 @@
+#ifndef _NT_CLIENT_H_
+#define _NT_CLIENT_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "faketcp.h"
+#include "nt/ntinstance.h"
+
+/// @brief A value update received by a NtTestClient
+struct NtTestUpdate
+{
+    int64_t id;
+    int64_t time;
+    NTDataValue value;
+    /// @brief The topic sequence number of UDP updates, -1 for WebSocket updates
+    int64_t sequence = -1;
+    /// @brief The virtual time the update was received at in microseconds
+    uint64_t receivedUs = 0;
+};
+
+/// @brief A NT4 client that talks to a NetworkTableInstance server through a fake TCP connection
+/// @note The connection is accepted by the server's TcpListener, frames are built and parsed by hand
+/// so the server is tested against the wire format instead of the library's own client
+class NtTestClient
+{
+public:
+    /// @brief Connects to the server with a client name and waits for the handshake
+    /// @return False if the server did not accept the connection
+    bool connect(std::string_view name = "test");
+    /// @brief Closes the input of the connection, the server sees a disconnect
+    void disconnect();
+
+    /// @brief Sends a text frame
+    void sendText(std::string_view json);
+    /// @brief Sends a binary frame
+    void sendBinary(const std::vector<uint8_t> &payload);
+    /// @brief Subscribes to topics, options is the JSON object of the subscription options
+    void subscribe(int32_t subuid, std::string_view topic, std::string_view options = "{}");
+    /// @brief Removes a subscription
+    void unsubscribe(int32_t subuid);
+    /// @brief Publishes a topic
+    void publish(int32_t pubuid, std::string_view topic, std::string_view type);
+    /// @brief Sends a value update of a published topic
+    void sendValue(int32_t pubuid, int64_t time, const NTDataValue &value);
+
+    /// @brief Reads the frames sent by the server until it has been quiet for a while
+    /// @param quietMs How long the server must not write to end the poll
+    void poll(uint32_t quietMs = 20);
+    /// @brief Polls until an update of a topic arrived
+    /// @return False if none arrived before the timeout
+    bool waitForUpdate(int64_t id, uint32_t timeoutMs);
+
+    /// @brief Returns the announced id of a topic, or -1
+    int64_t topicId(std::string_view name) const;
+
+    /// @brief The connection the server reads from and writes to
+    FakeTcpConnection connection;
+    /// @brief Every value update received in order, the caller may clear it
+    std::vector<NtTestUpdate> updates;
+    /// @brief Every text message received, one JSON object each
+    std::vector<std::string> messages;
+    /// @brief Announced topic ids by name
+    std::map<std::string, int64_t, std::less<>> announced;
+
+private:
+    /// @brief Unparsed output of the server
+    std::string pending;
+
+    void parseFrames();
+    void parseText(std::string_view payload);
+    void parseBinary(std::string_view payload);
+};
+
+/// @brief Decodes the value updates of a binary frame or a UDP datagram
+/// @param receivedUs The virtual time the updates were received at
+void nt_parse_updates(const uint8_t *data, size_t length, uint64_t receivedUs, std::vector<NtTestUpdate> &out_updates);
+
+#endif
@@ -0,0 +1,241 @@
+#include <string>
+#include "testing.h"
+#include "faketcp.h"
+#include "websocket.h"
+#include "wsserver.h"
+#include "config.h"
+
+using namespace std::literals;
+
+// RFC 6455 section 1.3
+constexpr std::string_view SAMPLE_KEY = "dGhlIHNhbXBsZSBub25jZQ=="sv;
+constexpr std::string_view SAMPLE_ACCEPT = "s3pPLMBiTxaQ9kYGzzhZRbK+xOo="sv;
+
+struct ServerEvents
+{
+    int connected = 0;
+    int disconnected = 0;
+    int received = 0;
+    int receivedEntries = 0;
+    std::string path;
+};
+
+static void on_connected(WsServer *server, const WsServer::ClientEntry *entry, void *args)
+{
+    ServerEvents *events = (ServerEvents *)args;
+    events->connected++;
+    events->path = entry->requestedPath;
+}
+
+static void on_disconnected(WsServer *server, const Guid &guid, WebSocketStatusCode statusCode, const std::string_view &reason, void *args)
+{
+    ((ServerEvents *)args)->disconnected++;
+}
+
+/// @brief Runs a scripted request through WsServer::handleRawConnection
+static std::string serve(std::string_view request, bool closeAtEnd, ServerEvents &events)
+{
+    WsServer server(5810);
+    server.callbackArgs = &events;
+    server.clientConnected.Add(on_connected);
+    server.clientDisconnected.Add(on_disconnected);
+
+    FakeTcpConnection connection;
+    connection.segmentSize = 100;
+    connection.push(request);
+    if (closeAtEnd)
+        connection.closeInput();
+
+    server.handleRawConnection(faketcp::connect(&connection));
+    CHECK(connection.isDisconnected());
+    return connection.takeOutput();
+}
+
+static std::string upgrade_request(std::string_view extraHeaders)
+{
+    return "GET /nt/test HTTP/1.1\r\nHost: 10.67.31.2\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\n"s +
+           "Sec-WebSocket-Key: "s + std::string(SAMPLE_KEY) + "\r\n"s + std::string(extraHeaders) + "\r\n"s;
+}
+
+TEST(server_accepts_a_valid_upgrade)
+{
+    ServerEvents events;
+    std::string response = serve(upgrade_request(""sv), true, events);
+
+    CHECK(response.starts_with("HTTP/1.1 101 Switching Protocols\r\n"sv));
+    CHECK(response.find("Sec-WebSocket-Accept: "s + std::string(SAMPLE_ACCEPT) + "\r\n"s) != std::string::npos);
+    CHECK_EQ(events.connected, 1);
+    CHECK_EQ(events.path, "/nt/test"s);
+    CHECK_EQ(events.disconnected, 1);
+}
+
+TEST(server_rejects_an_overlong_header_line)
+{
+    ServerEvents events;
+    std::string response = serve(upgrade_request("Cookie: "s + std::string(2000, 'c') + "\r\n"s), true, events);
+
+    CHECK(response.starts_with("HTTP/1.1 400 Bad Request"sv));
+    CHECK_EQ(events.connected, 0);
+}
+
+TEST(server_rejects_headers_cut_off_by_a_timeout)
+{
+    // the valid headers are never terminated by an empty line
+    std::string request = upgrade_request(""sv);
+    request.resize(request.size() - 2);
+
+    ServerEvents events;
+    uint64_t start = hostsim::now();
+    std::string response = serve(request, false, events);
+
+    CHECK(response.starts_with("HTTP/1.1 400 Bad Request"sv));
+    CHECK_EQ(events.connected, 0);
+    CHECK(hostsim::now() - start >= WEBSOCKET_TIMEOUT * 1000ull);
+}
+
+TEST(server_rejects_headers_cut_off_by_a_disconnect)
+{
+    std::string request = upgrade_request(""sv);
+    request.resize(request.size() - 2);
+
+    ServerEvents events;
+    serve(request, true, events);
+    CHECK_EQ(events.connected, 0);
+}
+
+TEST(server_drops_a_truncated_request_line)
+{
+    ServerEvents events;
+    std::string response = serve("GET /nt/te"sv, true, events);
+    CHECK(response.empty());
+    CHECK_EQ(events.connected, 0);
+
+    response = serve("GET "s + std::string(2000, 'p'), true, events);
+    CHECK(response.empty());
+    CHECK_EQ(events.connected, 0);
+}
+
+/// @brief Plays the server side of a client handshake, optionally with an oversized or unterminated response
+/// @note Instances are static, the server task may still be returning when the client gives up
+struct ScriptedServer
+{
+    FakeTcpConnection connection;
+    std::string extraHeaders;
+    bool terminate = true;
+};
+
+static void scripted_server_task(void *args)
+{
+    ScriptedServer *server = (ScriptedServer *)args;
+    FakeTcpConnection &connection = server->connection;
+
+    // wait for the full request and answer with the accept key of its nonce
+    std::string request;
+    while (request.find("\r\n\r\n"sv) == std::string::npos)
+    {
+        connection.waitForOutput(1, 1000);
+        request += connection.takeOutput();
+    }
+
+    size_t keyStart = request.find("Sec-WebSocket-Key: "sv) + 19;
+    std::string_view key = std::string_view(request).substr(keyStart, request.find('\r', keyStart) - keyStart);
+    char accept[WEBSOCKET_ACCEPT_KEY_LENGTH];
+    websocket_accept_key(key, accept);
+
+    std::string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"s + server->extraHeaders +
+                           "Sec-WebSocket-Accept: "s + std::string(accept, sizeof(accept)) + "\r\n"s;
+    if (server->terminate)
+        response += "\r\n"s;
+    connection.push(response);
+}
+
+static bool client_connects(ScriptedServer &server)
+{
+    faketcp::queueConnect(&server.connection);
+    xTaskCreate(scripted_server_task, "server", configMINIMAL_STACK_SIZE, &server, 1, nullptr);
+
+    // a connected client keeps polling its connection, so it lives until the process exits
+    WebSocket *ws = new WebSocket("ws://127.0.0.1:5810/nt/test"sv);
+    if (ws->isConnected())
+        return true;
+    delete ws;
+    return false;
+}
+
+TEST(client_accepts_a_valid_response)
+{
+    static ScriptedServer server;
+    CHECK(client_connects(server));
+}
+
+TEST(client_rejects_an_overlong_header_line)
+{
+    static ScriptedServer server;
+    server.extraHeaders = "Set-Cookie: "s + std::string(2000, 'c') + "\r\n"s;
+    CHECK(!client_connects(server));
+}
+
+TEST(client_rejects_headers_cut_off_by_a_timeout)
+{
+    static ScriptedServer server;
+    server.terminate = false;
+    CHECK(!client_connects(server));
+}
+
+static void on_received(WsServer *server, const Guid &guid, const WebSocketFrame &frame, void *args)
+{
+    ((ServerEvents *)args)->received++;
+}
+
+static void on_entry_received(WsServer *server, const WsServer::ClientEntry *entry, const WebSocketFrame &frame, void *args)
+{
+    if (entry->guid == server->getClient(entry->id)->guid)
+        ((ServerEvents *)args)->receivedEntries++;
+}
+
+TEST(client_connects_to_the_server)
+{
+    // both ends keep running message loops, so they live until the process exits
+    static ServerEvents events;
+    WsServer *wsServer = new WsServer(5810);
+    wsServer->callbackArgs = &events;
+    wsServer->clientConnected.Add(on_connected);
+    wsServer->messageReceived.Add(on_received);
+    wsServer->clientEntryMessageReceived.Add(on_entry_received);
+
+    static uint32_t activityFrames = 0;
+    ws_server_set_activity_callback([](uint32_t frames, void *args)
+                                    { *(uint32_t *)args += frames; }, &activityFrames);
+
+    static FakeTcpConnection clientSide;
+    static FakeTcpConnection serverSide;
+    faketcp::pair(&clientSide, &serverSide);
+    faketcp::queueConnect(&clientSide);
+
+    struct Args
+    {
+        WsServer *server;
+        TcpClient *client;
+    };
+    static Args args;
+    args = {wsServer, faketcp::connect(&serverSide)};
+    xTaskCreate([](void *ins) -> void
+                { Args *args = (Args *)ins;
+        args->server->handleRawConnection(args->client); }, "wsclient", configMINIMAL_STACK_SIZE, &args, 1, nullptr);
+
+    WebSocket *ws = new WebSocket("ws://127.0.0.1:5810/nt/test"sv);
+    CHECK(ws->isConnected());
+    hostsim::sleepMs(10);
+    CHECK_EQ(events.connected, 1);
+    CHECK_EQ(events.path, "/nt/test"s);
+
+    // a frame reaches the guid and entry events and counts as activity
+    CHECK(ws->send("hello"sv));
+    hostsim::sleepMs(10);
+    CHECK_EQ(events.received, 1);
+    CHECK_EQ(events.receivedEntries, 1);
+    CHECK_EQ(activityFrames, 1u);
+    ws_server_set_activity_callback(nullptr, nullptr);
+}
+
+TEST_MAIN()
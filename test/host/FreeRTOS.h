@@ -0,0 +1,38 @@
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+// Host replacement of the FreeRTOS kernel headers, backed by host/freertos.cpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <assert.h>
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#define pdTRUE ((BaseType_t)1)
+#define pdFALSE ((BaseType_t)0)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ ((TickType_t)1000)
+#define configMINIMAL_STACK_SIZE ((uint32_t)512)
+#define configASSERT(x) assert(x)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * configTICK_RATE_HZ) / 1000U))
+#define portCHECK_IF_IN_ISR() 0
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    void *pvPortMalloc(size_t size);
+    void vPortFree(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,330 @@
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+#include <mutex>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "pico/cyw43_arch.h"
+#include "hostsim.h"
+
+/// @brief A queued outcome of a join attempt
+struct WifiJoin
+{
+    int status;
+    uint32_t delayMs;
+    /// @brief The join attempt the outcome was taken by
+    uint32_t generation;
+};
+
+/// @brief The simulated driver state, guarded by mutex
+struct WifiHost
+{
+    std::mutex mutex;
+    bool initialized = false;
+    uint32_t country = 0;
+    int staStatus = CYW43_LINK_DOWN;
+    /// @brief Incremented by every join and leave, so a finished join of an abandoned attempt is ignored
+    uint32_t joinGeneration = 0;
+    std::deque<WifiJoin> joins;
+    hostsim::WifiStats stats = {};
+    int32_t rssi = -50;
+    uint32_t channel = 6;
+    int stations = 0;
+    bool apUp = false;
+    uint32_t apChannel = CYW43_CHANNEL_NONE;
+};
+
+static WifiHost &wifi_host()
+{
+    static WifiHost instance;
+    return instance;
+}
+
+static const uint8_t WIFI_BSSID[6] = {0x02, 0x11, 0x22, 0x33, 0x44, 0x55};
+
+/// @brief Calls the netif callbacks of the station interface, like lwIP on a link or address change
+static void wifi_netif_changed(bool linkUp)
+{
+    struct netif *netif = &cyw43_state.netif[CYW43_ITF_STA];
+    cyw43_arch_lwip_begin();
+    netif_status_callback_fn callback = linkUp ? netif->status_callback : netif->link_callback;
+    if (callback != NULL)
+        callback(netif);
+    cyw43_arch_lwip_end();
+}
+
+/// @brief Finishes a join attempt after its scripted delay
+static void wifi_join_task(void *args)
+{
+    WifiJoin join = *(WifiJoin *)args;
+    delete (WifiJoin *)args;
+    WifiHost &host = wifi_host();
+
+    vTaskDelay(pdMS_TO_TICKS(join.delayMs));
+
+    {
+        std::lock_guard<std::mutex> guard(host.mutex);
+        if (host.joinGeneration != join.generation)
+            return; // left or joined again meanwhile
+        host.staStatus = join.status;
+    }
+    wifi_netif_changed(join.status == CYW43_LINK_UP);
+}
+
+int cyw43_arch_init_with_country(uint32_t country)
+{
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    host.initialized = true;
+    host.country = country;
+    host.staStatus = CYW43_LINK_DOWN;
+    return 0;
+}
+
+void cyw43_arch_deinit(void)
+{
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    host.initialized = false;
+    host.joinGeneration++;
+    host.staStatus = CYW43_LINK_DOWN;
+    host.apUp = false;
+}
+
+void cyw43_arch_enable_sta_mode(void)
+{
+    cyw43_wifi_set_up(&cyw43_state, CYW43_ITF_STA, true, cyw43_arch_get_country_code());
+}
+
+uint32_t cyw43_arch_get_country_code(void)
+{
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    return host.country;
+}
+
+bool cyw43_is_initialized(cyw43_t *self)
+{
+    (void)self;
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    return host.initialized;
+}
+
+void cyw43_wifi_set_up(cyw43_t *self, int itf, bool up, uint32_t country)
+{
+    (void)self;
+    (void)country;
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    if (itf == CYW43_ITF_AP)
+        host.apUp = up;
+}
+
+int cyw43_wifi_join(cyw43_t *self, size_t ssid_len, const uint8_t *ssid, size_t key_len, const uint8_t *key, uint32_t auth_type, const uint8_t *bssid, uint32_t channel)
+{
+    (void)self;
+    (void)ssid_len;
+    (void)ssid;
+    (void)key_len;
+    (void)key;
+    (void)auth_type;
+    (void)channel;
+
+    WifiHost &host = wifi_host();
+    WifiJoin *join = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(host.mutex);
+        host.stats.joins++;
+        if (bssid != NULL)
+            host.stats.fastJoins++;
+        host.staStatus = CYW43_LINK_JOIN;
+        host.joinGeneration++;
+
+        // a join without a queued outcome never finishes
+        if (!host.joins.empty())
+        {
+            join = new WifiJoin(host.joins.front());
+            join->generation = host.joinGeneration;
+            host.joins.pop_front();
+        }
+    }
+
+    if (join != nullptr)
+        xTaskCreate(wifi_join_task, "cyw43_join", configMINIMAL_STACK_SIZE, join, 3, NULL);
+    return 0;
+}
+
+int cyw43_wifi_leave(cyw43_t *self, int itf)
+{
+    (void)self;
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    if (itf == CYW43_ITF_STA)
+    {
+        host.joinGeneration++;
+        host.staStatus = CYW43_LINK_DOWN;
+    }
+    return 0;
+}
+
+int cyw43_tcpip_link_status(cyw43_t *self, int itf)
+{
+    (void)self;
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    if (itf == CYW43_ITF_AP)
+        return host.apUp ? CYW43_LINK_UP : CYW43_LINK_DOWN;
+    return host.staStatus;
+}
+
+int cyw43_wifi_pm(cyw43_t *self, uint32_t pm)
+{
+    (void)self;
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    host.stats.pm = pm;
+    host.stats.pmChanges++;
+    return 0;
+}
+
+int cyw43_wifi_get_rssi(cyw43_t *self, int32_t *rssi)
+{
+    (void)self;
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    if (host.staStatus != CYW43_LINK_UP)
+        return -1;
+    *rssi = host.rssi;
+    return 0;
+}
+
+int cyw43_wifi_get_bssid(cyw43_t *self, uint8_t bssid[6])
+{
+    (void)self;
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    if (host.staStatus != CYW43_LINK_UP)
+        return -1;
+    memcpy(bssid, WIFI_BSSID, sizeof(WIFI_BSSID));
+    return 0;
+}
+
+int cyw43_wifi_scan(cyw43_t *self, cyw43_wifi_scan_options_t *opts, void *env, int (*result_cb)(void *, const cyw43_ev_scan_result_t *))
+{
+    (void)self;
+    (void)opts;
+    (void)env;
+    (void)result_cb;
+    return 0; // finishes right away without results
+}
+
+bool cyw43_wifi_scan_active(cyw43_t *self)
+{
+    (void)self;
+    return false;
+}
+
+int cyw43_wifi_ap_get_stas(cyw43_t *self, int *num_stas, uint8_t *macs)
+{
+    (void)self;
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    *num_stas = host.stations;
+    if (macs != NULL)
+        memset(macs, 0, (size_t)host.stations * 6);
+    return 0;
+}
+
+void cyw43_wifi_ap_set_ssid(cyw43_t *self, size_t len, const uint8_t *buf)
+{
+    (void)self;
+    (void)len;
+    (void)buf;
+}
+
+void cyw43_wifi_ap_set_password(cyw43_t *self, size_t len, const uint8_t *buf)
+{
+    (void)self;
+    (void)len;
+    (void)buf;
+}
+
+void cyw43_wifi_ap_set_auth(cyw43_t *self, uint32_t auth)
+{
+    (void)self;
+    (void)auth;
+}
+
+void cyw43_wifi_ap_set_channel(cyw43_t *self, uint32_t channel)
+{
+    (void)self;
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    host.apChannel = channel;
+}
+
+int cyw43_ioctl(cyw43_t *self, uint32_t cmd, size_t len, uint8_t *buf, uint32_t iface)
+{
+    (void)self;
+    WifiHost &host = wifi_host();
+    std::lock_guard<std::mutex> guard(host.mutex);
+    if (cmd != CYW43_IOCTL_GET_CHANNEL || len < sizeof(uint32_t))
+        return -1;
+
+    uint32_t channel = iface == CYW43_ITF_AP ? host.apChannel : host.channel;
+    if (iface != CYW43_ITF_AP && host.staStatus != CYW43_LINK_UP)
+        channel = CYW43_CHANNEL_NONE;
+    memcpy(buf, &channel, sizeof(channel));
+    return 0;
+}
+
+namespace hostsim
+{
+    void queueWifiJoin(int status, uint32_t delayMs)
+    {
+        WifiHost &host = wifi_host();
+        std::lock_guard<std::mutex> guard(host.mutex);
+        host.joins.push_back({status, delayMs, 0});
+    }
+
+    void dropWifiLink(int status)
+    {
+        WifiHost &host = wifi_host();
+        {
+            std::lock_guard<std::mutex> guard(host.mutex);
+            host.joinGeneration++;
+            host.staStatus = status;
+        }
+        wifi_netif_changed(false);
+    }
+
+    void setWifiLinkQuality(int32_t rssi, uint32_t channel, int stations)
+    {
+        WifiHost &host = wifi_host();
+        std::lock_guard<std::mutex> guard(host.mutex);
+        host.rssi = rssi;
+        host.channel = channel;
+        host.stations = stations;
+    }
+
+    WifiStats wifiStats()
+    {
+        WifiHost &host = wifi_host();
+        std::lock_guard<std::mutex> guard(host.mutex);
+        return host.stats;
+    }
+
+    void resetWifi()
+    {
+        WifiHost &host = wifi_host();
+        std::lock_guard<std::mutex> guard(host.mutex);
+        host.joinGeneration++;
+        host.staStatus = CYW43_LINK_DOWN;
+        host.joins.clear();
+        host.stats = {};
+        host.rssi = -50;
+        host.channel = 6;
+        host.stations = 0;
+    }
+}
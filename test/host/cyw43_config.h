@@ -0,0 +1,6 @@
+#ifndef _HOST_CYW43_CONFIG_H_
+#define _HOST_CYW43_CONFIG_H_
+
+#include "pico/cyw43_arch.h"
+
+#endif
@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "timers.h"
+#include "hostsim.h"
+
+namespace hostsim
+{
+    struct Waiter
+    {
+        std::condition_variable cv;
+        WaitQueue *queue;
+        uint64_t deadline;
+        bool counted;
+        bool done = false;
+        bool woken = false;
+    };
+
+    /// @brief The state of the whole scheduler, guarded by mutex
+    struct Scheduler
+    {
+        std::mutex mutex;
+        uint64_t now = 0;
+        /// @brief The number of registered tasks that are not blocked
+        int runnable = 1; // the main thread
+        /// @brief Waiters with a finite deadline
+        std::vector<Waiter *> timed;
+    };
+
+    static Scheduler &scheduler()
+    {
+        static Scheduler instance;
+        return instance;
+    }
+}
+
+struct HostTask
+{
+    std::string name;
+    uint32_t notifyValue = 0;
+    hostsim::WaitQueue notified;
+};
+
+struct HostSemaphore
+{
+    uint32_t count;
+    uint32_t max;
+    hostsim::WaitQueue available;
+};
+
+static HostTask mainTask{"main"};
+static thread_local HostTask *currentTask = nullptr;
+/// @brief True on threads counted as tasks by the scheduler, other threads block without stopping the clock
+static thread_local bool registeredTask = false;
+
+/// @brief The main thread is the first registered task
+static struct MainTaskRegistration
+{
+    MainTaskRegistration()
+    {
+        currentTask = &mainTask;
+        registeredTask = true;
+    }
+} mainTaskRegistration;
+
+namespace hostsim
+{
+    void release(Waiter *waiter, bool woken)
+    {
+        Scheduler &s = scheduler();
+        waiter->queue->waiters.remove(waiter);
+        if (waiter->deadline != FOREVER)
+            std::erase(s.timed, waiter);
+        waiter->done = true;
+        waiter->woken = woken;
+        if (waiter->counted)
+            s.runnable++;
+        waiter->cv.notify_one();
+    }
+
+    /// @brief Advances the virtual clock to the next deadline while every task is blocked
+    static void advance()
+    {
+        Scheduler &s = scheduler();
+        while (s.runnable == 0)
+        {
+            if (s.timed.empty())
+            {
+                fprintf(stderr, "[HOST] Every task is blocked forever at %llu us\n", (unsigned long long)s.now);
+                fflush(stdout);
+                abort();
+            }
+
+            uint64_t next = FOREVER;
+            for (Waiter *waiter : s.timed)
+                next = std::min(next, waiter->deadline);
+            s.now = std::max(s.now, next);
+
+            std::vector<Waiter *> expired;
+            for (Waiter *waiter : s.timed)
+            {
+                if (waiter->deadline <= s.now)
+                    expired.push_back(waiter);
+            }
+            for (Waiter *waiter : expired)
+                release(waiter, false);
+        }
+    }
+
+    /// @brief Marks the calling task as blocked, advancing the clock if it was the last runnable task
+    static void block()
+    {
+        Scheduler &s = scheduler();
+        if (!registeredTask)
+            return;
+        s.runnable--;
+        if (s.runnable == 0)
+            advance();
+    }
+
+    uint64_t now()
+    {
+        auto guard = lock();
+        return scheduler().now;
+    }
+
+    uint64_t deadlineAfterMs(uint32_t ms)
+    {
+        if (ms == 0xffffffffu)
+            return FOREVER;
+        return scheduler().now + (uint64_t)ms * 1000;
+    }
+
+    std::unique_lock<std::mutex> lock()
+    {
+        return std::unique_lock<std::mutex>(scheduler().mutex);
+    }
+
+    WaitQueue::~WaitQueue()
+    {
+        assert(waiters.empty());
+    }
+
+    bool WaitQueue::wait(std::unique_lock<std::mutex> &lock, uint64_t deadline)
+    {
+        Scheduler &s = scheduler();
+        if (deadline <= s.now)
+            return false;
+
+        Waiter waiter;
+        waiter.queue = this;
+        waiter.deadline = deadline;
+        waiter.counted = registeredTask;
+        waiters.push_back(&waiter);
+        if (deadline != FOREVER)
+            s.timed.push_back(&waiter);
+
+        block();
+        while (!waiter.done)
+            waiter.cv.wait(lock);
+        return waiter.woken;
+    }
+
+    void WaitQueue::wakeOne()
+    {
+        if (!waiters.empty())
+            release(waiters.front(), true);
+    }
+
+    void WaitQueue::wakeAll()
+    {
+        while (!waiters.empty())
+            release(waiters.front(), true);
+    }
+
+    void sleepMs(uint32_t ms)
+    {
+        auto guard = lock();
+        WaitQueue delay;
+        if (ms == 0)
+        {
+            guard.unlock();
+            std::this_thread::yield();
+            return;
+        }
+        delay.wait(guard, deadlineAfterMs(ms));
+    }
+}
+
+static std::atomic<size_t> port_malloc_limit = SIZE_MAX;
+
+namespace hostsim
+{
+    void setPortMallocLimit(size_t size)
+    {
+        port_malloc_limit = size;
+    }
+}
+
+void *pvPortMalloc(size_t size)
+{
+    if (size > port_malloc_limit)
+        return nullptr;
+    return malloc(size);
+}
+
+void vPortFree(void *ptr)
+{
+    free(ptr);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *parameters, UBaseType_t priority, TaskHandle_t *out_task)
+{
+    HostTask *task = new HostTask{name};
+    {
+        auto guard = hostsim::lock();
+        hostsim::scheduler().runnable++;
+    }
+
+    if (out_task != nullptr)
+        *out_task = task;
+
+    std::thread([task, code, parameters]()
+                {
+        currentTask = task;
+        registeredTask = true;
+        code(parameters);
+        vTaskDelete(NULL); })
+        .detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    assert(task == NULL || task == currentTask); // only self-deletion is supported
+
+    auto guard = hostsim::lock();
+    hostsim::block();
+    registeredTask = false;
+
+    // a deleted task never runs again, park the thread until the process exits
+    std::condition_variable parked;
+    while (true)
+        parked.wait(guard);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    hostsim::sleepMs(ticks * 1000 / configTICK_RATE_HZ);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(hostsim::now() * configTICK_RATE_HZ / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return currentTask;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait)
+{
+    HostTask *task = currentTask;
+    auto guard = hostsim::lock();
+    uint64_t deadline = hostsim::deadlineAfterMs(ticksToWait == portMAX_DELAY ? 0xffffffffu : ticksToWait * 1000 / configTICK_RATE_HZ);
+    while (task->notifyValue == 0)
+    {
+        if (!task->notified.wait(guard, deadline))
+            break;
+    }
+
+    uint32_t value = task->notifyValue;
+    if (value > 0)
+        task->notifyValue = clearCountOnExit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    auto guard = hostsim::lock();
+    task->notifyValue++;
+    task->notified.wakeAll();
+    return pdPASS;
+}
+
+static std::recursive_mutex &critical_mutex()
+{
+    static std::recursive_mutex mutex;
+    return mutex;
+}
+
+void host_enter_critical(void)
+{
+    critical_mutex().lock();
+}
+
+void host_exit_critical(void)
+{
+    critical_mutex().unlock();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return new HostSemaphore{1, 1};
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return new HostSemaphore{0, 1};
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount)
+{
+    return new HostSemaphore{(uint32_t)initialCount, (uint32_t)maxCount};
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait)
+{
+    auto guard = hostsim::lock();
+    uint64_t deadline = hostsim::deadlineAfterMs(ticksToWait == portMAX_DELAY ? 0xffffffffu : ticksToWait * 1000 / configTICK_RATE_HZ);
+    while (semaphore->count == 0)
+    {
+        if (!semaphore->available.wait(guard, deadline) && semaphore->count == 0)
+            return pdFALSE;
+    }
+
+    semaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    auto guard = hostsim::lock();
+    if (semaphore->count >= semaphore->max)
+        return pdFALSE;
+
+    semaphore->count++;
+    semaphore->available.wakeOne();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    delete semaphore;
+}
+
+/// @brief The daemon task running pended function calls, like the FreeRTOS timer service task
+struct TimerService
+{
+    std::deque<std::pair<PendedFunction_t, std::pair<void *, uint32_t>>> calls;
+    hostsim::WaitQueue pending;
+    bool started = false;
+};
+
+static TimerService &timer_service()
+{
+    static TimerService instance;
+    return instance;
+}
+
+static void timer_service_task(void *)
+{
+    TimerService &service = timer_service();
+    while (true)
+    {
+        auto guard = hostsim::lock();
+        while (service.calls.empty())
+            service.pending.wait(guard, hostsim::FOREVER);
+
+        auto call = service.calls.front();
+        service.calls.pop_front();
+        guard.unlock();
+
+        call.first(call.second.first, call.second.second);
+    }
+}
+
+BaseType_t xTimerPendFunctionCall(PendedFunction_t function, void *parameter1, uint32_t parameter2, TickType_t ticksToWait)
+{
+    TimerService &service = timer_service();
+    bool start = false;
+    {
+        auto guard = hostsim::lock();
+        service.calls.push_back({function, {parameter1, parameter2}});
+        service.pending.wakeAll();
+        start = !service.started;
+        service.started = true;
+    }
+
+    if (start)
+        xTaskCreate(timer_service_task, "Tmr Svc", configMINIMAL_STACK_SIZE, nullptr, 31, nullptr);
+    return pdPASS;
+}
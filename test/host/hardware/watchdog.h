@@ -0,0 +1,17 @@
+#ifndef _HOST_HARDWARE_WATCHDOG_H_
+#define _HOST_HARDWARE_WATCHDOG_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    bool watchdog_caused_reboot(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
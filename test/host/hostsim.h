@@ -0,0 +1,102 @@
+#ifndef _HOST_SIM_H_
+#define _HOST_SIM_H_
+
+#include <stdint.h>
+#include <functional>
+#include <list>
+#include <mutex>
+#include "lwip/host.h"
+
+/// @brief The host scheduler behind the FreeRTOS and pico time shims.
+///        Tasks run as threads on a virtual clock, which only advances once every task is blocked,
+///        so timeouts and delays are deterministic and cost no wall-clock time.
+namespace hostsim
+{
+    /// @brief A deadline that never passes
+    constexpr uint64_t FOREVER = UINT64_MAX;
+
+    struct Waiter;
+
+    /// @brief Returns the virtual time in microseconds
+    uint64_t now();
+    /// @brief Returns the deadline a number of milliseconds from now
+    /// @param ms The timeout, 0xffffffff waits forever
+    uint64_t deadlineAfterMs(uint32_t ms);
+    /// @brief Takes the lock protecting all scheduler state, WaitQueues must only be used with it held
+    std::unique_lock<std::mutex> lock();
+
+    /// @brief A list of tasks blocked until they are woken or their deadline passes
+    class WaitQueue
+    {
+    public:
+        ~WaitQueue();
+
+        /// @brief Blocks the calling task
+        /// @param lock The scheduler lock, released while blocked
+        /// @param deadline The virtual time to give up at
+        /// @return False if the deadline passed before the task was woken
+        bool wait(std::unique_lock<std::mutex> &lock, uint64_t deadline);
+        /// @brief Wakes the longest waiting task
+        void wakeOne();
+        /// @brief Wakes all waiting tasks
+        void wakeAll();
+
+    private:
+        std::list<Waiter *> waiters;
+
+        friend void release(Waiter *waiter, bool woken);
+    };
+
+    /// @brief Blocks the calling task for a number of virtual milliseconds
+    void sleepMs(uint32_t ms);
+
+    /// @brief Sets the result of watchdog_caused_reboot(), to simulate a warm boot
+    void setWatchdogReboot(bool reboot);
+    /// @brief Erases the whole simulated flash, like a fresh device
+    void eraseFlash();
+    /// @brief Makes pvPortMalloc() fail for larger blocks, like a fragmented heap
+    /// @param size The largest block that can be allocated, SIZE_MAX restores the default
+    void setPortMallocLimit(size_t size);
+
+    /// @brief Receives the datagrams sent by a pcb instead of the POSIX socket
+    typedef std::function<err_t(struct udp_pcb *pcb, const uint8_t *data, size_t length, const ip_addr_t *to, uint16_t port)> UdpOutput;
+    /// @brief Routes all sent datagrams through an output function, an empty function restores the POSIX sockets
+    /// @note The output function is called with the lwIP lock held
+    void setUdpOutput(UdpOutput output);
+    /// @brief Keeps a reference to every sent pbuf, like a driver with queued frames
+    /// @param hold False releases the held pbufs
+    void holdUdpPbufs(bool hold);
+    /// @brief Passes a datagram to the receive callback of a pcb, like a datagram arriving from the network
+    /// @param segmentSize The payload bytes per pbuf of the chain, 0 for a single pbuf
+    void deliverUdp(struct udp_pcb *pcb, const void *data, size_t length, const ip_addr_t *from, uint16_t port, size_t segmentSize = 0);
+
+    /// @brief Queues the outcome of the next join attempt of the simulated wifi driver
+    /// @param status The final link status, CYW43_LINK_UP or a failure like CYW43_LINK_BADAUTH
+    /// @param delayMs The virtual milliseconds until the status is reached
+    /// @note A join attempt without a queued outcome never finishes
+    void queueWifiJoin(int status, uint32_t delayMs);
+    /// @brief Drops the established station link, like an access point that went away
+    /// @param status The link status reported from now on
+    void dropWifiLink(int status);
+    /// @brief Sets the signal strength and channel of the station link and the number of stations of the access point
+    void setWifiLinkQuality(int32_t rssi, uint32_t channel, int stations);
+
+    /// @brief Counters of the simulated wifi driver
+    struct WifiStats
+    {
+        /// @brief The number of join attempts
+        int joins;
+        /// @brief The number of join attempts to a known BSSID, without a scan
+        int fastJoins;
+        /// @brief The last power management value
+        uint32_t pm;
+        /// @brief The number of times the power management value was set
+        int pmChanges;
+    };
+    /// @brief Returns the counters of the simulated wifi driver
+    WifiStats wifiStats();
+    /// @brief Drops the link and forgets the queued joins, counters and link quality
+    void resetWifi();
+}
+
+#endif
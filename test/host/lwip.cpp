@@ -0,0 +1,551 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "lwip/host.h"
+#include "pico/cyw43_arch.h"
+#include "hostsim.h"
+
+const ip_addr_t ip_addr_any = IPADDR4_INIT(0);
+const ip_addr_t ip_addr_broadcast = IPADDR4_INIT(0xffffffffUL);
+
+cyw43_t cyw43_state = {};
+struct netif *netif_default = &cyw43_state.netif[CYW43_ITF_STA];
+struct netif *netif_list = &cyw43_state.netif[CYW43_ITF_STA];
+
+/// @brief Gives the interfaces the loopback address, so the POSIX sockets can reach them
+static struct NetifInit
+{
+    NetifInit()
+    {
+        for (struct netif &netif : cyw43_state.netif)
+        {
+            IP4_ADDR(&netif.ip_addr, 127, 0, 0, 1);
+            IP4_ADDR(&netif.netmask, 255, 0, 0, 0);
+            IP4_ADDR(&netif.gw, 127, 0, 0, 1);
+        }
+    }
+} netifInit;
+
+static std::recursive_mutex &lwip_mutex()
+{
+    static std::recursive_mutex mutex;
+    return mutex;
+}
+
+void cyw43_arch_lwip_begin(void)
+{
+    lwip_mutex().lock();
+}
+
+void cyw43_arch_lwip_end(void)
+{
+    lwip_mutex().unlock();
+}
+
+char *ip4addr_ntoa(const ip4_addr_t *addr)
+{
+    static thread_local char buf[16];
+    struct in_addr in = {addr->addr};
+    return (char *)inet_ntop(AF_INET, &in, buf, sizeof(buf));
+}
+
+int ip4addr_aton(const char *cp, ip4_addr_t *addr)
+{
+    struct in_addr in;
+    if (inet_aton(cp, &in) == 0)
+        return 0;
+    if (addr != NULL)
+        addr->addr = in.s_addr;
+    return 1;
+}
+
+void netif_set_hostname(struct netif *netif, const char *name)
+{
+    netif->hostname = name;
+}
+
+void netif_set_addr(struct netif *netif, const ip4_addr_t *ipaddr, const ip4_addr_t *netmask, const ip4_addr_t *gw)
+{
+    netif->ip_addr = *ipaddr;
+    netif->netmask = *netmask;
+    netif->gw = *gw;
+    if (netif->status_callback != NULL)
+        netif->status_callback(netif);
+}
+
+void netif_set_status_callback(struct netif *netif, netif_status_callback_fn status_callback)
+{
+    netif->status_callback = status_callback;
+}
+
+void netif_set_link_callback(struct netif *netif, netif_status_callback_fn link_callback)
+{
+    netif->link_callback = link_callback;
+}
+
+struct netif *ip_current_input_netif(void)
+{
+    return netif_default;
+}
+
+void dhcp_release_and_stop(struct netif *netif)
+{
+    (void)netif;
+}
+
+#define PBUF_FLAG_IS_CUSTOM 0x02U
+
+struct pbuf *pbuf_alloc(pbuf_layer l, u16_t length, pbuf_type type)
+{
+    (void)l;
+    bool inline_payload = type == PBUF_RAM || type == PBUF_POOL;
+    struct pbuf *p = (struct pbuf *)malloc(sizeof(struct pbuf) + (inline_payload ? length : 0));
+    if (p == NULL)
+        return NULL;
+
+    p->next = NULL;
+    p->payload = inline_payload ? (void *)(p + 1) : NULL;
+    p->tot_len = length;
+    p->len = length;
+    p->type_internal = (u8_t)type;
+    p->flags = 0;
+    p->ref = 1;
+    return p;
+}
+
+struct pbuf *pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type, struct pbuf_custom *p, void *payload_mem, u16_t payload_mem_len)
+{
+    (void)l;
+    if (payload_mem_len < length)
+        return NULL;
+
+    p->pbuf.next = NULL;
+    p->pbuf.payload = payload_mem;
+    p->pbuf.tot_len = length;
+    p->pbuf.len = length;
+    p->pbuf.type_internal = (u8_t)type;
+    p->pbuf.flags = PBUF_FLAG_IS_CUSTOM;
+    p->pbuf.ref = 1;
+    return &p->pbuf;
+}
+
+u8_t pbuf_free(struct pbuf *p)
+{
+    u8_t count = 0;
+    while (p != NULL)
+    {
+        if (--p->ref > 0)
+            break;
+
+        struct pbuf *next = p->next;
+        if (p->flags & PBUF_FLAG_IS_CUSTOM)
+            ((struct pbuf_custom *)p)->custom_free_function(p);
+        else
+            free(p);
+        count++;
+        p = next;
+    }
+    return count;
+}
+
+void pbuf_ref(struct pbuf *p)
+{
+    p->ref++;
+}
+
+void pbuf_cat(struct pbuf *head, struct pbuf *tail)
+{
+    struct pbuf *p = head;
+    for (; p->next != NULL; p = p->next)
+        p->tot_len = (u16_t)(p->tot_len + tail->tot_len);
+    p->tot_len = (u16_t)(p->tot_len + tail->tot_len);
+    p->next = tail;
+}
+
+void pbuf_chain(struct pbuf *head, struct pbuf *tail)
+{
+    pbuf_cat(head, tail);
+    pbuf_ref(tail);
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset)
+{
+    u16_t copied = 0;
+    for (; p != NULL && copied < len; p = p->next)
+    {
+        if (offset >= p->len)
+        {
+            offset = (u16_t)(offset - p->len);
+            continue;
+        }
+
+        u16_t n = std::min<u16_t>((u16_t)(p->len - offset), (u16_t)(len - copied));
+        memcpy((u8_t *)dataptr + copied, (const u8_t *)p->payload + offset, n);
+        copied = (u16_t)(copied + n);
+        offset = 0;
+    }
+    return copied;
+}
+
+err_t pbuf_take(struct pbuf *buf, const void *dataptr, u16_t len)
+{
+    if (buf->tot_len < len)
+        return ERR_ARG;
+
+    u16_t copied = 0;
+    for (struct pbuf *p = buf; p != NULL && copied < len; p = p->next)
+    {
+        u16_t n = std::min<u16_t>(p->len, (u16_t)(len - copied));
+        memcpy(p->payload, (const u8_t *)dataptr + copied, n);
+        copied = (u16_t)(copied + n);
+    }
+    return ERR_OK;
+}
+
+struct pbuf *pbuf_coalesce(struct pbuf *p, pbuf_layer layer)
+{
+    if (p->next == NULL)
+        return p;
+
+    // the chain is kept when there is no memory for the copy, like lwIP
+    struct pbuf *q = pbuf_alloc(layer, p->tot_len, PBUF_RAM);
+    if (q == NULL)
+        return p;
+
+    pbuf_copy_partial(p, q->payload, p->tot_len, 0);
+    pbuf_free(p);
+    return q;
+}
+
+/// @brief The bound pcbs and the joined multicast groups, guarded by the lwIP lock
+struct UdpHost
+{
+    std::vector<struct udp_pcb *> pcbs;
+    std::vector<ip4_addr_t> groups;
+    hostsim::UdpOutput output;
+    bool holdPbufs = false;
+    std::vector<struct pbuf *> heldPbufs;
+    int wakeFds[2] = {-1, -1};
+    bool pollerStarted = false;
+};
+
+static UdpHost &udp_host()
+{
+    static UdpHost instance;
+    return instance;
+}
+
+/// @brief Joins or leaves a multicast group on the loopback interface
+static void udp_membership(int fd, const ip4_addr_t *group, bool join)
+{
+    struct ip_mreq mreq = {};
+    mreq.imr_multiaddr.s_addr = group->addr;
+    mreq.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(fd, IPPROTO_IP, join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq));
+}
+
+/// @brief Delivers received datagrams to the pcb callbacks, like the lwIP thread
+static void udp_poller()
+{
+    UdpHost &host = udp_host();
+    std::vector<struct pollfd> fds;
+    std::vector<struct udp_pcb *> pcbs;
+    uint8_t buf[65536];
+
+    while (true)
+    {
+        fds.clear();
+        pcbs.clear();
+        {
+            std::lock_guard<std::recursive_mutex> guard(lwip_mutex());
+            fds.push_back({host.wakeFds[0], POLLIN, 0});
+            for (struct udp_pcb *pcb : host.pcbs)
+            {
+                fds.push_back({pcb->fd, POLLIN, 0});
+                pcbs.push_back(pcb);
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), -1) <= 0)
+            continue;
+
+        if (fds[0].revents & POLLIN)
+        {
+            char drain[64];
+            if (read(host.wakeFds[0], drain, sizeof(drain)) < 0)
+                continue;
+        }
+
+        for (size_t i = 1; i < fds.size(); i++)
+        {
+            if (!(fds[i].revents & POLLIN))
+                continue;
+
+            std::lock_guard<std::recursive_mutex> guard(lwip_mutex());
+            struct udp_pcb *pcb = pcbs[i - 1];
+            if (std::find(host.pcbs.begin(), host.pcbs.end(), pcb) == host.pcbs.end())
+                continue; // removed while polling
+
+            struct sockaddr_in from;
+            socklen_t fromLen = sizeof(from);
+            ssize_t len = recvfrom(pcb->fd, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &fromLen);
+            if (len < 0)
+                continue;
+
+            ip_addr_t addr = {from.sin_addr.s_addr};
+            hostsim::deliverUdp(pcb, buf, (size_t)len, &addr, ntohs(from.sin_port));
+        }
+    }
+}
+
+/// @brief Wakes the poller so it picks up added or removed pcbs
+static void udp_poller_wake()
+{
+    UdpHost &host = udp_host();
+    if (!host.pollerStarted)
+    {
+        if (pipe(host.wakeFds) != 0)
+            abort();
+        host.pollerStarted = true;
+        std::thread(udp_poller).detach();
+        return;
+    }
+
+    char c = 0;
+    if (write(host.wakeFds[1], &c, 1) < 0)
+        perror("[HOST] poller wake");
+}
+
+struct udp_pcb *udp_new(void)
+{
+    struct udp_pcb *pcb = (struct udp_pcb *)calloc(1, sizeof(struct udp_pcb));
+    pcb->fd = -1;
+    pcb->mcast_ttl = 1;
+    return pcb;
+}
+
+void udp_remove(struct udp_pcb *pcb)
+{
+    std::lock_guard<std::recursive_mutex> guard(lwip_mutex());
+    UdpHost &host = udp_host();
+    std::erase(host.pcbs, pcb);
+    if (pcb->fd >= 0)
+    {
+        close(pcb->fd);
+        udp_poller_wake();
+    }
+    free(pcb);
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
+{
+    std::lock_guard<std::recursive_mutex> guard(lwip_mutex());
+    UdpHost &host = udp_host();
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return ERR_MEM;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+    struct sockaddr_in sin = {};
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = ipaddr != NULL ? ipaddr->addr : 0;
+    sin.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) != 0)
+    {
+        close(fd);
+        return ERR_USE;
+    }
+
+    socklen_t len = sizeof(sin);
+    getsockname(fd, (struct sockaddr *)&sin, &len);
+
+    struct in_addr loopback = {htonl(INADDR_LOOPBACK)};
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof(loopback));
+    for (const ip4_addr_t &group : host.groups)
+        udp_membership(fd, &group, true);
+
+    if (pcb->fd >= 0)
+    {
+        close(pcb->fd);
+        std::erase(host.pcbs, pcb);
+    }
+
+    pcb->fd = fd;
+    pcb->local_ip = ipaddr != NULL ? *ipaddr : ip_addr_any;
+    pcb->local_port = ntohs(sin.sin_port);
+    host.pcbs.push_back(pcb);
+    udp_poller_wake();
+    return ERR_OK;
+}
+
+err_t udp_connect(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
+{
+    if (pcb->fd < 0)
+    {
+        err_t err = udp_bind(pcb, IP_ANY_TYPE, 0);
+        if (err != ERR_OK)
+            return err;
+    }
+
+    pcb->remote_ip = *ipaddr;
+    pcb->remote_port = port;
+    pcb->connected = true;
+    return ERR_OK;
+}
+
+void udp_disconnect(struct udp_pcb *pcb)
+{
+    pcb->remote_ip = ip_addr_any;
+    pcb->remote_port = 0;
+    pcb->connected = false;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg)
+{
+    pcb->recv = recv;
+    pcb->recv_arg = recv_arg;
+}
+
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port)
+{
+    std::lock_guard<std::recursive_mutex> guard(lwip_mutex());
+    UdpHost &host = udp_host();
+
+    if (pcb->fd < 0)
+    {
+        err_t err = udp_bind(pcb, IP_ANY_TYPE, 0);
+        if (err != ERR_OK)
+            return err;
+    }
+
+    if (host.holdPbufs)
+    {
+        // like a driver still queueing the frame, e.g. waiting for ARP
+        pbuf_ref(p);
+        host.heldPbufs.push_back(p);
+    }
+
+    uint8_t buf[65536];
+    u16_t len = pbuf_copy_partial(p, buf, p->tot_len, 0);
+
+    if (host.output)
+        return host.output(pcb, buf, len, dst_ip, dst_port);
+
+    if (ip_addr_ismulticast(dst_ip))
+    {
+        int ttl = pcb->mcast_ttl;
+        setsockopt(pcb->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    }
+
+    struct sockaddr_in sin = {};
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = dst_ip->addr;
+    sin.sin_port = htons(dst_port);
+    if (sendto(pcb->fd, buf, len, 0, (struct sockaddr *)&sin, sizeof(sin)) != len)
+        return ERR_RTE;
+    return ERR_OK;
+}
+
+err_t udp_send(struct udp_pcb *pcb, struct pbuf *p)
+{
+    if (!pcb->connected)
+        return ERR_CONN;
+    return udp_sendto(pcb, p, &pcb->remote_ip, pcb->remote_port);
+}
+
+err_t udp_sendto_if(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port, struct netif *netif)
+{
+    (void)netif;
+    return udp_sendto(pcb, p, dst_ip, dst_port);
+}
+
+err_t igmp_joingroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr)
+{
+    (void)ifaddr;
+    std::lock_guard<std::recursive_mutex> guard(lwip_mutex());
+    UdpHost &host = udp_host();
+    host.groups.push_back(*groupaddr);
+    for (struct udp_pcb *pcb : host.pcbs)
+        udp_membership(pcb->fd, groupaddr, true);
+    return ERR_OK;
+}
+
+err_t igmp_leavegroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr)
+{
+    (void)ifaddr;
+    std::lock_guard<std::recursive_mutex> guard(lwip_mutex());
+    UdpHost &host = udp_host();
+    auto it = std::find_if(host.groups.begin(), host.groups.end(), [groupaddr](const ip4_addr_t &group)
+                           { return group.addr == groupaddr->addr; });
+    if (it == host.groups.end())
+        return ERR_VAL;
+
+    host.groups.erase(it);
+    for (struct udp_pcb *pcb : host.pcbs)
+        udp_membership(pcb->fd, groupaddr, false);
+    return ERR_OK;
+}
+
+namespace hostsim
+{
+    void setUdpOutput(UdpOutput output)
+    {
+        std::lock_guard<std::recursive_mutex> guard(lwip_mutex());
+        udp_host().output = std::move(output);
+    }
+
+    void holdUdpPbufs(bool hold)
+    {
+        std::vector<struct pbuf *> held;
+        {
+            std::lock_guard<std::recursive_mutex> guard(lwip_mutex());
+            udp_host().holdPbufs = hold;
+            if (hold)
+                return;
+            held.swap(udp_host().heldPbufs);
+        }
+
+        std::lock_guard<std::recursive_mutex> guard(lwip_mutex());
+        for (struct pbuf *p : held)
+            pbuf_free(p);
+    }
+
+    void deliverUdp(struct udp_pcb *pcb, const void *data, size_t length, const ip_addr_t *from, uint16_t port, size_t segmentSize)
+    {
+        std::lock_guard<std::recursive_mutex> guard(lwip_mutex());
+        if (pcb->connected && (pcb->remote_ip.addr != from->addr || pcb->remote_port != port))
+            return;
+
+        if (segmentSize == 0 || segmentSize > length)
+            segmentSize = length;
+
+        // a chain of segmentSize pbufs, like a driver with small pool buffers
+        struct pbuf *p = NULL;
+        for (size_t offset = 0; offset < length || p == NULL; offset += segmentSize)
+        {
+            u16_t segment = (u16_t)std::min(segmentSize, length - offset);
+            struct pbuf *q = pbuf_alloc(PBUF_TRANSPORT, segment, PBUF_RAM);
+            memcpy(q->payload, (const uint8_t *)data + offset, segment);
+            if (p == NULL)
+                p = q;
+            else
+                pbuf_cat(p, q);
+        }
+        if (pcb->recv != NULL)
+            pcb->recv(pcb->recv_arg, pcb, p, from, port);
+        else
+            pbuf_free(p);
+    }
+}
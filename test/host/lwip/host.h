@@ -0,0 +1,195 @@
+#ifndef _HOST_LWIP_H_
+#define _HOST_LWIP_H_
+
+// Host replacement of the lwIP raw API used by pico-radio, backed by host/lwip.cpp.
+// UDP pcbs send and receive through POSIX sockets unless an output hook is installed.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+#include <arpa/inet.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef uint8_t u8_t;
+    typedef uint16_t u16_t;
+    typedef uint32_t u32_t;
+    typedef int8_t s8_t;
+    typedef int16_t s16_t;
+    typedef int32_t s32_t;
+    typedef s8_t err_t;
+
+#define ERR_OK 0
+#define ERR_MEM -1
+#define ERR_BUF -2
+#define ERR_TIMEOUT -3
+#define ERR_RTE -4
+#define ERR_VAL -6
+#define ERR_USE -8
+#define ERR_CONN -11
+#define ERR_IF -12
+#define ERR_ARG -16
+
+#define LWIP_UNUSED_ARG(x) (void)x
+#define LWIP_IGMP 1
+#define TCP_MSS 1460
+#define TCP_SND_BUF (8 * TCP_MSS)
+#define PP_HTONS(x) ((u16_t)((((x) & 0xff) << 8) | (((x) & 0xff00) >> 8)))
+#define PP_HTONL(x) ((((x) & 0xffUL) << 24) | (((x) & 0xff00UL) << 8) | (((x) & 0xff0000UL) >> 8) | (((x) & 0xff000000UL) >> 24))
+
+    typedef struct ip4_addr
+    {
+        u32_t addr;
+    } ip4_addr_t;
+    typedef ip4_addr_t ip_addr_t;
+
+#define IP4_ADDR(ip, a, b, c, d) ((ip)->addr = PP_HTONL(((u32_t)((a) & 0xff) << 24) | ((u32_t)((b) & 0xff) << 16) | ((u32_t)((c) & 0xff) << 8) | (u32_t)((d) & 0xff)))
+#define IPADDR4_INIT(u32val) {u32val}
+#define IPADDR4_INIT_BYTES(a, b, c, d) IPADDR4_INIT(PP_HTONL(((u32_t)((a) & 0xff) << 24) | ((u32_t)((b) & 0xff) << 16) | ((u32_t)((c) & 0xff) << 8) | (u32_t)((d) & 0xff)))
+#define ip_2_ip4(ipaddr) (ipaddr)
+#define ip4_addr_get_u32(src_ipaddr) ((src_ipaddr)->addr)
+#define ip4_addr_set_u32(dest_ipaddr, src_u32) ((dest_ipaddr)->addr = (src_u32))
+#define ip_addr_copy(dest, src) ((dest) = (src))
+#define ip4_addr_copy(dest, src) ((dest) = (src))
+#define ip4_addr_ismulticast(addr1) (((addr1)->addr & PP_HTONL(0xf0000000UL)) == PP_HTONL(0xe0000000UL))
+#define ip_addr_ismulticast(addr1) ip4_addr_ismulticast(addr1)
+#define ip4_addr_isany(addr1) ((addr1) == NULL || (addr1)->addr == 0)
+#define ip_addr_cmp(addr1, addr2) ((addr1)->addr == (addr2)->addr)
+#define ip4_addr_cmp(addr1, addr2) ((addr1)->addr == (addr2)->addr)
+#define ip4_addr1(ipaddr) (((const u8_t *)(&(ipaddr)->addr))[0])
+#define ip4_addr2(ipaddr) (((const u8_t *)(&(ipaddr)->addr))[1])
+#define ip4_addr3(ipaddr) (((const u8_t *)(&(ipaddr)->addr))[2])
+#define ip4_addr4(ipaddr) (((const u8_t *)(&(ipaddr)->addr))[3])
+
+    extern const ip_addr_t ip_addr_any;
+    extern const ip_addr_t ip_addr_broadcast;
+#define IP_ANY_TYPE (&ip_addr_any)
+#define IP4_ADDR_ANY (&ip_addr_any)
+#define IP4_ADDR_ANY4 (&ip_addr_any)
+#define IP_ADDR_ANY (&ip_addr_any)
+#define IP_ADDR_BROADCAST (&ip_addr_broadcast)
+
+    char *ip4addr_ntoa(const ip4_addr_t *addr);
+    int ip4addr_aton(const char *cp, ip4_addr_t *addr);
+#define ipaddr_ntoa(ipaddr) ip4addr_ntoa(ipaddr)
+
+    struct netif;
+    typedef void (*netif_status_callback_fn)(struct netif *netif);
+
+    struct netif
+    {
+        ip4_addr_t ip_addr;
+        ip4_addr_t netmask;
+        ip4_addr_t gw;
+        const char *hostname;
+        netif_status_callback_fn status_callback;
+        netif_status_callback_fn link_callback;
+    };
+
+    extern struct netif *netif_list;
+    extern struct netif *netif_default;
+#define netif_ip4_addr(netif) ((const ip4_addr_t *)&((netif)->ip_addr))
+#define netif_ip4_netmask(netif) ((const ip4_addr_t *)&((netif)->netmask))
+#define netif_ip4_gw(netif) ((const ip4_addr_t *)&((netif)->gw))
+#define netif_ip_addr4(netif) ((const ip_addr_t *)&((netif)->ip_addr))
+    void netif_set_hostname(struct netif *netif, const char *name);
+    void netif_set_addr(struct netif *netif, const ip4_addr_t *ipaddr, const ip4_addr_t *netmask, const ip4_addr_t *gw);
+    void netif_set_status_callback(struct netif *netif, netif_status_callback_fn status_callback);
+    void netif_set_link_callback(struct netif *netif, netif_status_callback_fn link_callback);
+    struct netif *ip_current_input_netif(void);
+    void dhcp_release_and_stop(struct netif *netif);
+
+    typedef enum
+    {
+        PBUF_TRANSPORT,
+        PBUF_IP,
+        PBUF_LINK,
+        PBUF_RAW_TX,
+        PBUF_RAW
+    } pbuf_layer;
+
+    typedef enum
+    {
+        PBUF_RAM,
+        PBUF_ROM,
+        PBUF_REF,
+        PBUF_POOL
+    } pbuf_type;
+
+    struct pbuf
+    {
+        struct pbuf *next;
+        void *payload;
+        u16_t tot_len;
+        u16_t len;
+        u8_t type_internal;
+        u8_t flags;
+        u16_t ref;
+    };
+
+    typedef void (*pbuf_free_custom_fn)(struct pbuf *p);
+    struct pbuf_custom
+    {
+        struct pbuf pbuf;
+        pbuf_free_custom_fn custom_free_function;
+    };
+
+    struct pbuf *pbuf_alloc(pbuf_layer l, u16_t length, pbuf_type type);
+    struct pbuf *pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type, struct pbuf_custom *p, void *payload_mem, u16_t payload_mem_len);
+    u8_t pbuf_free(struct pbuf *p);
+    void pbuf_ref(struct pbuf *p);
+    void pbuf_cat(struct pbuf *head, struct pbuf *tail);
+    void pbuf_chain(struct pbuf *head, struct pbuf *tail);
+    u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset);
+    err_t pbuf_take(struct pbuf *buf, const void *dataptr, u16_t len);
+    struct pbuf *pbuf_coalesce(struct pbuf *p, pbuf_layer layer);
+
+    struct udp_pcb;
+    typedef void (*udp_recv_fn)(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+
+#define UDP_FLAGS_MULTICAST_LOOP 0x08U
+
+    struct udp_pcb
+    {
+        ip_addr_t local_ip;
+        ip_addr_t remote_ip;
+        u16_t local_port;
+        u16_t remote_port;
+        u8_t flags;
+        u8_t mcast_ttl;
+        bool connected;
+        udp_recv_fn recv;
+        void *recv_arg;
+        /// @brief The POSIX socket, -1 until bound
+        int fd;
+    };
+
+#define udp_set_multicast_ttl(pcb, value) ((pcb)->mcast_ttl = (value))
+#define udp_get_multicast_ttl(pcb) ((pcb)->mcast_ttl)
+#define udp_set_flags(pcb, set_flags) ((pcb)->flags = (u8_t)((pcb)->flags | (set_flags)))
+#define udp_clear_flags(pcb, clr_flags) ((pcb)->flags = (u8_t)((pcb)->flags & (u8_t)(~(clr_flags) & 0xff)))
+#define udp_is_flag_set(pcb, flag) (((pcb)->flags & (flag)) != 0)
+
+    struct udp_pcb *udp_new(void);
+    void udp_remove(struct udp_pcb *pcb);
+    err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port);
+    err_t udp_connect(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port);
+    void udp_disconnect(struct udp_pcb *pcb);
+    void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg);
+    err_t udp_send(struct udp_pcb *pcb, struct pbuf *p);
+    err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port);
+    err_t udp_sendto_if(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port, struct netif *netif);
+
+    err_t igmp_joingroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr);
+    err_t igmp_leavegroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
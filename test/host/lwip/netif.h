@@ -0,0 +1,6 @@
+#ifndef _HOST_LWIP_NETIF_H_
+#define _HOST_LWIP_NETIF_H_
+
+#include "lwip/host.h"
+
+#endif
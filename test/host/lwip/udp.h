@@ -0,0 +1,6 @@
+#ifndef _HOST_LWIP_UDP_H_
+#define _HOST_LWIP_UDP_H_
+
+#include "lwip/host.h"
+
+#endif
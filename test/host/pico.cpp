@@ -0,0 +1,127 @@
+#include <mutex>
+#include "pico/stdlib.h"
+#include "pico/rand.h"
+#include "pico/flash.h"
+#include "hardware/watchdog.h"
+#include "hardware/flash.h"
+#include "hostsim.h"
+
+uint64_t time_us_64(void)
+{
+    return hostsim::now();
+}
+
+absolute_time_t get_absolute_time(void)
+{
+    return hostsim::now();
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+    return delayed_by_ms(get_absolute_time(), ms);
+}
+
+absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms)
+{
+    uint64_t delayed = t + (uint64_t)ms * 1000;
+    return delayed < t ? UINT64_MAX : delayed;
+}
+
+bool time_reached(absolute_time_t t)
+{
+    return get_absolute_time() >= t;
+}
+
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+    return (int64_t)(to - from);
+}
+
+uint32_t to_ms_since_boot(absolute_time_t t)
+{
+    return (uint32_t)(t / 1000);
+}
+
+uint64_t to_us_since_boot(absolute_time_t t)
+{
+    return t;
+}
+
+/// @brief A fixed seed keeps the tests reproducible
+static uint64_t rand_state = 0x9e3779b97f4a7c15ull;
+static std::mutex rand_mutex;
+
+uint64_t get_rand_64(void)
+{
+    std::lock_guard<std::mutex> guard(rand_mutex);
+    // xorshift64*
+    rand_state ^= rand_state >> 12;
+    rand_state ^= rand_state << 25;
+    rand_state ^= rand_state >> 27;
+    return rand_state * 0x2545f4914f6cdd1dull;
+}
+
+uint32_t get_rand_32(void)
+{
+    return (uint32_t)(get_rand_64() >> 32);
+}
+
+void get_rand_128(rng_128_t *rand128)
+{
+    rand128->r[0] = get_rand_64();
+    rand128->r[1] = get_rand_64();
+}
+
+static bool watchdog_reboot = false;
+
+bool watchdog_caused_reboot(void)
+{
+    return watchdog_reboot;
+}
+
+uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+
+/// @brief Flash starts erased
+static struct FlashInit
+{
+    FlashInit()
+    {
+        memset(host_flash, 0xff, sizeof(host_flash));
+    }
+} flashInit;
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+    assert(flash_offs % FLASH_SECTOR_SIZE == 0 && count % FLASH_SECTOR_SIZE == 0);
+    assert(flash_offs + count <= PICO_FLASH_SIZE_BYTES);
+    memset(host_flash + flash_offs, 0xff, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count)
+{
+    assert(flash_offs % FLASH_PAGE_SIZE == 0 && count % FLASH_PAGE_SIZE == 0);
+    assert(flash_offs + count <= PICO_FLASH_SIZE_BYTES);
+    // programming can only clear bits
+    for (size_t i = 0; i < count; i++)
+        host_flash[flash_offs + i] &= data[i];
+}
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms)
+{
+    (void)enter_exit_timeout_ms;
+    func(param);
+    return PICO_OK;
+}
+
+namespace hostsim
+{
+    void setWatchdogReboot(bool reboot)
+    {
+        watchdog_reboot = reboot;
+    }
+
+    void eraseFlash()
+    {
+        memset(host_flash, 0xff, sizeof(host_flash));
+    }
+}
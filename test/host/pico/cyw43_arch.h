@@ -0,0 +1,98 @@
+#ifndef _HOST_PICO_CYW43_ARCH_H_
+#define _HOST_PICO_CYW43_ARCH_H_
+
+// Host replacement of the cyw43 driver API, the link is simulated by host/cyw43.cpp
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lwip/host.h"
+
+#define CYW43_LINK_DOWN (0)
+#define CYW43_LINK_JOIN (1)
+#define CYW43_LINK_NOIP (2)
+#define CYW43_LINK_UP (3)
+#define CYW43_LINK_FAIL (-1)
+#define CYW43_LINK_NONET (-2)
+#define CYW43_LINK_BADAUTH (-3)
+
+#define CYW43_ITF_STA 0
+#define CYW43_ITF_AP 1
+
+#define CYW43_AUTH_OPEN (0)
+#define CYW43_AUTH_WPA2_AES_PSK (0x00400004)
+#define CYW43_CHANNEL_NONE (0xffffffff)
+#define CYW43_COUNTRY_USA (0x5355)
+#define CYW43_IOCTL_GET_CHANNEL (0x3a)
+
+#define CYW43_NO_POWERSAVE_MODE (0)
+#define CYW43_PM1_POWERSAVE_MODE (1)
+#define CYW43_PM2_POWERSAVE_MODE (2)
+#define cyw43_pm_value(pm_mode, pm2_sleep_ret_ms, li_beacon_period, li_dtim_period, li_assoc) \
+    (li_assoc << 20 | li_dtim_period << 16 | li_beacon_period << 12 | (pm2_sleep_ret_ms / 10) << 4 | pm_mode)
+#define CYW43_PERFORMANCE_PM cyw43_pm_value(CYW43_PM2_POWERSAVE_MODE, 20, 1, 1, 1)
+#define CYW43_DEFAULT_PM (CYW43_PERFORMANCE_PM)
+
+typedef struct _cyw43_t
+{
+    struct netif netif[2];
+} cyw43_t;
+
+typedef struct _cyw43_ev_scan_result_t
+{
+    uint8_t bssid[6];
+    uint16_t channel;
+    uint8_t ssid_len;
+    uint8_t ssid[32];
+    uint8_t auth_mode;
+    int16_t rssi;
+} cyw43_ev_scan_result_t;
+
+typedef struct _cyw43_wifi_scan_options_t
+{
+    uint32_t version;
+    uint16_t action;
+    uint16_t _;
+    uint32_t ssid_len;
+    uint8_t ssid[32];
+    uint8_t bssid[6];
+    int8_t bss_type;
+    int8_t scan_type;
+} cyw43_wifi_scan_options_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    extern cyw43_t cyw43_state;
+
+    int cyw43_arch_init_with_country(uint32_t country);
+    void cyw43_arch_deinit(void);
+    void cyw43_arch_enable_sta_mode(void);
+    uint32_t cyw43_arch_get_country_code(void);
+    void cyw43_arch_lwip_begin(void);
+    void cyw43_arch_lwip_end(void);
+
+    bool cyw43_is_initialized(cyw43_t *self);
+    void cyw43_wifi_set_up(cyw43_t *self, int itf, bool up, uint32_t country);
+    int cyw43_wifi_join(cyw43_t *self, size_t ssid_len, const uint8_t *ssid, size_t key_len, const uint8_t *key, uint32_t auth_type, const uint8_t *bssid, uint32_t channel);
+    int cyw43_wifi_leave(cyw43_t *self, int itf);
+    int cyw43_tcpip_link_status(cyw43_t *self, int itf);
+    int cyw43_wifi_pm(cyw43_t *self, uint32_t pm);
+    int cyw43_wifi_get_rssi(cyw43_t *self, int32_t *rssi);
+    int cyw43_wifi_get_bssid(cyw43_t *self, uint8_t bssid[6]);
+    int cyw43_wifi_scan(cyw43_t *self, cyw43_wifi_scan_options_t *opts, void *env, int (*result_cb)(void *, const cyw43_ev_scan_result_t *));
+    bool cyw43_wifi_scan_active(cyw43_t *self);
+    int cyw43_wifi_ap_get_stas(cyw43_t *self, int *num_stas, uint8_t *macs);
+    void cyw43_wifi_ap_set_ssid(cyw43_t *self, size_t len, const uint8_t *buf);
+    void cyw43_wifi_ap_set_password(cyw43_t *self, size_t len, const uint8_t *buf);
+    void cyw43_wifi_ap_set_auth(cyw43_t *self, uint32_t auth);
+    void cyw43_wifi_ap_set_channel(cyw43_t *self, uint32_t channel);
+    int cyw43_ioctl(cyw43_t *self, uint32_t cmd, size_t len, uint8_t *buf, uint32_t iface);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _HOST_PICO_FLASH_H_
+#define _HOST_PICO_FLASH_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _HOST_PICO_RAND_H_
+#define _HOST_PICO_RAND_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint64_t r[2];
+} rng_128_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    uint32_t get_rand_32(void);
+    uint64_t get_rand_64(void);
+    void get_rand_128(rng_128_t *rand128);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
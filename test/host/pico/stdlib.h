@@ -0,0 +1,16 @@
+#ifndef _HOST_PICO_STDLIB_H_
+#define _HOST_PICO_STDLIB_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/types.h>
+#include "pico/time.h"
+
+#define PICO_OK 0
+#define PICO_ERROR_TIMEOUT -1
+#define panic(...) abort()
+
+#endif
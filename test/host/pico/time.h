@@ -0,0 +1,29 @@
+#ifndef _HOST_PICO_TIME_H_
+#define _HOST_PICO_TIME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host replacement of pico/time.h on the virtual clock of host/freertos.cpp
+
+typedef uint64_t absolute_time_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    uint64_t time_us_64(void);
+    absolute_time_t get_absolute_time(void);
+    absolute_time_t make_timeout_time_ms(uint32_t ms);
+    absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms);
+    bool time_reached(absolute_time_t t);
+    int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+    uint32_t to_ms_since_boot(absolute_time_t t);
+    uint64_t to_us_since_boot(absolute_time_t t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
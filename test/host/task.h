@@ -0,0 +1,31 @@
+#ifndef _HOST_TASK_H_
+#define _HOST_TASK_H_
+
+#include "FreeRTOS.h"
+
+typedef struct HostTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *parameters, UBaseType_t priority, TaskHandle_t *out_task);
+    void vTaskDelete(TaskHandle_t task);
+    void vTaskDelay(TickType_t ticks);
+    TickType_t xTaskGetTickCount(void);
+    TaskHandle_t xTaskGetCurrentTaskHandle(void);
+    uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+    BaseType_t xTaskNotifyGive(TaskHandle_t task);
+    void host_enter_critical(void);
+    void host_exit_critical(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define taskENTER_CRITICAL() host_enter_critical()
+#define taskEXIT_CRITICAL() host_exit_critical()
+
+#endif
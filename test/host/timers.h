@@ -0,0 +1,19 @@
+#ifndef _HOST_TIMERS_H_
+#define _HOST_TIMERS_H_
+
+#include "FreeRTOS.h"
+
+typedef void (*PendedFunction_t)(void *, uint32_t);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    BaseType_t xTimerPendFunctionCall(PendedFunction_t function, void *parameter1, uint32_t parameter2, TickType_t ticksToWait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,242 @@
+#include <string>
+#include <vector>
+#include "testing.h"
+#include "hostsim.h"
+#include "mdnsresponder.h"
+
+using namespace std::literals;
+
+/// @brief A response sent by the responder
+struct MdnsSent
+{
+    std::vector<uint8_t> data;
+    ip_addr_t to;
+    uint16_t port;
+};
+
+/// @brief A record of a parsed response
+struct MdnsRecord
+{
+    std::string name;
+    uint16_t type;
+    uint16_t cls;
+    uint32_t ttl;
+    /// @brief The decoded target of PTR and SRV records
+    std::string target;
+    /// @brief True if the target ends exactly at the end of the rdata
+    bool targetFits;
+};
+
+/// @brief A parsed response
+struct MdnsResponse
+{
+    uint16_t id;
+    std::vector<std::string> questions;
+    std::vector<MdnsRecord> records;
+};
+
+static uint16_t read_u16(const std::vector<uint8_t> &data, size_t pos)
+{
+    return (data.at(pos) << 8) | data.at(pos + 1);
+}
+
+/// @brief Reads a possibly compressed name
+static std::string read_name(const std::vector<uint8_t> &data, size_t *pos)
+{
+    std::string name;
+    size_t p = *pos;
+    bool jumped = false;
+    while (data.at(p) != 0)
+    {
+        if ((data[p] & 0xc0) == 0xc0)
+        {
+            if (!jumped)
+                *pos = p + 2;
+            jumped = true;
+            p = read_u16(data, p) & 0x3fff;
+            continue;
+        }
+        if (!name.empty())
+            name += '.';
+        name.append((const char *)&data.at(p + 1), data[p]);
+        p += data[p] + 1;
+    }
+    if (!jumped)
+        *pos = p + 1;
+    return name;
+}
+
+static MdnsResponse parse_response(const std::vector<uint8_t> &data)
+{
+    MdnsResponse response;
+    response.id = read_u16(data, 0);
+    uint16_t questions = read_u16(data, 4);
+    uint16_t records = read_u16(data, 6) + read_u16(data, 8) + read_u16(data, 10);
+
+    size_t pos = 12;
+    for (uint16_t i = 0; i < questions; i++)
+    {
+        response.questions.push_back(read_name(data, &pos));
+        pos += 4;
+    }
+    for (uint16_t i = 0; i < records; i++)
+    {
+        MdnsRecord record = {};
+        record.name = read_name(data, &pos);
+        record.type = read_u16(data, pos);
+        record.cls = read_u16(data, pos + 2);
+        record.ttl = (read_u16(data, pos + 4) << 16) | read_u16(data, pos + 6);
+        uint16_t rdlength = read_u16(data, pos + 8);
+        pos += 10;
+
+        size_t target = pos + (record.type == 33 ? 6 : 0);
+        if (record.type == 12 || record.type == 33)
+        {
+            record.target = read_name(data, &target);
+            record.targetFits = target == pos + rdlength;
+        }
+        pos += rdlength;
+        response.records.push_back(record);
+    }
+    return response;
+}
+
+/// @brief Builds a query with a single question
+static std::vector<uint8_t> make_query(uint16_t id, std::string_view name, uint16_t type, bool unicast = false)
+{
+    std::vector<uint8_t> query = {(uint8_t)(id >> 8), (uint8_t)id, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0};
+    while (!name.empty())
+    {
+        size_t dot = name.find('.');
+        std::string_view label = name.substr(0, dot);
+        query.push_back(label.length());
+        query.insert(query.end(), label.begin(), label.end());
+        name = dot == std::string_view::npos ? ""sv : name.substr(dot + 1);
+    }
+    query.insert(query.end(), {0, (uint8_t)(type >> 8), (uint8_t)type, (uint8_t)(unicast ? 0x80 : 0), 1});
+    return query;
+}
+
+/// @brief A responder whose responses are captured instead of sent
+struct MdnsLoopback
+{
+    MdnsResponder *responder;
+    struct udp_pcb *pcb = nullptr;
+    std::vector<MdnsSent> sent;
+
+    MdnsLoopback()
+    {
+        hostsim::setUdpOutput([this](struct udp_pcb *pcb, const uint8_t *data, size_t length, const ip_addr_t *to, uint16_t port)
+                              {
+            if (pcb->local_port == MDNS_PORT)
+                this->pcb = pcb;
+            sent.push_back({std::vector<uint8_t>(data, data + length), *to, port});
+            return ERR_OK; });
+        responder = new MdnsResponder("Pico-Radio"sv);
+    }
+
+    ~MdnsLoopback()
+    {
+        delete responder;
+        hostsim::setUdpOutput(nullptr);
+    }
+
+    /// @brief Passes a query to the responder and returns the responses
+    std::vector<MdnsSent> query(const std::vector<uint8_t> &query, uint16_t port)
+    {
+        sent.clear();
+        ip_addr_t from = IPADDR4_INIT_BYTES(127, 0, 0, 2);
+        hostsim::deliverUdp(pcb, query.data(), query.size(), &from, port);
+        return sent;
+    }
+};
+
+TEST(answers_a_multicast_address_query)
+{
+    MdnsLoopback mdns;
+    REQUIRE(mdns.pcb != nullptr);
+
+    std::vector<MdnsSent> sent = mdns.query(make_query(0x1234, "pico-radio.local"sv, 1), MDNS_PORT);
+    REQUIRE(sent.size() == 1);
+    CHECK_EQ(sent[0].port, MDNS_PORT);
+    CHECK(ip_addr_ismulticast(&sent[0].to));
+
+    MdnsResponse response = parse_response(sent[0].data);
+    CHECK_EQ(response.id, (uint16_t)0);
+    CHECK(response.questions.empty());
+    REQUIRE(response.records.size() == 1);
+    CHECK_EQ(response.records[0].name, "Pico-Radio.local"s);
+    CHECK_EQ(response.records[0].cls, (uint16_t)0x8001);
+    CHECK_EQ(response.records[0].ttl, 120u);
+}
+
+TEST(answers_a_legacy_unicast_query_with_its_id_and_question)
+{
+    MdnsLoopback mdns;
+    REQUIRE(mdns.pcb != nullptr);
+    REQUIRE(mdns.responder->addService("_networktables._tcp"sv, 5810));
+
+    std::vector<MdnsSent> sent = mdns.query(make_query(0xbeef, "_networktables._tcp.local"sv, 12), 40000);
+    REQUIRE(sent.size() == 1);
+    CHECK_EQ(sent[0].port, (uint16_t)40000);
+    CHECK(!ip_addr_ismulticast(&sent[0].to));
+
+    MdnsResponse response = parse_response(sent[0].data);
+    CHECK_EQ(response.id, (uint16_t)0xbeef);
+    REQUIRE(response.questions.size() == 1);
+    CHECK_EQ(response.questions[0], "_networktables._tcp.local"s);
+    REQUIRE(response.records.size() == 4);
+    for (const MdnsRecord &record : response.records)
+    {
+        CHECK_EQ(record.cls, (uint16_t)1);
+        CHECK(record.ttl <= 10);
+    }
+
+    // the shared response of multicast queries keeps id 0 and its cache-flush bits
+    sent = mdns.query(make_query(0xbeef, "_networktables._tcp.local"sv, 12), MDNS_PORT);
+    REQUIRE(sent.size() == 1);
+    response = parse_response(sent[0].data);
+    CHECK_EQ(response.id, (uint16_t)0);
+    CHECK(response.questions.empty());
+    REQUIRE(response.records.size() == 4);
+    CHECK_EQ(response.records[1].cls, (uint16_t)0x8001);
+    CHECK_EQ(response.records[3].ttl, 120u);
+}
+
+TEST(answers_a_unicast_response_query_directly)
+{
+    MdnsLoopback mdns;
+    REQUIRE(mdns.pcb != nullptr);
+
+    std::vector<MdnsSent> sent = mdns.query(make_query(0x4321, "pico-radio.local"sv, 1, true), MDNS_PORT);
+    REQUIRE(sent.size() == 1);
+    CHECK_EQ(sent[0].port, MDNS_PORT);
+    CHECK(!ip_addr_ismulticast(&sent[0].to));
+
+    MdnsResponse response = parse_response(sent[0].data);
+    CHECK_EQ(response.id, (uint16_t)0);
+    REQUIRE(response.records.size() == 1);
+    CHECK_EQ(response.records[0].cls, (uint16_t)0x8001);
+}
+
+TEST(sets_the_record_lengths_of_the_encoded_names)
+{
+    MdnsLoopback mdns;
+    REQUIRE(mdns.pcb != nullptr);
+    REQUIRE(mdns.responder->addService("_networktables._tcp"sv, 5810));
+
+    std::vector<MdnsSent> sent = mdns.query(make_query(0, "_networktables._tcp.local"sv, 12), MDNS_PORT);
+    REQUIRE(sent.size() == 1);
+    MdnsResponse response = parse_response(sent[0].data);
+    REQUIRE(response.records.size() == 4);
+
+    CHECK_EQ(response.records[0].type, (uint16_t)12);
+    CHECK_EQ(response.records[0].target, "Pico-Radio._networktables._tcp.local"s);
+    CHECK(response.records[0].targetFits);
+    CHECK_EQ(response.records[1].type, (uint16_t)33);
+    CHECK_EQ(response.records[1].name, "Pico-Radio._networktables._tcp.local"s);
+    CHECK_EQ(response.records[1].target, "Pico-Radio.local"s);
+    CHECK(response.records[1].targetFits);
+}
+
+TEST_MAIN()
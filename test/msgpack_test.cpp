@@ -0,0 +1,208 @@
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include "testing.h"
+#include "msgpack/msgpack.hpp"
+
+using namespace std::literals;
+
+/// @brief Packs values into the internal vector of a packer
+template <class... Types>
+static std::vector<uint8_t> pack(const Types &...values)
+{
+    msgpack::Packer<false> packer;
+    packer.process(values...);
+    return packer.vector();
+}
+
+/// @brief Unpacks one value of the encoded bytes
+/// @return False if the bytes were not consumed exactly
+template <class T>
+static bool unpack(const std::vector<uint8_t> &bytes, T &value)
+{
+    msgpack::Unpacker<false> unpacker(bytes.data(), bytes.size());
+    unpacker.process(value);
+    return !unpacker.ec && unpacker.bytes() == bytes.size();
+}
+
+TEST(packs_scalars_with_their_smallest_encoding)
+{
+    CHECK(pack(true) == std::vector<uint8_t>{0xc3});
+    CHECK(pack(false) == std::vector<uint8_t>{0xc2});
+    CHECK(pack(nullptr) == std::vector<uint8_t>{0xc0});
+
+    CHECK(pack((int64_t)5) == std::vector<uint8_t>{0x05});
+    CHECK(pack((int64_t)-1) == std::vector<uint8_t>{0xff});
+    CHECK(pack((int64_t)-32) == std::vector<uint8_t>{0xe0});
+    CHECK(pack((int64_t)-33) == (std::vector<uint8_t>{0xd0, 0xdf}));
+    CHECK(pack((int64_t)200) == (std::vector<uint8_t>{0xd1, 0x00, 0xc8}));
+    CHECK(pack((int64_t)70000) == (std::vector<uint8_t>{0xd2, 0x00, 0x01, 0x11, 0x70}));
+    CHECK(pack((int64_t)1 << 40) == (std::vector<uint8_t>{0xd3, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00}));
+    CHECK(pack((uint64_t)200) == (std::vector<uint8_t>{0xcc, 0xc8}));
+    CHECK(pack((uint64_t)300) == (std::vector<uint8_t>{0xcd, 0x01, 0x2c}));
+
+    // whole numbers are packed as ints
+    CHECK(pack(2.0) == std::vector<uint8_t>{0x02});
+    CHECK(pack(1.5) == (std::vector<uint8_t>{0xcb, 0x3f, 0xf8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}));
+    CHECK(pack(0.5f) == (std::vector<uint8_t>{0xca, 0x3f, 0x00, 0x00, 0x00}));
+}
+
+TEST(round_trips_scalars)
+{
+    for (int64_t value : std::initializer_list<int64_t>{0, 31, -32, 127, -128, 32767, -32768, 1LL << 40, INT64_MIN, INT64_MAX})
+    {
+        int64_t decoded = 0;
+        CHECK(unpack(pack(value), decoded));
+        CHECK_EQ(decoded, value);
+    }
+
+    for (uint64_t value : std::initializer_list<uint64_t>{0, 127, 255, 65535, 1ULL << 40, UINT64_MAX})
+    {
+        uint64_t decoded = 0;
+        CHECK(unpack(pack(value), decoded));
+        CHECK_EQ(decoded, value);
+    }
+
+    for (double value : {0.0, -0.25, 1.5, 1e300, -7.0})
+    {
+        double decoded = 0;
+        CHECK(unpack(pack(value), decoded));
+        CHECK_EQ(decoded, value);
+    }
+
+    // a negative fixint read as a double
+    double negative = 0;
+    CHECK(unpack(std::vector<uint8_t>{0xfb}, negative));
+    CHECK_EQ(negative, -5.0);
+}
+
+TEST(round_trips_strings_and_binary)
+{
+    // fixstr up to 31 characters, then str8
+    for (size_t length : {0, 1, 16, 31, 32, 254, 255, 70000})
+    {
+        std::string value(length, 'x');
+        std::vector<uint8_t> bytes = pack(value);
+        if (length < 32)
+            CHECK_EQ(bytes[0], (uint8_t)(0xa0 | length));
+
+        std::string_view decoded;
+        CHECK(unpack(bytes, decoded));
+        CHECK(decoded == value);
+    }
+
+    std::vector<uint8_t> bin = {0x00, 0xff, 0x7f};
+    std::vector<uint8_t> bytes = pack(std::span<const uint8_t>(bin));
+    CHECK(bytes == (std::vector<uint8_t>{0xc4, 0x03, 0x00, 0xff, 0x7f}));
+    std::vector<uint8_t> decoded;
+    CHECK(unpack(bytes, decoded));
+    CHECK(decoded == bin);
+}
+
+TEST(round_trips_number_arrays)
+{
+    // fixarray up to 15 elements, then array16
+    for (size_t count : {0, 1, 11, 15, 16, 100})
+    {
+        std::vector<double> doubles;
+        std::vector<float> floats;
+        std::vector<int64_t> ints;
+        for (size_t i = 0; i < count; i++)
+        {
+            doubles.push_back(i * 0.5 - 3.0);
+            floats.push_back(i * 0.25f);
+            ints.push_back((int64_t)(i * i) - 40);
+        }
+
+        std::vector<uint8_t> bytes = pack(doubles);
+        CHECK_EQ(bytes[0], count < 16 ? (uint8_t)(0x90 | count) : (uint8_t)0xdc);
+        // every element keeps its float64 encoding, whole numbers included
+        CHECK_EQ(bytes.size(), (count < 16 ? 1 : 3) + count * 9);
+
+        std::vector<double> decodedDoubles;
+        std::vector<float> decodedFloats;
+        std::vector<int64_t> decodedInts;
+        CHECK(unpack(bytes, decodedDoubles));
+        CHECK(unpack(pack(floats), decodedFloats));
+        CHECK(unpack(pack(ints), decodedInts));
+        CHECK(decodedDoubles == doubles);
+        CHECK(decodedFloats == floats);
+        CHECK(decodedInts == ints);
+    }
+
+    // elements of other formats, as another NT4 implementation may send them
+    std::vector<uint8_t> mixed = {0x94, 0x01, 0xfb, 0xca, 0x3f, 0x00, 0x00, 0x00, 0xcd, 0x01, 0x2c};
+    std::vector<double> decoded;
+    CHECK(unpack(mixed, decoded));
+    CHECK(decoded == (std::vector<double>{1.0, -5.0, 0.5, 300.0}));
+}
+
+TEST(packs_into_a_caller_buffer)
+{
+    std::vector<double> values = {0.1, 0.2, 0.3};
+    std::vector<uint8_t> expected = pack(values, "name"sv);
+
+    // an exact fit
+    std::vector<uint8_t> buffer(expected.size());
+    msgpack::Packer<false> packer(buffer.data(), buffer.size());
+    packer.process(values, "name"sv);
+    CHECK(!packer.overflowed());
+    CHECK_EQ(packer.size(), expected.size());
+    CHECK(buffer == expected);
+
+    // any smaller buffer overflows, nothing is written past it
+    for (size_t capacity = 0; capacity < expected.size(); capacity++)
+    {
+        std::vector<uint8_t> small(capacity + 1, 0xee);
+        msgpack::Packer<false> overflowing(small.data(), capacity);
+        overflowing.process(values, "name"sv);
+        CHECK(overflowing.overflowed());
+        CHECK(overflowing.size() <= capacity);
+        CHECK_EQ(small[capacity], (uint8_t)0xee);
+    }
+
+    packer.clear();
+    CHECK_EQ(packer.size(), (size_t)0);
+    packer.process(true);
+    CHECK_EQ(buffer[0], (uint8_t)0xc3);
+}
+
+TEST(reports_truncated_input)
+{
+    std::vector<double> values = {0.1, 0.2, 0.3, 1e10};
+    std::vector<int64_t> ints = {1, -100, 70000, 1LL << 40};
+    std::vector<uint8_t> doubleBytes = pack(values);
+    std::vector<uint8_t> intBytes = pack(ints);
+    std::vector<uint8_t> stringBytes = pack(std::string(40, 'x'));
+
+    // every prefix of the encoded values, copied so reads past the end are caught by the sanitizers
+    for (size_t length = 0; length < doubleBytes.size(); length++)
+    {
+        std::vector<uint8_t> truncated(doubleBytes.begin(), doubleBytes.begin() + length);
+        std::vector<double> decoded;
+        CHECK(!unpack(truncated, decoded));
+    }
+    for (size_t length = 0; length < intBytes.size(); length++)
+    {
+        std::vector<uint8_t> truncated(intBytes.begin(), intBytes.begin() + length);
+        std::vector<int64_t> decoded;
+        CHECK(!unpack(truncated, decoded));
+    }
+    for (size_t length = 0; length < stringBytes.size(); length++)
+    {
+        std::vector<uint8_t> truncated(stringBytes.begin(), stringBytes.begin() + length);
+        std::string_view decoded;
+        CHECK(!unpack(truncated, decoded));
+    }
+
+    // an array header claiming more elements than there are bytes is rejected before reserving
+    std::vector<uint8_t> huge = {0xdd, 0x7f, 0xff, 0xff, 0xff, 0x01};
+    std::vector<double> decoded;
+    msgpack::Unpacker<false> unpacker(huge.data(), huge.size());
+    unpacker.process(decoded);
+    CHECK(unpacker.ec == msgpack::UnpackerError::OutOfRange);
+    CHECK(decoded.capacity() < 16);
+}
+
+TEST_MAIN()
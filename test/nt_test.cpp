@@ -0,0 +1,585 @@
+#include <string>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "testing.h"
+#include "ntclient.h"
+#include "nt/ntpublisher.h"
+#include "nt/ntsubscriber.h"
+#include "config.h"
+
+using namespace std::literals;
+
+/// @brief The server under test, shared by the tests since the server binds fixed ports
+static NetworkTableInstance *server()
+{
+    static NetworkTableInstance *nt = []()
+    {
+        NetworkTableInstance *nt = new NetworkTableInstance();
+        nt->startServer();
+        return nt;
+    }();
+    return nt;
+}
+
+TEST(sends_local_updates_to_a_subscriber)
+{
+    NetworkTableInstance *nt = server();
+    NTPublisher publisher(nt, "/local/x"s, NTDataValue(1.0));
+
+    // the server may still be closing the connection when the test returns
+    static NtTestClient client;
+    REQUIRE(client.connect("local"sv));
+    client.subscribe(1, "/local/x"sv, "{\"periodic\":0}"sv);
+    client.poll();
+    int64_t id = client.topicId("/local/x"sv);
+    REQUIRE(id >= 0);
+
+    client.updates.clear();
+    publisher.setDouble(2.0);
+    nt->flush();
+    REQUIRE(client.waitForUpdate(id, 100));
+    CHECK_EQ(client.updates.back().value.f64, 2.0);
+    CHECK_EQ(client.updates.back().sequence, (int64_t)-1);
+    client.disconnect();
+}
+
+TEST(sends_the_newest_value_once_per_subscription_period)
+{
+    NetworkTableInstance *nt = server();
+    NTPublisher publisher(nt, "/periodic/x"s, NTDataValue((int64_t)-1));
+
+    // the server may still be closing the connection when the test returns
+    static NtTestClient client;
+    REQUIRE(client.connect("periodic"sv));
+    client.subscribe(1, "/periodic/x"sv, "{\"periodic\":0.1}"sv);
+    client.poll(200);
+    int64_t id = client.topicId("/periodic/x"sv);
+    REQUIRE(id >= 0);
+    client.updates.clear();
+
+    // off the millisecond grid of the other tests, the updates must not wait for a fixed tick
+    hostsim::sleepMs(5);
+
+    // publish at 1 kHz for a second, each value is the millisecond it was published at
+    uint64_t startUs = hostsim::now();
+    for (int64_t ms = 0; ms < 1000; ms++)
+    {
+        publisher.setInt(ms);
+        nt->flush();
+        hostsim::sleepMs(1);
+        client.poll(0);
+    }
+    client.poll(200);
+
+    // about 10 Hz, the first update leaves right away and the last one after the period
+    CHECK(client.updates.size() >= 10 && client.updates.size() <= 11);
+    for (size_t i = 0; i < client.updates.size(); i++)
+    {
+        const NtTestUpdate &update = client.updates[i];
+        CHECK_EQ(update.id, id);
+
+        // the newest value when the update was sent, at most one publish older than its arrival
+        int64_t receivedMs = std::min<int64_t>((int64_t)(update.receivedUs - startUs) / 1000, 999);
+        CHECK(receivedMs - update.value.i <= 1);
+        if (i > 0)
+            CHECK(update.value.i - client.updates[i - 1].value.i >= 99);
+    }
+    client.disconnect();
+}
+
+TEST(counts_updates_dropped_from_a_full_all_queue)
+{
+    NetworkTableInstance *nt = server();
+    NTPublisher publisher(nt, "/all/x"s, NTDataValue((int64_t)0));
+
+    // the server may still be closing the connection when the test returns
+    static NtTestClient client;
+    REQUIRE(client.connect("all"sv));
+    client.subscribe(1, "/all/x"sv, "{\"all\":true,\"periodic\":1}"sv);
+    client.poll(200);
+    int64_t id = client.topicId("/all/x"sv);
+    REQUIRE(id >= 0);
+    client.updates.clear();
+
+    // within the period of the initial value, every update is queued and the oldest are dropped
+    uint32_t overflowBefore = nt->getQueueOverflowCount();
+    const int64_t count = NT_ALL_QUEUE_DEPTH + 4;
+    for (int64_t i = 1; i <= count; i++)
+    {
+        publisher.setInt(i);
+        nt->flush();
+    }
+    CHECK_EQ(nt->getQueueOverflowCount() - overflowBefore, 4u);
+
+    client.poll(1100);
+    REQUIRE(client.updates.size() == NT_ALL_QUEUE_DEPTH);
+    for (size_t i = 0; i < client.updates.size(); i++)
+    {
+        CHECK_EQ(client.updates[i].id, id);
+        CHECK_EQ(client.updates[i].value.i, count - NT_ALL_QUEUE_DEPTH + 1 + (int64_t)i);
+    }
+    client.disconnect();
+}
+
+TEST(keeps_queued_updates_when_other_topics_use_the_client_budget)
+{
+    NetworkTableInstance *nt = server();
+    NTPublisher a(nt, "/budget/a"s, NTDataValue(""s));
+    NTPublisher b(nt, "/budget/b"s, NTDataValue(""s));
+
+    // the server may still be closing the connection when the test returns
+    static NtTestClient client;
+    REQUIRE(client.connect("budget"sv));
+    client.subscribe(1, "/budget/a"sv, "{\"all\":true,\"periodic\":1}"sv);
+    client.subscribe(2, "/budget/b"sv, "{\"all\":true,\"periodic\":1}"sv);
+    client.poll(200);
+    int64_t idB = client.topicId("/budget/b"sv);
+    REQUIRE(idB >= 0);
+    client.updates.clear();
+
+    // within the period, a small update of b and three large updates of a fill most of the budget,
+    // each update fits a single WebSocket frame
+    uint32_t overflowBefore = nt->getQueueOverflowCount();
+    b.setString(std::string(300, 'b'), 1000);
+    nt->flush();
+    for (int64_t i = 0; i < 3; i++)
+    {
+        a.setString(std::string(1100, 'a' + i), 2000 + i);
+        nt->flush();
+    }
+
+    // dropping the queued update of b would not make room, it is kept and the newest value follows it
+    b.setString(std::string(1000, 'B'), 4000);
+    nt->flush();
+    CHECK_EQ(nt->getQueueOverflowCount() - overflowBefore, 1u);
+
+    client.poll(1100);
+    std::vector<NtTestUpdate> updatesB;
+    for (const NtTestUpdate &update : client.updates)
+        if (update.id == idB)
+            updatesB.push_back(update);
+    REQUIRE(updatesB.size() == 2);
+    CHECK(updatesB[0].value.str() == std::string(300, 'b'));
+    CHECK_EQ(updatesB[0].time, 1000);
+    CHECK(updatesB[1].value.str() == std::string(1000, 'B'));
+    CHECK_EQ(updatesB[1].time, 4000);
+    CHECK_EQ(client.updates.size(), (size_t)5);
+    client.disconnect();
+}
+
+TEST(drops_held_updates_when_the_subscription_is_removed)
+{
+    NetworkTableInstance *nt = server();
+    NTPublisher periodic(nt, "/held/periodic"s, NTDataValue((int64_t)0));
+    NTPublisher all(nt, "/held/all"s, NTDataValue((int64_t)0));
+
+    // the server may still be closing the connection when the test returns
+    static NtTestClient client;
+    REQUIRE(client.connect("held"sv));
+    client.subscribe(1, "/held/periodic"sv, "{\"periodic\":1}"sv);
+    client.subscribe(2, "/held/all"sv, "{\"all\":true,\"periodic\":1}"sv);
+    client.poll(200);
+    REQUIRE(client.topicId("/held/periodic"sv) >= 0);
+    REQUIRE(client.topicId("/held/all"sv) >= 0);
+    client.updates.clear();
+
+    // both updates are held for the rest of the period
+    periodic.setInt(1);
+    all.setInt(1);
+    all.setInt(2);
+    nt->flush();
+    client.unsubscribe(1);
+    client.unsubscribe(2);
+    client.poll(1500);
+
+    CHECK(client.updates.empty());
+    client.disconnect();
+}
+
+TEST(drops_a_message_that_does_not_fit_the_text_buffer)
+{
+    NetworkTableInstance *nt = server();
+
+    // the server may still be closing the connection when the test returns
+    static NtTestClient client;
+    REQUIRE(client.connect("oom"sv));
+    client.subscribe(1, "/oom/"sv, "{\"prefix\":true,\"topicsonly\":true}"sv);
+    client.poll();
+    client.messages.clear();
+
+    // the announce needs a larger text buffer, which cannot be allocated
+    std::string longName = "/oom/"s + std::string(1000, 'x');
+    hostsim::setPortMallocLimit(600);
+    NTPublisher dropped(nt, longName, NTDataValue((int64_t)0));
+    hostsim::setPortMallocLimit(SIZE_MAX);
+    NTPublisher sent(nt, "/oom/small"s, NTDataValue((int64_t)0));
+
+    // the server sends the cached messages after handling one from the client
+    client.subscribe(2, "/oom/none"sv);
+    client.poll();
+
+    // no announce of a partially written topic name either
+    CHECK_EQ(client.topicId(longName), (int64_t)-1);
+    CHECK(client.topicId("/oom/small"sv) >= 0);
+    CHECK_EQ(client.announced.size(), (size_t)1);
+    REQUIRE(!client.messages.empty());
+    for (const std::string &message : client.messages)
+    {
+        json::Tokenizer tokenizer((const uint8_t *)message.data(), message.size());
+        while (tokenizer.next())
+            ;
+        CHECK(!tokenizer.has_error());
+    }
+    client.disconnect();
+}
+
+struct SubscriberReader
+{
+    NTSubscriber *subscriber;
+    volatile bool done = false;
+};
+
+TEST(reads_subscribers_while_the_server_adds_topics)
+{
+    NetworkTableInstance *nt = server();
+    const int count = 32;
+    std::vector<NTSubscriber *> subscribers;
+    for (int i = 0; i < count; i++)
+        subscribers.push_back(new NTSubscriber(nt, "/race/"s + std::to_string(i)));
+
+    // a user task reads while the announce and update callbacks add the topics of the other subscribers
+    SubscriberReader reader = {subscribers[0]};
+    xTaskCreate([](void *args) -> void
+                {
+        SubscriberReader *reader = (SubscriberReader *)args;
+        for (int i = 0; i < 200; i++)
+        {
+            reader->subscriber->getInt(-1);
+            vTaskDelay(1);
+        }
+        reader->done = true;
+        vTaskDelete(NULL); },
+                "reader", configMINIMAL_STACK_SIZE * 4, &reader, 1, NULL);
+
+    // the server may still be closing the connection when the test returns
+    static NtTestClient client;
+    REQUIRE(client.connect("race"sv));
+    for (int i = 0; i < count; i++)
+    {
+        client.publish(i, "/race/"s + std::to_string(i), "int"sv);
+        client.sendValue(i, 0, NTDataValue((int64_t)i));
+        hostsim::sleepMs(1);
+    }
+    while (!reader.done)
+        hostsim::sleepMs(10);
+
+    for (int i = 0; i < count; i++)
+    {
+        CHECK_EQ(subscribers[i]->getInt(-1), (int64_t)i);
+        delete subscribers[i];
+    }
+    client.disconnect();
+}
+
+TEST(sends_opted_in_updates_over_udp_with_sequence_numbers)
+{
+    std::vector<NtTestUpdate> datagramUpdates;
+    uint16_t sentPort = 0;
+    hostsim::setUdpOutput([&](struct udp_pcb *pcb, const uint8_t *data, size_t length, const ip_addr_t *to, uint16_t port)
+                          {
+        if (port != 6000)
+            return ERR_OK;
+        sentPort = port;
+        nt_parse_updates(data, length, hostsim::now(), datagramUpdates);
+        return ERR_OK; });
+
+    NetworkTableInstance *nt = server();
+    NTPublisher publisher(nt, "/udp/x"s, NTDataValue((int64_t)0));
+
+    // the server may still be closing the connection when the test returns
+    static NtTestClient client;
+    REQUIRE(client.connect("udp"sv));
+
+    client.subscribe(1, "/udp/x"sv, "{\"periodic\":0,\"udp\":6000}"sv);
+    client.poll();
+    int64_t id = client.topicId("/udp/x"sv);
+    REQUIRE(id >= 0);
+
+    // the initial value stays on the WebSocket
+    REQUIRE(!client.updates.empty());
+    CHECK_EQ(client.updates.back().id, id);
+    client.updates.clear();
+
+    for (int64_t i = 1; i <= 3; i++)
+    {
+        publisher.setInt(i);
+        nt->flush();
+    }
+    client.poll();
+
+    CHECK(client.updates.empty());
+    CHECK_EQ(sentPort, (uint16_t)6000);
+    REQUIRE(datagramUpdates.size() == 3);
+    for (size_t i = 0; i < datagramUpdates.size(); i++)
+    {
+        CHECK_EQ(datagramUpdates[i].id, id);
+        CHECK_EQ(datagramUpdates[i].value.i, (int64_t)i + 1);
+        if (i > 0)
+            CHECK_EQ(datagramUpdates[i].sequence, datagramUpdates[i - 1].sequence + 1);
+    }
+
+    client.disconnect();
+    hostsim::setUdpOutput(nullptr);
+}
+
+/// @brief A pattern of the trie check with the matcher the server used before the trie
+struct MatcherPattern
+{
+    std::string topic;
+    bool prefix;
+    int value;
+
+    bool matches(const std::string &name) const
+    {
+        if (prefix)
+        {
+            if (name.starts_with('$'))
+                return topic.starts_with('$') && name.starts_with(topic);
+            return topic.length() == 0 || name.starts_with(topic);
+        }
+        return name == topic;
+    }
+};
+
+TEST(subscription_trie_matches_like_the_linear_matcher)
+{
+    // few distinct parts, so patterns share prefixes and split edges at every position
+    static const char *PARTS[] = {"", "/", "$", "a", "b", "ab", "/a", "/b/", "$sub$"};
+    std::mt19937 random(42);
+    auto random_name = [&]()
+    {
+        std::string name;
+        int parts = random() % 5;
+        for (int i = 0; i < parts; i++)
+            name += PARTS[random() % std::size(PARTS)];
+        return name;
+    };
+
+    for (int round = 0; round < 50; round++)
+    {
+        SubscriptionTrie<int> trie;
+        std::vector<MatcherPattern> patterns;
+        for (int i = 0; i < 40; i++)
+        {
+            MatcherPattern pattern{random_name(), random() % 2 == 0, i};
+            trie.insert(pattern.topic, pattern.prefix, pattern.value);
+            patterns.push_back(pattern);
+        }
+
+        // removed patterns must neither match nor take other values with them
+        for (int i = 0; i < 10; i++)
+        {
+            size_t index = random() % patterns.size();
+            CHECK(trie.remove(patterns[index].topic, patterns[index].prefix, patterns[index].value));
+            CHECK(!trie.remove(patterns[index].topic, !patterns[index].prefix, patterns[index].value));
+            patterns.erase(patterns.begin() + index);
+        }
+
+        for (int i = 0; i < 100; i++)
+        {
+            std::string name = random_name();
+            std::vector<int> expected;
+            for (const MatcherPattern &pattern : patterns)
+            {
+                if (pattern.matches(name))
+                    expected.push_back(pattern.value);
+            }
+
+            std::vector<int> matched;
+            trie.match(name, [&](const int &value)
+                       { matched.push_back(value); });
+            std::sort(expected.begin(), expected.end());
+            std::sort(matched.begin(), matched.end());
+            CHECK(matched == expected);
+        }
+    }
+}
+
+/// @brief Returns true if two values have the same type and data
+static bool same_value(const NTDataValue &a, const NTDataValue &b)
+{
+    if (a.type != b.type || a.size() != b.size())
+        return false;
+
+    switch (a.getAPIType())
+    {
+    case NTDataType::Bool:
+        return a.b == b.b;
+    case NTDataType::Float64:
+        return a.f64 == b.f64;
+    case NTDataType::Int:
+        return a.i == b.i;
+    case NTDataType::Float32:
+        return a.f32 == b.f32;
+    case NTDataType::Str:
+        return a.str() == b.str();
+    case NTDataType::Bin:
+        return std::equal(a.bin().begin(), a.bin().end(), b.bin().begin());
+    case NTDataType::BoolArray:
+        return a.bArray() == b.bArray();
+    case NTDataType::Float64Array:
+        return std::equal(a.f64Array().begin(), a.f64Array().end(), b.f64Array().begin());
+    case NTDataType::IntArray:
+        return std::equal(a.iArray().begin(), a.iArray().end(), b.iArray().begin());
+    case NTDataType::Float32Array:
+        return std::equal(a.f32Array().begin(), a.f32Array().end(), b.f32Array().begin());
+    case NTDataType::StrArray:
+        return a.strArray() == b.strArray();
+    default:
+        return true;
+    }
+}
+
+/// @brief Values of every type, with payloads that fit inline and payloads that do not
+static std::vector<NTDataValue> sample_values()
+{
+    static const std::vector<double> doubles = {0.5, -2.25, 1e300};
+    static const std::vector<double> manyDoubles(100, 0.1);
+    static const std::vector<int64_t> ints = {-1, 1LL << 40};
+    static const std::vector<float> floats = {0.5f, -3.0f, 7.25f, 1e-3f, 2.0f};
+    static const std::vector<uint8_t> bin = {0x00, 0xff, 0x7f};
+    static const std::vector<uint8_t> longBin(40, 0xab);
+
+    std::vector<NTDataValue> values;
+    values.emplace_back(true);
+    values.emplace_back(1.5);
+    values.emplace_back((int64_t)-70000);
+    values.emplace_back(0.25f);
+    values.emplace_back((uint64_t)1 << 40);
+    values.emplace_back(""sv);
+    values.emplace_back("sixteen chars ok"sv);
+    values.emplace_back("seventeen chars!!"sv);
+    values.emplace_back(NTDataType::Json, "{\"key\":[1,2,3],\"other\":null}"sv);
+    values.emplace_back(std::span<const uint8_t>(bin));
+    values.emplace_back(NTDataType::Raw, std::span<const uint8_t>(longBin));
+    values.emplace_back(std::vector<bool>{true, false, true});
+    values.emplace_back(std::vector<bool>(130, true));
+    values.emplace_back(std::span<const double>(doubles));
+    values.emplace_back(std::span<const double>(manyDoubles));
+    values.emplace_back(std::span<const int64_t>(ints));
+    values.emplace_back(std::span<const float>(floats));
+    values.emplace_back(std::vector<std::string>{});
+    values.emplace_back(std::vector<std::string>{"a", "", "a longer string than fits inline"});
+    return values;
+}
+
+TEST(round_trips_values_of_every_type)
+{
+    for (const NTDataValue &value : sample_values())
+    {
+        msgpack::Packer<false> packer;
+        value.pack(packer);
+        msgpack::Unpacker<false> unpacker(packer.data(), packer.size());
+        NTDataValue decoded(value.type, unpacker);
+        CHECK(!unpacker.ec);
+        CHECK_EQ(unpacker.bytes(), packer.size());
+        CHECK(same_value(decoded, value));
+    }
+}
+
+TEST(copies_moves_and_assigns_values)
+{
+    for (const NTDataValue &value : sample_values())
+    {
+        NTDataValue copy(value);
+        CHECK(same_value(copy, value));
+
+        NTDataValue moved(std::move(copy));
+        CHECK(same_value(moved, value));
+
+        NTDataValue copyAssigned(NTDataType::Unassigned);
+        copyAssigned = moved;
+        CHECK(same_value(copyAssigned, value));
+        copyAssigned = copyAssigned;
+        CHECK(same_value(copyAssigned, value));
+
+        NTDataValue moveAssigned((int64_t)1);
+        moveAssigned = std::move(moved);
+        CHECK(same_value(moveAssigned, value));
+
+        // assign keeps the type of an assigned value and replaces the data
+        NTDataValue assigned(value.type);
+        assigned.assign(value);
+        CHECK(same_value(assigned, value));
+        assigned.assign(value);
+        CHECK(same_value(assigned, value));
+        NTDataValue taken(value.type);
+        taken.assign(std::move(assigned));
+        CHECK(same_value(taken, value));
+    }
+}
+
+TEST(shares_snapshots_until_the_last_reference_is_released)
+{
+    static const std::vector<double> first(40, 1.0);
+    static const std::vector<double> second(40, 2.0);
+
+    NTValueSnapshot shared{NTDataValue(std::span<const double>(first))};
+    CHECK(shared.unique());
+
+    // a reader shares the value instead of copying it
+    NTValueSnapshot reader = NTValueSnapshot::load(shared);
+    CHECK(!shared.unique());
+    CHECK(&*reader == &*shared);
+
+    // a store swaps in a new value, the reader keeps the old one alive
+    NTValueSnapshot::store(shared, NTValueSnapshot(NTDataValue(std::span<const double>(second))));
+    CHECK(shared.unique());
+    CHECK(reader.unique());
+    CHECK_EQ(reader->f64Array()[39], 1.0);
+    CHECK_EQ(shared->f64Array()[39], 2.0);
+
+    // copies and moves only move the reference
+    NTValueSnapshot copy = reader;
+    NTValueSnapshot moved = std::move(copy);
+    CHECK(!copy);
+    CHECK(&*moved == &*reader);
+    copy = moved;
+    copy = copy;
+    CHECK(!reader.unique());
+    reader = NTValueSnapshot();
+    moved = NTValueSnapshot();
+    CHECK(copy.unique());
+    CHECK_EQ(copy->f64Array()[0], 1.0);
+}
+
+TEST(keeps_the_value_a_subscriber_read_while_the_topic_changes)
+{
+    NetworkTableInstance *nt = server();
+    std::vector<double> values(40, 1.0);
+    NTPublisher publisher(nt, "/local/snapshot"s, NTDataValue(std::span<const double>(values)));
+    NTSubscriber subscriber(nt, "/local/snapshot"s);
+
+    NTValueSnapshot held = subscriber.getSnapshot();
+    REQUIRE(held);
+    CHECK_EQ(held->f64Array()[0], 1.0);
+
+    // the topic is updated while a reader holds the previous value, the reader keeps it
+    for (int i = 2; i <= 5; i++)
+    {
+        std::fill(values.begin(), values.end(), (double)i);
+        publisher.setDoubleArray(values);
+        NTValueSnapshot latest = subscriber.getSnapshot();
+        REQUIRE(latest);
+        CHECK(&*latest != &*held);
+        CHECK_EQ(latest->f64Array()[39], (double)i);
+    }
+    CHECK_EQ(held->size(), (size_t)40);
+    CHECK_EQ(held->f64Array()[39], 1.0);
+
+    held = NTValueSnapshot();
+    CHECK(subscriber.getDoubleArray({}) == values);
+}
+
+TEST_MAIN()
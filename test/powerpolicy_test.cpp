@@ -0,0 +1,128 @@
+#include <vector>
+#include "testing.h"
+#include "powerpolicy.h"
+
+/// @brief Frames seen in one update of a traffic trace
+struct TraceStep
+{
+    uint32_t timeMs;
+    uint32_t frames;
+};
+
+/// @brief Feeds a traffic trace into a policy, updated every 100 ms like the link task
+/// @return The mode after every update
+static std::vector<WifiPowerMode> replay(WifiPowerPolicy &policy, uint32_t endMs, const std::vector<TraceStep> &trace)
+{
+    std::vector<WifiPowerMode> modes;
+    size_t next = 0;
+    for (uint32_t now = 0; now <= endMs; now += 100)
+    {
+        uint32_t frames = 0;
+        for (; next < trace.size() && trace[next].timeMs <= now; next++)
+            frames += trace[next].frames;
+        modes.push_back(policy.update(now, frames));
+    }
+    return modes;
+}
+
+static int count_switches(const std::vector<WifiPowerMode> &modes)
+{
+    int switches = 0;
+    for (size_t i = 1; i < modes.size(); i++)
+    {
+        if (modes[i] != modes[i - 1])
+            switches++;
+    }
+    return switches;
+}
+
+TEST(stays_in_performance_without_a_latency_budget)
+{
+    WifiPowerPolicy policy(POWER_POLICY_BEACON_INTERVAL_MS - 1);
+    CHECK_EQ(policy.getListenBeacons(), 0u);
+
+    std::vector<WifiPowerMode> modes = replay(policy, 60000, {});
+    CHECK(modes.back() == WifiPowerMode::Performance);
+    CHECK_EQ(count_switches(modes), 0);
+}
+
+TEST(sleeps_through_the_beacons_of_the_latency_budget)
+{
+    CHECK_EQ(WifiPowerPolicy(300).getListenBeacons(), 2u);
+    CHECK_EQ(WifiPowerPolicy(POWER_POLICY_BEACON_INTERVAL_MS).getListenBeacons(), 1u);
+    CHECK_EQ(WifiPowerPolicy(60000).getListenBeacons(), POWER_POLICY_MAX_LISTEN_BEACONS);
+}
+
+TEST(enters_power_save_after_the_idle_timeout)
+{
+    WifiPowerPolicy policy(300, 1000, 3, 5000);
+    policy.reset(0);
+
+    CHECK(policy.update(4900, 0) == WifiPowerMode::Performance);
+    CHECK(policy.update(5000, 0) == WifiPowerMode::PowerSave);
+    CHECK(policy.getMode() == WifiPowerMode::PowerSave);
+}
+
+TEST(ignores_sporadic_frames_in_power_save)
+{
+    WifiPowerPolicy policy(300, 1000, 3, 5000);
+    policy.reset(0);
+    REQUIRE(policy.update(5000, 0) == WifiPowerMode::PowerSave);
+
+    // keepalives below the active frame count of a window do not wake the radio
+    for (uint32_t now = 5500; now < 20000; now += 1500)
+        CHECK(policy.update(now, 2) == WifiPowerMode::PowerSave);
+}
+
+TEST(wakes_on_a_burst_and_sleeps_only_after_another_idle_timeout)
+{
+    WifiPowerPolicy policy(300, 1000, 3, 5000);
+    policy.reset(0);
+    REQUIRE(policy.update(5000, 0) == WifiPowerMode::PowerSave);
+
+    CHECK(policy.update(6000, 3) == WifiPowerMode::Performance);
+    CHECK(policy.update(10900, 0) == WifiPowerMode::Performance);
+    CHECK(policy.update(11000, 0) == WifiPowerMode::PowerSave);
+}
+
+TEST(follows_a_dashboard_session_without_flapping)
+{
+    WifiPowerPolicy policy(500);
+    policy.reset(0);
+
+    // a dashboard at 50 Hz for 20 s, 30 s of idle with a keepalive per second, then another 10 s session
+    std::vector<TraceStep> trace;
+    for (uint32_t t = 0; t < 20000; t += 20)
+        trace.push_back({t, 1});
+    for (uint32_t t = 20000; t < 50000; t += 1000)
+        trace.push_back({t, 1});
+    for (uint32_t t = 50000; t < 60000; t += 20)
+        trace.push_back({t, 1});
+
+    std::vector<WifiPowerMode> modes = replay(policy, 60000, trace);
+
+    // asleep 5 s after the last window with enough frames, awake within one update of the second session
+    CHECK(modes[258] == WifiPowerMode::Performance);
+    CHECK(modes[259] == WifiPowerMode::PowerSave);
+    CHECK(modes[500] == WifiPowerMode::PowerSave);
+    CHECK(modes[501] == WifiPowerMode::Performance);
+    CHECK_EQ(count_switches(modes), 2);
+}
+
+TEST(applies_a_changed_latency_budget)
+{
+    WifiPowerPolicy policy(300);
+    policy.reset(0);
+    REQUIRE(policy.update(5000, 0) == WifiPowerMode::PowerSave);
+
+    policy.setLatencyBudget(0);
+    CHECK(policy.update(5100, 0) == WifiPowerMode::Performance);
+    CHECK_EQ(policy.getListenBeacons(), 0u);
+
+    // a new budget still needs the idle timeout
+    policy.setLatencyBudget(300);
+    CHECK(policy.update(10000, 0) == WifiPowerMode::Performance);
+    CHECK(policy.update(10100, 0) == WifiPowerMode::PowerSave);
+}
+
+TEST_MAIN()
@@ -0,0 +1,180 @@
+#include <vector>
+#include "testing.h"
+#include "hostsim.h"
+#include "pico/cyw43_arch.h"
+#include "radio.h"
+#include "config.h"
+
+/// @brief The link events of a radio with their virtual times
+struct LinkEvents
+{
+    std::vector<uint64_t> upTimes;
+    std::vector<uint32_t> upDurations;
+    std::vector<uint64_t> downTimes;
+    std::vector<int> downStatuses;
+};
+
+static void on_link_up(Radio *radio, uint32_t linkUpTimeMs, void *args)
+{
+    LinkEvents *events = (LinkEvents *)args;
+    events->upTimes.push_back(hostsim::now());
+    events->upDurations.push_back(linkUpTimeMs);
+}
+
+static void on_link_down(Radio *radio, int status, void *args)
+{
+    LinkEvents *events = (LinkEvents *)args;
+    events->downTimes.push_back(hostsim::now());
+    events->downStatuses.push_back(status);
+}
+
+/// @brief Creates a radio that joins in the background and records its link events
+static Radio *start_radio(LinkEvents *events)
+{
+    Radio *radio = new Radio(false);
+    // the first join attempt cannot finish before the clock advances
+    radio->callbackArgs = events;
+    radio->linkUp.Add(on_link_up);
+    radio->linkDown.Add(on_link_down);
+    return radio;
+}
+
+TEST(joins_in_the_background_and_reports_the_link_up_time)
+{
+    hostsim::resetWifi();
+    hostsim::queueWifiJoin(CYW43_LINK_UP, 1200);
+
+    uint64_t startUs = hostsim::now();
+    LinkEvents events;
+    Radio *radio = start_radio(&events);
+    CHECK_EQ(hostsim::now(), startUs);
+    CHECK(!radio->isLinkUp());
+
+    REQUIRE(radio->waitForLinkUp(5000));
+    CHECK_EQ(radio->getLinkUpTime(), 1200u);
+    REQUIRE(events.upTimes.size() == 1);
+    // woken by the netif callback instead of the next poll
+    CHECK_EQ(events.upTimes[0] - startUs, 1200000u);
+    CHECK_EQ(events.upDurations[0], 1200u);
+    CHECK_EQ(hostsim::wifiStats().joins, 1);
+
+    delete radio;
+}
+
+TEST(retries_failed_joins_with_exponential_backoff)
+{
+    hostsim::resetWifi();
+    hostsim::queueWifiJoin(CYW43_LINK_FAIL, 100);
+    hostsim::queueWifiJoin(CYW43_LINK_NONET, 100);
+    hostsim::queueWifiJoin(CYW43_LINK_UP, 100);
+
+    LinkEvents events;
+    Radio *radio = start_radio(&events);
+    REQUIRE(radio->waitForLinkUp(10000));
+
+    // 100 ms join, 500 ms backoff, 100 ms join, 1000 ms backoff, 100 ms join
+    CHECK_EQ(radio->getLinkUpTime(), 1800u);
+    CHECK_EQ(hostsim::wifiStats().joins, 3);
+    CHECK_EQ(hostsim::wifiStats().fastJoins, 0);
+    CHECK_EQ(events.upTimes.size(), (size_t)1);
+
+    delete radio;
+}
+
+TEST(rejoins_the_last_access_point_after_a_link_drop)
+{
+    hostsim::resetWifi();
+    hostsim::queueWifiJoin(CYW43_LINK_UP, 100);
+
+    LinkEvents events;
+    Radio *radio = start_radio(&events);
+    REQUIRE(radio->waitForLinkUp(5000));
+
+    hostsim::queueWifiJoin(CYW43_LINK_UP, 50);
+    uint64_t dropUs = hostsim::now();
+    hostsim::dropWifiLink(CYW43_LINK_DOWN);
+    hostsim::sleepMs(500);
+
+    // the drop is noticed through the netif callback, the rejoin skips the scan
+    REQUIRE(events.downTimes.size() == 1);
+    CHECK_EQ(events.downTimes[0], dropUs);
+    CHECK_EQ(events.downStatuses[0], CYW43_LINK_DOWN);
+    REQUIRE(events.upTimes.size() == 2);
+    CHECK_EQ(events.upDurations[1], 50u);
+    CHECK_EQ(hostsim::wifiStats().joins, 2);
+    CHECK_EQ(hostsim::wifiStats().fastJoins, 1);
+    CHECK(radio->isLinkUp());
+
+    delete radio;
+}
+
+TEST(scans_again_when_the_last_access_point_is_gone)
+{
+    hostsim::resetWifi();
+    hostsim::queueWifiJoin(CYW43_LINK_UP, 100);
+
+    LinkEvents events;
+    Radio *radio = start_radio(&events);
+    REQUIRE(radio->waitForLinkUp(5000));
+
+    hostsim::queueWifiJoin(CYW43_LINK_NONET, 50);
+    hostsim::queueWifiJoin(CYW43_LINK_UP, 300);
+    hostsim::dropWifiLink(CYW43_LINK_DOWN);
+    hostsim::sleepMs(1000);
+
+    // the failed fast join falls back to a full join right away, without a backoff
+    REQUIRE(events.upTimes.size() == 2);
+    CHECK_EQ(events.upDurations[1], 350u);
+    CHECK_EQ(hostsim::wifiStats().joins, 3);
+    CHECK_EQ(hostsim::wifiStats().fastJoins, 1);
+
+    delete radio;
+}
+
+TEST(gives_up_after_the_retry_count_and_can_start_again)
+{
+    hostsim::resetWifi();
+    for (int i = 0; i < NET_RETRY_COUNT; i++)
+        hostsim::queueWifiJoin(CYW43_LINK_BADAUTH, 10);
+
+    LinkEvents events;
+    Radio *radio = start_radio(&events);
+    CHECK(!radio->waitForLinkUp(60000));
+    CHECK(radio->getLinkState() == RadioLinkState::Failed);
+    CHECK_EQ(hostsim::wifiStats().joins, NET_RETRY_COUNT);
+    CHECK(events.upTimes.empty());
+
+    hostsim::queueWifiJoin(CYW43_LINK_UP, 10);
+    radio->start();
+    REQUIRE(radio->waitForLinkUp(5000));
+    CHECK_EQ(hostsim::wifiStats().joins, NET_RETRY_COUNT + 1);
+
+    delete radio;
+}
+
+TEST(switches_the_driver_power_mode_with_traffic)
+{
+    hostsim::resetWifi();
+    hostsim::queueWifiJoin(CYW43_LINK_UP, 100);
+
+    LinkEvents events;
+    Radio *radio = start_radio(&events);
+    REQUIRE(radio->waitForLinkUp(5000));
+    CHECK_EQ(hostsim::wifiStats().pm & 0xf, (uint32_t)CYW43_NO_POWERSAVE_MODE);
+
+    // two beacons of wake latency, applied after the idle timeout
+    radio->setLatencyBudget(300);
+    hostsim::sleepMs(6000);
+    CHECK(radio->getPowerMode() == WifiPowerMode::PowerSave);
+    CHECK_EQ(hostsim::wifiStats().pm, cyw43_pm_value(CYW43_PM2_POWERSAVE_MODE, RADIO_POWER_SAVE_SLEEP_RET_MS, 2, 0, 2));
+
+    // a burst of frames wakes the link task right away
+    radio->notifyActivity(3);
+    hostsim::sleepMs(1);
+    CHECK(radio->getPowerMode() == WifiPowerMode::Performance);
+    CHECK_EQ(hostsim::wifiStats().pm & 0xf, (uint32_t)CYW43_NO_POWERSAVE_MODE);
+
+    delete radio;
+}
+
+TEST_MAIN()
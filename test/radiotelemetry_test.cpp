@@ -0,0 +1,104 @@
+#include <string>
+#include "testing.h"
+#include "hostsim.h"
+#include "ntclient.h"
+#include "pico/cyw43_arch.h"
+#include "radio.h"
+#include "radiotelemetry.h"
+#include "nt/ntsubscriber.h"
+
+using namespace std::literals;
+
+TEST(publishes_the_link_quality_of_the_simulated_driver)
+{
+    hostsim::resetWifi();
+    hostsim::setWifiLinkQuality(-55, 11, 0);
+    hostsim::queueWifiJoin(CYW43_LINK_UP, 250);
+
+    Radio radio(false);
+    NetworkTableInstance *nt = new NetworkTableInstance();
+    nt->startServer(&radio);
+
+    // subscribed before the telemetry announces its topics
+    NTSubscriber rssi(nt, "$radio/rssi"s);
+    NTSubscriber linkStatus(nt, "$radio/linkStatus"s);
+    NTSubscriber channel(nt, "$radio/channel"s);
+    NTSubscriber stations(nt, "$radio/stations"s);
+    NTSubscriber linkUpTime(nt, "$radio/linkUpTimeMs"s);
+    RadioTelemetry *telemetry = new RadioTelemetry(&radio, nt, 100);
+
+    // still joining, there is no channel yet and the signal strength is not announced
+    hostsim::sleepMs(150);
+    CHECK_EQ(linkStatus.getInt(-100), (int64_t)CYW43_LINK_JOIN);
+    CHECK_EQ(channel.getInt(-100), (int64_t)-1);
+    CHECK_EQ(rssi.getInt(-100), (int64_t)-100);
+
+    // the first sample after the link is up
+    hostsim::sleepMs(200);
+    CHECK_EQ(linkStatus.getInt(-100), (int64_t)CYW43_LINK_UP);
+    CHECK_EQ(rssi.getInt(-100), (int64_t)-55);
+    CHECK_EQ(channel.getInt(-100), (int64_t)11);
+    CHECK_EQ(linkUpTime.getInt(-100), (int64_t)250);
+    // station mode has no associated stations, the topic is never announced
+    CHECK_EQ(stations.getInt(-100), (int64_t)-100);
+
+    hostsim::setWifiLinkQuality(-72, 11, 0);
+    hostsim::sleepMs(100);
+    CHECK_EQ(rssi.getInt(-100), (int64_t)-72);
+
+    // a lost link keeps the last signal strength, the rejoin never finishes
+    hostsim::dropWifiLink(CYW43_LINK_DOWN);
+    hostsim::sleepMs(100);
+    CHECK_EQ(linkStatus.getInt(-100), (int64_t)CYW43_LINK_JOIN);
+    CHECK_EQ(channel.getInt(-100), (int64_t)-1);
+    CHECK_EQ(rssi.getInt(-100), (int64_t)-72);
+
+    delete telemetry;
+    nt->stop();
+    radio.deinit();
+}
+
+TEST(only_publishes_changed_values)
+{
+    hostsim::resetWifi();
+    hostsim::setWifiLinkQuality(-60, 1, 0);
+    hostsim::queueWifiJoin(CYW43_LINK_UP, 10);
+
+    Radio radio(true);
+    REQUIRE(radio.isLinkUp());
+    NetworkTableInstance *nt = new NetworkTableInstance();
+    nt->startServer(&radio);
+    RadioTelemetry *telemetry = new RadioTelemetry(&radio, nt, 100);
+
+    // the server may still be closing the connection when the test returns
+    static NtTestClient client;
+    REQUIRE(client.connect("telemetry"sv));
+    client.subscribe(1, "$radio/"sv, "{\"prefix\":true,\"all\":true,\"periodic\":0}"sv);
+    client.poll(200);
+    REQUIRE(client.topicId("$radio/rssi"sv) >= 0);
+    CHECK(client.topicId("$radio/stations"sv) < 0);
+    // the signal strength was announced with its sampled value, not a placeholder
+    for (const NtTestUpdate &update : client.updates)
+        if (update.id == client.topicId("$radio/rssi"sv))
+            CHECK_EQ(update.value.i, (int64_t)-60);
+    client.updates.clear();
+
+    // a second of samples without a change sends nothing
+    client.poll(1000);
+    CHECK(client.updates.empty());
+
+    hostsim::setWifiLinkQuality(-61, 1, 0);
+    client.poll(200);
+    REQUIRE(client.updates.size() == 1);
+    CHECK_EQ(client.updates[0].id, client.topicId("$radio/rssi"sv));
+    CHECK_EQ(client.updates[0].value.i, (int64_t)-61);
+
+    client.disconnect();
+    // stopped once the server has seen the disconnect
+    hostsim::sleepMs(100);
+    delete telemetry;
+    nt->stop();
+    radio.deinit();
+}
+
+TEST_MAIN()
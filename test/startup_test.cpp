@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string>
+#include "testing.h"
+#include "hostsim.h"
+#include "ntclient.h"
+#include "pico/cyw43_arch.h"
+#include "radio.h"
+#include "nt/ntpublisher.h"
+#include "nt/ntsubscriber.h"
+
+using namespace std::literals;
+
+// Startup times of the pipelined boot against the blocking one, on a join of JOIN_DELAY_MS.
+// The dashboard connects right away, its connection is accepted once the server is bound.
+
+static constexpr uint32_t JOIN_DELAY_MS = 800;
+
+/// @brief Milliseconds of virtual time since a start time
+static uint32_t elapsed_ms(uint64_t startUs)
+{
+    return (uint32_t)((hostsim::now() - startUs) / 1000);
+}
+
+/// @brief The startup times of one boot sequence in milliseconds
+struct StartupTimes
+{
+    uint32_t firstLocalPublish;
+    uint32_t firstClient;
+};
+
+static void print_times(const char *sequence, const StartupTimes &times)
+{
+    printf("STARTUP %-10s first local publish %5u ms, first client %5u ms\n", sequence, times.firstLocalPublish, times.firstClient);
+}
+
+/// @brief Disconnects the client and stops the server once it has seen the disconnect
+static void stop_server(NetworkTableInstance *nt, NtTestClient &client)
+{
+    client.disconnect();
+    hostsim::sleepMs(100);
+    nt->stop();
+}
+
+TEST(pipelined_boot_publishes_before_the_link_is_up)
+{
+    hostsim::resetWifi();
+    hostsim::queueWifiJoin(CYW43_LINK_UP, JOIN_DELAY_MS);
+
+    uint64_t startUs = hostsim::now();
+    Radio radio(false);
+    NetworkTableInstance *nt = new NetworkTableInstance();
+    nt->startServer(&radio);
+
+    StartupTimes times;
+    NTPublisher publisher(nt, "/robot/ready"s, NTDataValue(false));
+    NTSubscriber subscriber(nt, "/robot/ready"s);
+    publisher.setBoolean(true);
+    REQUIRE(subscriber.getBoolean(false));
+    times.firstLocalPublish = elapsed_ms(startUs);
+    CHECK(!radio.isLinkUp());
+
+    // the server may still be closing the connection when the test returns
+    static NtTestClient client;
+    REQUIRE(client.connect("dashboard"sv));
+    times.firstClient = elapsed_ms(startUs);
+    print_times("pipelined", times);
+
+    CHECK_EQ(times.firstLocalPublish, 0u);
+    CHECK_EQ(times.firstClient, JOIN_DELAY_MS);
+
+    // the value published before the bind reaches the client
+    client.subscribe(1, "/robot/ready"sv, "{\"periodic\":0}"sv);
+    client.poll();
+    int64_t id = client.topicId("/robot/ready"sv);
+    REQUIRE(id >= 0);
+    REQUIRE(!client.updates.empty());
+    CHECK_EQ(client.updates.back().id, id);
+    CHECK(client.updates.back().value.b);
+
+    stop_server(nt, client);
+    radio.deinit();
+}
+
+TEST(blocking_boot_publishes_after_the_join)
+{
+    hostsim::resetWifi();
+    hostsim::queueWifiJoin(CYW43_LINK_UP, JOIN_DELAY_MS);
+
+    uint64_t startUs = hostsim::now();
+    Radio radio(true);
+    REQUIRE(radio.isLinkUp());
+    NetworkTableInstance *nt = new NetworkTableInstance();
+    nt->startServer();
+
+    StartupTimes times;
+    NTPublisher publisher(nt, "/robot/ready"s, NTDataValue(false));
+    NTSubscriber subscriber(nt, "/robot/ready"s);
+    publisher.setBoolean(true);
+    REQUIRE(subscriber.getBoolean(false));
+    times.firstLocalPublish = elapsed_ms(startUs);
+
+    static NtTestClient client;
+    REQUIRE(client.connect("dashboard"sv));
+    times.firstClient = elapsed_ms(startUs);
+    print_times("blocking", times);
+
+    // the whole store waits for the join, the client is not accepted any earlier
+    CHECK(times.firstLocalPublish >= JOIN_DELAY_MS);
+    CHECK(times.firstClient >= JOIN_DELAY_MS);
+
+    stop_server(nt, client);
+    radio.deinit();
+}
+
+TEST_MAIN()
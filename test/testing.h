@@ -0,0 +1,138 @@
+#ifndef _TESTING_H_
+#define _TESTING_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/// @brief A minimal test runner for the host tests, every test executable is registered with ctest
+namespace testing
+{
+    struct Case
+    {
+        const char *name;
+        void (*function)();
+    };
+
+    inline std::vector<Case> &cases()
+    {
+        static std::vector<Case> instance;
+        return instance;
+    }
+
+    inline int failures = 0;
+
+    struct Registration
+    {
+        Registration(const char *name, void (*function)())
+        {
+            cases().push_back({name, function});
+        }
+    };
+
+    inline void fail(const char *file, int line, const std::string &message)
+    {
+        printf("%s:%d: check failed: %s\n", file, line, message.c_str());
+        failures++;
+    }
+
+    template <typename T>
+    std::string describe(const T &value)
+    {
+        if constexpr (std::is_arithmetic_v<T>)
+            return std::to_string(value);
+        else if constexpr (std::is_enum_v<T>)
+            return std::to_string((long long)value);
+        else if constexpr (std::is_convertible_v<T, std::string_view>)
+            return "\"" + std::string(std::string_view(value)) + "\"";
+        else
+            return "?";
+    }
+
+    /// @brief Runs all registered tests and exits, without running the destructors of the still running tasks
+    inline int run()
+    {
+        for (const Case &test : cases())
+        {
+            printf("[ RUN      ] %s\n", test.name);
+            fflush(stdout);
+            int before = failures;
+            test.function();
+            printf("[ %s ] %s\n", failures == before ? "      OK" : " FAILED ", test.name);
+            fflush(stdout);
+        }
+
+        printf("%zu tests, %d failed checks\n", cases().size(), failures);
+        fflush(stdout);
+        fflush(stderr);
+        _Exit(failures == 0 ? 0 : 1);
+    }
+
+    /// @brief Times a function until it ran for at least minMs of wall-clock time
+    /// @return The mean time per call in nanoseconds
+    template <typename F>
+    double measure(const char *name, F &&function, uint32_t minMs = 200)
+    {
+        using clock = std::chrono::steady_clock;
+        uint64_t iterations = 0;
+        auto start = clock::now();
+        auto elapsed = clock::duration::zero();
+        do
+        {
+            for (int i = 0; i < 16; i++)
+                function();
+            iterations += 16;
+            elapsed = clock::now() - start;
+        } while (elapsed < std::chrono::milliseconds(minMs));
+
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+        printf("BENCH %-48s %12.1f ns/op %14.0f op/s (%llu iterations)\n", name, ns, 1e9 / ns, (unsigned long long)iterations);
+        fflush(stdout);
+        return ns;
+    }
+}
+
+#define TEST(name)                                                             \
+    static void test_##name();                                                 \
+    static testing::Registration registration_##name(#name, test_##name);      \
+    static void test_##name()
+
+#define CHECK(condition)                                         \
+    do                                                           \
+    {                                                            \
+        if (!(condition))                                        \
+            testing::fail(__FILE__, __LINE__, #condition);       \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                                    \
+    do                                                                                                                \
+    {                                                                                                                 \
+        auto &&actual_ = (actual);                                                                                    \
+        auto &&expected_ = (expected);                                                                                \
+        if (!(actual_ == expected_))                                                                                  \
+            testing::fail(__FILE__, __LINE__, #actual " == " #expected " (" + testing::describe(actual_) + " vs " + \
+                                                  testing::describe(expected_) + ")");                                \
+    } while (0)
+
+#define REQUIRE(condition)                                       \
+    do                                                           \
+    {                                                            \
+        if (!(condition))                                        \
+        {                                                        \
+            testing::fail(__FILE__, __LINE__, #condition);       \
+            return;                                              \
+        }                                                        \
+    } while (0)
+
+#define TEST_MAIN()          \
+    int main()               \
+    {                        \
+        return testing::run(); \
+    }
+
+#endif
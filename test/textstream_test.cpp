@@ -0,0 +1,118 @@
+#include <string>
+#include "testing.h"
+#include "faketcp.h"
+#include "textstream.h"
+
+using namespace std::literals;
+
+TEST(reads_lines_with_any_line_ending)
+{
+    FakeTcpConnection connection;
+    connection.push("first\r\nsecond\nthird\rfourth\r\n\r\n"sv);
+    TcpClient *client = faketcp::connect(&connection);
+    TextStream stream(client);
+
+    TextStreamResult result;
+    CHECK_EQ(stream.readLine(1000, &result), "first"sv);
+    CHECK(result == TextStreamResult::Ok);
+    CHECK_EQ(stream.readLine(1000, &result), "second"sv);
+    CHECK_EQ(stream.readLine(1000, &result), "third"sv);
+    CHECK_EQ(stream.readLine(1000, &result), "fourth"sv);
+    CHECK_EQ(stream.readLine(1000, &result), ""sv);
+    CHECK(result == TextStreamResult::Ok);
+    delete client;
+}
+
+TEST(reassembles_lines_split_across_reads)
+{
+    FakeTcpConnection connection;
+    connection.segmentSize = 3;
+    connection.push("GET /nt/client HTTP/1.1\r\nHost: 10.67.31\r\n\r\n"sv);
+    TcpClient *client = faketcp::connect(&connection);
+    TextStream stream(client, 16);
+
+    TextStreamResult result;
+    CHECK_EQ(stream.readLine(1000, &result), ""sv);
+    CHECK(result == TextStreamResult::LineTooLong);
+    CHECK_EQ(stream.readLine(1000, &result), "Host: 10.67.31"sv);
+    CHECK(result == TextStreamResult::Ok);
+    CHECK_EQ(stream.readLine(1000, &result), ""sv);
+    CHECK(result == TextStreamResult::Ok);
+    delete client;
+}
+
+TEST(wraps_lines_around_the_ring_buffer)
+{
+    FakeTcpConnection connection;
+    connection.segmentSize = 5;
+    std::string input;
+    for (int i = 0; i < 50; i++)
+        input += "line" + std::to_string(i) + "\r\n";
+    connection.push(input);
+    TcpClient *client = faketcp::connect(&connection);
+    TextStream stream(client, 16);
+
+    for (int i = 0; i < 50; i++)
+    {
+        TextStreamResult result;
+        std::string expected = "line" + std::to_string(i);
+        CHECK_EQ(stream.readLine(1000, &result), std::string_view(expected));
+        CHECK(result == TextStreamResult::Ok);
+    }
+    delete client;
+}
+
+TEST(discards_overlong_lines_and_resynchronizes)
+{
+    FakeTcpConnection connection;
+    connection.segmentSize = 7;
+    connection.push(std::string(100, 'x') + "\r\nshort\r\n");
+    TcpClient *client = faketcp::connect(&connection);
+    TextStream stream(client, 32);
+
+    TextStreamResult result;
+    CHECK_EQ(stream.readLine(1000, &result), ""sv);
+    CHECK(result == TextStreamResult::LineTooLong);
+    CHECK_EQ(stream.readLine(1000, &result), "short"sv);
+    CHECK(result == TextStreamResult::Ok);
+    delete client;
+}
+
+TEST(reports_timeout_and_disconnect)
+{
+    FakeTcpConnection connection;
+    connection.push("partial"sv);
+    TcpClient *client = faketcp::connect(&connection);
+    TextStream stream(client);
+
+    TextStreamResult result;
+    CHECK_EQ(stream.readLine(100, &result), ""sv);
+    CHECK(result == TextStreamResult::Timeout);
+
+    // the partial line is kept across the timeout
+    connection.push(" line\n"sv);
+    CHECK_EQ(stream.readLine(100, &result), "partial line"sv);
+    CHECK(result == TextStreamResult::Ok);
+
+    connection.closeInput();
+    CHECK_EQ(stream.readLine(100, &result), ""sv);
+    CHECK(result == TextStreamResult::Disconnected);
+    delete client;
+}
+
+TEST(enforces_the_maximum_line_length)
+{
+    FakeTcpConnection connection;
+    connection.push("0123456789\n01234\n"sv);
+    TcpClient *client = faketcp::connect(&connection);
+    TextStream stream(client, 64, 8);
+
+    TextStreamResult result;
+    CHECK_EQ(stream.readLine(1000, &result), ""sv);
+    CHECK(result == TextStreamResult::LineTooLong);
+    CHECK_EQ(stream.readLine(1000, &result), "01234"sv);
+    CHECK(result == TextStreamResult::Ok);
+    delete client;
+}
+
+TEST_MAIN()
@@ -0,0 +1,146 @@
+#include <string>
+#include <vector>
+#include "testing.h"
+#include "hostsim.h"
+#include "pico/cyw43_arch.h"
+#include "udpsocket.h"
+
+struct ReceivedDatagrams
+{
+    std::vector<std::string> payloads;
+};
+
+static void on_receive(UdpSocket *socket, Datagram *datagram, void *args)
+{
+    char buffer[64];
+    uint16_t length = datagram->copyTo(buffer, sizeof(buffer));
+    ((ReceivedDatagrams *)args)->payloads.emplace_back(buffer, length);
+}
+
+struct SendCompletions
+{
+    int count = 0;
+};
+
+static void on_send_complete(UdpSocket *socket, const void *data, void *args)
+{
+    ((SendCompletions *)args)->count++;
+}
+
+TEST(queues_received_datagrams_until_they_are_processed)
+{
+    UdpSocket socket(5900);
+    ReceivedDatagrams received;
+    socket.receiveCallback = on_receive;
+    socket.callbackArgs = &received;
+    REQUIRE(socket.enableReceiveQueue(4));
+
+    // the lwIP thread only queues the datagrams, the ones that do not fit are dropped
+    ip_addr_t from = IPADDR4_INIT_BYTES(127, 0, 0, 1);
+    for (int i = 0; i < 6; i++)
+    {
+        std::string payload = "datagram " + std::to_string(i);
+        hostsim::deliverUdp(socket.udp, payload.data(), payload.size(), &from, 5901);
+    }
+    CHECK(received.payloads.empty());
+    CHECK_EQ(socket.stats.received, 6u);
+    CHECK(socket.stats.dropped > 0);
+    CHECK_EQ(socket.stats.queueHighWater, 6u - socket.stats.dropped);
+
+    // the application task gets the queued datagrams in order
+    size_t processed = socket.processReceiveQueue(16, 0);
+    CHECK_EQ(processed, (size_t)(6 - socket.stats.dropped));
+    REQUIRE(received.payloads.size() == processed);
+    for (size_t i = 0; i < processed; i++)
+        CHECK_EQ(received.payloads[i], "datagram " + std::to_string(i));
+    CHECK_EQ(socket.processReceiveQueue(16, 0), (size_t)0);
+
+    socket.deinit();
+}
+
+TEST(passes_a_chained_payload_as_contiguous_data)
+{
+    struct ReadData
+    {
+        bool contiguous = false;
+        std::string payload;
+    } read;
+
+    UdpSocket socket(5900);
+    socket.callbackArgs = &read;
+    socket.receiveCallback = [](UdpSocket *socket, Datagram *datagram, void *args)
+    {
+        ReadData *read = (ReadData *)args;
+        read->contiguous = datagram->isContiguous();
+        read->payload.assign((const char *)datagram->data, datagram->length);
+    };
+
+    // a payload in pbufs of 7 bytes each
+    std::string payload = "a payload that spans several pbufs";
+    ip_addr_t from = IPADDR4_INIT_BYTES(127, 0, 0, 1);
+    hostsim::deliverUdp(socket.udp, payload.data(), payload.size(), &from, 5901, 7);
+    CHECK(read.contiguous);
+    CHECK_EQ(read.payload, payload);
+    CHECK_EQ(socket.stats.dropped, 0u);
+
+    socket.deinit();
+}
+
+TEST(counts_zero_copy_sends_without_a_free_slot)
+{
+    std::vector<std::string> sent;
+    hostsim::setUdpOutput([&](struct udp_pcb *pcb, const uint8_t *data, size_t length, const ip_addr_t *to, uint16_t port)
+                          {
+        sent.emplace_back((const char *)data, length);
+        return ERR_OK; });
+    hostsim::holdUdpPbufs(true);
+
+    UdpSocket socket(5900);
+    static const char payload[] = "value";
+    ip_addr_t to = IPADDR4_INIT_BYTES(127, 0, 0, 1);
+    SendCompletions completions;
+
+    for (size_t i = 0; i < UDP_SOCKET_MAX_PENDING_SENDS; i++)
+    {
+        Datagram datagram(payload, sizeof(payload), &to, 5901);
+        CHECK(socket.sendDatagramRef(&datagram, on_send_complete, &completions));
+    }
+    CHECK_EQ(socket.stats.sendSlotsExhausted, 0u);
+    CHECK_EQ(completions.count, 0);
+
+    // every slot waits for the driver, the send is rejected but still completed
+    Datagram datagram(payload, sizeof(payload), &to, 5901);
+    CHECK(!socket.sendDatagramRef(&datagram, on_send_complete, &completions));
+    CHECK_EQ(socket.stats.sendSlotsExhausted, 1u);
+    CHECK_EQ(completions.count, 1);
+    CHECK_EQ(sent.size(), UDP_SOCKET_MAX_PENDING_SENDS);
+
+    hostsim::holdUdpPbufs(false);
+    CHECK_EQ(completions.count, (int)UDP_SOCKET_MAX_PENDING_SENDS + 1);
+    CHECK(socket.sendDatagramRef(&datagram, on_send_complete, &completions));
+    CHECK_EQ(socket.stats.sendSlotsExhausted, 1u);
+
+    socket.deinit();
+    hostsim::setUdpOutput(nullptr);
+}
+
+TEST(computes_the_broadcast_address_of_an_unconfigured_interface)
+{
+    // an interface without an address yet, as while the radio is still joining
+    struct netif *netif = &cyw43_state.netif[CYW43_ITF_STA];
+    ip4_addr_t address = netif->ip_addr;
+    ip4_addr_t netmask = netif->netmask;
+    ip4_addr_set_u32(&netif->ip_addr, 0);
+    ip4_addr_set_u32(&netif->netmask, 0);
+
+    UdpSocket socket(5900);
+    CHECK_EQ(ip4_addr_get_u32(ip_2_ip4(socket.getBroadcastAddress())), 0xffffffffu);
+
+    netif->ip_addr = address;
+    netif->netmask = netmask;
+    CHECK_EQ(ip4_addr_get_u32(ip_2_ip4(socket.getBroadcastAddress())), ip4_addr_get_u32(&address) | ~ip4_addr_get_u32(&netmask));
+
+    socket.deinit();
+}
+
+TEST_MAIN()